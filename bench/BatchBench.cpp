@@ -0,0 +1,147 @@
+// Measures one 10k-op JSON-RPC batch sent to the automation server over its
+// local socket, as a pipeline tool sends it, with the preview's segment
+// rebuild connected. The batch adds clips with an in-point, trims, moves
+// and removes them on a timeline of 10k clips, so every edit journals one
+// record and every remove shifts the clips after it. Runs once without the
+// journal and once with it, in a temporary directory.
+// Run headless with QT_QPA_PLATFORM=offscreen.
+#include "AutomationServer.h"
+#include "EditJournal.h"
+#include "PreviewRebuild.h"
+#include "Timeline.h"
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLocalSocket>
+#include <QTemporaryDir>
+#include <cstdio>
+
+namespace {
+const int kClips = 10000;
+const int kOps = 10000;
+const double kClipSeconds = 4.0;
+const int kTimeoutMs = 600000;
+
+QJsonObject request(int id, const char *method, const QJsonObject &params)
+{
+    return QJsonObject{{"jsonrpc", "2.0"}, {"id", id}, {"method", method}, {"params", params}};
+}
+
+// Adds, trims, moves and removes in turn, so the clip count stays level
+QByteArray batchLine()
+{
+    QJsonArray batch;
+    int count = kClips;
+    for (int i = 0; i < kOps; ++i) {
+        const int index = int((qint64(i) * 7919) % count);
+        const double start = index * kClipSeconds;
+        switch (i % 4) {
+        case 0:
+            batch.append(request(i, "timeline.add",
+                                 {{"path", QString("add%1.mp4").arg(i)}, {"start", count * kClipSeconds},
+                                  {"duration", kClipSeconds}, {"trimStart", 1.0}}));
+            ++count;
+            break;
+        case 1:
+            batch.append(request(i, "timeline.trim",
+                                 {{"index", index}, {"trimStart", 0.5}, {"duration", kClipSeconds - 0.5}}));
+            break;
+        case 2:
+            batch.append(request(i, "timeline.move", {{"index", index}, {"start", start + 0.25}}));
+            break;
+        default:
+            batch.append(request(i, "timeline.remove", {{"index", index}}));
+            --count;
+            break;
+        }
+    }
+    return QJsonDocument(batch).toJson(QJsonDocument::Compact) + '\n';
+}
+
+struct Run
+{
+    double batchMs;     // Until the batch's answer arrived
+    double rebuiltMs;   // Until the rebuild it scheduled had run
+    qint64 records;
+    bool ok;
+};
+
+Run runBatch(const QByteArray &line, bool journaled)
+{
+    Run run = {0, 0, 0, false};
+    Timeline timeline;
+    for (int i = 0; i < kClips; ++i) {
+        timeline.addClip(QString("clip%1.mp4").arg(i), Timebase::fromSeconds(i * kClipSeconds),
+                         Timebase::fromSeconds(kClipSeconds));
+    }
+
+    QTemporaryDir dir;
+    EditJournal journal;
+    if (journaled && (!dir.isValid() || !journal.open(dir.path(), &timeline))) {
+        std::fprintf(stderr, "batch_bench: can't open a journal\n");
+        return run;
+    }
+    if (journaled) {
+        timeline.setJournal(&journal);
+    }
+
+    PreviewRebuild preview(&timeline);
+    AutomationServer server(&timeline);
+    if (!server.listen(QString("mvideo-batch-bench-%1").arg(QCoreApplication::applicationPid()))) {
+        return run;
+    }
+    QLocalSocket client;
+    client.connectToServer(server.serverName());
+    if (!client.waitForConnected(kTimeoutMs)) {
+        std::fprintf(stderr, "batch_bench: can't connect to the server\n");
+        return run;
+    }
+
+    const int rebuilds = preview.rebuilds();
+    QElapsedTimer timer;
+    QElapsedTimer timeout;
+    timer.start();
+    timeout.start();
+    client.write(line);
+    client.flush();
+    while (!client.canReadLine() && timeout.elapsed() < kTimeoutMs) {
+        QCoreApplication::processEvents();
+    }
+    run.batchMs = timer.nsecsElapsed() / 1e6;
+    while (preview.rebuilds() == rebuilds && timeout.elapsed() < kTimeoutMs) {
+        QCoreApplication::processEvents();
+    }
+    run.rebuiltMs = timer.nsecsElapsed() / 1e6;
+
+    const QJsonArray responses = QJsonDocument::fromJson(client.readLine()).array();
+    run.ok = responses.size() == kOps && preview.rebuilds() == rebuilds + 1;
+    for (const QJsonValue &response : responses) {
+        run.ok = run.ok && !response.toObject().contains("error");
+    }
+    run.records = journaled ? journal.stats().records : 0;
+    return run;
+}
+}
+
+int main(int argc, char *argv[])
+{
+    QApplication app(argc, argv);
+    const QByteArray line = batchLine();
+
+    std::printf("%d ops on %d clips, %d KiB of JSON\n", kOps, kClips, int(line.size() / 1024));
+    std::printf("%10s %12s %12s %14s %10s\n", "journal", "batch ms", "us/op", "rebuilt ms", "records");
+    bool ok = true;
+    for (bool journaled : {false, true}) {
+        const Run run = runBatch(line, journaled);
+        std::printf("%10s %12.1f %12.2f %14.1f %10lld\n", journaled ? "on" : "off", run.batchMs,
+                    run.batchMs * 1e3 / kOps, run.rebuiltMs, static_cast<long long>(run.records));
+        ok = ok && run.ok;
+    }
+    if (!ok) {
+        std::fprintf(stderr, "batch_bench: an edit failed, timed out or wasn't rebuilt once\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,116 @@
+// Measures how chunk-parallel export scales with the worker count.
+// Usage: export_bench <source> [seconds]
+// Transcodes the first <seconds> (default 120) of the source with 1, 2, 4,
+// ... workers up to the scheduler's process limit. Stream copy is off so every chunk is
+// encoded and the runs compare like for like. A last run with stream copy
+// on cuts mid-GOP, joining copied GOPs to encoded ones. Every output is
+// decoded in full and any decoder error fails the bench.
+#include "JobScheduler.h"
+#include "KeyframeIndexer.h"
+#include "SmartExporter.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QProcess>
+#include <QTemporaryDir>
+#include <cstdio>
+
+namespace {
+bool runExport(SmartExporter &exporter, const ExportSegment &segment, const QString &path, QString &report)
+{
+    bool ok = false;
+    // Disconnected with the loop
+    QEventLoop loop;
+    QObject::connect(&exporter, &SmartExporter::finished, &loop, [&](bool success, const QString &text) {
+        ok = success;
+        report = text;
+        loop.quit();
+    });
+    exporter.start(QVector<ExportSegment>() << segment, path);
+    if (exporter.isRunning()) {
+        loop.exec();
+    }
+    return ok;
+}
+
+// Decodes every frame; errors are anything ffmpeg prints at -v error
+bool decodesCleanly(const QString &path, QString &errors)
+{
+    QProcess ffmpeg;
+    ffmpeg.start("ffmpeg", QStringList() << "-v" << "error" << "-i" << path << "-f" << "null" << "-");
+    if (!ffmpeg.waitForFinished(-1)) {
+        errors = "ffmpeg did not run";
+        return false;
+    }
+    errors = QString::fromUtf8(ffmpeg.readAllStandardError()).trimmed();
+    return ffmpeg.exitStatus() == QProcess::NormalExit && ffmpeg.exitCode() == 0 && errors.isEmpty();
+}
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    const QStringList args = app.arguments();
+    if (args.size() < 2) {
+        std::fprintf(stderr, "usage: export_bench <source> [seconds]\n");
+        return 1;
+    }
+
+    const double seconds = args.size() > 2 ? args[2].toDouble() : 120.0;
+    const ExportSegment segment = {args[1], 0, Timebase::fromSeconds(seconds), false, false};
+    QTemporaryDir outputDir;
+
+    JobScheduler jobs;
+    KeyframeIndexer indexer(&jobs);
+    SmartExporter exporter(&indexer, &jobs);
+    exporter.setStreamCopyEnabled(false);
+
+    QVector<int> workerCounts;
+    const int maxWorkers = JobScheduler::kMaxProcesses;
+    for (int workers = 1; workers < maxWorkers; workers *= 2) {
+        workerCounts.append(workers);
+    }
+    workerCounts.append(maxWorkers);
+
+    std::printf("%8s %10s %9s\n", "workers", "seconds", "speedup");
+    double baseline = 0.0;
+    QString report;
+    QString errors;
+    for (int workers : workerCounts) {
+        exporter.setWorkerCount(workers);
+
+        QElapsedTimer timer;
+        timer.start();
+        const bool ok = runExport(exporter, segment, outputDir.filePath("out.mkv"), report);
+        const double elapsed = timer.elapsed() / 1000.0;
+
+        if (!ok) {
+            std::fprintf(stderr, "export failed: %s\n", qPrintable(report));
+            return 1;
+        }
+        if (!decodesCleanly(outputDir.filePath("out.mkv"), errors)) {
+            std::fprintf(stderr, "output with %d workers does not decode: %s\n", workers, qPrintable(errors));
+            return 1;
+        }
+        if (baseline == 0.0) {
+            baseline = elapsed;
+        }
+        std::printf("%8d %10.2f %8.2fx\n", workers, elapsed, baseline / elapsed);
+    }
+
+    // Off the keyframes at both ends, so each end has a re-encoded piece
+    const Ticks frame = Timebase::frameTicks({30, 1});
+    const ExportSegment cut = {args[1], 37 * frame, segment.duration - 74 * frame, false, false};
+    exporter.setStreamCopyEnabled(true);
+    exporter.setWorkerCount(maxWorkers);
+    if (!runExport(exporter, cut, outputDir.filePath("smart.mp4"), report)) {
+        std::fprintf(stderr, "smart export failed: %s\n", qPrintable(report));
+        return 1;
+    }
+    if (!decodesCleanly(outputDir.filePath("smart.mp4"), errors)) {
+        std::fprintf(stderr, "smart export does not decode: %s\n", qPrintable(errors));
+        return 1;
+    }
+    std::printf("smart export decodes cleanly\n%s\n", qPrintable(report));
+    return 0;
+}
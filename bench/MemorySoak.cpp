@@ -0,0 +1,130 @@
+// Soaks the memory budget on simulated caches, in virtual time.
+// Usage: memory_soak [hours]
+// Polls the budget once per simulated second for <hours> (default 24)
+// against a 1 GiB ceiling. The caches fill at a steady rate and, like
+// mpv's demuxer cache, run a tenth past their limits before trimming
+// back, and evict down to a new limit at once; a decoder the
+// budget can't resize idles at 300 MiB and spikes to 700 MiB for 20
+// seconds every ten minutes, pushing the total over the ceiling.
+//
+// Prints the pressure events, the limit changes per cache, how often a
+// cut limit was restored and then cut again, the peak
+// against the ceiling and the longest run of polls over it. Exits
+// non-zero if usage stays over the ceiling for more than two polls in a
+// row, or if any cache's limit swings more than once per spike.
+#include "MemoryBudget.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QStringList>
+#include <QVector>
+#include <algorithm>
+#include <cstdio>
+
+namespace {
+const qint64 kMiB = 1024 * 1024;
+const qint64 kCeiling = 1024 * kMiB;
+const qint64 kFillPerSecond = 48 * kMiB;
+const qint64 kDecoderIdle = 300 * kMiB;
+const qint64 kDecoderSpike = 700 * kMiB;
+const int kSpikeEvery = 600;
+const int kSpikeLength = 20;
+const int kMaxPollsOver = 2;
+
+struct Cache
+{
+    const char *name;
+    MemoryBudget::Priority priority;
+    qint64 wanted;
+    qint64 minimum;
+    qint64 limit;
+    qint64 bytes;
+    int changes;
+    int cuts;
+    int swings;         // Restored, then cut again
+    bool restored;
+};
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    const QStringList args = app.arguments();
+    const int hours = args.size() > 1 ? args[1].toInt() : 24;
+    if (hours <= 0) {
+        std::fprintf(stderr, "usage: memory_soak [hours]\n");
+        return 1;
+    }
+
+    QVector<Cache> caches = {
+        {"preview", MemoryBudget::High, 512 * kMiB, 64 * kMiB, 0, 0, 0, 0, 0, false},
+        {"shuttle", MemoryBudget::Normal, 256 * kMiB, 32 * kMiB, 0, 0, 0, 0, 0, false},
+        {"scopes", MemoryBudget::Normal, 64 * kMiB, 8 * kMiB, 0, 0, 0, 0, 0, false},
+        {"angles", MemoryBudget::Low, 64 * kMiB, 8 * kMiB, 0, 0, 0, 0, 0, false},
+        {"trim", MemoryBudget::Low, 64 * kMiB, 8 * kMiB, 0, 0, 0, 0, 0, false},
+    };
+    qint64 decoder = kDecoderIdle;
+
+    MemoryBudget budget;
+    budget.setCeiling(kCeiling);
+    for (int i = 0; i < caches.size(); ++i) {
+        budget.add(caches[i].name, caches[i].priority, caches[i].wanted, caches[i].minimum,
+                   [&caches, i]() { return caches[i].bytes; },
+                   [&caches, i](qint64 limit) {
+                       Cache &cache = caches[i];
+                       if (limit < cache.limit) {
+                           ++cache.cuts;
+                           cache.swings += cache.restored ? 1 : 0;
+                           cache.restored = false;
+                       } else if (cache.cuts > 0) {
+                           cache.restored = true;
+                       }
+                       ++cache.changes;
+                       cache.limit = limit;
+                       cache.bytes = std::min(cache.bytes, limit);
+                   });
+    }
+    budget.add("decoder", MemoryBudget::High, 0, 0, [&decoder]() { return decoder; });
+    // Limits handed out while registering aren't swings
+    for (Cache &cache : caches) {
+        cache.changes = 0;
+        cache.cuts = 0;
+    }
+
+    const int polls = hours * 3600;
+    int over = 0;
+    int longestOver = 0;
+    int spikes = 0;
+    QElapsedTimer timer;
+    timer.start();
+    for (int second = 0; second < polls; ++second) {
+        const bool spiking = second % kSpikeEvery < kSpikeLength && second >= kSpikeEvery;
+        spikes += spiking && second % kSpikeEvery == 0 ? 1 : 0;
+        decoder = spiking ? kDecoderSpike : kDecoderIdle;
+        for (Cache &cache : caches) {
+            cache.bytes = std::min(cache.limit + cache.limit / 10, cache.bytes + kFillPerSecond);
+        }
+
+        budget.poll();
+        over = budget.used() > kCeiling ? over + 1 : 0;
+        longestOver = std::max(longestOver, over);
+    }
+    const double pollUs = timer.nsecsElapsed() / 1e3 / polls;
+
+    std::printf("%d h simulated, %d polls, %.2f us/poll, %d spikes\n", hours, polls, pollUs, spikes);
+    std::printf("pressure events %d, peak %lld MiB of %lld MiB, longest over %d polls\n",
+                budget.pressureEvents(), static_cast<long long>(budget.peak() / kMiB),
+                static_cast<long long>(kCeiling / kMiB), longestOver);
+    std::printf("%-10s %10s %10s %8s %8s %8s\n", "cache", "limit MiB", "held MiB", "changes", "cuts", "swings");
+    bool ok = longestOver <= kMaxPollsOver;
+    for (const Cache &cache : caches) {
+        std::printf("%-10s %10lld %10lld %8d %8d %8d\n", cache.name, static_cast<long long>(cache.limit / kMiB),
+                    static_cast<long long>(cache.bytes / kMiB),
+                    cache.changes, cache.cuts, cache.swings);
+        ok = ok && cache.swings <= spikes;
+    }
+    if (!ok) {
+        std::fprintf(stderr, "memory_soak: usage stayed over the ceiling or limits oscillated\n");
+        return 1;
+    }
+    return 0;
+}
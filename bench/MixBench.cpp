@@ -0,0 +1,109 @@
+// Measures the audio track mixdown on its own: the work each mvmix://
+// stream's thread does during playback and renderWav does on export.
+// Usage: mix_bench [tracks] [seconds]
+// Renders one sine source per track with ffmpeg, at 44.1 kHz so the
+// decode resamples, and lays <tracks> (default 32) stereo tracks of
+// <seconds> (default 120) over them: clips end to end with fades, gains
+// and pans. Once the sources are decoded it mixes the whole program in
+// the streams' block size and prints the time taken, how much faster than
+// real time that is, and the share of one core that playback would use.
+#include "AudioMixer.h"
+#include "JobScheduler.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QProcess>
+#include <QRandomGenerator>
+#include <QStringList>
+#include <QTemporaryDir>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+namespace {
+const int kClipsPerTrack = 4;
+const int kBlockFrames = 1024;
+const int kRuns = 5;
+
+bool renderSource(const QString &path, int index, int seconds)
+{
+    QStringList args;
+    args << "-v" << "error" << "-y"
+         << "-f" << "lavfi" << "-i" << QString("sine=frequency=%1:sample_rate=44100").arg(110 + 20 * index)
+         << "-t" << QString::number(seconds)
+         << "-ac" << "2" << path;
+
+    QProcess ffmpeg;
+    ffmpeg.start("ffmpeg", args);
+    return ffmpeg.waitForFinished(-1) && ffmpeg.exitStatus() == QProcess::NormalExit
+        && ffmpeg.exitCode() == 0;
+}
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    const QStringList args = app.arguments();
+    const int tracks = args.size() > 1 ? args[1].toInt() : 32;
+    const int seconds = args.size() > 2 ? args[2].toInt() : 120;
+    if (tracks <= 0 || tracks > AudioTracks::kMaxTracks || seconds <= 0) {
+        std::fprintf(stderr, "usage: mix_bench [tracks (1-%d)] [seconds]\n", AudioTracks::kMaxTracks);
+        return 1;
+    }
+
+    QTemporaryDir sourceDir;
+    QVector<AudioClip> clips;
+    QRandomGenerator *random = QRandomGenerator::global();
+    const Ticks clipLength = Timebase::kTicksPerSecond * seconds / kClipsPerTrack;
+    for (int track = 0; track < tracks; ++track) {
+        const QString path = sourceDir.filePath(QString("track%1.wav").arg(track));
+        if (!renderSource(path, track, seconds)) {
+            std::fprintf(stderr, "ffmpeg failed to render %s\n", qPrintable(path));
+            return 1;
+        }
+        for (int i = 0; i < kClipsPerTrack; ++i) {
+            AudioClip clip = AudioTracks::makeClip(path, track, clipLength * i, clipLength);
+            clip.trimStart = clipLength * i;
+            clip.gainDb = -6.0 - random->bounded(12.0);
+            clip.pan = random->bounded(2.0) - 1.0;
+            clip.fadeIn = Timebase::kTicksPerSecond / 2;
+            clip.fadeOut = Timebase::kTicksPerSecond / 2;
+            clips.append(clip);
+        }
+    }
+
+    JobScheduler jobs;
+    AudioMixer mixer(&jobs);
+    mixer.setClips(clips, Timebase::kTicksPerSecond * seconds);
+    while (mixer.isDecoding()) {
+        QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+    }
+
+    const qint64 frames = Timebase::toSamples(mixer.length(), AudioMixer::kSampleRate);
+    std::vector<float> block(kBlockFrames * AudioMixer::kChannels);
+    double best = -1.0;
+    double peak = 0.0;
+    for (int run = 0; run < kRuns; ++run) {
+        QElapsedTimer timer;
+        timer.start();
+        for (qint64 frame = 0; frame < frames; frame += kBlockFrames) {
+            const int count = int(std::min<qint64>(kBlockFrames, frames - frame));
+            mixer.mix(frame, count, block.data());
+            peak = std::max(peak, double(std::fabs(block[0])));
+        }
+        const double ms = timer.nsecsElapsed() / 1e6;
+        best = best < 0 ? ms : std::min(best, ms);
+    }
+
+    // Sines this far apart never cancel out, so silence means a bug
+    if (frames <= 0 || peak <= 0.0 || !std::isfinite(peak)) {
+        std::fprintf(stderr, "the mix came out silent or invalid\n");
+        return 1;
+    }
+
+    const double programMs = 1000.0 * frames / AudioMixer::kSampleRate;
+    std::printf("%d stereo tracks, %d clips, %.1f s of program\n", tracks, int(clips.size()), programMs / 1000.0);
+    std::printf("mixed in %.1f ms (best of %d): %.0fx real time, %.2f%% of one core\n",
+                best, kRuns, programMs / best, 100.0 * best / programMs);
+    return 0;
+}
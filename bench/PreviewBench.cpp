@@ -0,0 +1,336 @@
+// Measures preview latency end to end through libmpv, headless (vo=null,
+// ao=null) so it runs in CI without a display.
+// Usage: preview_bench [iterations]
+// Renders a few synthetic lavfi sources with ffmpeg, then for each of
+// <iterations> (default 50) random edits to a timeline of them measures:
+//   rebuild   the segment rebuild and loadfile of the EDL the preview
+//             builds from it, as loadEdlWindow does, to the first frame
+//   seek      setting time-pos to the frame being ready
+//   boundary  the stall playing across a cut, beyond one frame interval
+// and prints p50, p99 and max of each in milliseconds. The EDL comes from
+// the preview's own SegmentBuilder, so gaps play the shared filler and
+// sources their conformed renders, as in the editor.
+// Run headless with QT_QPA_PLATFORM=offscreen.
+#include "PreviewRebuild.h"
+#include "Timebase.h"
+#include "Timeline.h"
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QProcess>
+#include <QRandomGenerator>
+#include <QStringList>
+#include <QTemporaryDir>
+#include <QVector>
+#include <algorithm>
+#include <clocale>
+#include <cstdio>
+#include <mpv/client.h>
+
+namespace {
+const int kSourceCount = 3;
+const int kSourceSeconds = 20;
+const int kSegmentCount = 12;
+const int kSeeksPerEdit = 5;
+const FrameRate kRate = {30, 1};
+const ProjectSettings kSettings = {1280, 720, kRate, 48000};
+
+// Any wait past this counts as a failure
+const qint64 kTimeoutMs = 10000;
+// The gap filler is rendered once, before the first edit
+const qint64 kFillerTimeoutMs = 120000;
+
+// Playback on each side of a cut that the boundary run covers
+const double kBoundaryLead = 0.3;
+
+// A clip and the gap before it
+struct Segment
+{
+    QString source;
+    Ticks trimStart;
+    Ticks duration;
+    Ticks gap;
+};
+
+bool renderSource(const QString &path, int index)
+{
+    const char *patterns[] = {"testsrc2", "testsrc"};
+    QStringList args;
+    args << "-v" << "error" << "-y"
+         << "-f" << "lavfi" << "-i" << QString("%1=size=%2x%3:rate=%4").arg(patterns[index % 2])
+                                              .arg(kSettings.width).arg(kSettings.height).arg(kRate.numerator)
+         << "-f" << "lavfi" << "-i" << QString("sine=frequency=%1:sample_rate=%2").arg(440 + 110 * index)
+                                              .arg(kSettings.sampleRate)
+         << "-t" << QString::number(kSourceSeconds)
+         << "-g" << "60" << "-pix_fmt" << "yuv420p" << path;
+
+    QProcess ffmpeg;
+    ffmpeg.start("ffmpeg", args);
+    return ffmpeg.waitForFinished(-1) && ffmpeg.exitStatus() == QProcess::NormalExit
+        && ffmpeg.exitCode() == 0;
+}
+
+// A random frame-aligned piece of a random source, after a gap a third
+// of the time
+Segment randomSegment(const QStringList &sources)
+{
+    QRandomGenerator *random = QRandomGenerator::global();
+    const qint64 frames = Timebase::toFrame(Timebase::kTicksPerSecond * kSourceSeconds, kRate);
+    const qint64 length = random->bounded(15, 90);
+    const qint64 start = random->bounded(frames - length);
+    const qint64 gap = random->bounded(3) == 0 ? random->bounded(5, 30) : 0;
+    return {sources[random->bounded(sources.size())], Timebase::fromFrame(start, kRate),
+            Timebase::fromFrame(length, kRate), Timebase::fromFrame(gap, kRate)};
+}
+
+// Lays the segments out in order; one rebuild follows
+void fillTimeline(Timeline &timeline, const QVector<Segment> &segments)
+{
+    timeline.clearClips();
+    Ticks start = 0;
+    for (const Segment &segment : segments) {
+        start += segment.gap;
+        timeline.addClip(segment.source, start, segment.duration, segment.trimStart);
+        start += segment.duration;
+    }
+}
+
+// Where the clip at index starts on the timeline
+Ticks clipStart(const QVector<Segment> &segments, int index)
+{
+    Ticks start = 0;
+    for (int i = 0; i < index; ++i) {
+        start += segments[i].gap + segments[i].duration;
+    }
+    return start + segments[index].gap;
+}
+
+// Returns once the rebuild scheduled by the last edit has run, false on
+// a timeout
+bool waitForRebuild(const PreviewRebuild &preview, int rebuilds)
+{
+    QElapsedTimer timer;
+    timer.start();
+    while (preview.rebuilds() == rebuilds) {
+        if (timer.elapsed() > kTimeoutMs) {
+            return false;
+        }
+        QCoreApplication::processEvents();
+    }
+    return true;
+}
+
+// mpv sends a playback restart once the first frame after a load or seek
+// is ready. Returns the time since timer started in ms, or -1.
+double waitForRestart(mpv_handle *mpv, const QElapsedTimer &timer)
+{
+    while (timer.elapsed() < kTimeoutMs) {
+        mpv_event *event = mpv_wait_event(mpv, 0.1);
+        if (event->event_id == MPV_EVENT_PLAYBACK_RESTART) {
+            return timer.nsecsElapsed() / 1e6;
+        }
+        if (event->event_id == MPV_EVENT_END_FILE) {
+            const mpv_event_end_file *end = static_cast<mpv_event_end_file *>(event->data);
+            if (end->reason == MPV_END_FILE_REASON_ERROR) {
+                return -1.0;
+            }
+        }
+        if (event->event_id == MPV_EVENT_SHUTDOWN) {
+            return -1.0;
+        }
+    }
+    return -1.0;
+}
+
+bool seekAndWait(mpv_handle *mpv, double position)
+{
+    QElapsedTimer timer;
+    timer.start();
+    mpv_set_property(mpv, "time-pos", MPV_FORMAT_DOUBLE, &position);
+    return waitForRestart(mpv, timer) >= 0;
+}
+
+// Plays across the cut at boundary and returns the largest gap between
+// frames either side of it less one frame interval, in ms, or -1
+double measureBoundary(mpv_handle *mpv, double boundary)
+{
+    if (!seekAndWait(mpv, std::max(0.0, boundary - kBoundaryLead))) {
+        return -1.0;
+    }
+
+    mpv_observe_property(mpv, 1, "time-pos", MPV_FORMAT_DOUBLE);
+    int paused = 0;
+    mpv_set_property(mpv, "pause", MPV_FORMAT_FLAG, &paused);
+
+    QElapsedTimer timer;
+    timer.start();
+    double stall = -1.0;
+    double lastWall = -1.0;
+    double lastPosition = -1.0;
+    while (timer.elapsed() < kTimeoutMs) {
+        mpv_event *event = mpv_wait_event(mpv, 0.1);
+        if (event->event_id != MPV_EVENT_PROPERTY_CHANGE) {
+            continue;
+        }
+        const mpv_event_property *property = static_cast<mpv_event_property *>(event->data);
+        if (property->format != MPV_FORMAT_DOUBLE) {
+            continue;
+        }
+        const double position = *static_cast<double *>(property->data);
+        const double wall = timer.nsecsElapsed() / 1e6;
+        if (lastPosition >= 0.0 && lastPosition < boundary && position >= boundary) {
+            const double frameMs = 1000.0 * kRate.denominator / kRate.numerator;
+            stall = std::max(0.0, wall - lastWall - frameMs);
+        }
+        lastWall = wall;
+        lastPosition = position;
+        if (position >= boundary + kBoundaryLead) {
+            break;
+        }
+    }
+
+    paused = 1;
+    mpv_set_property(mpv, "pause", MPV_FORMAT_FLAG, &paused);
+    mpv_unobserve_property(mpv, 1);
+    return stall;
+}
+
+void printRow(const char *name, QVector<double> samples)
+{
+    if (samples.isEmpty()) {
+        std::printf("%-10s %9s %9s %9s %7d\n", name, "-", "-", "-", 0);
+        return;
+    }
+    std::sort(samples.begin(), samples.end());
+    const int count = samples.size();
+    std::printf("%-10s %9.1f %9.1f %9.1f %7d\n", name, samples[(count - 1) / 2],
+                samples[(count - 1) * 99 / 100], samples.last(), count);
+}
+}
+
+int main(int argc, char *argv[])
+{
+    QApplication app(argc, argv);
+    const QStringList args = app.arguments();
+    const int iterations = args.size() > 1 ? args[1].toInt() : 50;
+    if (iterations <= 0) {
+        std::fprintf(stderr, "usage: preview_bench [iterations]\n");
+        return 1;
+    }
+
+    QTemporaryDir sourceDir;
+    QStringList sources;
+    for (int i = 0; i < kSourceCount; ++i) {
+        const QString path = sourceDir.filePath(QString("source%1.mkv").arg(i));
+        if (!renderSource(path, i)) {
+            std::fprintf(stderr, "ffmpeg failed to render %s\n", qPrintable(path));
+            return 1;
+        }
+        sources.append(path);
+    }
+
+    // MPV uses C locale
+    std::setlocale(LC_NUMERIC, "C");
+    mpv_handle *mpv = mpv_create();
+    if (!mpv) {
+        std::fprintf(stderr, "failed creating mpv context\n");
+        return 1;
+    }
+    mpv_set_option_string(mpv, "vo", "null");
+    mpv_set_option_string(mpv, "ao", "null");
+    mpv_set_option_string(mpv, "keep-open", "yes");
+    mpv_set_option_string(mpv, "pause", "yes");
+    if (mpv_initialize(mpv) < 0) {
+        std::fprintf(stderr, "mpv init failed\n");
+        mpv_terminate_destroy(mpv);
+        return 1;
+    }
+
+    QVector<Segment> segments;
+    for (int i = 0; i < kSegmentCount; ++i) {
+        segments.append(randomSegment(sources));
+    }
+
+    // The sources are in the project format, so only the filler is rendered
+    Timeline timeline;
+    timeline.setSettings(kSettings);
+    PreviewRebuild preview(&timeline);
+    fillTimeline(timeline, segments);
+    QElapsedTimer fillerTimer;
+    fillerTimer.start();
+    while (preview.conformCache().fillerFile().isEmpty() && fillerTimer.elapsed() < kFillerTimeoutMs) {
+        QCoreApplication::processEvents();
+    }
+    if (preview.conformCache().fillerFile().isEmpty()) {
+        std::fprintf(stderr, "the gap filler wasn't rendered\n");
+        mpv_terminate_destroy(mpv);
+        return 1;
+    }
+
+    QRandomGenerator *random = QRandomGenerator::global();
+    QVector<double> rebuilds;
+    QVector<double> seeks;
+    QVector<double> boundaries;
+    int failures = 0;
+    double playhead = 0.0;
+    for (int iteration = 0; iteration < iterations; ++iteration) {
+        // A trim or replace somewhere, then the same reload as the editor:
+        // the segment rebuild, and loadfile starting where the playhead was
+        segments[random->bounded(segments.size())] = randomSegment(sources);
+        QElapsedTimer timer;
+        timer.start();
+        const int rebuildCount = preview.rebuilds();
+        fillTimeline(timeline, segments);
+        if (!waitForRebuild(preview, rebuildCount)) {
+            ++failures;
+            continue;
+        }
+        const double total = Timebase::toSeconds(timeline.totalDuration());
+        playhead = std::min(playhead, total);
+
+        const QByteArray edlBytes = preview.edl();
+        const QByteArray startOption =
+            QByteArray("start=") + Timebase::toEdlSeconds(Timebase::fromSeconds(playhead)).toUtf8();
+        const char *cmd[] = {"loadfile", edlBytes.constData(), "replace", startOption.constData(), NULL};
+        mpv_command(mpv, cmd);
+        const double rebuild = waitForRestart(mpv, timer);
+        if (rebuild < 0) {
+            ++failures;
+            continue;
+        }
+        rebuilds.append(rebuild);
+
+        for (int i = 0; i < kSeeksPerEdit; ++i) {
+            playhead = random->bounded(total);
+            QElapsedTimer seekTimer;
+            seekTimer.start();
+            mpv_set_property(mpv, "time-pos", MPV_FORMAT_DOUBLE, &playhead);
+            const double seek = waitForRestart(mpv, seekTimer);
+            if (seek < 0) {
+                ++failures;
+                continue;
+            }
+            seeks.append(seek);
+        }
+
+        // Any clip's start but the first
+        const Ticks boundary = clipStart(segments, random->bounded(1, segments.size()));
+        const double stall = measureBoundary(mpv, Timebase::toSeconds(boundary));
+        if (stall < 0) {
+            ++failures;
+            continue;
+        }
+        boundaries.append(stall);
+    }
+
+    mpv_terminate_destroy(mpv);
+
+    std::printf("%-10s %9s %9s %9s %7s\n", "ms", "p50", "p99", "max", "samples");
+    printRow("rebuild", rebuilds);
+    printRow("seek", seeks);
+    printRow("boundary", boundaries);
+    if (failures > 0) {
+        std::fprintf(stderr, "%d operations timed out or failed\n", failures);
+        return 1;
+    }
+    return 0;
+}
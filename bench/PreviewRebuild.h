@@ -0,0 +1,57 @@
+#ifndef PREVIEWREBUILD_H
+#define PREVIEWREBUILD_H
+
+#include "ConformCache.h"
+#include "JobScheduler.h"
+#include "SegmentBuilder.h"
+#include "SequenceFlattener.h"
+#include "Timeline.h"
+#include "TransitionCache.h"
+#include <QTimer>
+
+// The preview's side of an edit, connected as MainWindow connects it:
+// timelineChanged schedules one segment rebuild for when control returns
+// to the event loop. Only mpv's reload is left out, which preview_bench
+// measures on the EDL built here.
+class PreviewRebuild
+{
+public:
+    explicit PreviewRebuild(Timeline *timeline)
+        : m_conformCache(&m_jobs)
+        , m_transitionCache(&m_jobs)
+        , m_flattener(timeline)
+        , m_builder(timeline, &m_conformCache, &m_transitionCache, &m_flattener)
+        , m_rebuilds(0)
+    {
+        m_timer.setSingleShot(true);
+        m_timer.setInterval(0);
+        QObject::connect(timeline, &Timeline::timelineChanged, &m_timer, [this]() { m_timer.start(); });
+        QObject::connect(&m_timer, &QTimer::timeout, &m_timer, [this]() {
+            m_segments = m_builder.build();
+            ++m_rebuilds;
+        });
+    }
+
+    int rebuilds() const { return m_rebuilds; }
+    int segmentCount() const { return m_segments.size(); }
+    const ConformCache &conformCache() const { return m_conformCache; }
+
+    // The last rebuild's EDL, built as the window builds it; the bench
+    // timelines have no audio tracks to mix in
+    QByteArray edl() const
+    {
+        return ("edl://" + m_builder.edlParts(m_segments, 0, m_segments.size() - 1).join(";")).toUtf8();
+    }
+
+private:
+    JobScheduler m_jobs;    // Renders the caches ask for
+    ConformCache m_conformCache;
+    TransitionCache m_transitionCache;
+    SequenceFlattener m_flattener;
+    SegmentBuilder m_builder;
+    QTimer m_timer;
+    QVector<TimelineSegment> m_segments;
+    int m_rebuilds;
+};
+
+#endif // PREVIEWREBUILD_H
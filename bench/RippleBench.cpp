@@ -0,0 +1,128 @@
+// Measures the cost of one ripple edit as the clip count grows: first the
+// edit alone, then with the preview's segment rebuild connected, for
+// edits made one at a time and for a burst sharing one rebuild. Exits
+// non-zero if a ripple insert inside a clip leaves clips overlapping.
+// Run headless with QT_QPA_PLATFORM=offscreen.
+#include "PreviewRebuild.h"
+#include "Timeline.h"
+#include <QApplication>
+#include <QElapsedTimer>
+#include <algorithm>
+#include <cstdio>
+
+namespace {
+const int kEditsPerRun = 2000;
+const int kRebuiltEdits = 20;
+const int kBurstLength = 100;
+const Ticks kClipLength = 4 * Timebase::kTicksPerSecond;
+
+void fillTimeline(Timeline &timeline, int clipCount)
+{
+    timeline.clearClips();
+    for (int i = 0; i < clipCount; ++i) {
+        timeline.addClip(QString("clip%1.mp4").arg(i), i * kClipLength, kClipLength);
+    }
+}
+
+// Fold the pending offsets so the next run starts from a clean tree
+void settle(const Timeline &timeline)
+{
+    timeline.clips();
+}
+
+// A ripple insert halfway into the second of three clips should land at
+// that clip's end and push the last one on, with nothing overlapping
+bool insertInsideClipIsAfterIt()
+{
+    Timeline timeline;
+    fillTimeline(timeline, 3);
+    timeline.rippleInsert("insert.mp4", kClipLength + kClipLength / 2, kClipLength);
+
+    QVector<Clip> clips = timeline.clips();
+    std::sort(clips.begin(), clips.end(), [](const Clip &a, const Clip &b) {
+        return a.startTime() < b.startTime();
+    });
+    bool ok = clips.size() == 4 && clips[2].filePath() == "insert.mp4" && clips[2].startTime() == 2 * kClipLength;
+    for (int i = 1; i < clips.size(); ++i) {
+        ok = ok && clips[i - 1].endTime() <= clips[i].startTime();
+    }
+    return ok;
+}
+
+// Returns once the rebuild scheduled by the last edit has run
+void waitForRebuild(const PreviewRebuild &preview, int rebuilds)
+{
+    while (preview.rebuilds() == rebuilds) {
+        QCoreApplication::processEvents();
+    }
+}
+}
+
+int main(int argc, char *argv[])
+{
+    QApplication app(argc, argv);
+    if (!insertInsideClipIsAfterIt()) {
+        std::fprintf(stderr, "ripple_bench: a ripple insert inside a clip overlapped it\n");
+        return 1;
+    }
+    const int clipCounts[] = {1000, 10000, 50000, 100000};
+
+    std::printf("%10s %14s %14s %14s %16s %16s\n", "clips", "trim ns/op", "delete ns/op", "insert ns/op",
+                "rebuilt ms/op", "burst ms/100");
+    for (int clipCount : clipCounts) {
+        Timeline timeline;
+        fillTimeline(timeline, clipCount);
+        QElapsedTimer timer;
+
+        // Ripple trims near the start shift every later clip
+        timeline.rippleTrim(0, 0, kClipLength);
+        timer.start();
+        for (int i = 0; i < kEditsPerRun; ++i) {
+            timeline.rippleTrim(i % 16, 0, kClipLength + ((i & 1) ? 1 : -1) * kClipLength / 8);
+        }
+        qint64 trimNs = timer.nsecsElapsed() / kEditsPerRun;
+        settle(timeline);
+
+        timer.start();
+        for (int i = 0; i < kEditsPerRun; ++i) {
+            timeline.rippleDelete(i % 16);
+        }
+        qint64 deleteNs = timer.nsecsElapsed() / kEditsPerRun;
+        settle(timeline);
+
+        timer.start();
+        for (int i = 0; i < kEditsPerRun; ++i) {
+            timeline.rippleInsert("insert.mp4", (i % 16) * kClipLength, kClipLength);
+        }
+        qint64 insertNs = timer.nsecsElapsed() / kEditsPerRun;
+        settle(timeline);
+
+        // The same edits as the user makes them, each rebuilt before the
+        // next, then a burst of them, as a batch or a held key makes
+        PreviewRebuild preview(&timeline);
+        timeline.rippleTrim(0, 0, kClipLength);
+        waitForRebuild(preview, 0);
+        timer.start();
+        for (int i = 0; i < kRebuiltEdits; ++i) {
+            const int rebuilds = preview.rebuilds();
+            timeline.rippleTrim(i % 16, 0, kClipLength + ((i & 1) ? 1 : -1) * kClipLength / 8);
+            waitForRebuild(preview, rebuilds);
+        }
+        const double rebuiltMs = timer.nsecsElapsed() / 1e6 / kRebuiltEdits;
+
+        timer.start();
+        const int rebuilds = preview.rebuilds();
+        for (int i = 0; i < kBurstLength; ++i) {
+            timeline.rippleDelete(i % 16);
+        }
+        waitForRebuild(preview, rebuilds);
+        const double burstMs = timer.nsecsElapsed() / 1e6;
+
+        std::printf("%10d %14lld %14lld %14lld %16.2f %16.2f\n", clipCount,
+                    static_cast<long long>(trimNs),
+                    static_cast<long long>(deleteNs),
+                    static_cast<long long>(insertNs),
+                    rebuiltMs, burstMs);
+    }
+    return 0;
+}
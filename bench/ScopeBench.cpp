@@ -0,0 +1,105 @@
+// Measures the scope kernels on their own: the accumulation the scopes
+// worker runs for each frame the preview hands it.
+// Usage: scope_bench [frames]
+// Builds <frames> (default 60) synthetic RGBA frames at the size the
+// preview reads back and at full 1080p, runs every scope over each, and
+// prints the time per frame and how much of a 30 fps budget on one core
+// the four scopes together take.
+#include "ScopeKernels.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QStringList>
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+namespace {
+const int kRuns = 3;
+const double kBudgetMs = 1000.0 / 30.0;
+
+struct Size
+{
+    int width;
+    int height;
+};
+
+// Gradients with a moving offset, so each frame fills different bins
+void fillFrame(std::vector<uchar> &frame, int width, int height, int index)
+{
+    for (int y = 0; y < height; ++y) {
+        uchar *row = frame.data() + size_t(y) * width * 4;
+        for (int x = 0; x < width; ++x) {
+            row[x * 4] = uchar(x + index);
+            row[x * 4 + 1] = uchar(y * 2 + index);
+            row[x * 4 + 2] = uchar((x ^ y) + index * 3);
+            row[x * 4 + 3] = 255;
+        }
+    }
+}
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    const QStringList args = app.arguments();
+    const int frameCount = args.size() > 1 ? args[1].toInt() : 60;
+    if (frameCount <= 0) {
+        std::fprintf(stderr, "usage: scope_bench [frames]\n");
+        return 1;
+    }
+
+    const Size sizes[] = {{480, 270}, {1920, 1080}};
+    const char *const names[] = {"waveform", "parade", "vectorscope", "histogram"};
+    for (const Size &size : sizes) {
+        const int stride = size.width * 4;
+        std::vector<std::vector<uchar>> frames(frameCount, std::vector<uchar>(size_t(stride) * size.height));
+        for (int i = 0; i < frameCount; ++i) {
+            fillFrame(frames[i], size.width, size.height, i);
+        }
+
+        const size_t columnBins = size_t(size.width) * ScopeKernels::kLevels;
+        const size_t binCounts[] = {columnBins, columnBins * 3,
+                                    size_t(ScopeKernels::kLevels) * ScopeKernels::kLevels,
+                                    size_t(ScopeKernels::kLevels) * 4};
+        double total = 0.0;
+        quint64 checksum = 0;
+        std::printf("%dx%d, %d frames\n", size.width, size.height, frameCount);
+        for (int scope = 0; scope < 4; ++scope) {
+            std::vector<quint32> bins(binCounts[scope]);
+            double best = -1.0;
+            for (int run = 0; run < kRuns; ++run) {
+                QElapsedTimer timer;
+                timer.start();
+                for (const std::vector<uchar> &frame : frames) {
+                    std::fill(bins.begin(), bins.end(), 0);
+                    switch (scope) {
+                    case 0:
+                        ScopeKernels::waveform(frame.data(), size.width, size.height, stride, bins.data());
+                        break;
+                    case 1:
+                        ScopeKernels::parade(frame.data(), size.width, size.height, stride, bins.data());
+                        break;
+                    case 2:
+                        ScopeKernels::vectorscope(frame.data(), size.width, size.height, stride, bins.data());
+                        break;
+                    default:
+                        ScopeKernels::histogram(frame.data(), size.width, size.height, stride, bins.data());
+                        break;
+                    }
+                    checksum += bins[frame[0]];
+                }
+                const double ms = timer.nsecsElapsed() / 1e6 / frameCount;
+                best = best < 0 ? ms : std::min(best, ms);
+            }
+            total += best;
+            std::printf("  %-12s %7.3f ms/frame\n", names[scope], best);
+        }
+        std::printf("  all scopes   %7.3f ms/frame: %.0f fps, %.1f%% of one core at 30 fps\n",
+                    total, 1000.0 / total, 100.0 * total / kBudgetMs);
+        // Keeps the kernels from being optimised away
+        if (checksum == quint64(-1)) {
+            std::printf("\n");
+        }
+    }
+    return 0;
+}
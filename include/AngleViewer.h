@@ -0,0 +1,56 @@
+#ifndef ANGLEVIEWER_H
+#define ANGLEVIEWER_H
+
+#include <QVector>
+#include <QWidget>
+#include <mpv/client.h>
+#include "Multicam.h"
+
+class QLabel;
+class MpvVideoWidget;
+
+// Shows every angle of a multicam clip at once. All angles are decoded by
+// one mpv instance of its own: the extra angles are loaded as external
+// video tracks and a lavfi-complex graph scales them down and stacks them
+// into a grid, so the viewer is a single demux, filter and render
+// pipeline rather than one player per angle. Clicking an angle emits
+// angleClicked.
+class AngleViewer : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit AngleViewer(QWidget *parent = nullptr);
+    ~AngleViewer() override;
+
+    // Loads the angles, starting at groupTime, unless they are already
+    // showing. The first call starts the viewer's mpv instance.
+    void setAngles(const QVector<CameraAngle> &angles, int activeAngle, Ticks groupTime);
+    void clear();
+
+    // Follows the main player, seeking only once the drift gets large
+    void syncTo(Ticks groupTime, bool playing);
+
+    // Demuxer cache ceiling, held until the mpv instance starts
+    void setCacheLimit(qint64 bytes);
+    qint64 cacheBytes() const;
+
+signals:
+    void angleClicked(int angle);
+
+protected:
+    void mousePressEvent(QMouseEvent *event) override;
+
+private:
+    mpv_handle *m_mpv;
+    MpvVideoWidget *m_video;
+    QLabel *m_status;
+    QVector<CameraAngle> m_angles;
+    int m_activeAngle;
+    qint64 m_cacheLimit;    // -1 for mpv's default
+
+    void initializeMpv();
+    void updateStatus();
+};
+
+#endif // ANGLEVIEWER_H
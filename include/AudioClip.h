@@ -0,0 +1,35 @@
+#ifndef AUDIOCLIP_H
+#define AUDIOCLIP_H
+
+#include <QString>
+#include "Timebase.h"
+
+// A clip on one of the audio-only tracks. These are mixed by AudioMixer
+// rather than played through the video clips' EDL.
+struct AudioClip
+{
+    QString path;
+    int track;          // 0 is the first audio track
+    Ticks startTime;
+    Ticks duration;
+    Ticks trimStart;
+    double gainDb;
+    double pan;         // -1 left to 1 right
+    Ticks fadeIn;
+    Ticks fadeOut;
+
+    Ticks endTime() const { return startTime + duration; }
+};
+
+namespace AudioTracks {
+
+const int kMaxTracks = 32;
+
+inline AudioClip makeClip(const QString &path, int track, Ticks startTime, Ticks duration)
+{
+    return {path, track, startTime, duration, 0, 0.0, 0.0, 0, 0};
+}
+
+} // namespace AudioTracks
+
+#endif // AUDIOCLIP_H
@@ -0,0 +1,109 @@
+#ifndef AUDIOMIXER_H
+#define AUDIOMIXER_H
+
+#include <QHash>
+#include <QMutex>
+#include <QObject>
+#include <QSet>
+#include <QSharedPointer>
+#include <QVector>
+#include <mpv/client.h>
+#include <mpv/stream_cb.h>
+#include "AudioClip.h"
+#include "JobScheduler.h"
+
+class QFile;
+
+// Mixes the audio tracks into one stereo stream. Each source is decoded
+// once with ffmpeg, as a scheduler job, to 32-bit float PCM at the mix
+// rate and cached on disk, where it stays mapped; mixing is then a gain
+// ramp and an add per clip over blocks of interleaved samples, done with
+// SIMD.
+//
+// mpv reads the mix as a WAV file from the mvmix:// protocol. Each stream
+// mpv opens gets a thread that mixes ahead into a ring buffer, which mpv's
+// demuxer drains without taking a lock. Exports render the same mix to a
+// file with renderWav.
+class AudioMixer : public QObject
+{
+    Q_OBJECT
+
+public:
+    static const int kSampleRate = 48000;
+    static const int kChannels = 2;
+
+    explicit AudioMixer(JobScheduler *jobs, QObject *parent = nullptr);
+    ~AudioMixer();
+
+    // Sources that aren't decoded yet are queued and stay silent until
+    // they are, when sourcesChanged is emitted
+    void setClips(const QVector<AudioClip> &clips, Ticks length);
+    bool isEmpty() const { return m_clips.isEmpty(); }
+    bool isDecoding() const { return !m_decodes.isEmpty(); }
+    Ticks length() const;
+
+    // Mixes frames from frame on into out, interleaved. Safe from any
+    // thread; clip changes apply from the next call.
+    void mix(qint64 frame, int frames, float *out) const;
+
+    // mpv protocol for the mix, and a URL for part of it to use in an EDL
+    bool registerProtocol(mpv_handle *mpv);
+    QString edlPart(Ticks start, Ticks length) const;
+
+    bool renderWav(const QString &path) const;
+
+signals:
+    void sourcesChanged();
+
+private:
+    struct Source
+    {
+        QFile *file;
+        const float *samples;
+        qint64 frames;
+
+        ~Source();
+    };
+
+    struct Entry
+    {
+        QSharedPointer<Source> source;
+        qint64 start;       // Mix frame of the first sample
+        qint64 frames;
+        qint64 offset;      // Source frame of the first sample
+        float gain;
+        qint64 fadeIn;
+        qint64 fadeOut;
+        float left;         // Pan law per channel
+        float right;
+    };
+
+    struct Program
+    {
+        QVector<Entry> entries;  // By start
+        qint64 frames;
+    };
+
+    JobScheduler *m_jobs;
+    CancelToken m_token;    // Cancelled on destruction
+    QVector<AudioClip> m_clips;
+    Ticks m_length;
+    QHash<QString, QSharedPointer<Source>> m_sources;
+    QSet<QString> m_failed;
+    QSet<QString> m_decodes;    // Queued or running
+    QString m_cacheDir;
+
+    // Swapped on the GUI thread, read by the mixing threads
+    mutable QMutex m_programMutex;
+    QSharedPointer<const Program> m_program;
+
+    QSharedPointer<const Program> program() const;
+    void rebuildProgram();
+    QString pcmPathFor(const QString &source) const;
+    bool openCached(const QString &source);
+    void decode(const QString &source);
+    void onDecodeFinished(const QString &source, bool ok);
+    static int openStream(void *userData, char *uri, mpv_stream_cb_info *info);
+};
+
+#endif // AUDIOMIXER_H
@@ -0,0 +1,89 @@
+#ifndef AUTOMATIONSERVER_H
+#define AUTOMATIONSERVER_H
+
+#include "Timebase.h"
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QJsonValue>
+#include <QObject>
+#include <functional>
+
+class QLocalServer;
+class QThread;
+class Timeline;
+
+// JSON-RPC 2.0 for pipeline tools, one request or batch per line, over a
+// local socket or, headless, stdin and stdout. Times are in seconds.
+//
+//   timeline.add     {path, start, duration, trimStart?}  -> index
+//   timeline.remove  {index}
+//   timeline.move    {index, start}
+//   timeline.trim    {index, trimStart, duration}, moving the start with the in-point
+//   timeline.clips   {}                                   -> [{path, start, duration, trimStart}]
+//   project.load     {path}
+//   project.save     {path}
+//   seek             {time}
+//   render           {path}, answered once the export finishes
+//
+// A batch (a JSON array) is one transaction of timeline edits: they apply
+// together with a single preview rebuild, or, if any of them fails, not
+// at all.
+class AutomationServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    typedef std::function<void(Ticks)> Seek;
+    // Starts exporting the timeline to path; false if it can't start now
+    typedef std::function<bool(const QString &)> Render;
+
+    explicit AutomationServer(Timeline *timeline, QObject *parent = nullptr);
+    ~AutomationServer();
+
+    void setSeek(Seek seek) { m_seek = std::move(seek); }
+    void setRender(Render render) { m_render = std::move(render); }
+
+    // A socket of the same name left behind by a crash is replaced
+    bool listen(const QString &name);
+    QString serverName() const;
+
+    // Reads requests from stdin on a thread of its own until end of
+    // input, then emits inputClosed. For headless runs, which quit then.
+    void attachStdio();
+
+public slots:
+    // From the exporter, for the render request waiting on it
+    void renderFinished(bool ok, const QString &report);
+
+signals:
+    void inputClosed();
+
+private:
+    typedef std::function<void(const QByteArray &)> Reply;
+
+    struct Outcome
+    {
+        QJsonValue result;
+        int code;           // 0 on success
+        QString message;
+    };
+
+    Timeline *m_timeline;
+    QLocalServer *m_server;
+    QThread *m_stdinThread;
+    QFile m_stdout;
+    Seek m_seek;
+    Render m_render;
+    // The render request waiting on the exporter, and where to answer it
+    bool m_rendering;
+    QJsonValue m_renderId;
+    Reply m_renderReply;
+
+    void handleLine(const QByteArray &line, const Reply &reply);
+    QJsonArray handleBatch(const QJsonArray &requests);
+    Outcome invoke(const QString &method, const QJsonObject &params);
+    Outcome edit(const QString &method, const QJsonObject &params);
+};
+
+#endif // AUTOMATIONSERVER_H
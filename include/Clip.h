@@ -2,34 +2,64 @@
 #define CLIP_H
 
 #include <QString>
+#include "Timebase.h"
+#include "Transition.h"
+#include "Multicam.h"
 
 class Clip
 {
 public:
     Clip();
-    Clip(const QString &filePath, double startTime, double duration);
+    Clip(const QString &filePath, Ticks startTime, Ticks duration);
     
     QString filePath() const { return m_filePath; }
-    double startTime() const { return m_startTime; }
-    double duration() const { return m_duration; }
-    double endTime() const { return m_startTime + m_duration; }
+    Ticks startTime() const { return m_startTime; }
+    Ticks duration() const { return m_duration; }
+    Ticks endTime() const { return m_startTime + m_duration; }
     
-    void setStartTime(double time) { m_startTime = time; }
-    void setDuration(double duration) { m_duration = duration; }
+    void setStartTime(Ticks time) { m_startTime = time; }
+    void setDuration(Ticks duration) { m_duration = duration; }
     void setFilePath(const QString &path) { m_filePath = path; }
     
     // Trimming support
-    double trimStart() const { return m_trimStart; }
-    double trimEnd() const { return m_trimEnd; }
-    void setTrimStart(double trim) { m_trimStart = trim; }
-    void setTrimEnd(double trim) { m_trimEnd = trim; }
+    Ticks trimStart() const { return m_trimStart; }
+    Ticks trimEnd() const { return m_trimEnd; }
+    void setTrimStart(Ticks trim) { m_trimStart = trim; }
+    void setTrimEnd(Ticks trim) { m_trimEnd = trim; }
+    
+    // Transition in from the clip ending where this one starts
+    TransitionType transitionType() const { return m_transitionType; }
+    Ticks transitionDuration() const { return m_transitionDuration; }
+    void setTransition(TransitionType type, Ticks duration)
+    {
+        m_transitionType = type;
+        m_transitionDuration = duration;
+    }
+    
+    // Multicam: the angles run in sync and the clip shows the active one.
+    // filePath and trimStart always refer to the active angle's source.
+    bool isMulticam() const { return !m_angles.isEmpty(); }
+    const QVector<CameraAngle> &angles() const { return m_angles; }
+    int activeAngle() const { return m_activeAngle; }
+    void setAngles(const QVector<CameraAngle> &angles, int active);
+    void switchAngle(int angle);
+    // Group time at the clip's in-point
+    Ticks groupTime() const;
     
 private:
     QString m_filePath;
-    double m_startTime;  // Position on timeline
-    double m_duration;   // Duration of clip
-    double m_trimStart;  // Trim from start of source
-    double m_trimEnd;    // Trim from end of source
+    Ticks m_startTime;  // Position on timeline
+    Ticks m_duration;   // Duration of clip
+    Ticks m_trimStart;  // Trim from start of source
+    Ticks m_trimEnd;    // Trim from end of source
+    TransitionType m_transitionType;
+    Ticks m_transitionDuration;
+    QVector<CameraAngle> m_angles;
+    int m_activeAngle;
 };
 
+// Only Qt containers and plain values, so removing a clip from the middle
+// of the timeline's QVector is one memmove
+Q_DECLARE_TYPEINFO(Clip, Q_RELOCATABLE_TYPE);
+
 #endif // CLIP_H
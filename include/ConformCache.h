@@ -0,0 +1,65 @@
+#ifndef CONFORMCACHE_H
+#define CONFORMCACHE_H
+
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include "JobScheduler.h"
+#include "ProjectSettings.h"
+
+// Renders what the preview plays into the project format, as background
+// scheduler jobs, so the EDL is one size, frame rate and sample rate
+// throughout and mpv has nothing to reconfigure at a cut.
+//
+// The first render for a format is the gap filler: kFillerSeconds of black
+// and silence that every gap trims, in place of a lavfi graph per gap.
+// Sources are probed and only those that differ from the project format
+// are conformed, once, copying the video when only the audio differs;
+// renders are named by the source and the format and
+// are reused by later sessions.
+class ConformCache : public QObject
+{
+    Q_OBJECT
+
+public:
+    static const int kFillerSeconds = 60;
+
+    explicit ConformCache(JobScheduler *jobs, QObject *parent = nullptr);
+    ~ConformCache();
+
+    // A new format starts over with its filler
+    void setSettings(const ProjectSettings &settings);
+
+    // The filler, or empty until it is rendered
+    QString fillerFile() const;
+
+    // Conformed render of a source, or the source itself while the render
+    // is being made or if it needs none
+    QString playableFile(const QString &source) const;
+
+    // Queues a probe, and a render if the source needs one
+    void request(const QString &source);
+
+signals:
+    void rendered(const QString &file);
+
+private:
+    JobScheduler *m_jobs;
+    CancelToken m_token;                // Cancelled when the format changes
+    QString m_cacheDir;
+    ProjectSettings m_settings;
+    bool m_configured;
+    QSet<QString> m_pending;            // Queued, probing or rendering
+    QSet<QString> m_matching;           // Already in the project format
+    QSet<QString> m_failed;
+    mutable QHash<QString, QString> m_rendered;
+    bool m_fillerRendered;
+
+    QString fileFor(const QString &source) const;
+    QString fillerPath() const;
+    void renderFiller();
+    void conform(const QString &source);
+    void onConformed(const QString &source, const QString &file, int outcome);
+};
+
+#endif // CONFORMCACHE_H
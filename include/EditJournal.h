@@ -0,0 +1,89 @@
+#ifndef EDITJOURNAL_H
+#define EDITJOURNAL_H
+
+#include <QFile>
+#include <QMutex>
+#include <QObject>
+#include <QVector>
+#include <QWaitCondition>
+#include "Timeline.h"
+
+class QThread;
+
+// Autosave for the timeline. Every edit is appended to a journal file as
+// a small checksummed record. A writer thread takes whatever arrived while
+// its previous fsync was running and commits it with one write and one
+// fsync (group commit), so the GUI thread never waits on the disk. Once
+// the journal passes a size threshold the timeline's state is written as
+// a snapshot, also on the writer thread, and the journal starts over.
+// Recovery loads the snapshot and replays the journal's tail.
+class EditJournal : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Stats
+    {
+        qint64 records;         // Edits appended this session
+        qint64 recordBytes;     // Their encoded size
+        qint64 bytesWritten;    // Journal and snapshot bytes written
+        qint64 syncs;
+        qint64 snapshots;
+        qint64 recoveredEdits;  // Replayed from the journal on open
+        double recoveryMs;
+    };
+
+    explicit EditJournal(QObject *parent = nullptr);
+    ~EditJournal();
+
+    // Restores the timeline from the session in dir and starts journaling
+    // into it. A torn record at the end of the journal is dropped.
+    bool open(const QString &dir, Timeline *timeline);
+
+    void append(const TimelineEdit &edit);
+    bool wantsSnapshot() const;
+    // State after every edit appended so far
+    void snapshot(const TimelineState &state);
+
+    // Project files are snapshots saved where the user chooses; they
+    // carry no journal. Settings a file lacks are kept from state.
+    static bool saveProject(const QString &path, const TimelineState &state);
+    static bool loadProject(const QString &path, TimelineState &state);
+
+    Stats stats() const;
+    // Bytes written to disk per byte of edit records
+    double writeAmplification() const;
+
+private:
+    struct Item
+    {
+        QByteArray record;      // Empty for a snapshot
+        TimelineState state;
+        quint64 sequence;
+    };
+
+    QString m_dir;
+    QFile m_journalFile;        // Used by the writer thread once open
+    QThread *m_writer;
+
+    // Shared between the GUI and writer threads
+    mutable QMutex m_mutex;
+    QWaitCondition m_wake;
+    QVector<Item> m_queue;
+    bool m_stopping;
+    Stats m_stats;
+
+    quint64 m_sequence;         // Last sequence number handed out
+    qint64 m_bytesSinceSnapshot;
+
+    QString journalPath() const;
+    QString snapshotPath() const;
+    bool readSnapshot(TimelineState &state, quint64 &sequence) const;
+    qint64 readJournal(quint64 after, QVector<TimelineEdit> &edits, quint64 &last) const;
+    void writerLoop();
+    void writeRecords(const QByteArray &records);
+    void writeSnapshot(const Item &item);
+    void resetJournal();
+};
+
+#endif // EDITJOURNAL_H
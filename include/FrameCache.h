@@ -0,0 +1,106 @@
+#ifndef FRAMECACHE_H
+#define FRAMECACHE_H
+
+#include <QImage>
+#include <QMap>
+#include <QObject>
+#include <QPair>
+#include <QSet>
+#include <QSize>
+#include <QVector>
+#include "JobScheduler.h"
+#include "Timebase.h"
+
+class KeyframeIndexer;
+
+// Memory-bounded window of decoded timeline frames for shuttle playback.
+// ffmpeg decodes, run as scheduler jobs, take whole GOPs (from the
+// keyframe indexes) ahead of the playhead in the direction of travel, so
+// reverse and fast shuttle read frames from memory instead of seeking for
+// each one. When the budget is reached, frames behind the playhead go
+// first, then the ones furthest ahead.
+class FrameCache : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Segment
+    {
+        QString source;      // File, or a lavfi graph when isLavfi is set
+        Ticks timelineStart;
+        Ticks duration;
+        Ticks trimStart;
+        bool isGap;
+        bool isLavfi;
+
+        bool operator==(const Segment &other) const;
+    };
+
+    FrameCache(KeyframeIndexer *indexer, JobScheduler *jobs, QObject *parent = nullptr);
+    ~FrameCache();
+
+    // Replacing the timeline layout drops every cached frame
+    void setSegments(const QVector<Segment> &segments, FrameRate rate);
+    void setMemoryBudget(qint64 bytes);
+    void setFrameSize(const QSize &size);
+
+    // Cached frame, or a null image on a miss. Counts towards the hit rate.
+    QImage frame(qint64 frameNumber);
+
+    // Queues decodes for the frames the playhead will reach next, and
+    // cancels those it has already passed
+    void prefetch(qint64 frameNumber, int direction);
+
+    qint64 memoryUsed() const;
+    qint64 memoryBudget() const { return m_budget; }
+    qint64 lookups() const { return m_hits + m_misses; }
+    double hitRate() const;
+    void resetStats();
+
+private:
+    struct Job
+    {
+        int segment;
+        Ticks start;         // Source time, on a keyframe where known
+        Ticks end;
+        qint64 firstFrame;   // Timeline frames the job produces
+        qint64 endFrame;
+        quint64 serial;      // Finds the job again when its result is in
+        JobScheduler::JobId id;
+        CancelToken token;   // Cancelled with the job, dropping its frames
+    };
+
+    typedef QVector<QPair<qint64, QImage>> Frames;
+
+    KeyframeIndexer *m_indexer;
+    JobScheduler *m_scheduler;
+    quint64 m_lastSerial;
+    QVector<Segment> m_segments;
+    FrameRate m_rate;
+    QSize m_frameSize;
+    qint64 m_budget;
+    QMap<qint64, QImage> m_frames;
+    QVector<Job> m_jobs;     // Submitted, nearest first
+    QSet<int> m_failed;      // Segments that could not be decoded
+    QImage m_black;
+    qint64 m_playhead;
+    int m_direction;
+    qint64 m_hits;
+    qint64 m_misses;
+
+    qint64 frameBytes() const;
+    static qint64 frameAt(const Segment &segment, Ticks sourceTime, FrameRate rate);
+    int segmentAt(qint64 frameNumber) const;
+    Job jobFor(int segment, qint64 frameNumber) const;
+    int frameBudget() const;
+    void start(Job &job, JobScheduler::Priority priority);
+    static bool decode(JobScheduler *jobs, const QStringList &arguments, const Segment &segment, const Job &job,
+                       FrameRate rate, QSize size, FrameCache *cache);
+    void addFrames(const Frames &frames);
+    void onFinished(quint64 serial, bool ok);
+    void cancelJob(int index);
+    void clear();
+    void evict();
+};
+
+#endif // FRAMECACHE_H
@@ -0,0 +1,71 @@
+#ifndef FRAMEGRABBER_H
+#define FRAMEGRABBER_H
+
+#include <QImage>
+#include <QObject>
+#include <QString>
+#include <QVector>
+#include <mpv/client.h>
+#include <mpv/render.h>
+#include "Timebase.h"
+
+// Single frames on demand from an mpv instance of its own, kept paused
+// and rendered in software into small images, so it never competes with
+// the main player. Each request is an exact seek: mpv jumps to the
+// keyframe before it and decodes forward. Only the latest request per
+// slot is kept, so while a seek is running newer requests replace older
+// ones rather than queueing behind them.
+class FrameGrabber : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit FrameGrabber(int slotCount, QObject *parent = nullptr);
+    ~FrameGrabber();
+
+    void setFrameSize(const QSize &size) { m_frameSize = size; }
+    // Image sequences play at the timeline's rate
+    void setFrameRate(FrameRate rate);
+    void request(int slot, const QString &source, Ticks time);
+    // Drops pending requests; a running seek still finishes
+    void cancel();
+
+    // Demuxer cache ceiling, held until the mpv instance starts
+    void setCacheLimit(qint64 bytes);
+    qint64 cacheBytes() const;
+
+signals:
+    void frameReady(int slot, const QImage &frame);
+
+private slots:
+    void handleEvents();
+    void handleUpdate();
+
+private:
+    struct Request
+    {
+        QString source;
+        Ticks time;
+        bool pending;
+    };
+
+    mpv_handle *m_mpv;
+    mpv_render_context *m_render;
+    QSize m_frameSize;
+    FrameRate m_frameRate;
+    QVector<Request> m_requests;
+    QString m_loadedSource;
+    int m_busySlot;         // Slot of the running seek, or -1
+    int m_nextSlot;         // Where the round robin over slots resumes
+    bool m_restarted;
+    bool m_frameQueued;
+    qint64 m_cacheLimit;    // -1 for mpv's default
+
+    bool initialize();
+    void startNext();
+    void tryRender();
+    static void onWakeup(void *ctx);
+    static void onUpdate(void *ctx);
+};
+
+#endif // FRAMEGRABBER_H
@@ -0,0 +1,35 @@
+#ifndef FRAMETAP_H
+#define FRAMETAP_H
+
+#include <QImage>
+#include <QSize>
+#include <mpv/client.h>
+
+class QOpenGLContext;
+class QOpenGLFramebufferObject;
+
+// Reads back a small copy of the picture mpv has just rendered, for the
+// scopes. The GPU scales the video area down with a framebuffer blit, so
+// only a few hundred KiB are read back per frame. Rows come out bottom
+// up, which none of the scopes care about.
+class FrameTap
+{
+public:
+    static const int kWidth = 480;
+
+    FrameTap();
+    ~FrameTap();
+
+    // With context current, right after rendering into fbo
+    QImage capture(QOpenGLContext *context, unsigned int fbo, const QSize &fboSize, mpv_handle *mpv);
+    // Frees the GL objects; the context must be current
+    void release();
+
+private:
+    QOpenGLFramebufferObject *m_target;
+
+    FrameTap(const FrameTap &) = delete;
+    FrameTap &operator=(const FrameTap &) = delete;
+};
+
+#endif // FRAMETAP_H
@@ -0,0 +1,82 @@
+#ifndef IMAGESEQUENCE_H
+#define IMAGESEQUENCE_H
+
+#include <QFile>
+#include <QSet>
+#include <QStringList>
+#include "Timebase.h"
+
+// A folder of numbered frames, e.g. shot.1001.exr to shot.1240.exr, used
+// as one source. Its path is the file name pattern with the frame number
+// as printf-style %0Nd. Frames play at the timeline's frame rate, and a
+// missing frame holds the one before it, in preview and in ffmpeg alike.
+//
+// The frame numbers come from one listing of the directory and are kept
+// in a memory mapped index in the cache, reused until the directory
+// changes, so opening a sequence of tens of thousands of frames reads no
+// per-frame metadata.
+class ImageSequence
+{
+public:
+    ImageSequence();
+    ~ImageSequence();
+
+    static bool isSequence(const QString &path);
+
+    // Pattern for the sequence a frame file would belong to, or empty if
+    // its name has no frame number
+    static QString patternFor(const QString &framePath);
+
+    // Builds the index if it is missing or older than the directory
+    bool open(const QString &pattern);
+    void close();
+    bool isOpen() const { return m_frames != nullptr; }
+
+    QString pattern() const { return m_pattern; }
+    int firstFrame() const;
+    int lastFrame() const;
+    int length() const;                     // Frames from first to last
+    int presentCount() const { return m_frameCount; }
+    Ticks duration(FrameRate rate) const;
+
+    // File shown at a frame offset from the first
+    QString framePath(int offset) const;
+
+    // mf:// over a list of every frame in order, holes held
+    QString mpvSource() const;
+
+    // ffconcat list of the frames present, each lasting until the next
+    // one at rate, or empty if it can't be written
+    QString concatList(FrameRate rate) const;
+
+    // Sequences stay open for the session once used. GUI thread only.
+    static const ImageSequence *find(const QString &pattern);
+
+    // What to give mpv for any source path, and the input ffmpeg and
+    // ffprobe read it from, -i and the demuxer options before it
+    static QString mpvSourceFor(const QString &path);
+    static QStringList inputArguments(const QString &path, FrameRate rate);
+
+private:
+    QString m_pattern;
+    QString m_directory;
+    QString m_prefix;        // File name around the number, unescaped
+    QString m_suffix;
+    int m_width;             // Zero padded digits
+    QString m_indexPath;
+    QFile m_file;
+    const uchar *m_data;
+    const qint32 *m_frames;  // Frame numbers present, ascending
+    int m_frameCount;
+    mutable QSet<QString> m_concatLists;   // Written this session
+
+    QString fileName(qint32 number) const;
+    QString listPath() const;
+    bool mapIndex(qint64 modified);
+    bool build(qint64 modified) const;
+
+    ImageSequence(const ImageSequence &) = delete;
+    ImageSequence &operator=(const ImageSequence &) = delete;
+};
+
+#endif // IMAGESEQUENCE_H
@@ -0,0 +1,214 @@
+#ifndef JOBSCHEDULER_H
+#define JOBSCHEDULER_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMutex>
+#include <QObject>
+#include <QStringList>
+#include <QVariant>
+#include <QVector>
+#include <QWaitCondition>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+
+class QThread;
+
+// Shared flag a job polls to stop early. Copies share the flag.
+class CancelToken
+{
+public:
+    CancelToken() : m_cancelled(std::make_shared<std::atomic<bool>>(false)) {}
+
+    void cancel() { *m_cancelled = true; }
+    bool isCancelled() const { return *m_cancelled; }
+
+private:
+    std::shared_ptr<std::atomic<bool>> m_cancelled;
+};
+
+// The one pool background work runs on. Each worker thread has a deque per
+// priority class; it runs its own newest job first and, when it has none,
+// steals the oldest from another worker, always taking the most urgent
+// class there is. Jobs can wait on other jobs and receive their results,
+// and at most kMaxProcesses external processes run at once however many
+// jobs want one; jobs waiting for a process get one most urgent first.
+// Jobs submitted as process jobs are only taken once a slot is free, so
+// a queue of them never ties up the workers other jobs need.
+//
+// A job's result comes back to the GUI thread through one queued call,
+// batched with any others finished by then. Cancelled jobs, and jobs
+// whose inputs were cancelled, are dropped without a result.
+class JobScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Priority
+    {
+        Interactive,    // The user is waiting on it
+        Visible,        // Fills in something on screen
+        Background,     // Caches, indexes, renders ahead
+        PriorityCount
+    };
+
+    typedef quint64 JobId;
+
+    struct Context
+    {
+        CancelToken token;
+        QVector<QVariant> inputs;   // Results of the jobs it waited on, in order
+    };
+
+    typedef std::function<QVariant(const Context &)> Work;
+    typedef std::function<void(const QVariant &)> Done;
+    // Standard output as it arrives, on the job's thread
+    typedef std::function<void(const QByteArray &)> Output;
+
+    // Latency runs from a job becoming ready to its result reaching the
+    // GUI thread, over the recent window
+    struct ClassStats
+    {
+        int queued;
+        qint64 completed;
+        qint64 cancelled;
+        double p50Ms;
+        double p95Ms;
+        double maxMs;
+    };
+
+    struct Stats
+    {
+        ClassStats classes[PriorityCount];
+        int waiting;            // On other jobs
+        int running;
+        int processes;
+        qint64 steals;
+    };
+
+    static const int kMaxProcesses = 4;
+
+    // One worker per core by default
+    explicit JobScheduler(int workers = 0, QObject *parent = nullptr);
+    ~JobScheduler();
+
+    // Runs work once every job in after has finished; ids already finished
+    // and delivered count as done, with an empty input. done runs on the
+    // GUI thread.
+    JobId submit(Priority priority, Work work, Done done = Done(),
+                 const QVector<JobId> &after = QVector<JobId>(), CancelToken token = CancelToken());
+
+    // As submit, for work that runs external processes: the job holds a
+    // process slot from when it is taken until it returns, and runs them
+    // one after another on it
+    JobId submitProcess(Priority priority, Work work, Done done = Done(),
+                        const QVector<JobId> &after = QVector<JobId>(), CancelToken token = CancelToken());
+
+    // Makes a job more urgent, whether it is still waiting, queued, or
+    // running and waiting for a process slot. Never makes one less urgent.
+    void raise(JobId id, Priority priority);
+
+    // For jobs: runs a program to completion in the calling thread once a
+    // process slot is free, killing it if the token is cancelled
+    bool runProcess(const QString &program, const QStringList &arguments, const CancelToken &token,
+                    QByteArray *output = nullptr, int timeoutMs = -1);
+    // The same, handing standard output to output as it arrives
+    bool streamProcess(const QString &program, const QStringList &arguments, const CancelToken &token,
+                       const Output &output, QByteArray *errors = nullptr);
+
+    // For jobs: runs call on the GUI thread unless token is cancelled by
+    // then, as done is dropped. Calls keep their order, but may arrive
+    // after the job's result.
+    void post(const CancelToken &token, std::function<void()> call);
+
+    int workerCount() const { return m_workers.size(); }
+    // GUI thread
+    Stats stats() const;
+    static QString priorityName(Priority priority);
+
+private:
+    struct Job
+    {
+        JobId id;
+        Priority priority;
+        Work work;
+        Done done;
+        CancelToken token;
+        QVector<JobId> after;
+        QVector<QVariant> inputs;
+        QVector<JobId> dependents;
+        int waitingOn;
+        bool inputCancelled;
+        bool finished;
+        bool cancelled;
+        QVariant result;
+        qint64 readyNs;
+        std::atomic<int> urgency;   // Priority, raised while running
+        bool process;               // Taken only with a process slot
+    };
+
+    struct Worker
+    {
+        QThread *thread;
+        QMutex mutex;
+        std::deque<Job *> queues[PriorityCount];
+        std::deque<Job *> processQueues[PriorityCount];
+    };
+
+    struct Delivery
+    {
+        Job *job;
+        qint64 finishedNs;
+    };
+
+    QVector<Worker *> m_workers;
+    QElapsedTimer m_clock;
+    std::atomic<bool> m_stopping;
+    std::atomic<int> m_ready;
+    std::atomic<int> m_queued[PriorityCount];
+    std::atomic<int> m_running;
+    std::atomic<int> m_processes;
+    std::atomic<qint64> m_steals;
+    std::atomic<unsigned> m_nextWorker;
+
+    // Process slots, handed to the most urgent waiter
+    QMutex m_slotMutex;
+    QWaitCondition m_slotFreed;
+    int m_freeSlots;
+    int m_slotWaiters[PriorityCount];
+    std::atomic<int> m_processQueued[PriorityCount];
+
+    // Idle workers sleep here until a job is pushed or a slot is freed
+    QMutex m_idleMutex;
+    QWaitCondition m_wake;
+
+    // Every job from submit until its result is delivered
+    mutable QMutex m_graphMutex;
+    QHash<JobId, Job *> m_jobs;
+    JobId m_lastId;
+    int m_waiting;
+
+    QMutex m_deliveryMutex;
+    QVector<Delivery> m_deliveries;
+
+    // GUI thread only
+    QVector<double> m_latency[PriorityCount];
+    qint64 m_completed[PriorityCount];
+    qint64 m_cancelled[PriorityCount];
+
+    JobId add(Priority priority, Work work, Done done, const QVector<JobId> &after, CancelToken token,
+              bool process);
+    void push(Job *job);
+    Job *take(int self);
+    Job *takeFrom(int self, int priority, bool process);
+    void workerLoop(int self);
+    void finish(Job *job, bool cancelled);
+    bool acquireSlot(const Job *job, const CancelToken &token);
+    bool reserveSlot(int priority);
+    void releaseSlot();
+    void deliver();
+};
+
+#endif // JOBSCHEDULER_H
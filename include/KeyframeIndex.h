@@ -0,0 +1,67 @@
+#ifndef KEYFRAMEINDEX_H
+#define KEYFRAMEINDEX_H
+
+#include <QFile>
+#include <QVector>
+#include "Timebase.h"
+
+// Packet index of one source's video stream. Built once by
+// KeyframeIndexer and written to a cache file that is memory mapped, so
+// opening a large source's index costs no parsing.
+class KeyframeIndex
+{
+public:
+    struct Packet
+    {
+        Ticks pts;       // Presentation time, rebased so the first frame is 0
+        qint64 pos;      // Byte offset in the container, -1 if unknown
+        quint32 size;
+        quint32 flags;
+    };
+    enum PacketFlag { Keyframe = 1 };
+
+    // Work needed before the frame at a given time can be shown
+    struct DecodeCost
+    {
+        int packets;  // Packets decoded from the preceding keyframe
+        qint64 bytes;
+    };
+
+    KeyframeIndex();
+    ~KeyframeIndex();
+
+    bool open(const QString &indexPath);
+    void close();
+    bool isOpen() const { return m_packets != nullptr; }
+
+    // Source size and modification time the index was built from
+    qint64 sourceSize() const;
+    qint64 sourceModified() const;
+
+    int packetCount() const { return m_packetCount; }
+    int keyframeCount() const { return m_keyframeCount; }
+
+    Ticks keyframeAtOrBefore(Ticks time) const;
+    Ticks keyframeAtOrAfter(Ticks time) const;  // -1 if there is none
+    Ticks nearestKeyframe(Ticks time) const;
+    DecodeCost decodeCost(Ticks time) const;
+
+    // Packets must be sorted by pts
+    static bool write(const QString &indexPath, const QVector<Packet> &packets,
+                      qint64 sourceSize, qint64 sourceModified);
+
+private:
+    QFile m_file;
+    const uchar *m_data;
+    const Packet *m_packets;
+    const quint32 *m_keyframes;  // Packet numbers of keyframes, in pts order
+    int m_packetCount;
+    int m_keyframeCount;
+
+    int keyframeSlotAtOrBefore(Ticks time) const;
+
+    KeyframeIndex(const KeyframeIndex &) = delete;
+    KeyframeIndex &operator=(const KeyframeIndex &) = delete;
+};
+
+#endif // KEYFRAMEINDEX_H
@@ -0,0 +1,46 @@
+#ifndef KEYFRAMEINDEXER_H
+#define KEYFRAMEINDEXER_H
+
+#include <QHash>
+#include <QObject>
+#include <QStringList>
+#include "JobScheduler.h"
+#include "KeyframeIndex.h"
+
+// Scans each source's video packets once with ffprobe, as scheduler jobs,
+// and keeps the resulting KeyframeIndex files mapped. Indexes are cached
+// on disk and reused until the source's size or timestamp changes.
+class KeyframeIndexer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit KeyframeIndexer(JobScheduler *jobs, QObject *parent = nullptr);
+    ~KeyframeIndexer();
+
+    // Index for a source, or nullptr while it is still being built.
+    // Unknown sources are queued for indexing at priority, and a scan
+    // already queued is raised to it.
+    const KeyframeIndex *index(const QString &source,
+                               JobScheduler::Priority priority = JobScheduler::Background);
+    // Only an index already open, never queueing a scan. For painting.
+    const KeyframeIndex *cachedIndex(const QString &source) const { return m_indexes.value(source); }
+    bool isIndexing(const QString &source) const { return m_scans.contains(source); }
+
+signals:
+    void indexed(const QString &source);
+    void failed(const QString &source);
+
+private:
+    JobScheduler *m_jobs;
+    CancelToken m_token;    // Cancelled on destruction
+    QHash<QString, KeyframeIndex *> m_indexes;
+    QHash<QString, JobScheduler::JobId> m_scans;  // Queued or running
+    QString m_cacheDir;
+
+    QString indexPathFor(const QString &source) const;
+    bool openCached(const QString &source);
+    void scan(const QString &source, JobScheduler::Priority priority);
+};
+
+#endif // KEYFRAMEINDEXER_H
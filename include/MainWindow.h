@@ -1,16 +1,43 @@
 #ifndef MAINWINDOW_H
 #define MAINWINDOW_H
 
+#include <QElapsedTimer>
 #include <QMainWindow>
 #include <QVector>
 #include <QString>
 #include <mpv/client.h>
+#include "SegmentBuilder.h"
+#include "Timebase.h"
 
+class QLabel;
 class QSlider;
+class QStackedWidget;
+class QPaintEvent;
+class QThread;
 class QToolButton;
 class QTimer;
 class Timeline;
 class MpvVideoWidget;
+class MpvVideoWindow;
+class MediaBin;
+class KeyframeIndexer;
+class JobScheduler;
+class SmartExporter;
+class TransitionCache;
+class ConformCache;
+class FrameCache;
+class ShuttleView;
+class EditJournal;
+class PlaybackMetrics;
+class MemoryBudget;
+class VideoScopes;
+class AngleViewer;
+class TrimPreview;
+class FrameGrabber;
+class AudioMixer;
+class SequencePrefetcher;
+class SequenceFlattener;
+class AutomationServer;
 
 class MainWindow : public QMainWindow
 {
@@ -20,44 +47,123 @@ public:
     MainWindow(QWidget *parent = nullptr);
     ~MainWindow();
 
+    // Starts without a window, taking automation requests on stdin until
+    // it closes. The autosaved session is left alone.
+    void startHeadless();
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+
 private slots:
     void openFile();
+    void exportTimeline();
+    void editProjectSettings();
     void playPause();
+    void shuttleReverse();
+    void shuttleStop();
+    void shuttleForward();
+    void shuttleTick();
+    void updateJournalStats();
+    void handleMpvEvents();
+    void showTrimFrames(const QString &source, Ticks inPoint, Ticks outPoint, bool inEdge);
     void updatePosition();
     void beginSeek();
     void endSeek();
+    void scrubTo(int sliderValue);
     void onClipSelected(int index);
     void onTimelineChanged();
+    void onRenderFinished();
+    void startDeferredInit();
+    void onMpvReady();
+    void warmCaches();
 
 private:
-    struct TimelineSegment {
-        QString source;
-        double timelineStart;
-        double duration;
-        double trimStart;
-        bool isGap;
-    };
+    // Startup paints the window first, then restores the session while
+    // mpv initializes on mpvInitThread
+    enum StartupStage { StartupPainting, StartupLoading, StartupReady, StartupDone };
     mpv_handle *mpv;
+    QThread *mpvInitThread;
+    mpv_handle *pendingMpv;     // Written by mpvInitThread
+    StartupStage startupStage;
+    bool printStartupTimings;
+    bool headless;
     MpvVideoWidget *videoContainer;
+    MpvVideoWindow *videoWindow;  // Set instead of videoContainer with --render-thread
     QToolButton *playPauseButton;
     QSlider *seekSlider;
     QTimer *positionTimer;
+    QTimer *rebuildTimer;       // Coalesces timelineChanged into one rebuild
+    bool rendersWaiting;        // Finished renders held back until playback pauses
     bool userSeeking;
     double mediaDuration;
     Timeline *timeline;
+    MediaBin *mediaBin;
+    JobScheduler *jobScheduler;
+    KeyframeIndexer *keyframeIndexer;
+    SmartExporter *smartExporter;
+    TransitionCache *transitionCache;
+    ConformCache *conformCache;
+    FrameCache *frameCache;
+    ShuttleView *shuttleView;
+    QStackedWidget *videoStack;
+    QTimer *shuttleTimer;
+    int shuttleSpeed;           // Negative for reverse
+    Ticks shuttlePosition;
+    QElapsedTimer shuttleClock;
+    EditJournal *editJournal;
+    QLabel *journalLabel;
+    PlaybackMetrics *playbackMetrics;
+    MemoryBudget *memoryBudget;
+    VideoScopes *videoScopes;
+    AngleViewer *angleViewer;
+    TrimPreview *trimPreview;
+    FrameGrabber *frameGrabber;
+    AudioMixer *audioMixer;
+    bool mixingAudio;       // lavfi-complex adds the mix to the clips' audio
+    SequencePrefetcher *sequencePrefetcher;
+    SequenceFlattener *sequenceFlattener;
+    SegmentBuilder *segmentBuilder;
+    AutomationServer *automationServer;
     QVector<TimelineSegment> timelineSegments;
+    // Preview window: only the segments around the playhead are loaded
+    // into mpv, one window per playlist entry, and program time is the
+    // entry's start plus mpv's time-pos
+    struct EdlWindow
+    {
+        int first;      // Segment range
+        int last;
+        Ticks start;    // Program time range
+        Ticks end;
+    };
+    QVector<EdlWindow> edlWindows;
+    Ticks edlWindowSpan;    // 0 loads the whole timeline
     bool usingTimelinePlaylist;
     double currentTimelinePos;
     
     void initializeMpv();
     void setupUI();
+    void restoreSession();
+    static void onMpvEvents(void *ctx);
     void updatePlayButton(bool isPlaying);
+    void shuttle(int speed);
+    int currentShuttleSpeed() const;
+    void updateFrameStats();
+    void syncAngleViewer(bool playing);
+    void prefetchSequenceFrames(Ticks playhead);
     void rebuildTimelinePlaylist(bool preservePosition);
     void rebuildTimelineEDL(bool preservePosition);
-    QString generateEDLString() const;
+    void buildTimelineSegments();
+    // Runs a rebuild still waiting on rebuildTimer now
+    void flushTimelineRebuild();
+    bool startExport(const QString &fileName);
+    QString generateEDLString(int first, int last) const;
+    EdlWindow edlWindowFrom(int first, Ticks end) const;
+    void loadEdlWindow(Ticks center);
+    void appendNextEdlWindow();
+    void dropPlayedEdlWindows();
     void seekToTimelineTime(double timelineTime);
     bool timelinePositionForMpv(double &timelinePos) const;
-    bool segmentForTimelineTime(double timelineTime, int &index, double &localPos) const;
+    bool segmentForTimelineTime(Ticks timelineTime, int &index, Ticks &localPos) const;
 };
 
 #endif // MAINWINDOW_H
@@ -0,0 +1,69 @@
+#ifndef MEDIABIN_H
+#define MEDIABIN_H
+
+#include <QAbstractTableModel>
+#include <QWidget>
+#include "MediaIndex.h"
+
+class QDoubleSpinBox;
+class QLabel;
+class QLineEdit;
+class QSpinBox;
+class QTimer;
+class JobScheduler;
+class MediaProber;
+
+// Table of the current search results; rows drag onto the timeline
+class MediaBinModel : public QAbstractTableModel
+{
+public:
+    explicit MediaBinModel(const MediaIndex *index, QObject *parent = nullptr);
+
+    void setResults(const QVector<int> &ids);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+    Qt::ItemFlags flags(const QModelIndex &index) const override;
+    QStringList mimeTypes() const override;
+    QMimeData *mimeData(const QModelIndexList &indexes) const override;
+
+private:
+    const MediaIndex *m_index;
+    QVector<int> m_ids;
+};
+
+class MediaBin : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit MediaBin(JobScheduler *jobs, QWidget *parent = nullptr);
+
+    void importFiles(const QStringList &paths);
+    const MediaIndex &index() const { return m_index; }
+
+private slots:
+    void onImportClicked();
+    void onImportFolderClicked();
+    void refreshResults();
+
+private:
+    MediaIndex m_index;
+    MediaProber *m_prober;
+    MediaBinModel *m_model;
+    QLineEdit *m_searchEdit;
+    QDoubleSpinBox *m_minDuration;
+    QDoubleSpinBox *m_maxDuration;
+    QSpinBox *m_minHeight;
+    QLabel *m_statusLabel;
+    QTimer *m_refreshTimer;  // Coalesces refreshes while probes stream in
+    double m_lastSearchMs;
+
+    void setupUI();
+    void onProbed(const MediaAsset &asset);
+    void updateStatus(int shown);
+};
+
+#endif // MEDIABIN_H
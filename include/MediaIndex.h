@@ -0,0 +1,64 @@
+#ifndef MEDIAINDEX_H
+#define MEDIAINDEX_H
+
+#include <QHash>
+#include <QPair>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include "Timebase.h"
+
+// Mime type for media dragged from the bin: one "path\tduration" line
+// per asset, duration in ticks
+const char kMediaMimeType[] = "application/x-mvideo-media";
+
+struct MediaAsset
+{
+    QString path;
+    QString name;
+    Ticks duration;
+    int width;
+    int height;
+    QString codec;
+    QStringList tags;
+};
+
+struct MediaFilter
+{
+    Ticks minDuration;
+    Ticks maxDuration;  // 0 for no upper bound
+    int minHeight;
+};
+
+// In-memory index of imported sources. Text search goes through a
+// trigram index over name, path tokens, codec and tags; duration range
+// filters use a sorted column. Assets are added one at a time as their
+// probes finish.
+class MediaIndex
+{
+public:
+    int addAsset(const MediaAsset &asset);
+    void addTags(int id, const QStringList &tags);
+
+    int size() const { return m_assets.size(); }
+    const MediaAsset &asset(int id) const { return m_assets[id]; }
+    bool contains(const QString &path) const { return m_idsByPath.contains(path); }
+
+    // Ids of assets containing every whitespace-separated term of query
+    // and passing filter, in import order
+    QVector<int> search(const QString &query, const MediaFilter &filter) const;
+
+private:
+    QVector<MediaAsset> m_assets;
+    QVector<QString> m_searchText;              // Lowercased text each asset is matched on
+    QHash<QString, int> m_idsByPath;
+    QHash<quint64, QVector<int>> m_trigrams;    // Trigram -> sorted asset ids
+    QVector<QPair<Ticks, int>> m_byDuration;    // Sorted by duration
+
+    void indexText(int id, const QString &text);
+    QVector<int> idsForTerm(const QString &term) const;
+    QVector<int> idsInDurationRange(const MediaFilter &filter) const;
+    bool matches(int id, const QStringList &terms, const MediaFilter &filter) const;
+};
+
+#endif // MEDIAINDEX_H
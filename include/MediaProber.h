@@ -0,0 +1,34 @@
+#ifndef MEDIAPROBER_H
+#define MEDIAPROBER_H
+
+#include <QObject>
+#include <QSet>
+#include <QStringList>
+#include "JobScheduler.h"
+#include "MediaIndex.h"
+
+// Runs ffprobe on queued files as Visible jobs without blocking the GUI
+// and reports each source as soon as its probe finishes.
+class MediaProber : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit MediaProber(JobScheduler *jobs, QObject *parent = nullptr);
+    ~MediaProber();
+
+    // Paths already being probed are skipped
+    void enqueue(const QStringList &paths);
+    int pendingCount() const { return m_pending.size(); }
+
+signals:
+    void probed(const MediaAsset &asset);
+    void failed(const QString &path);
+
+private:
+    JobScheduler *m_jobs;
+    CancelToken m_token;    // Cancelled with the prober
+    QSet<QString> m_pending;    // Queued or probing
+};
+
+#endif // MEDIAPROBER_H
@@ -0,0 +1,96 @@
+#ifndef MEMORYBUDGET_H
+#define MEMORYBUDGET_H
+
+#include <QObject>
+#include <QString>
+#include <QVector>
+#include <functional>
+
+class QTimer;
+struct mpv_handle;
+
+// One ceiling on the memory every cache in the process holds. Each cache
+// registers with the bytes it would like, the least it can work with and a
+// priority, and is given a limit: minimums first, then what it wants in
+// priority order until the ceiling is spent. Usage is read back once a
+// second; when the total runs over, the lowest priority caches are told
+// to shrink first, and keep the smaller limits until usage has fallen
+// well below the ceiling. Caches that can't shrink are only counted, and
+// what they hold comes out of everyone else's share. GUI thread only.
+class MemoryBudget : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Priority
+    {
+        Low,        // Previews that can refill cheaply
+        Normal,
+        High        // Playback
+    };
+
+    typedef std::function<qint64()> Usage;
+    typedef std::function<void(qint64)> Resize;
+
+    struct Holder
+    {
+        QString name;
+        Priority priority;
+        qint64 wanted;
+        qint64 minimum;
+        qint64 limit;       // -1 if it can't be resized
+        qint64 bytes;
+    };
+
+    static const qint64 kDefaultCeiling = 2048LL * 1024 * 1024;
+
+    explicit MemoryBudget(QObject *parent = nullptr);
+
+    // resize is called with the new limit whenever it changes, including
+    // once from add
+    int add(const QString &name, Priority priority, qint64 wanted, qint64 minimum, Usage usage,
+            Resize resize = Resize());
+    void remove(int id);
+
+    void setCeiling(qint64 bytes);
+    qint64 ceiling() const { return m_ceiling; }
+
+    QVector<Holder> holders() const;
+    qint64 used() const;
+    qint64 peak() const { return m_peak; }
+    int pressureEvents() const { return m_pressureEvents; }
+
+    // Reads usage back and acts on it; the timer calls this once a second
+    void poll();
+
+    // The demuxer cache of an mpv instance, as forward and back bytes in a
+    // 3:1 split of the limit
+    static qint64 mpvCacheBytes(mpv_handle *mpv);
+    static void setMpvCacheLimit(mpv_handle *mpv, qint64 bytes);
+
+signals:
+    void updated();
+
+private:
+    struct Entry
+    {
+        int id;
+        Holder holder;
+        Usage usage;
+        Resize resize;
+    };
+
+    QVector<Entry> m_entries;
+    QTimer *m_timer;
+    qint64 m_ceiling;
+    qint64 m_peak;
+    int m_pressureEvents;
+    int m_nextId;
+    bool m_relieved;        // Limits cut under pressure, not yet restored
+
+    void rebalance(bool allowGrowth = true);
+    void relieve(qint64 excess);
+    void applyLimit(Entry &entry, qint64 limit);
+};
+
+#endif // MEMORYBUDGET_H
@@ -0,0 +1,29 @@
+#ifndef MEMORYPANEL_H
+#define MEMORYPANEL_H
+
+#include <QWidget>
+
+class QLabel;
+class QSpinBox;
+class QTableWidget;
+class MemoryBudget;
+
+// Dockable view of the MemoryBudget: the ceiling, which can be changed
+// here, and what each cache holds against the limit it was given
+class MemoryPanel : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit MemoryPanel(MemoryBudget *budget, QWidget *parent = nullptr);
+
+private:
+    MemoryBudget *m_budget;
+    QSpinBox *m_ceiling;
+    QLabel *m_summary;
+    QTableWidget *m_holders;
+
+    void refresh();
+};
+
+#endif // MEMORYPANEL_H
@@ -0,0 +1,36 @@
+#ifndef METRICSPANEL_H
+#define METRICSPANEL_H
+
+#include <QWidget>
+
+class QLabel;
+class PlaybackMetrics;
+
+// Dockable view of the PlaybackMetrics samples and latencies
+class MetricsPanel : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit MetricsPanel(PlaybackMetrics *metrics, QWidget *parent = nullptr);
+
+private:
+    PlaybackMetrics *m_metrics;
+    QLabel *m_frameDrops;
+    QLabel *m_decoderFrameDrops;
+    QLabel *m_delayedFrames;
+    QLabel *m_cacheDuration;
+    QLabel *m_cacheSpeed;
+    QLabel *m_filterFps;
+    QLabel *m_rebuildLatency;
+    QLabel *m_seekLatency;
+    QLabel *m_timeToInteractive;
+    QLabel *m_jobQueues;
+    QLabel *m_jobLatency;
+    QLabel *m_nesting;
+    QLabel *m_exportPath;
+
+    void refresh();
+};
+
+#endif // METRICSPANEL_H
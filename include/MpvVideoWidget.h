@@ -5,6 +5,9 @@
 #include <QOpenGLFunctions>
 #include <mpv/client.h>
 #include <mpv/render.h>
+#include "FrameTap.h"
+
+class VideoScopes;
 
 class MpvVideoWidget : public QOpenGLWidget, protected QOpenGLFunctions
 {
@@ -15,6 +18,7 @@ public:
     ~MpvVideoWidget() override;
 
     void setMpv(mpv_handle *handle);
+    void setScopes(VideoScopes *videoScopes) { scopes = videoScopes; }
     void shutdown();
 
 protected:
@@ -25,6 +29,8 @@ protected:
 private:
     mpv_handle *mpv;
     mpv_render_context *mpvGl;
+    VideoScopes *scopes;
+    FrameTap tap;
 
     static void *getProcAddress(void *ctx, const char *name);
     static void onMpvUpdate(void *ctx);
@@ -0,0 +1,59 @@
+#ifndef MPVVIDEOWINDOW_H
+#define MPVVIDEOWINDOW_H
+
+#include <QWindow>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QSize>
+#include <mpv/client.h>
+#include <mpv/render.h>
+
+class QOpenGLContext;
+class QThread;
+class VideoScopes;
+
+// Video surface that renders mpv on a dedicated thread with its own
+// OpenGL context, so slow GUI work never delays frame presentation.
+// Embed it with QWidget::createWindowContainer.
+class MpvVideoWindow : public QWindow
+{
+    Q_OBJECT
+
+public:
+    explicit MpvVideoWindow(QWindow *parent = nullptr);
+    ~MpvVideoWindow() override;
+
+    // Whether the platform allows rendering from a non-GUI thread
+    static bool isSupported();
+
+    void setMpv(mpv_handle *handle);
+    // Before rendering starts
+    void setScopes(VideoScopes *videoScopes) { scopes = videoScopes; }
+    void shutdown();
+
+protected:
+    void exposeEvent(QExposeEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+
+private:
+    mpv_handle *mpv;
+    QOpenGLContext *glContext;
+    QThread *renderThread;
+    VideoScopes *scopes;
+
+    // Shared between the GUI, mpv and render threads
+    QMutex renderMutex;
+    QWaitCondition renderCondition;
+    QSize framebufferSize;
+    bool updatePending;
+    bool resizePending;
+    bool stopRequested;
+
+    static void *getProcAddress(void *ctx, const char *name);
+    static void onMpvUpdate(void *ctx);
+    void startRendering();
+    void renderLoop();
+    void updateFramebufferSize();
+};
+
+#endif // MPVVIDEOWINDOW_H
@@ -0,0 +1,51 @@
+#ifndef MULTICAM_H
+#define MULTICAM_H
+
+#include <QString>
+#include <QVector>
+#include "Timebase.h"
+
+// One synced camera in a multicam clip
+struct CameraAngle
+{
+    QString path;
+    Ticks syncOffset;   // Source time at the group's time zero
+
+    bool operator==(const CameraAngle &other) const
+    {
+        return path == other.path && syncOffset == other.syncOffset;
+    }
+};
+
+namespace Multicam {
+
+const int kMinAngles = 2;
+const int kMaxAngles = 4;
+
+// Size each angle is scaled to in the viewer grid
+const int kAngleWidth = 480;
+const int kAngleHeight = 270;
+
+// Grid layout: side by side for two angles, 2x2 for three or four
+int columns(int count);
+int rows(int count);
+
+// The angle's source as an EDL starting at its sync offset, so every
+// angle's time zero is the group's
+QString angleSource(const CameraAngle &angle);
+
+// lavfi-complex graph scaling mpv's video tracks (vid1 ...) down and
+// stacking them into one frame
+QString gridGraph(int count);
+
+// Angle under a point given as a fraction of the grid's width and
+// height, or -1
+int angleAt(int count, double x, double y);
+
+// One "offset<TAB>path" line per angle, for the edit journal
+QString encodeAngles(const QVector<CameraAngle> &angles);
+QVector<CameraAngle> decodeAngles(const QString &encoded);
+
+}
+
+#endif // MULTICAM_H
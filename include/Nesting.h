@@ -0,0 +1,30 @@
+#ifndef NESTING_H
+#define NESTING_H
+
+#include <QString>
+
+// Compound clips: a clip whose path names another sequence of the same
+// timeline, which it plays like a source
+namespace Nesting {
+
+// The sequence a new session opens in
+const char *const kMainSequence = "Main";
+
+inline QString compoundPath(const QString &sequence)
+{
+    return "compound://" + sequence;
+}
+
+inline bool isCompound(const QString &path)
+{
+    return path.startsWith("compound://");
+}
+
+inline QString sequenceName(const QString &path)
+{
+    return isCompound(path) ? path.mid(11) : QString();
+}
+
+}
+
+#endif // NESTING_H
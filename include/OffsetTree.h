@@ -0,0 +1,71 @@
+#ifndef OFFSETTREE_H
+#define OFFSETTREE_H
+
+#include <QVector>
+#include "Timebase.h"
+
+// Clip positions in timeline order, as a treap with shifts kept lazily on
+// subtrees. Every operation a ripple edit needs is O(log n) expected:
+// shifting every position from one onwards, inserting a position in
+// order, removing one and finding where a time falls. Nodes are stable
+// handles, so callers can keep one per clip.
+class OffsetTree
+{
+public:
+    OffsetTree();
+
+    void clear();
+    int size() const { return sizeOf(m_root); }
+
+    // Rebuilds from times already in order in O(n); node i holds times[i]
+    void assign(const QVector<Ticks> &times);
+
+    // Returns the new node, at position in the order
+    int insert(int position, Ticks time);
+    void remove(int node);
+
+    // Shifts the position at position and every one after it
+    void shiftFrom(int position, Ticks delta);
+
+    int positionOf(int node) const;
+    // The node at position, or -1 past the end
+    int nodeAt(int position) const;
+    Ticks timeOf(int node) const;
+
+    // Positions of the first time at or after, and after, time
+    int lowerBound(Ticks time) const;
+    int upperBound(Ticks time) const;
+
+    // Applies every pending shift, so timeOf() is a plain read until the
+    // next shift. For callers reading every node.
+    void settle();
+
+private:
+    struct Node
+    {
+        Ticks time;     // Exact once the ancestors' shifts are added
+        Ticks shift;    // Pending for both subtrees
+        int left;
+        int right;
+        int parent;
+        int size;
+        quint32 priority;
+    };
+
+    QVector<Node> m_nodes;
+    QVector<int> m_free;
+    int m_root;
+    quint32 m_seed;
+    bool m_settled;         // No shift pending anywhere
+
+    int sizeOf(int node) const { return node < 0 ? 0 : m_nodes[node].size; }
+    int newNode(Ticks time);
+    quint32 nextPriority();
+    void push(int node);
+    void pull(int node);
+    void split(int node, int count, int &first, int &rest);
+    int merge(int first, int rest);
+    int bound(Ticks time, bool inclusive) const;
+};
+
+#endif // OFFSETTREE_H
@@ -0,0 +1,112 @@
+#ifndef PLAYBACKMETRICS_H
+#define PLAYBACKMETRICS_H
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QString>
+#include <QVector>
+#include <mpv/client.h>
+
+class QTimer;
+class JobScheduler;
+class MemoryBudget;
+class SequenceFlattener;
+
+// Samples mpv's playback health properties once a second, together with
+// our own rebuild and seek latencies, and writes each sample to a file as
+// JSON or, for a path ending in .prom, Prometheus text, so soak tests can
+// grade a run without scraping the UI.
+class PlaybackMetrics : public QObject
+{
+    Q_OBJECT
+
+public:
+    // Unavailable properties (nothing loaded, no cache) read as -1
+    struct Sample
+    {
+        qint64 frameDrops;
+        qint64 decoderFrameDrops;
+        qint64 delayedFrames;
+        double cacheDuration;     // Seconds of demuxed media buffered ahead
+        qint64 cacheSpeed;        // Bytes per second into the cache
+        double filterFps;         // estimated-vf-fps
+    };
+
+    // Percentiles and max are over the recent window; count and total
+    // cover the whole session
+    struct Latency
+    {
+        int count;
+        double lastMs;
+        double p50Ms;
+        double p95Ms;
+        double maxMs;
+        double totalMs;
+    };
+
+    explicit PlaybackMetrics(QObject *parent = nullptr);
+
+    void setMpv(mpv_handle *handle);
+    void setExportPath(const QString &path);
+    QString exportPath() const { return m_exportPath; }
+
+    // A rebuild or seek finishes at mpv's next playback restart
+    void beginRebuild();
+    void beginSeek();
+    void playbackRestarted();
+
+    Sample sample() const { return m_sample; }
+    Latency rebuildLatency() const { return summarize(m_rebuild); }
+    Latency seekLatency() const { return summarize(m_seek); }
+
+    // From process start to the first frame painted with mpv up and the
+    // session restored; -1 until then
+    void setTimeToInteractive(double ms);
+    double timeToInteractiveMs() const { return m_timeToInteractiveMs; }
+
+    // Queue depths and latency per priority class go out with each sample
+    void setJobScheduler(const JobScheduler *jobs) { m_jobs = jobs; }
+    const JobScheduler *jobScheduler() const { return m_jobs; }
+
+    // The ceiling, and what each cache holds against its limit
+    void setMemoryBudget(const MemoryBudget *budget) { m_memory = budget; }
+
+    // Nesting depth and flattening cache reuse of the last rebuild
+    void setSequenceFlattener(const SequenceFlattener *flattener) { m_flattener = flattener; }
+    const SequenceFlattener *sequenceFlattener() const { return m_flattener; }
+
+signals:
+    void updated();
+
+private:
+    enum Pending { None, Rebuild, Seek };
+
+    struct Series
+    {
+        QVector<double> recent;
+        int count;
+        double totalMs;
+    };
+
+    mpv_handle *m_mpv;
+    QTimer *m_timer;
+    QString m_exportPath;
+    Sample m_sample;
+    Pending m_pending;
+    QElapsedTimer m_pendingTimer;
+    Series m_rebuild;
+    Series m_seek;
+    double m_timeToInteractiveMs;
+    const JobScheduler *m_jobs;
+    const MemoryBudget *m_memory;
+    const SequenceFlattener *m_flattener;
+
+    static Latency summarize(const Series &series);
+    static void record(Series &series, double ms);
+    void poll();
+    void writeSnapshot() const;
+    QByteArray toJson() const;
+    QByteArray toPrometheus() const;
+};
+
+#endif // PLAYBACKMETRICS_H
@@ -0,0 +1,43 @@
+#ifndef PROJECTSETTINGS_H
+#define PROJECTSETTINGS_H
+
+#include <QString>
+#include "Timebase.h"
+
+// The format the timeline plays and exports in. Gaps, transitions and
+// conformed sources are rendered in it, so the preview plays one format
+// from end to end.
+struct ProjectSettings
+{
+    int width;
+    int height;
+    FrameRate frameRate;
+    int sampleRate;
+
+    bool operator==(const ProjectSettings &other) const
+    {
+        return width == other.width && height == other.height
+            && frameRate.numerator == other.frameRate.numerator
+            && frameRate.denominator == other.frameRate.denominator
+            && sampleRate == other.sampleRate;
+    }
+    bool operator!=(const ProjectSettings &other) const { return !(*this == other); }
+};
+
+namespace Project {
+
+// 1920x1080, 30 fps, 48 kHz
+ProjectSettings defaults();
+bool isValid(const ProjectSettings &settings);
+
+// Frame rate as ffmpeg takes and ffprobe reports it, e.g. "30000/1001"
+QString rateString(FrameRate rate);
+
+// "1920x1080, 30000/1001, 48000", used by the settings dialog and the
+// edit journal. The rate may also be written as 29.97 or 30.
+QString encode(const ProjectSettings &settings);
+bool decode(const QString &text, ProjectSettings &settings);
+
+}
+
+#endif // PROJECTSETTINGS_H
@@ -0,0 +1,32 @@
+#ifndef SCOPEKERNELS_H
+#define SCOPEKERNELS_H
+
+#include <QtGlobal>
+
+// Accumulation kernels for the video scopes, over RGBA8888 frames as
+// glReadPixels returns them. Luma and chroma are BT.709 in 7-bit fixed
+// point, converted eight pixels at a time with SIMD; the bin increments
+// after that are a scatter and stay scalar.
+//
+// Every kernel adds to its bins, so callers clear them for each frame.
+// stride is the distance between rows in bytes.
+namespace ScopeKernels {
+
+const int kLevels = 256;
+
+void lumaRow(const uchar *rgba, int width, uchar *luma);
+// Cb and Cr offset by 128
+void chromaRow(const uchar *rgba, int width, uchar *cb, uchar *cr);
+
+// width columns of kLevels bins
+void waveform(const uchar *rgba, int width, int height, int stride, quint32 *bins);
+// Red, green then blue, each laid out as waveform
+void parade(const uchar *rgba, int width, int height, int stride, quint32 *bins);
+// kLevels rows by Cr of kLevels bins by Cb
+void vectorscope(const uchar *rgba, int width, int height, int stride, quint32 *bins);
+// Red, green, blue then luma, kLevels bins each
+void histogram(const uchar *rgba, int width, int height, int stride, quint32 *bins);
+
+} // namespace ScopeKernels
+
+#endif // SCOPEKERNELS_H
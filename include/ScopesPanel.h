@@ -0,0 +1,28 @@
+#ifndef SCOPESPANEL_H
+#define SCOPESPANEL_H
+
+#include <QWidget>
+
+class VideoScopes;
+
+// Dockable view of the VideoScopes images in a two by two grid, with the
+// time each scope takes. The scopes only run while the panel is shown.
+class ScopesPanel : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit ScopesPanel(VideoScopes *scopes, QWidget *parent = nullptr);
+
+    QSize sizeHint() const override;
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void showEvent(QShowEvent *event) override;
+    void hideEvent(QHideEvent *event) override;
+
+private:
+    VideoScopes *m_scopes;
+};
+
+#endif // SCOPESPANEL_H
@@ -0,0 +1,57 @@
+#ifndef SEGMENTBUILDER_H
+#define SEGMENTBUILDER_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include "Timebase.h"
+
+class Timeline;
+class ConformCache;
+class TransitionCache;
+class SequenceFlattener;
+
+// A stretch of the preview: a source, the gap filler or a transition
+struct TimelineSegment
+{
+    QString source;
+    Ticks timelineStart;
+    Ticks duration;
+    Ticks trimStart;
+    bool isGap;
+    bool isTransition;
+    QString lavfiGraph;  // Set while a transition is composited live
+};
+
+// Lays the timeline out as the segments the preview plays, in order and
+// without overlaps: clips by start time with the gaps between them,
+// transitions at the heads of their clips and compound clips flattened in
+// place. Building also queues the conform and transition renders the
+// segments want. Kept apart from the window so benchmarks run the same
+// rebuild the preview does.
+class SegmentBuilder
+{
+public:
+    SegmentBuilder(Timeline *timeline, ConformCache *conformCache, TransitionCache *transitionCache,
+                   SequenceFlattener *sequenceFlattener);
+
+    QVector<TimelineSegment> build() const;
+
+    // Segments first to last as mpv EDL parts, playing conformed renders
+    // where there are any
+    QStringList edlParts(const QVector<TimelineSegment> &segments, int first, int last) const;
+
+    // The gap filler trimmed to duration, as EDL parts, or black from lavfi
+    // until the filler is rendered
+    QString gapSource(Ticks duration) const;
+
+private:
+    Timeline *m_timeline;
+    ConformCache *m_conformCache;
+    TransitionCache *m_transitionCache;
+    SequenceFlattener *m_sequenceFlattener;
+
+    TimelineSegment gapSegment(Ticks start, Ticks duration) const;
+};
+
+#endif // SEGMENTBUILDER_H
@@ -0,0 +1,82 @@
+#ifndef SEQUENCEFLATTENER_H
+#define SEQUENCEFLATTENER_H
+
+#include "Timebase.h"
+#include <QElapsedTimer>
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+class Timeline;
+
+// Turns compound clips into the plain sources and gaps they play. Each
+// nested sequence is flattened once and kept against its version and the
+// versions of everything nested in it, so an edit to one sequence only
+// re-flattens that sequence and those containing it. GUI thread only.
+class SequenceFlattener
+{
+public:
+    // A stretch of source, or of black, on the timeline
+    struct Piece
+    {
+        QString source;
+        Ticks start;
+        Ticks duration;
+        Ticks trimStart;
+        bool isGap;
+    };
+
+    // Hits and misses count sequences taken from or put in the cache; the
+    // pass figures are for the last beginPass/endPass
+    struct Stats
+    {
+        int cached;
+        int depth;
+        int passHits;
+        int passMisses;
+        qint64 hits;
+        qint64 misses;
+        double lastPassMs;
+    };
+
+    explicit SequenceFlattener(const Timeline *timeline);
+
+    void beginPass();
+    void endPass();
+
+    // The pieces a compound clip of the sequence plays, placed at start on
+    // the timeline: trimStart to trimStart + duration of the sequence, with
+    // black past its end. False if the sequence is missing or contains
+    // itself.
+    bool expand(const QString &name, Ticks start, Ticks trimStart, Ticks duration, QVector<Piece> &pieces);
+
+    Stats stats() const;
+
+private:
+    struct Entry
+    {
+        quint64 version;
+        QHash<QString, quint64> dependencies;  // Every sequence nested in it, at any depth
+        QVector<Piece> pieces;                  // From 0 in the sequence's own time
+        Ticks length;
+        int depth;
+    };
+
+    const Timeline *m_timeline;
+    QHash<QString, Entry> m_entries;
+    QStringList m_stack;                        // Sequences being flattened
+    qint64 m_hits;
+    qint64 m_misses;
+    int m_passHits;
+    int m_passMisses;
+    int m_passDepth;
+    QElapsedTimer m_passTimer;
+    double m_lastPassMs;
+
+    bool flatten(const QString &name, Entry &entry);
+    bool isCurrent(const Entry &entry, const QString &name) const;
+    static void slice(const Entry &entry, Ticks start, Ticks trimStart, Ticks duration, QVector<Piece> &pieces);
+};
+
+#endif // SEQUENCEFLATTENER_H
@@ -0,0 +1,33 @@
+#ifndef SEQUENCEPREFETCHER_H
+#define SEQUENCEPREFETCHER_H
+
+#include <QObject>
+#include <QSet>
+#include <QStringList>
+#include "JobScheduler.h"
+
+// Reads image sequence frames ahead of the playhead as scheduler jobs,
+// several at once. mpv's mf demuxer opens one frame file at a time, and
+// large EXR or DPX frames read back to back from a network share can't
+// keep up with the frame rate; read in parallel beforehand they come from
+// the page cache instead.
+class SequencePrefetcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit SequencePrefetcher(JobScheduler *jobs, QObject *parent = nullptr);
+    ~SequencePrefetcher();
+
+    // Replaces the frames still waiting; ones read recently are skipped
+    void prefetch(const QStringList &paths);
+
+private:
+    JobScheduler *m_jobs;
+    CancelToken m_token;        // The frames still waiting
+    QSet<QString> m_queue;      // Submitted and not read yet
+    QSet<QString> m_recent;     // Read or queued
+    QStringList m_recentOrder;  // Oldest first
+};
+
+#endif // SEQUENCEPREFETCHER_H
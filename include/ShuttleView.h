@@ -0,0 +1,27 @@
+#ifndef SHUTTLEVIEW_H
+#define SHUTTLEVIEW_H
+
+#include <QImage>
+#include <QWidget>
+
+// Shows frames from the FrameCache in place of the mpv video while
+// shuttling, letterboxed, with the shuttle speed in the corner
+class ShuttleView : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit ShuttleView(QWidget *parent = nullptr);
+
+    void setFrame(const QImage &frame);
+    void setSpeed(int speed);
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+
+private:
+    QImage m_frame;
+    int m_speed;
+};
+
+#endif // SHUTTLEVIEW_H
@@ -0,0 +1,154 @@
+#ifndef SMARTEXPORTER_H
+#define SMARTEXPORTER_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QObject>
+#include <QVector>
+#include <memory>
+#include "JobScheduler.h"
+#include "ProjectSettings.h"
+
+class QTemporaryDir;
+class AudioMixer;
+class KeyframeIndex;
+class KeyframeIndexer;
+
+struct ExportSegment
+{
+    QString source;
+    Ticks trimStart;
+    Ticks duration;
+    bool isGap;
+    bool isLavfi;    // source is a lavfi graph, such as a live transition
+};
+
+// Exports timeline segments by stream-copying the whole GOPs inside each
+// segment and re-encoding only the partial GOPs at its cut points.
+// Segments are split into keyframe-aligned chunks that ffmpeg writes in
+// parallel as scheduler jobs, costliest first; the chunks are then joined
+// with the concat demuxer. Chunk audio is kept as PCM and
+// encoded once over the whole program as the chunks are joined, so there
+// is no encoder priming or padding at the joins.
+class SmartExporter : public QObject
+{
+    Q_OBJECT
+
+public:
+    SmartExporter(KeyframeIndexer *indexer, JobScheduler *jobs, QObject *parent = nullptr);
+    ~SmartExporter();
+
+    // Chunks in flight at once, each shown as a worker. Defaults to, and
+    // is capped at, the scheduler's process limit.
+    void setWorkerCount(int count);
+    int workerCount() const { return m_workers.size(); }
+
+    // With stream copy off every chunk is re-encoded (a full transcode)
+    void setStreamCopyEnabled(bool enabled) { m_streamCopyEnabled = enabled; }
+
+    // The audio tracks' mix, rendered alongside the chunks and mixed into
+    // the clips' audio when they are joined
+    void setAudioMixer(const AudioMixer *mixer) { m_audioMixer = mixer; }
+
+    // Output size, frame rate and sample rate. Image sequences have no
+    // rate of their own and are read at the project's.
+    void setProjectSettings(const ProjectSettings &settings) { m_settings = settings; }
+
+    void start(const QVector<ExportSegment> &segments, const QString &outputPath);
+    void cancel();
+    bool isRunning() const;
+
+signals:
+    void progress(int done, int total);
+    void workerProgress(int worker, int piece, int percent);  // piece -1 when idle
+    void finished(bool ok, const QString &report);
+
+private:
+    struct SourceInfo
+    {
+        QString codec;
+        QString profile;    // As ffprobe names it, e.g. "High"
+        int level;          // As ffprobe reports it, e.g. 40 for H.264 level 4.0
+        int refs;
+        QString pixelFormat;
+        QString frameRate;  // As ffprobe reports it, e.g. "30000/1001"
+        int width;
+        int height;
+        Ticks videoStart;   // Video stream's start, past the file's; keyframe times are from it
+        bool hasAudio;
+    };
+
+    struct Piece
+    {
+        QString source;  // Empty for gaps, a graph for lavfi pieces
+        bool lavfi;
+        Ticks start;
+        Ticks duration;
+        bool copy;
+        double cost;     // Estimated work, for scheduling
+        int attempts;
+        QString file;
+        QString audioFile;  // PCM, joined and encoded once for the program
+    };
+
+    struct Worker
+    {
+        int piece;          // -1 when idle
+        QElapsedTimer timer;
+    };
+
+    KeyframeIndexer *m_indexer;
+    JobScheduler *m_jobs;
+    CancelToken m_token;    // Cancelled when the export ends
+    int m_probesLeft;
+    QVector<ExportSegment> m_segments;
+    QString m_outputPath;
+    QHash<QString, SourceInfo> m_sources;
+    SourceInfo m_output;
+    QString m_encoder;
+    QString m_pieceSuffix;  // Intermediate container, by extension
+    QVector<Piece> m_pieces;
+    QVector<int> m_queue;  // Pieces waiting for a worker, costliest first
+    QVector<Worker> m_workers;
+    int m_donePieces;
+    std::shared_ptr<QTemporaryDir> m_workDir;  // Also held by the jobs writing in it
+    bool m_waitingForIndexes;
+    bool m_streamCopyEnabled;
+    const AudioMixer *m_audioMixer;
+    ProjectSettings m_settings;
+    bool m_hasMix;
+    bool m_mixing;
+    bool m_mixOk;
+
+    // Report figures
+    QElapsedTimer m_timer;
+    qint64 m_encodeMs;
+    qint64 m_busyMs;
+    Ticks m_copiedTicks;
+    Ticks m_encodedTicks;
+    int m_copiedPieces;
+    int m_retries;
+
+    void onIndexReady();
+    void probeSources();
+    void plan();
+    void planSegment(const ExportSegment &segment);
+    void addPieces(const QString &source, const KeyframeIndex *keyframes,
+                   Ticks start, Ticks end, bool copy);
+    static bool parseProbe(const QByteArray &output, SourceInfo &info);
+    bool canCopy(const QString &source) const;
+    QStringList pieceArguments(const Piece &piece) const;
+    QStringList encoderArguments(const SourceInfo &info) const;
+    void dispatch();
+    void runPiece(int worker);
+    void onPieceProgress(int worker, int piece, int attempt, int percent);
+    void onPieceFinished(int worker, bool ok, const QString &errors);
+    void onMixFinished(bool ok);
+    void runConcat();
+    void onJoinFinished(bool ok, const QString &errors);
+    void finish(bool ok, const QString &message);
+    int threadsPerWorker() const;
+    QString report() const;
+};
+
+#endif // SMARTEXPORTER_H
@@ -0,0 +1,26 @@
+#ifndef SNAPINDEX_H
+#define SNAPINDEX_H
+
+#include <QMap>
+#include "Timebase.h"
+
+// Sorted set of snap targets (clip edges, markers) on the timeline.
+// Edges are reference counted so clips that share a boundary can be
+// moved independently; lookups are a single binary search.
+class SnapIndex
+{
+public:
+    void clear() { m_edges.clear(); }
+    int size() const { return m_edges.size(); }
+
+    void insertEdge(Ticks time);
+    void removeEdge(Ticks time);
+
+    // Finds the edge closest to time within tolerance. Returns false if none.
+    bool nearestEdge(Ticks time, Ticks tolerance, Ticks &edge) const;
+
+private:
+    QMap<Ticks, int> m_edges;  // Edge time -> number of targets at that time
+};
+
+#endif // SNAPINDEX_H
@@ -0,0 +1,19 @@
+#ifndef STARTUPPROFILE_H
+#define STARTUPPROFILE_H
+
+#include <QtGlobal>
+
+// Wall clock time of each startup phase, measured from the start of main.
+// Phases are marked on the GUI thread as they finish.
+namespace StartupProfile {
+
+void start();
+void mark(const char *phase);
+double elapsedMs();
+
+// One line per phase with its time since start and since the phase before
+void print();
+
+} // namespace StartupProfile
+
+#endif // STARTUPPROFILE_H
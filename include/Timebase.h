@@ -0,0 +1,82 @@
+#ifndef TIMEBASE_H
+#define TIMEBASE_H
+
+#include <QString>
+#include <QtGlobal>
+#include <cmath>
+
+// Integer time used by clips, the timeline and EDL generation.
+// One tick is 1/705600000 s, which divides evenly into every common
+// frame rate (including the 1001-based NTSC rates) and audio sample rate,
+// so frame and sample positions convert exactly and never drift.
+typedef qint64 Ticks;
+
+struct FrameRate
+{
+    int numerator;
+    int denominator;
+};
+
+namespace Timebase {
+
+const Ticks kTicksPerSecond = 705600000;
+
+inline Ticks fromSeconds(double seconds)
+{
+    return static_cast<Ticks>(std::llround(seconds * kTicksPerSecond));
+}
+
+inline double toSeconds(Ticks ticks)
+{
+    return static_cast<double>(ticks) / kTicksPerSecond;
+}
+
+inline Ticks frameTicks(FrameRate rate)
+{
+    return kTicksPerSecond * rate.denominator / rate.numerator;
+}
+
+// Frame containing ticks (floor)
+inline qint64 toFrame(Ticks ticks, FrameRate rate)
+{
+    const Ticks frame = frameTicks(rate);
+    return ticks >= 0 ? ticks / frame : -((-ticks + frame - 1) / frame);
+}
+
+inline Ticks fromFrame(qint64 frame, FrameRate rate)
+{
+    return frame * frameTicks(rate);
+}
+
+// Nearest frame boundary
+inline Ticks snapToFrame(Ticks ticks, FrameRate rate)
+{
+    return fromFrame(toFrame(ticks + frameTicks(rate) / 2, rate), rate);
+}
+
+// First frame boundary at or after ticks
+inline Ticks ceilToFrame(Ticks ticks, FrameRate rate)
+{
+    return fromFrame(toFrame(ticks + frameTicks(rate) - 1, rate), rate);
+}
+
+inline qint64 toSamples(Ticks ticks, int sampleRate)
+{
+    return ticks / (kTicksPerSecond / sampleRate);
+}
+
+inline Ticks fromSamples(qint64 samples, int sampleRate)
+{
+    return samples * (kTicksPerSecond / sampleRate);
+}
+
+// Seconds for mpv, with enough digits that a frame boundary stays inside
+// its frame after rounding
+inline QString toEdlSeconds(Ticks ticks)
+{
+    return QString::number(toSeconds(ticks), 'f', 6);
+}
+
+} // namespace Timebase
+
+#endif // TIMEBASE_H
@@ -2,12 +2,84 @@
 #define TIMELINE_H
 
 #include <QWidget>
+#include <QHash>
+#include <QSet>
+#include <QStringList>
 #include <QVector>
 #include <QPushButton>
 #include "Clip.h"
+#include "AudioClip.h"
+#include "SnapIndex.h"
+#include "OffsetTree.h"
+#include "MediaIndex.h"
+#include "ProjectSettings.h"
+#include "JobScheduler.h"
 
 // Forward declaration for mpv
 struct mpv_handle;
+class QTimer;
+class KeyframeIndexer;
+class TransitionCache;
+class EditJournal;
+
+// One timeline mutation, as recorded in the edit journal. Which fields
+// are used depends on the type.
+struct TimelineEdit
+{
+    enum Type : quint8
+    {
+        AddClip = 1,        // path, time (start), duration
+        RemoveClip,         // index
+        ClearClips,
+        RippleDelete,       // index
+        RippleInsert,       // path, time (start), duration
+        RippleTrim,         // index, time (trim start), duration
+        MoveClip,           // index, time (start)
+        AddMarker,          // time
+        SetTransition,      // index, value (type), duration
+        AddMulticam,        // path (encoded angles), time (start), duration
+        CutToAngle,         // time, value (angle)
+        TrimClip,           // index, time (trim start), duration
+        AddAudioClip,       // path, index (track), time (start), duration
+        RemoveAudioClip,    // index
+        MoveAudioClip,      // index, time (start), value (track)
+        SetAudioGain,       // index, value (hundredths of a dB)
+        SetAudioPan,        // index, value (thousandths, -1000 left to 1000 right)
+        SetAudioFades,      // index, time (fade in), duration (fade out)
+        SetProjectSettings, // path (Project::encode)
+        OpenSequence,       // path (sequence name)
+        AddTrimmedClip      // path, time (start), duration, trimStart
+    };
+
+    Type type;
+    qint32 index;
+    QString path;
+    Ticks time;
+    Ticks duration;
+    qint32 value;
+    Ticks trimStart;        // AddTrimmedClip only
+};
+
+// A sequence other than the open one, set aside whole
+struct SequenceState
+{
+    QString name;
+    QVector<Clip> clips;
+    QVector<Ticks> markers;
+    QVector<AudioClip> audioClips;
+};
+
+// Everything the journal snapshots. The clips, markers and audio clips
+// are the open sequence's.
+struct TimelineState
+{
+    QVector<Clip> clips;
+    QVector<Ticks> markers;
+    ProjectSettings settings;
+    QVector<AudioClip> audioClips;
+    QString sequence;
+    QVector<SequenceState> otherSequences;
+};
 
 class Timeline : public QWidget
 {
@@ -18,26 +90,121 @@ public:
     ~Timeline();
     
     // Clip management
-    void addClip(const QString &filePath, double startTime, double duration);
+    void addClip(const QString &filePath, Ticks startTime, Ticks duration);
+    // One edit for a clip that starts trimStart into its source
+    void addClip(const QString &filePath, Ticks startTime, Ticks duration, Ticks trimStart);
     void removeClip(int index);
     void clearClips();
     
+    // Ripple edits shift every later clip by the change in length
+    void rippleDelete(int index);
+    void rippleInsert(const QString &filePath, Ticks startTime, Ticks duration);
+    void rippleTrim(int index, Ticks trimStart, Ticks duration);
+    void moveClip(int index, Ticks startTime);
+    // Trim without ripple: moving the in-point moves the clip's start with
+    // it, so nothing else on the timeline shifts
+    void trimClip(int index, Ticks trimStart, Ticks duration);
+    
     // Get clips
-    const QVector<Clip>& clips() const { return m_clips; }
+    const QVector<Clip>& clips() const;
     
-    // Timeline properties
-    double totalDuration() const;
+    // Timeline properties. The total covers the audio tracks as well.
+    Ticks totalDuration() const;
+    FrameRate frameRate() const { return m_settings.frameRate; }
+    
+    // Size, frame rate and sample rate the timeline plays and exports in.
+    // Clips keep their times when the frame rate changes.
+    const ProjectSettings &settings() const { return m_settings; }
+    void setSettings(const ProjectSettings &settings);
     
     // Playhead control
-    void setPlayheadPosition(double time);
-    double playheadPosition() const { return m_playheadPosition; }
+    void setPlayheadPosition(Ticks time);
+    Ticks playheadPosition() const { return m_playheadPosition; }
+    
+    // Markers
+    void addMarker(Ticks time);
+    const QVector<Ticks>& markers() const { return m_markers; }
+    
+    // Snapping to clip edges, markers, the playhead and the frame grid
+    void setSnapEnabled(bool enabled) { m_snapEnabled = enabled; }
+    bool snapEnabled() const { return m_snapEnabled; }
+    
+    // Source keyframe indexes, used to show decode cost at cuts and to
+    // optionally pull trimmed in-points back to a keyframe
+    void setKeyframeIndexer(KeyframeIndexer *indexer);
+    void setKeyframeSnapEnabled(bool enabled) { m_keyframeSnapEnabled = enabled; }
+    bool keyframeSnapEnabled() const { return m_keyframeSnapEnabled; }
+    
+    // Transitions into clips from the clip ending where they start, with
+    // the render cache key when key is given
+    void setClipTransition(int index, TransitionType type, Ticks duration);
+    bool transitionAt(int index, TransitionSpec &spec, QByteArray *key = nullptr) const;
+    void setTransitionCache(TransitionCache *cache);
+    
+    // Runs source duration probes; without one they report 0
+    void setJobScheduler(JobScheduler *jobs) { m_jobScheduler = jobs; }
+    
+    // Multicam clips. Cutting to an angle splits the clip under time there
+    // and shows the angle from then on.
+    void addMulticamClip(const QVector<CameraAngle> &angles, Ticks startTime, Ticks duration);
+    void cutToAngle(Ticks time, int angle);
+    int multicamClipAt(Ticks time) const;
+    
+    // Audio-only tracks, mixed by AudioMixer. Ripple edits on the video
+    // track leave them where they are.
+    void addAudioClip(const QString &filePath, int track, Ticks startTime, Ticks duration);
+    void removeAudioClip(int index);
+    void moveAudioClip(int index, int track, Ticks startTime);
+    void setAudioClipGain(int index, double gainDb);
+    void setAudioClipPan(int index, double pan);
+    void setAudioClipFades(int index, Ticks fadeIn, Ticks fadeOut);
+    const QVector<AudioClip> &audioClips() const { return m_audioClips; }
+    int audioTrackCount() const;
+    
+    // Nested sequences. The timeline shows and edits one sequence at a
+    // time and keeps the others aside; a compound clip, with the path
+    // Nesting::compoundPath(name), plays another sequence as a source.
+    // Opening a name that doesn't exist starts an empty sequence.
+    QString currentSequence() const { return m_sequenceName; }
+    QStringList sequenceNames() const;
+    void openSequence(const QString &name);
+    void addCompoundClip(const QString &name, Ticks startTime);
+    // Clips of any sequence, and its version, which changes with every
+    // edit made to it; false for an unknown name
+    bool sequenceClips(const QString &name, QVector<Clip> &clips, quint64 &version) const;
+    quint64 sequenceVersion(const QString &name) const { return m_sequenceVersions.value(name); }
+    Ticks sequenceDuration(const QString &name) const;
+    // Whether outer plays inner at any depth, or is inner
+    bool sequenceNests(const QString &outer, const QString &inner) const;
+    
+    // Every mutation is appended to the journal once one is set
+    void setJournal(EditJournal *journal) { m_journal = journal; }
+    TimelineState state() const;
+    // Replaces the timeline with a snapshot plus the edits made after it,
+    // emitting timelineChanged once at the end
+    void restore(const TimelineState &state, const QVector<TimelineEdit> &edits);
+    // Replaces the timeline outright, as loading a project does, and has
+    // the journal snapshot the result
+    void replace(const TimelineState &state);
+    
+    // Edits between beginBatch and endBatch emit timelineChanged once, at
+    // the end, so the preview is rebuilt once however many there were.
+    // endBatch(false) rolls back to the state beginBatch saw and snapshots
+    // it, so recovery doesn't replay the edits that were undone.
+    void beginBatch();
+    void endBatch(bool commit);
+    bool inBatch() const { return m_inBatch; }
     
 signals:
     void clipAdded(int index);
     void clipRemoved(int index);
     void clipSelected(int index);
     void timelineChanged();
-    void playheadMoved(double time);
+    void playheadMoved(Ticks time);
+    // While an edge is dragged: the clip's new first and last frame times
+    // in its source. Committed with one timelineChanged on release.
+    void trimming(const QString &source, Ticks inPoint, Ticks outPoint, bool inEdge);
+    void trimFinished();
     
 protected:
     void paintEvent(QPaintEvent *event) override;
@@ -45,36 +212,141 @@ protected:
     void mouseMoveEvent(QMouseEvent *event) override;
     void mouseReleaseEvent(QMouseEvent *event) override;
     void wheelEvent(QWheelEvent *event) override;
+    void dragEnterEvent(QDragEnterEvent *event) override;
+    void dragMoveEvent(QDragMoveEvent *event) override;
+    void dropEvent(QDropEvent *event) override;
     
 private slots:
     void onAddClipClicked();
     void onRemoveClipClicked();
+    void onRippleDeleteClicked();
+    void onAddMarkerClicked();
+    void onTransitionClicked();
+    void onMulticamClicked();
+    void onAddAudioClicked();
+    void onAudioMixClicked();
+    void onSequenceClicked();
+    void onAddSequenceClicked();
     
 private:
-    QVector<Clip> m_clips;
+    // Clip start times are folded lazily from the ripple offsets, so
+    // const readers may still need to update them
+    mutable QVector<Clip> m_clips;
     int m_selectedClipIndex;
     double m_pixelsPerSecond;
     double m_scrollOffset;
-    double m_playheadPosition;
+    Ticks m_playheadPosition;
+    QVector<Ticks> m_markers;
+    ProjectSettings m_settings;
+    QVector<AudioClip> m_audioClips;
+    int m_selectedAudioClip;
+    QString m_sequenceName;
+    QVector<SequenceState> m_otherSequences;
+    QHash<QString, quint64> m_sequenceVersions;
+    quint64 m_lastVersion;              // Versions are never reused
+    
+    // Snap targets, kept sorted and updated incrementally as clips change
+    SnapIndex m_snapIndex;
+    bool m_snapEnabled;
+    Ticks m_snapIndicatorTime;  // Edge the dragged clip snapped to, or -1
+    mutable bool m_snapIndexValid;
+    
+    // Ripple index: clip start times in order, shifted in O(log n) by
+    // ripple edits and folded into the clips when they are read
+    QVector<int> m_rippleNodes;             // Clip index -> node in m_rippleOffsets
+    QVector<int> m_rippleClips;             // And back
+    Ticks m_rippleLongest;                  // No clip in the index is longer
+    mutable OffsetTree m_rippleOffsets;
+    bool m_rippleIndexValid;
+    mutable bool m_ripplePending;           // Offsets not yet folded into clips
+    
+    KeyframeIndexer *m_keyframeIndexer;
+    bool m_keyframeSnapEnabled;
+    TransitionCache *m_transitionCache;
+    
+    // Transitions by clip, worked out in one pass after each change and
+    // read by painting and preview rebuilds
+    struct ClipTransition
+    {
+        bool active;
+        TransitionSpec spec;
+        QByteArray key;
+        bool rendered;
+    };
+    mutable QVector<ClipTransition> m_transitions;
+    mutable bool m_transitionsValid;
+    QTimer *m_transitionTimer;          // Refreshes them outside painting
+    
+    EditJournal *m_journal;
+    bool m_replaying;
+    bool m_snapshotQueued;
+    bool m_inBatch;
+    bool m_batchWasBlocked;
+    TimelineState m_batchState;
+    JobScheduler *m_jobScheduler;
+    CancelToken m_jobToken;             // Cancelled with the timeline
     
     // UI elements
     QPushButton *m_addClipButton;
     QPushButton *m_removeClipButton;
+    QPushButton *m_addMarkerButton;
+    QPushButton *m_rippleDeleteButton;
+    QPushButton *m_transitionButton;
+    QPushButton *m_multicamButton;
+    QPushButton *m_addAudioButton;
+    QPushButton *m_audioMixButton;
+    QPushButton *m_sequenceButton;
+    QPushButton *m_addSequenceButton;
     
     // Mouse interaction
     bool m_isDragging;
     bool m_isResizing;
     bool m_isPanning;
+    bool m_isDraggingAudio;
     int m_dragClipIndex;
+    Ticks m_dragOriginStart;
+    int m_dragOriginX;
+    int m_dragOriginTrack;
+    bool m_resizeInEdge;
+    Ticks m_resizeOriginTrim;
+    Ticks m_resizeOriginDuration;
+    Ticks m_resizeSourceLength;         // 0 if unknown
+    QHash<QString, Ticks> m_sourceLengths;
+    QHash<QString, JobScheduler::JobId> m_probingLengths;   // 0 until submitted
     QPoint m_lastMousePos;
     
     // Helper methods
     void setupUI();
+    void resetContents();
+    void insertClip(const Clip &clip);
+    void ensureTransitions() const;
+    void applyEdit(const TimelineEdit &edit);
+    void recordEdit(TimelineEdit::Type type, int index, const QString &path,
+                    Ticks time, Ticks duration, int value = 0, Ticks trimStart = 0);
     int getClipAtPosition(const QPoint &pos);
+    int getAudioClipAtPosition(const QPoint &pos) const;
+    int audioTrackAtY(int y) const;
+    int clipEdgeAtPosition(const QPoint &pos, bool &inEdge);
+    void emitTrimming(const Clip &clip);
+    Ticks snapClipStart(Ticks start, Ticks duration);
+    void ensureSnapIndex();
+    void ensureRippleIndex();
+    void invalidateRippleIndex();
+    void foldRippleOffsets() const;
+    int rippleClipAt(int position) const;
+    QVector<int> clipsBetween(Ticks from, Ticks to);
+    void detachClip(int index);
     void drawClip(QPainter &painter, const Clip &clip, int index);
-    double pixelToTime(int pixel) const;
-    int timeToPixel(double time) const;
-    double getVideoDuration(const QString &filePath) const;
+    void drawAudioClip(QPainter &painter, const AudioClip &clip, int index);
+    void audioClipsChanged();
+    void selectAudioClip(int index);
+    Ticks videoEnd() const;
+    Ticks pixelToTime(int pixel) const;
+    int timeToPixel(Ticks time) const;
+    // The probe's job, or 0 if done was called already
+    JobScheduler::JobId probeDuration(const QString &filePath, JobScheduler::Priority priority,
+                                      const std::function<void(Ticks)> &done);
+    void prefetchSourceLength(const QString &filePath, JobScheduler::Priority priority);
 };
 
 #endif // TIMELINE_H
@@ -0,0 +1,48 @@
+#ifndef TRANSITION_H
+#define TRANSITION_H
+
+#include <QByteArray>
+#include <QString>
+#include "ProjectSettings.h"
+
+enum TransitionType
+{
+    NoTransition,
+    CrossFade,
+    Wipe
+};
+
+// A transition into a clip from the clip that ends where it starts. It
+// covers the first `duration` of the incoming clip, with the outgoing
+// source carrying on past its cut underneath (its last frame is held if
+// the source runs out).
+struct TransitionSpec
+{
+    QString fromSource;
+    Ticks fromOut;   // Source time the outgoing clip was cut at
+    QString toSource;
+    Ticks toIn;      // Source time the incoming clip starts at
+    TransitionType type;
+    Ticks duration;
+    ProjectSettings format;  // Rendered at the project's size and rates
+};
+
+namespace Transitions {
+
+QString name(TransitionType type);
+
+// What a graph puts out of [out1]: nothing, the two clips' sound
+// crossfaded, or silence for sources amovie can't read
+enum Sound { NoSound, SourceSound, Silence };
+
+// lavfi graph compositing the transition. Video comes out of [out0] and
+// any sound out of [out1].
+QString lavfiGraph(const TransitionSpec &spec, Sound sound);
+
+// Hash of the inputs (including each source's size and mtime) and the
+// parameters, naming the cached render
+QByteArray cacheKey(const TransitionSpec &spec);
+
+}
+
+#endif // TRANSITION_H
@@ -0,0 +1,43 @@
+#ifndef TRANSITIONCACHE_H
+#define TRANSITIONCACHE_H
+
+#include <QObject>
+#include <QSet>
+#include "JobScheduler.h"
+#include "Transition.h"
+
+// Renders transitions as background scheduler jobs into short
+// intermediate files named by Transitions::cacheKey(). Renders stay valid
+// until an input or parameter changes, which changes the key.
+class TransitionCache : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit TransitionCache(JobScheduler *jobs, QObject *parent = nullptr);
+    ~TransitionCache();
+
+    // Cached render for a transition, or empty if there is none yet
+    QString renderedFile(const TransitionSpec &spec) const;
+    // The same by Transitions::cacheKey(), for callers keeping the key
+    QString renderedFile(const QByteArray &key) const;
+
+    // Queues a render unless one is cached, queued or known to fail
+    void request(const TransitionSpec &spec);
+
+signals:
+    void rendered(const QString &file);
+
+private:
+    JobScheduler *m_jobs;
+    CancelToken m_token;    // Cancelled on destruction
+    QString m_cacheDir;
+    QSet<QByteArray> m_pending;         // Queued or rendering
+    QSet<QByteArray> m_failed;
+    mutable QSet<QByteArray> m_rendered;
+
+    QString fileFor(const QByteArray &key) const;
+    void onRendered(const QByteArray &key, bool ok);
+};
+
+#endif // TRANSITIONCACHE_H
@@ -0,0 +1,31 @@
+#ifndef TRIMPREVIEW_H
+#define TRIMPREVIEW_H
+
+#include <QImage>
+#include <QWidget>
+#include "Timebase.h"
+
+// Two-up view shown while a clip edge is dragged: the clip's first frame
+// on the left and its last on the right, each with its source time
+class TrimPreview : public QWidget
+{
+    Q_OBJECT
+
+public:
+    enum Side { InPoint, OutPoint };
+
+    explicit TrimPreview(QWidget *parent = nullptr);
+
+    void setFrame(int side, const QImage &frame);
+    void setTimes(Ticks inPoint, Ticks outPoint);
+    void clear();
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+
+private:
+    QImage m_frames[2];
+    Ticks m_times[2];
+};
+
+#endif // TRIMPREVIEW_H
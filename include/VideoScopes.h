@@ -0,0 +1,66 @@
+#ifndef VIDEOSCOPES_H
+#define VIDEOSCOPES_H
+
+#include <QElapsedTimer>
+#include <QImage>
+#include <QMutex>
+#include <QObject>
+#include <QWaitCondition>
+#include <atomic>
+
+class QThread;
+
+// Luma waveform, RGB parade, vectorscope and histogram of the preview.
+// The video surfaces hand in small frames read back after rendering; a
+// worker thread runs the ScopeKernels over them and draws each scope into
+// an image, which the GUI picks up when updated is emitted. Frames are
+// taken at most kMaxRate times a second, and are dropped while the worker
+// is still busy with the last one, so scopes never hold up playback.
+class VideoScopes : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Scope { Waveform, Parade, Vectorscope, Histogram, ScopeCount };
+    static const int kMaxRate = 30;
+
+    explicit VideoScopes(QObject *parent = nullptr);
+    ~VideoScopes();
+
+    // Off while nobody is looking at the scopes
+    void setEnabled(bool enabled);
+
+    // Safe from any thread. A surface checks wantsFrame before reading a
+    // frame back, then submits it as RGBA8888.
+    bool wantsFrame() const;
+    void submit(const QImage &frame);
+
+    QImage image(Scope scope) const;
+    // Accumulating and drawing one scope, averaged over recent frames
+    double computeMs(Scope scope) const;
+    double framesPerSecond() const;
+    // The frame waiting for the worker and the drawn scopes
+    qint64 memoryUsed() const;
+
+signals:
+    void updated();
+
+private:
+    QThread *m_thread;
+    mutable QMutex m_mutex;
+    QWaitCondition m_wake;
+    QImage m_pending;
+    bool m_stopping;
+    QImage m_images[ScopeCount];
+    double m_computeMs[ScopeCount];
+    double m_framesPerSecond;
+
+    std::atomic<bool> m_enabled;
+    std::atomic<bool> m_busy;
+    std::atomic<qint64> m_lastFrameMs;
+    QElapsedTimer m_clock;
+
+    void run();
+};
+
+#endif // VIDEOSCOPES_H
@@ -0,0 +1,198 @@
+#include "AngleViewer.h"
+#include "MpvVideoWidget.h"
+#include "MemoryBudget.h"
+#include <QDebug>
+#include <QLabel>
+#include <QMouseEvent>
+#include <QVBoxLayout>
+#include <cmath>
+
+namespace {
+// Drift from the main player that triggers a seek
+const double kMaxPlayingDrift = 0.25;
+const double kMaxPausedDrift = 0.02;
+}
+
+AngleViewer::AngleViewer(QWidget *parent)
+    : QWidget(parent)
+    , m_mpv(nullptr)
+    , m_activeAngle(0)
+    , m_cacheLimit(-1)
+{
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->setContentsMargins(0, 0, 0, 0);
+    m_video = new MpvVideoWidget(this);
+    m_video->setMinimumSize(320, 180);
+    layout->addWidget(m_video, 1);
+    m_status = new QLabel(this);
+    m_status->setContentsMargins(6, 2, 6, 2);
+    layout->addWidget(m_status);
+    updateStatus();
+}
+
+AngleViewer::~AngleViewer()
+{
+    m_video->shutdown();
+    if (m_mpv) {
+        mpv_terminate_destroy(m_mpv);
+    }
+}
+
+void AngleViewer::initializeMpv()
+{
+    m_mpv = mpv_create();
+    if (!m_mpv) {
+        qDebug() << "failed creating angle viewer context";
+        return;
+    }
+
+    mpv_set_option_string(m_mpv, "vo", "libmpv");
+    mpv_set_option_string(m_mpv, "aid", "no");
+    mpv_set_option_string(m_mpv, "keep-open", "yes");
+    // Only a preview: skip the deblocking filter and other exact-decode
+    // work, and drop frames rather than fall behind
+    mpv_set_option_string(m_mpv, "vd-lavc-skiploopfilter", "all");
+    mpv_set_option_string(m_mpv, "vd-lavc-fast", "yes");
+    mpv_set_option_string(m_mpv, "framedrop", "decoder+vo");
+
+    if (mpv_initialize(m_mpv) < 0) {
+        qDebug() << "angle viewer mpv init failed";
+        mpv_terminate_destroy(m_mpv);
+        m_mpv = nullptr;
+        return;
+    }
+    if (m_cacheLimit >= 0) {
+        MemoryBudget::setMpvCacheLimit(m_mpv, m_cacheLimit);
+    }
+    m_video->setMpv(m_mpv);
+}
+
+void AngleViewer::setCacheLimit(qint64 bytes)
+{
+    m_cacheLimit = bytes;
+    if (m_mpv) {
+        MemoryBudget::setMpvCacheLimit(m_mpv, bytes);
+    }
+}
+
+qint64 AngleViewer::cacheBytes() const
+{
+    return MemoryBudget::mpvCacheBytes(m_mpv);
+}
+
+void AngleViewer::setAngles(const QVector<CameraAngle> &angles, int activeAngle, Ticks groupTime)
+{
+    m_activeAngle = activeAngle;
+    if (angles == m_angles) {
+        updateStatus();
+        return;
+    }
+
+    if (!m_mpv) {
+        initializeMpv();
+        if (!m_mpv) {
+            return;
+        }
+    }
+    m_angles = angles;
+    updateStatus();
+
+    // The first angle is the main file; the rest come in as external
+    // tracks, which the grid graph picks up as vid2 onwards
+    QVector<QByteArray> sources;
+    for (int i = 1; i < angles.size(); ++i) {
+        sources.append(Multicam::angleSource(angles[i]).toUtf8());
+    }
+    QVector<mpv_node> items(sources.size());
+    for (int i = 0; i < sources.size(); ++i) {
+        items[i].format = MPV_FORMAT_STRING;
+        items[i].u.string = sources[i].data();
+    }
+    mpv_node_list list = {int(items.size()), items.data(), nullptr};
+    mpv_node node;
+    node.format = MPV_FORMAT_NODE_ARRAY;
+    node.u.list = &list;
+
+    const char *stop[] = {"stop", NULL};
+    mpv_command(m_mpv, stop);
+    mpv_set_property(m_mpv, "external-files", MPV_FORMAT_NODE, &node);
+    const QByteArray graph = Multicam::gridGraph(angles.size()).toUtf8();
+    mpv_set_property_string(m_mpv, "lavfi-complex", graph.constData());
+    const QByteArray start = Timebase::toEdlSeconds(groupTime).toUtf8();
+    mpv_set_property_string(m_mpv, "start", start.constData());
+
+    const QByteArray main = Multicam::angleSource(angles[0]).toUtf8();
+    const char *cmd[] = {"loadfile", main.constData(), NULL};
+    if (mpv_command(m_mpv, cmd) < 0) {
+        qDebug() << "Failed to load angles" << main;
+    }
+}
+
+void AngleViewer::clear()
+{
+    if (m_angles.isEmpty()) {
+        return;
+    }
+    m_angles.clear();
+    updateStatus();
+    if (m_mpv) {
+        const char *stop[] = {"stop", NULL};
+        mpv_command(m_mpv, stop);
+    }
+}
+
+void AngleViewer::syncTo(Ticks groupTime, bool playing)
+{
+    if (!m_mpv || m_angles.isEmpty()) {
+        return;
+    }
+
+    // Nothing here waits on events; drain them so the queue doesn't fill
+    while (mpv_wait_event(m_mpv, 0)->event_id != MPV_EVENT_NONE) {
+    }
+
+    int paused = playing ? 0 : 1;
+    mpv_set_property(m_mpv, "pause", MPV_FORMAT_FLAG, &paused);
+
+    double position = 0.0;
+    if (mpv_get_property(m_mpv, "time-pos", MPV_FORMAT_DOUBLE, &position) < 0) {
+        return;  // Still loading; it starts at the right time
+    }
+    const double target = Timebase::toSeconds(groupTime);
+    if (std::fabs(position - target) > (playing ? kMaxPlayingDrift : kMaxPausedDrift)) {
+        const QByteArray seekTarget = QByteArray::number(target, 'f', 6);
+        const char *cmd[] = {"seek", seekTarget.constData(), "absolute", NULL};
+        mpv_command(m_mpv, cmd);
+    }
+}
+
+void AngleViewer::mousePressEvent(QMouseEvent *event)
+{
+    if (event->button() != Qt::LeftButton || m_angles.isEmpty()) {
+        QWidget::mousePressEvent(event);
+        return;
+    }
+
+    // mpv letterboxes the grid inside the video widget
+    const int count = m_angles.size();
+    QSize grid(Multicam::columns(count) * Multicam::kAngleWidth, Multicam::rows(count) * Multicam::kAngleHeight);
+    grid.scale(m_video->size(), Qt::KeepAspectRatio);
+    const QPoint pos = m_video->mapFrom(this, event->pos());
+    const double x = double(pos.x() - (m_video->width() - grid.width()) / 2) / grid.width();
+    const double y = double(pos.y() - (m_video->height() - grid.height()) / 2) / grid.height();
+    const int angle = Multicam::angleAt(count, x, y);
+    if (angle >= 0) {
+        emit angleClicked(angle);
+    }
+}
+
+void AngleViewer::updateStatus()
+{
+    if (m_angles.isEmpty()) {
+        m_status->setText(tr("No multicam clip at the playhead"));
+        return;
+    }
+    m_status->setText(tr("Live: angle %1 of %2. Click an angle to cut to it.")
+                          .arg(m_activeAngle + 1)
+                          .arg(m_angles.size()));
+}
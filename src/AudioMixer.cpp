@@ -0,0 +1,511 @@
+#include "AudioMixer.h"
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QStandardPaths>
+#include <QThread>
+#include <QtEndian>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <vector>
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define MVIDEO_MIX_SSE
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define MVIDEO_MIX_NEON
+#endif
+
+namespace {
+const int kFrameBytes = AudioMixer::kChannels * sizeof(float);
+const qint64 kWavHeaderSize = 44;
+
+// Each stream mixes this far ahead of what mpv has read, in blocks
+const int kBlockFrames = 1024;
+const int kRingBlocks = 48;
+
+// How long the reader and the mixing thread sleep when they get ahead
+const unsigned long kStarvedWaitUs = 250;
+const unsigned long kFullWaitUs = 2000;
+
+// out += in * gain over interleaved stereo frames, the gains moving by
+// step per frame
+void mixStereo(float *out, const float *in, qint64 frames, float gainLeft, float gainRight,
+               float stepLeft, float stepRight)
+{
+    qint64 i = 0;
+#if defined(MVIDEO_MIX_SSE)
+    // Two frames per vector
+    __m128 gain = _mm_setr_ps(gainLeft, gainRight, gainLeft + stepLeft, gainRight + stepRight);
+    const __m128 step = _mm_setr_ps(2 * stepLeft, 2 * stepRight, 2 * stepLeft, 2 * stepRight);
+    for (; i + 2 <= frames; i += 2) {
+        const __m128 sum = _mm_add_ps(_mm_loadu_ps(out + 2 * i), _mm_mul_ps(_mm_loadu_ps(in + 2 * i), gain));
+        _mm_storeu_ps(out + 2 * i, sum);
+        gain = _mm_add_ps(gain, step);
+    }
+#elif defined(MVIDEO_MIX_NEON)
+    const float start[4] = {gainLeft, gainRight, gainLeft + stepLeft, gainRight + stepRight};
+    const float steps[4] = {2 * stepLeft, 2 * stepRight, 2 * stepLeft, 2 * stepRight};
+    float32x4_t gain = vld1q_f32(start);
+    const float32x4_t step = vld1q_f32(steps);
+    for (; i + 2 <= frames; i += 2) {
+        vst1q_f32(out + 2 * i, vmlaq_f32(vld1q_f32(out + 2 * i), vld1q_f32(in + 2 * i), gain));
+        gain = vaddq_f32(gain, step);
+    }
+#endif
+    gainLeft += stepLeft * i;
+    gainRight += stepRight * i;
+    for (; i < frames; ++i) {
+        out[2 * i] += in[2 * i] * gainLeft;
+        out[2 * i + 1] += in[2 * i + 1] * gainRight;
+        gainLeft += stepLeft;
+        gainRight += stepRight;
+    }
+}
+
+// IEEE float WAV, so mpv and ffmpeg take the mix like any other file
+QByteArray wavHeader(qint64 frames)
+{
+    const quint32 dataBytes = quint32(std::min<qint64>(frames * kFrameBytes, 0xffffffffLL - kWavHeaderSize));
+    QByteArray header(kWavHeaderSize, '\0');
+    char *data = header.data();
+    std::memcpy(data, "RIFF", 4);
+    qToLittleEndian<quint32>(dataBytes + kWavHeaderSize - 8, data + 4);
+    std::memcpy(data + 8, "WAVEfmt ", 8);
+    qToLittleEndian<quint32>(16, data + 16);
+    qToLittleEndian<quint16>(3, data + 20);  // WAVE_FORMAT_IEEE_FLOAT
+    qToLittleEndian<quint16>(AudioMixer::kChannels, data + 22);
+    qToLittleEndian<quint32>(AudioMixer::kSampleRate, data + 24);
+    qToLittleEndian<quint32>(AudioMixer::kSampleRate * kFrameBytes, data + 28);
+    qToLittleEndian<quint16>(kFrameBytes, data + 32);
+    qToLittleEndian<quint16>(32, data + 34);
+    std::memcpy(data + 36, "data", 4);
+    qToLittleEndian<quint32>(dataBytes, data + 40);
+    return header;
+}
+
+// One mvmix:// stream opened by mpv. A thread mixes blocks into a ring
+// buffer ahead of the reader; the two only share the ring's byte counts,
+// each written by one side. A seek asks the mixing thread to restart and
+// waits for it to acknowledge, which is the only time the reader waits
+// on it other than when the ring runs dry.
+class MixStream
+{
+public:
+    MixStream(const AudioMixer *mixer, qint64 frames)
+        : m_mixer(mixer)
+        , m_frames(frames)
+        , m_header(wavHeader(frames))
+        , m_ring(kBlockFrames * kRingBlocks * AudioMixer::kChannels)
+        , m_written(0)
+        , m_read(0)
+        , m_seekFrame(0)
+        , m_seekGeneration(0)
+        , m_ackGeneration(0)
+        , m_stopping(false)
+        , m_baseFrame(0)
+        , m_position(0)
+    {
+        m_thread = QThread::create([this]() { produce(); });
+        m_thread->setObjectName("audio-mix");
+        m_thread->start();
+    }
+
+    ~MixStream()
+    {
+        m_stopping.store(true);
+        m_thread->wait();
+        delete m_thread;
+    }
+
+    qint64 size() const { return kWavHeaderSize + m_frames * kFrameBytes; }
+
+    qint64 read(char *buffer, qint64 bytes)
+    {
+        qint64 done = 0;
+        if (m_position < kWavHeaderSize) {
+            done = std::min(bytes, kWavHeaderSize - m_position);
+            std::memcpy(buffer, m_header.constData() + m_position, done);
+            m_position += done;
+        }
+
+        const char *ring = reinterpret_cast<const char *>(m_ring.data());
+        const qint64 ringBytes = qint64(m_ring.size()) * sizeof(float);
+        while (done < bytes && m_position < size()) {
+            const qint64 read = m_read.load(std::memory_order_relaxed);
+            const qint64 available = m_written.load(std::memory_order_acquire) - read;
+            if (available <= 0) {
+                if (done > 0) {
+                    break;
+                }
+                QThread::usleep(kStarvedWaitUs);
+                continue;
+            }
+            const qint64 at = read % ringBytes;
+            const qint64 count = std::min({available, bytes - done, ringBytes - at, size() - m_position});
+            std::memcpy(buffer + done, ring + at, count);
+            m_read.store(read + count, std::memory_order_release);
+            done += count;
+            m_position += count;
+        }
+        return done;
+    }
+
+    qint64 seek(qint64 offset)
+    {
+        if (offset < 0 || offset > size()) {
+            return MPV_ERROR_GENERIC;
+        }
+
+        const qint64 data = std::max<qint64>(0, offset - kWavHeaderSize);
+        m_seekFrame.store(data / kFrameBytes, std::memory_order_relaxed);
+        const int generation = m_seekGeneration.fetch_add(1, std::memory_order_release) + 1;
+        while (m_ackGeneration.load(std::memory_order_acquire) != generation) {
+            QThread::usleep(kStarvedWaitUs);
+        }
+        // Into the middle of a frame: its leading bytes are skipped
+        m_read.store(data % kFrameBytes, std::memory_order_release);
+        m_position = offset;
+        return offset;
+    }
+
+private:
+    const AudioMixer *m_mixer;
+    const qint64 m_frames;
+    const QByteArray m_header;
+    std::vector<float> m_ring;
+    QThread *m_thread;
+
+    // Bytes since the last restart: written by the mixing thread, read by
+    // mpv's
+    std::atomic<qint64> m_written;
+    std::atomic<qint64> m_read;
+    std::atomic<qint64> m_seekFrame;
+    std::atomic<int> m_seekGeneration;
+    std::atomic<int> m_ackGeneration;
+    std::atomic<bool> m_stopping;
+
+    qint64 m_baseFrame;  // Mix frame at the ring's start, set before the ack
+    qint64 m_position;   // The reader's offset in the WAV file
+
+    void produce()
+    {
+        const qint64 ringBytes = qint64(m_ring.size()) * sizeof(float);
+        while (!m_stopping.load(std::memory_order_relaxed)) {
+            const int generation = m_seekGeneration.load(std::memory_order_acquire);
+            if (generation != m_ackGeneration.load(std::memory_order_relaxed)) {
+                m_baseFrame = m_seekFrame.load(std::memory_order_relaxed);
+                m_written.store(0, std::memory_order_relaxed);
+                m_read.store(0, std::memory_order_relaxed);
+                m_ackGeneration.store(generation, std::memory_order_release);
+            }
+
+            const qint64 written = m_written.load(std::memory_order_relaxed);
+            const qint64 frame = m_baseFrame + written / kFrameBytes;
+            const qint64 free = ringBytes - (written - m_read.load(std::memory_order_acquire));
+            if (frame >= m_frames || free < kBlockFrames * kFrameBytes) {
+                QThread::usleep(kFullWaitUs);
+                continue;
+            }
+
+            // Whole blocks, so none wraps around the end of the ring
+            const int frames = int(std::min<qint64>(kBlockFrames, m_frames - frame));
+            m_mixer->mix(frame, frames, m_ring.data() + (written % ringBytes) / sizeof(float));
+            m_written.store(written + frames * kFrameBytes, std::memory_order_release);
+        }
+    }
+};
+
+int64_t readStream(void *cookie, char *buffer, uint64_t bytes)
+{
+    return static_cast<MixStream *>(cookie)->read(buffer, qint64(bytes));
+}
+
+int64_t seekStream(void *cookie, int64_t offset)
+{
+    return static_cast<MixStream *>(cookie)->seek(offset);
+}
+
+int64_t streamSize(void *cookie)
+{
+    return static_cast<MixStream *>(cookie)->size();
+}
+
+void closeStream(void *cookie)
+{
+    delete static_cast<MixStream *>(cookie);
+}
+}
+
+AudioMixer::Source::~Source()
+{
+    delete file;  // Unmaps
+}
+
+AudioMixer::AudioMixer(JobScheduler *jobs, QObject *parent)
+    : QObject(parent)
+    , m_jobs(jobs)
+    , m_length(0)
+    , m_program(new Program{QVector<Entry>(), 0})
+{
+    m_cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/audio";
+    QDir().mkpath(m_cacheDir);
+}
+
+AudioMixer::~AudioMixer()
+{
+    // Running decodes are killed, and remove their partial files
+    m_token.cancel();
+}
+
+void AudioMixer::setClips(const QVector<AudioClip> &clips, Ticks length)
+{
+    m_clips = clips;
+    m_length = length;
+    for (const AudioClip &clip : m_clips) {
+        const QString &source = clip.path;
+        if (m_sources.contains(source) || m_failed.contains(source) || m_decodes.contains(source)) {
+            continue;
+        }
+        if (!openCached(source)) {
+            decode(source);
+        }
+    }
+    rebuildProgram();
+}
+
+Ticks AudioMixer::length() const
+{
+    return Timebase::fromSamples(program()->frames, kSampleRate);
+}
+
+void AudioMixer::mix(qint64 frame, int frames, float *out) const
+{
+    std::fill(out, out + qint64(frames) * kChannels, 0.0f);
+    const QSharedPointer<const Program> current = program();
+    const qint64 end = frame + frames;
+
+    for (const Entry &entry : current->entries) {
+        if (entry.start >= end) {
+            break;
+        }
+        const qint64 entryEnd = entry.start + entry.frames;
+        if (entryEnd <= frame) {
+            continue;
+        }
+
+        // The envelope is linear between the ends of the fades, so each
+        // piece between them is one ramp
+        const qint64 to = std::min(end, entryEnd);
+        qint64 points[] = {entry.start + entry.fadeIn, entryEnd - entry.fadeOut, to};
+        std::sort(points, points + 3);
+        qint64 from = std::max(frame, entry.start);
+        auto envelope = [&entry](qint64 position) {
+            float gain = entry.gain;
+            if (position < entry.fadeIn) {
+                gain *= float(position) / entry.fadeIn;
+            }
+            const qint64 remaining = entry.frames - position;
+            if (remaining < entry.fadeOut) {
+                gain *= float(remaining) / entry.fadeOut;
+            }
+            return gain;
+        };
+        for (qint64 point : points) {
+            const qint64 until = std::min(point, to);
+            if (until <= from) {
+                continue;
+            }
+            const float startGain = envelope(from - entry.start);
+            const float step = (envelope(until - entry.start) - startGain) / (until - from);
+            mixStereo(out + (from - frame) * kChannels,
+                      entry.source->samples + (entry.offset + from - entry.start) * kChannels,
+                      until - from, startGain * entry.left, startGain * entry.right,
+                      step * entry.left, step * entry.right);
+            from = until;
+        }
+    }
+}
+
+bool AudioMixer::registerProtocol(mpv_handle *mpv)
+{
+    if (mpv_stream_cb_add_ro(mpv, "mvmix", this, openStream) < 0) {
+        qDebug() << "Failed to register the audio mix protocol";
+        return false;
+    }
+    return true;
+}
+
+QString AudioMixer::edlPart(Ticks start, Ticks length) const
+{
+    return QString("mvmix://mix,%1,%2").arg(Timebase::toEdlSeconds(start)).arg(Timebase::toEdlSeconds(length));
+}
+
+bool AudioMixer::renderWav(const QString &path) const
+{
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qDebug() << "Failed to write audio mix" << path;
+        return false;
+    }
+
+    const qint64 frames = program()->frames;
+    bool ok = file.write(wavHeader(frames)) == kWavHeaderSize;
+    std::vector<float> block(kBlockFrames * kChannels);
+    for (qint64 frame = 0; ok && frame < frames; frame += kBlockFrames) {
+        const int count = int(std::min<qint64>(kBlockFrames, frames - frame));
+        mix(frame, count, block.data());
+        const qint64 bytes = qint64(count) * kFrameBytes;
+        ok = file.write(reinterpret_cast<const char *>(block.data()), bytes) == bytes;
+    }
+    if (!ok) {
+        qDebug() << "Failed to write audio mix" << path << file.errorString();
+    }
+    return ok;
+}
+
+QSharedPointer<const AudioMixer::Program> AudioMixer::program() const
+{
+    QMutexLocker locker(&m_programMutex);
+    return m_program;
+}
+
+void AudioMixer::rebuildProgram()
+{
+    QSharedPointer<Program> next(new Program{QVector<Entry>(), Timebase::toSamples(m_length, kSampleRate)});
+    for (const AudioClip &clip : m_clips) {
+        const QSharedPointer<Source> source = m_sources.value(clip.path);
+        if (!source) {
+            continue;
+        }
+
+        Entry entry;
+        entry.source = source;
+        entry.start = Timebase::toSamples(clip.startTime, kSampleRate);
+        entry.offset = Timebase::toSamples(clip.trimStart, kSampleRate);
+        entry.frames = std::min(Timebase::toSamples(clip.duration, kSampleRate), source->frames - entry.offset);
+        if (entry.start < 0) {
+            entry.offset -= entry.start;
+            entry.frames += entry.start;
+            entry.start = 0;
+        }
+        if (entry.frames <= 0 || entry.offset < 0) {
+            continue;
+        }
+        entry.gain = float(std::pow(10.0, clip.gainDb / 20.0));
+        entry.fadeIn = std::min(Timebase::toSamples(clip.fadeIn, kSampleRate), entry.frames);
+        entry.fadeOut = std::min(Timebase::toSamples(clip.fadeOut, kSampleRate), entry.frames);
+
+        // Equal power, scaled so the centre leaves both channels as they are
+        const double angle = (std::max(-1.0, std::min(1.0, clip.pan)) + 1.0) * std::atan(1.0);
+        entry.left = float(std::sqrt(2.0) * std::cos(angle));
+        entry.right = float(std::sqrt(2.0) * std::sin(angle));
+        next->entries.append(entry);
+        next->frames = std::max(next->frames, entry.start + entry.frames);
+    }
+    std::sort(next->entries.begin(), next->entries.end(), [](const Entry &a, const Entry &b) {
+        return a.start < b.start;
+    });
+
+    QMutexLocker locker(&m_programMutex);
+    m_program = next;
+}
+
+QString AudioMixer::pcmPathFor(const QString &source) const
+{
+    // A changed source gets a new cache file
+    const QFileInfo info(source);
+    const QByteArray key = info.absoluteFilePath().toUtf8() + '\0' + QByteArray::number(info.size())
+                           + '\0' + QByteArray::number(info.lastModified().toMSecsSinceEpoch());
+    return m_cacheDir + "/" + QString::fromLatin1(QCryptographicHash::hash(key, QCryptographicHash::Sha1).toHex()) + ".f32";
+}
+
+bool AudioMixer::openCached(const QString &source)
+{
+    if (!QFileInfo::exists(source)) {
+        return false;
+    }
+
+    // Native float order; the cache is written as little-endian
+    QFile *file = new QFile(pcmPathFor(source));
+    const qint64 size = file->size();
+    uchar *data = nullptr;
+    if (size < kFrameBytes || !file->open(QIODevice::ReadOnly) || !(data = file->map(0, size))) {
+        delete file;
+        return false;
+    }
+
+    QSharedPointer<Source> mapped(new Source);
+    mapped->file = file;
+    mapped->samples = reinterpret_cast<const float *>(data);
+    mapped->frames = size / kFrameBytes;
+    m_sources.insert(source, mapped);
+    return true;
+}
+
+void AudioMixer::decode(const QString &source)
+{
+    // ffmpeg's resampler brings every source to the mix rate here, so
+    // mixing never has to
+    const QString path = pcmPathFor(source);
+    QStringList arguments;
+    arguments << "-v" << "error" << "-nostdin" << "-y"
+              << "-i" << source
+              << "-vn" << "-ac" << QString::number(kChannels) << "-ar" << QString::number(kSampleRate)
+              << "-c:a" << "pcm_f32le" << "-f" << "f32le"
+              << path + ".part";
+
+    // The scheduler caps the decodes along with every other ffmpeg
+    m_decodes.insert(source);
+    JobScheduler *jobs = m_jobs;
+    const CancelToken token = m_token;
+    m_jobs->submitProcess(JobScheduler::Visible,
+                          [jobs, source, path, arguments, token](const JobScheduler::Context &) {
+                              QByteArray errors;
+                              bool ok = jobs->streamProcess("ffmpeg", arguments, token, JobScheduler::Output(),
+                                                            &errors);
+                              if (ok) {
+                                  QFile::remove(path);
+                                  ok = QFile::rename(path + ".part", path);
+                              }
+                              if (!ok) {
+                                  if (!token.isCancelled()) {
+                                      qDebug() << "Failed to decode audio from" << source
+                                               << QString::fromUtf8(errors).trimmed();
+                                  }
+                                  QFile::remove(path + ".part");
+                              }
+                              return ok;
+                          },
+                          [this, source](const QVariant &result) { onDecodeFinished(source, result.toBool()); },
+                          QVector<JobScheduler::JobId>(), token);
+}
+
+void AudioMixer::onDecodeFinished(const QString &source, bool ok)
+{
+    m_decodes.remove(source);
+    if (!ok || !openCached(source)) {
+        m_failed.insert(source);
+        return;
+    }
+    rebuildProgram();
+    emit sourcesChanged();
+}
+
+int AudioMixer::openStream(void *userData, char *uri, mpv_stream_cb_info *info)
+{
+    Q_UNUSED(uri);
+    // Called on one of mpv's threads
+    const AudioMixer *mixer = static_cast<AudioMixer *>(userData);
+    info->cookie = new MixStream(mixer, mixer->program()->frames);
+    info->read_fn = readStream;
+    info->seek_fn = seekStream;
+    info->size_fn = streamSize;
+    info->close_fn = closeStream;
+    return 0;
+}
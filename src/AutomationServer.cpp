@@ -0,0 +1,344 @@
+#include "AutomationServer.h"
+#include "EditJournal.h"
+#include "Timeline.h"
+#include <QDebug>
+#include <QJsonDocument>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QPointer>
+#include <QThread>
+#include <cstdio>
+#include <iostream>
+#include <string>
+
+namespace {
+// JSON-RPC's own error codes, then ours from -32000 down
+const int kParseError = -32700;
+const int kInvalidRequest = -32600;
+const int kMethodNotFound = -32601;
+const int kInvalidParams = -32602;
+const int kFailed = -32000;
+const int kRolledBack = -32001;
+
+QJsonObject response(const QJsonValue &id, int code, const QString &message, const QJsonValue &result)
+{
+    QJsonObject object;
+    object["jsonrpc"] = "2.0";
+    object["id"] = id.isUndefined() ? QJsonValue() : id;
+    if (code == 0) {
+        object["result"] = result;
+    } else {
+        QJsonObject error;
+        error["code"] = code;
+        error["message"] = message;
+        object["error"] = error;
+    }
+    return object;
+}
+
+QByteArray compact(const QJsonObject &object)
+{
+    return QJsonDocument(object).toJson(QJsonDocument::Compact);
+}
+
+bool isEdit(const QString &method)
+{
+    return method == "timeline.add" || method == "timeline.remove" || method == "timeline.move"
+        || method == "timeline.trim";
+}
+
+// Seconds, on the project's frame grid like edits made by hand
+bool readTime(const QJsonObject &params, const QString &key, FrameRate rate, Ticks &ticks)
+{
+    const QJsonValue value = params.value(key);
+    if (!value.isDouble()) {
+        return false;
+    }
+    ticks = Timebase::snapToFrame(Timebase::fromSeconds(value.toDouble()), rate);
+    return true;
+}
+
+bool readIndex(const QJsonObject &params, int count, int &index)
+{
+    const QJsonValue value = params.value("index");
+    index = value.toInt(-1);
+    return value.isDouble() && value.toDouble() == index && index >= 0 && index < count;
+}
+}
+
+AutomationServer::AutomationServer(Timeline *timeline, QObject *parent)
+    : QObject(parent)
+    , m_timeline(timeline)
+    , m_server(new QLocalServer(this))
+    , m_stdinThread(nullptr)
+    , m_rendering(false)
+{
+    m_server->setSocketOptions(QLocalServer::UserAccessOption);
+    connect(m_server, &QLocalServer::newConnection, this, [this]() {
+        while (QLocalSocket *socket = m_server->nextPendingConnection()) {
+            connect(socket, &QLocalSocket::disconnected, socket, &QObject::deleteLater);
+            connect(socket, &QLocalSocket::readyRead, this, [this, socket]() {
+                // A render is answered after the client may have gone
+                const QPointer<QLocalSocket> client(socket);
+                const Reply reply = [client](const QByteArray &bytes) {
+                    if (client) {
+                        client->write(bytes + '\n');
+                        client->flush();
+                    }
+                };
+                while (socket->canReadLine()) {
+                    handleLine(socket->readLine(), reply);
+                }
+            });
+        }
+    });
+}
+
+AutomationServer::~AutomationServer()
+{
+    // A thread still blocked reading stdin can't be stopped, and is left
+    // to end with the process
+    if (m_stdinThread && m_stdinThread->isFinished()) {
+        delete m_stdinThread;
+    }
+}
+
+bool AutomationServer::listen(const QString &name)
+{
+    QLocalServer::removeServer(name);
+    if (!m_server->listen(name)) {
+        qDebug() << "Automation server can't listen on" << name << m_server->errorString();
+        return false;
+    }
+    return true;
+}
+
+QString AutomationServer::serverName() const
+{
+    return m_server->fullServerName();
+}
+
+void AutomationServer::attachStdio()
+{
+    if (m_stdinThread) {
+        return;
+    }
+    m_stdout.open(stdout, QIODevice::WriteOnly);
+    m_stdinThread = QThread::create([this]() {
+        std::string line;
+        while (std::getline(std::cin, line)) {
+            const QByteArray bytes(line.data(), int(line.size()));
+            QMetaObject::invokeMethod(this, [this, bytes]() {
+                handleLine(bytes, [this](const QByteArray &response) {
+                    m_stdout.write(response + '\n');
+                    m_stdout.flush();
+                });
+            }, Qt::QueuedConnection);
+        }
+        QMetaObject::invokeMethod(this, [this]() { emit inputClosed(); }, Qt::QueuedConnection);
+    });
+    m_stdinThread->setObjectName("automation-stdin");
+    m_stdinThread->start();
+}
+
+void AutomationServer::renderFinished(bool ok, const QString &report)
+{
+    if (!m_rendering) {
+        return;
+    }
+    m_rendering = false;
+    const Reply reply = m_renderReply;
+    m_renderReply = Reply();
+    if (!m_renderId.isUndefined()) {
+        reply(compact(response(m_renderId, ok ? 0 : kFailed, report, report)));
+    }
+}
+
+void AutomationServer::handleLine(const QByteArray &line, const Reply &reply)
+{
+    if (line.trimmed().isEmpty()) {
+        return;
+    }
+
+    QJsonParseError error;
+    const QJsonDocument document = QJsonDocument::fromJson(line, &error);
+    if (error.error != QJsonParseError::NoError) {
+        reply(compact(response(QJsonValue(), kParseError, error.errorString(), QJsonValue())));
+        return;
+    }
+    if (document.isArray()) {
+        const QJsonArray requests = document.array();
+        if (requests.isEmpty()) {
+            reply(compact(response(QJsonValue(), kInvalidRequest, "Empty batch", QJsonValue())));
+            return;
+        }
+        // A batch of notifications gets no answer at all
+        const QJsonArray responses = handleBatch(requests);
+        if (!responses.isEmpty()) {
+            reply(QJsonDocument(responses).toJson(QJsonDocument::Compact));
+        }
+        return;
+    }
+
+    const QJsonObject request = document.object();
+    const QString method = request.value("method").toString();
+    const QJsonValue id = request.value("id");
+    if (!document.isObject() || method.isEmpty()) {
+        reply(compact(response(id, kInvalidRequest, "Expected a method", QJsonValue())));
+        return;
+    }
+
+    // Answered by renderFinished
+    if (method == "render") {
+        const QString path = request.value("params").toObject().value("path").toString();
+        if (path.isEmpty()) {
+            reply(compact(response(id, kInvalidParams, "Expected a path", QJsonValue())));
+        } else if (m_rendering || !m_render || !m_render(path)) {
+            reply(compact(response(id, kFailed, "Can't start a render now", QJsonValue())));
+        } else {
+            m_rendering = true;
+            m_renderId = id;
+            m_renderReply = reply;
+        }
+        return;
+    }
+
+    const Outcome outcome = invoke(method, request.value("params").toObject());
+    if (!id.isUndefined()) {
+        reply(compact(response(id, outcome.code, outcome.message, outcome.result)));
+    }
+}
+
+QJsonArray AutomationServer::handleBatch(const QJsonArray &requests)
+{
+    // One transaction: every edit or none, and one rebuild either way
+    QVector<Outcome> outcomes;
+    int failed = -1;
+    m_timeline->beginBatch();
+    for (int i = 0; i < requests.size() && failed < 0; ++i) {
+        const QJsonObject request = requests[i].toObject();
+        const QString method = request.value("method").toString();
+        Outcome outcome;
+        if (!requests[i].isObject() || method.isEmpty()) {
+            outcome = {QJsonValue(), kInvalidRequest, "Expected a method"};
+        } else if (!isEdit(method)) {
+            outcome = {QJsonValue(), kInvalidRequest, "Only timeline edits can be batched, not " + method};
+        } else {
+            outcome = edit(method, request.value("params").toObject());
+        }
+        if (outcome.code != 0) {
+            failed = i;
+        }
+        outcomes.append(outcome);
+    }
+    m_timeline->endBatch(failed < 0);
+
+    QJsonArray responses;
+    for (int i = 0; i < requests.size(); ++i) {
+        const QJsonObject request = requests[i].toObject();
+        if (!request.contains("id")) {
+            continue;
+        }
+        const QJsonValue id = request.value("id");
+        if (failed < 0 || i == failed) {
+            responses.append(response(id, outcomes[i].code, outcomes[i].message, outcomes[i].result));
+        } else {
+            responses.append(response(id, kRolledBack,
+                                      QString("Batch rolled back at request %1").arg(failed), QJsonValue()));
+        }
+    }
+    return responses;
+}
+
+AutomationServer::Outcome AutomationServer::invoke(const QString &method, const QJsonObject &params)
+{
+    if (isEdit(method)) {
+        return edit(method, params);
+    }
+
+    if (method == "timeline.clips") {
+        QJsonArray clips;
+        for (const Clip &clip : m_timeline->clips()) {
+            QJsonObject entry;
+            entry["path"] = clip.filePath();
+            entry["start"] = Timebase::toSeconds(clip.startTime());
+            entry["duration"] = Timebase::toSeconds(clip.duration());
+            entry["trimStart"] = Timebase::toSeconds(clip.trimStart());
+            clips.append(entry);
+        }
+        return {clips, 0, QString()};
+    }
+
+    if (method == "project.load" || method == "project.save") {
+        const QString path = params.value("path").toString();
+        if (path.isEmpty()) {
+            return {QJsonValue(), kInvalidParams, "Expected a path"};
+        }
+        if (method == "project.save") {
+            if (!EditJournal::saveProject(path, m_timeline->state())) {
+                return {QJsonValue(), kFailed, "Can't write " + path};
+            }
+            return {QJsonValue(), 0, QString()};
+        }
+        TimelineState state = m_timeline->state();
+        if (!EditJournal::loadProject(path, state)) {
+            return {QJsonValue(), kFailed, "Can't read " + path};
+        }
+        m_timeline->replace(state);
+        return {QJsonValue(), 0, QString()};
+    }
+
+    if (method == "seek") {
+        Ticks time = 0;
+        if (!readTime(params, "time", m_timeline->frameRate(), time) || time < 0) {
+            return {QJsonValue(), kInvalidParams, "Expected a time"};
+        }
+        if (m_seek) {
+            m_seek(time);
+        }
+        return {QJsonValue(), 0, QString()};
+    }
+
+    return {QJsonValue(), kMethodNotFound, "No method " + method};
+}
+
+AutomationServer::Outcome AutomationServer::edit(const QString &method, const QJsonObject &params)
+{
+    const int count = m_timeline->clips().size();
+    const FrameRate rate = m_timeline->frameRate();
+    Ticks start = 0;
+    Ticks duration = 0;
+    Ticks trimStart = 0;
+
+    if (method == "timeline.add") {
+        const QString path = params.value("path").toString();
+        const bool trimmed = params.contains("trimStart");
+        if (path.isEmpty() || !readTime(params, "start", rate, start) || !readTime(params, "duration", rate, duration)
+            || (trimmed && !readTime(params, "trimStart", rate, trimStart))
+            || start < 0 || duration <= 0 || trimStart < 0) {
+            return {QJsonValue(), kInvalidParams, "Expected a path, start and duration, and optionally trimStart"};
+        }
+        m_timeline->addClip(path, start, duration, trimStart);
+        return {count, 0, QString()};
+    }
+
+    int index = -1;
+    if (!readIndex(params, count, index)) {
+        return {QJsonValue(), kInvalidParams, QString("Expected an index below %1").arg(count)};
+    }
+    if (method == "timeline.remove") {
+        m_timeline->removeClip(index);
+    } else if (method == "timeline.move") {
+        if (!readTime(params, "start", rate, start) || start < 0) {
+            return {QJsonValue(), kInvalidParams, "Expected a start"};
+        }
+        m_timeline->moveClip(index, start);
+    } else {
+        if (!readTime(params, "trimStart", rate, trimStart) || !readTime(params, "duration", rate, duration)
+            || trimStart < 0 || duration <= 0) {
+            return {QJsonValue(), kInvalidParams, "Expected a trimStart and duration"};
+        }
+        m_timeline->trimClip(index, trimStart, duration);
+    }
+    return {QJsonValue(), 0, QString()};
+}
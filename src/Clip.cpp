@@ -1,18 +1,51 @@
 #include "Clip.h"
 
 Clip::Clip()
-    : m_startTime(0.0)
-    , m_duration(0.0)
-    , m_trimStart(0.0)
-    , m_trimEnd(0.0)
+    : m_startTime(0)
+    , m_duration(0)
+    , m_trimStart(0)
+    , m_trimEnd(0)
+    , m_transitionType(NoTransition)
+    , m_transitionDuration(0)
+    , m_activeAngle(0)
 {
 }
 
-Clip::Clip(const QString &filePath, double startTime, double duration)
+Clip::Clip(const QString &filePath, Ticks startTime, Ticks duration)
     : m_filePath(filePath)
     , m_startTime(startTime)
     , m_duration(duration)
-    , m_trimStart(0.0)
-    , m_trimEnd(0.0)
+    , m_trimStart(0)
+    , m_trimEnd(0)
+    , m_transitionType(NoTransition)
+    , m_transitionDuration(0)
+    , m_activeAngle(0)
 {
 }
+
+void Clip::setAngles(const QVector<CameraAngle> &angles, int active)
+{
+    m_angles = angles;
+    m_activeAngle = 0;
+    if (active >= 0 && active < m_angles.size()) {
+        m_activeAngle = active;
+        m_filePath = m_angles[active].path;
+    }
+}
+
+void Clip::switchAngle(int angle)
+{
+    if (angle < 0 || angle >= m_angles.size() || angle == m_activeAngle) {
+        return;
+    }
+
+    // Same group time, measured in the new angle's source
+    m_trimStart += m_angles[angle].syncOffset - m_angles[m_activeAngle].syncOffset;
+    m_activeAngle = angle;
+    m_filePath = m_angles[angle].path;
+}
+
+Ticks Clip::groupTime() const
+{
+    return isMulticam() ? m_trimStart - m_angles[m_activeAngle].syncOffset : m_trimStart;
+}
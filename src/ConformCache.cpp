@@ -0,0 +1,296 @@
+#include "ConformCache.h"
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QStandardPaths>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+const char kConformVersion[] = "1";
+
+QString formatName(const ProjectSettings &settings)
+{
+    return QString("%1x%2-%3_%4-%5")
+        .arg(settings.width)
+        .arg(settings.height)
+        .arg(settings.frameRate.numerator)
+        .arg(settings.frameRate.denominator)
+        .arg(settings.sampleRate);
+}
+
+// A keyframe a second, so seeks into a render decode little
+QString keyframeInterval(const ProjectSettings &settings)
+{
+    return QString::number(std::max(1.0, std::round(double(settings.frameRate.numerator)
+                                                    / settings.frameRate.denominator)));
+}
+
+enum Outcome
+{
+    Matching,   // Already in the project format
+    Rendered,
+    Failed
+};
+
+bool matchesSettings(const ProjectSettings &settings, const QByteArray &probeOutput, bool &videoMatches)
+{
+    bool hasVideo = false;
+    bool audioMatches = true;
+    videoMatches = false;
+    const QJsonArray streams = QJsonDocument::fromJson(probeOutput).object().value("streams").toArray();
+    for (const QJsonValue &value : streams) {
+        const QJsonObject stream = value.toObject();
+        const QString type = stream.value("codec_type").toString();
+        if (type == "video" && !hasVideo) {
+            hasVideo = true;
+            videoMatches = stream.value("width").toInt() == settings.width
+                        && stream.value("height").toInt() == settings.height
+                        && stream.value("r_frame_rate").toString() == Project::rateString(settings.frameRate);
+        } else if (type == "audio" && stream.value("sample_rate").toString().toInt() != settings.sampleRate) {
+            audioMatches = false;
+        }
+    }
+    return videoMatches && audioMatches;
+}
+
+// A source's render, or the filler's for an empty source
+QStringList renderArguments(const ProjectSettings &settings, const QString &source, bool copyVideo,
+                            const QString &partFile)
+{
+    QStringList arguments;
+    arguments << "-v" << "error" << "-y";
+    if (source.isEmpty()) {
+        arguments << "-f" << "lavfi"
+                  << "-i" << QString("color=c=black:s=%1x%2:r=%3")
+                                 .arg(settings.width).arg(settings.height)
+                                 .arg(Project::rateString(settings.frameRate))
+                  << "-f" << "lavfi" << "-i" << QString("anullsrc=r=%1:cl=stereo").arg(settings.sampleRate)
+                  << "-t" << QString::number(ConformCache::kFillerSeconds)
+                  << "-map" << "0:v" << "-map" << "1:a" << "-tune" << "stillimage";
+    } else {
+        arguments << "-i" << source
+                  << "-map" << "0:v:0" << "-map" << "0:a:0?";
+    }
+    if (copyVideo) {
+        // The picture already matches; only the sound is resampled
+        arguments << "-c:v" << "copy";
+    } else {
+        // Same scaling as export, so the preview frames what gets written
+        if (!source.isEmpty()) {
+            arguments << "-vf" << QString("scale=%1:%2:force_original_aspect_ratio=decrease,"
+                                          "pad=%1:%2:(ow-iw)/2:(oh-ih)/2,setsar=1,fps=%3")
+                                      .arg(settings.width).arg(settings.height)
+                                      .arg(Project::rateString(settings.frameRate));
+        }
+        arguments << "-c:v" << "libx264" << "-preset" << "veryfast" << "-crf" << "18"
+                  << "-pix_fmt" << "yuv420p" << "-g" << keyframeInterval(settings);
+    }
+    arguments << "-c:a" << "aac" << "-b:a" << "192k"
+              << "-ar" << QString::number(settings.sampleRate) << "-ac" << "2"
+              << partFile;
+    return arguments;
+}
+
+// Runs on a worker, as do the two below: renders beside file and moves
+// the render into place once it is whole
+bool render(JobScheduler *jobs, const QStringList &arguments, const QString &file, const CancelToken &token)
+{
+    const QString partFile = file + ".part.mkv";
+    QByteArray errors;
+    if (!jobs->streamProcess("ffmpeg", arguments, token, JobScheduler::Output(), &errors)) {
+        if (!token.isCancelled()) {
+            qDebug() << "Conform render failed:" << QString::fromUtf8(errors).trimmed();
+        }
+        QFile::remove(partFile);
+        return false;
+    }
+    QFile::remove(file);
+    return QFile::rename(partFile, file);
+}
+
+bool renderFillerFile(JobScheduler *jobs, const ProjectSettings &settings, const QString &file,
+                      const CancelToken &token)
+{
+    return render(jobs, renderArguments(settings, QString(), false, file + ".part.mkv"), file, token);
+}
+
+// Probes the source and renders it if it differs from the format; both
+// run on the job's one process slot
+int conformSource(JobScheduler *jobs, const ProjectSettings &settings, const QString &source, const QString &file,
+                  const CancelToken &token)
+{
+    QStringList arguments;
+    arguments << "-v" << "error"
+              << "-show_entries" << "stream=codec_type,width,height,r_frame_rate,sample_rate"
+              << "-of" << "json"
+              << source;
+    QByteArray output;
+    QByteArray errors;
+    if (!jobs->streamProcess("ffprobe", arguments, token,
+                             [&output](const QByteArray &chunk) { output += chunk; }, &errors)) {
+        if (!token.isCancelled()) {
+            qDebug() << "Could not probe" << source << "to conform it:" << QString::fromUtf8(errors).trimmed();
+        }
+        return Failed;
+    }
+
+    bool copyVideo = false;
+    if (matchesSettings(settings, output, copyVideo)) {
+        return Matching;
+    }
+    return render(jobs, renderArguments(settings, source, copyVideo, file + ".part.mkv"), file, token) ? Rendered
+                                                                                                      : Failed;
+}
+}
+
+ConformCache::ConformCache(JobScheduler *jobs, QObject *parent)
+    : QObject(parent)
+    , m_jobs(jobs)
+    , m_settings(Project::defaults())
+    , m_configured(false)
+    , m_fillerRendered(false)
+{
+    m_cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/conform";
+    QDir().mkpath(m_cacheDir);
+}
+
+ConformCache::~ConformCache()
+{
+    // Running renders are killed, and remove their partial files
+    m_token.cancel();
+}
+
+void ConformCache::setSettings(const ProjectSettings &settings)
+{
+    if (m_configured && settings == m_settings) {
+        return;
+    }
+
+    m_token.cancel();
+    m_token = CancelToken();
+    m_configured = true;
+    m_settings = settings;
+    m_pending.clear();
+    m_matching.clear();
+    m_failed.clear();
+    m_rendered.clear();
+    m_fillerRendered = QFile::exists(fillerPath());
+    if (!m_fillerRendered) {
+        renderFiller();
+    }
+}
+
+
+QString ConformCache::fillerPath() const
+{
+    return m_cacheDir + "/filler-" + formatName(m_settings) + ".mkv";
+}
+
+QString ConformCache::fillerFile() const
+{
+    return m_fillerRendered ? fillerPath() : QString();
+}
+
+QString ConformCache::fileFor(const QString &source) const
+{
+    const QFileInfo info(source);
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(QByteArray(kConformVersion));
+    hash.addData(info.absoluteFilePath().toUtf8());
+    hash.addData(QByteArray::number(info.size()));
+    hash.addData(QByteArray::number(info.lastModified().toMSecsSinceEpoch()));
+    hash.addData(formatName(m_settings).toUtf8());
+    return m_cacheDir + "/" + QString::fromLatin1(hash.result().toHex()) + ".mkv";
+}
+
+QString ConformCache::playableFile(const QString &source) const
+{
+    if (m_matching.contains(source) || m_pending.contains(source) || m_failed.contains(source)) {
+        return source;
+    }
+    auto it = m_rendered.constFind(source);
+    if (it != m_rendered.constEnd()) {
+        return it.value();
+    }
+    // Renders left by earlier sessions
+    const QString file = fileFor(source);
+    if (QFile::exists(file)) {
+        m_rendered.insert(source, file);
+        return file;
+    }
+    return source;
+}
+
+void ConformCache::request(const QString &source)
+{
+    // Sequences and generated sources are left as they are
+    if (!m_configured || m_matching.contains(source) || m_pending.contains(source)
+        || m_failed.contains(source) || !QFileInfo(source).isFile()
+        || playableFile(source) != source) {
+        return;
+    }
+
+    m_pending.insert(source);
+    conform(source);
+}
+
+void ConformCache::renderFiller()
+{
+    // Gaps play as lavfi graphs until it is in, so it comes before the
+    // conforms
+    JobScheduler *jobs = m_jobs;
+    const ProjectSettings settings = m_settings;
+    const QString file = fillerPath();
+    const CancelToken token = m_token;
+    m_jobs->submitProcess(JobScheduler::Visible,
+                          [jobs, settings, file, token](const JobScheduler::Context &) {
+                              return renderFillerFile(jobs, settings, file, token);
+                          },
+                          [this, file](const QVariant &result) {
+                              m_fillerRendered = result.toBool();
+                              if (m_fillerRendered) {
+                                  emit rendered(file);
+                              }
+                          },
+                          QVector<JobScheduler::JobId>(), token);
+}
+
+void ConformCache::conform(const QString &source)
+{
+    JobScheduler *jobs = m_jobs;
+    const ProjectSettings settings = m_settings;
+    const QString file = fileFor(source);
+    const CancelToken token = m_token;
+    m_jobs->submitProcess(JobScheduler::Background,
+                          [jobs, settings, source, file, token](const JobScheduler::Context &) {
+                              return conformSource(jobs, settings, source, file, token);
+                          },
+                          [this, source, file](const QVariant &result) {
+                              onConformed(source, file, result.toInt());
+                          },
+                          QVector<JobScheduler::JobId>(), token);
+}
+
+void ConformCache::onConformed(const QString &source, const QString &file, int outcome)
+{
+    m_pending.remove(source);
+    switch (outcome) {
+    case Matching:
+        m_matching.insert(source);
+        break;
+    case Rendered:
+        m_rendered.insert(source, file);
+        emit rendered(file);
+        break;
+    default:
+        m_failed.insert(source);
+        break;
+    }
+}
@@ -0,0 +1,527 @@
+#include "EditJournal.h"
+#include <QDataStream>
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QSaveFile>
+#include <QThread>
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+const char kJournalMagic[] = "MVEJ";
+const quint32 kSnapshotMagic = 0x4d565353; // "MVSS"
+const quint32 kJournalVersion = 1;
+// Version 2 added multicam angles to each clip, 3 the audio tracks, 4 the
+// project settings and 5 the sequences besides the open one
+const quint32 kSnapshotVersion = 5;
+const qint64 kHeaderSize = 8;
+
+// Record framing: payload length and checksum, then the payload
+const qint64 kFrameSize = 6;
+
+// Journal size that triggers a snapshot; also bounds what recovery replays
+const qint64 kSnapshotThreshold = 256 * 1024;
+
+bool syncFile(QFile &file)
+{
+    if (!file.flush()) {
+        return false;
+    }
+#ifdef Q_OS_WIN
+    return _commit(file.handle()) == 0;
+#else
+    return ::fsync(file.handle()) == 0;
+#endif
+}
+
+QByteArray journalHeader()
+{
+    QByteArray header;
+    QDataStream out(&header, QIODevice::WriteOnly);
+    out.writeRawData(kJournalMagic, 4);
+    out << kJournalVersion;
+    return header;
+}
+
+// A sequence's clips, markers and audio clips, as the snapshot of the given
+// version holds them
+void writeContents(QDataStream &out, const QVector<Clip> &clips, const QVector<Ticks> &markers,
+                   const QVector<AudioClip> &audioClips)
+{
+    out << quint32(clips.size());
+    for (const Clip &clip : clips) {
+        out << clip.filePath().toUtf8() << qint64(clip.startTime()) << qint64(clip.duration())
+            << qint64(clip.trimStart()) << qint64(clip.trimEnd())
+            << qint32(clip.transitionType()) << qint64(clip.transitionDuration())
+            << quint32(clip.angles().size()) << qint32(clip.activeAngle());
+        for (const CameraAngle &angle : clip.angles()) {
+            out << angle.path.toUtf8() << qint64(angle.syncOffset);
+        }
+    }
+    out << quint32(markers.size());
+    for (Ticks marker : markers) {
+        out << qint64(marker);
+    }
+    out << quint32(audioClips.size());
+    for (const AudioClip &clip : audioClips) {
+        out << clip.path.toUtf8() << qint32(clip.track) << qint64(clip.startTime) << qint64(clip.duration)
+            << qint64(clip.trimStart) << clip.gainDb << clip.pan << qint64(clip.fadeIn) << qint64(clip.fadeOut);
+    }
+}
+
+void readContents(QDataStream &in, quint32 version, QVector<Clip> &clips, QVector<Ticks> &markers,
+                  QVector<AudioClip> &audioClips)
+{
+    quint32 clipCount = 0;
+    in >> clipCount;
+    for (quint32 i = 0; i < clipCount && in.status() == QDataStream::Ok; ++i) {
+        QByteArray path;
+        qint64 start = 0;
+        qint64 duration = 0;
+        qint64 trimStart = 0;
+        qint64 trimEnd = 0;
+        qint32 transitionType = 0;
+        qint64 transitionDuration = 0;
+        in >> path >> start >> duration >> trimStart >> trimEnd >> transitionType >> transitionDuration;
+
+        Clip clip(QString::fromUtf8(path), start, duration);
+        if (version >= 2) {
+            quint32 angleCount = 0;
+            qint32 activeAngle = 0;
+            in >> angleCount >> activeAngle;
+            QVector<CameraAngle> angles;
+            for (quint32 a = 0; a < angleCount && in.status() == QDataStream::Ok; ++a) {
+                QByteArray anglePath;
+                qint64 syncOffset = 0;
+                in >> anglePath >> syncOffset;
+                angles.append({QString::fromUtf8(anglePath), syncOffset});
+            }
+            clip.setAngles(angles, activeAngle);
+        }
+        clip.setTrimStart(trimStart);
+        clip.setTrimEnd(trimEnd);
+        clip.setTransition(TransitionType(transitionType), transitionDuration);
+        clips.append(clip);
+    }
+    quint32 markerCount = 0;
+    in >> markerCount;
+    for (quint32 i = 0; i < markerCount && in.status() == QDataStream::Ok; ++i) {
+        qint64 marker = 0;
+        in >> marker;
+        markers.append(marker);
+    }
+    quint32 audioCount = 0;
+    if (version >= 3) {
+        in >> audioCount;
+    }
+    for (quint32 i = 0; i < audioCount && in.status() == QDataStream::Ok; ++i) {
+        QByteArray path;
+        qint32 track = 0;
+        qint64 start = 0;
+        qint64 duration = 0;
+        qint64 trimStart = 0;
+        double gainDb = 0.0;
+        double pan = 0.0;
+        qint64 fadeIn = 0;
+        qint64 fadeOut = 0;
+        in >> path >> track >> start >> duration >> trimStart >> gainDb >> pan >> fadeIn >> fadeOut;
+        audioClips.append({QString::fromUtf8(path), track, start, duration, trimStart, gainDb, pan, fadeIn, fadeOut});
+    }
+}
+
+// The whole state, as the session snapshot and project files hold it.
+// sequence is the last journal record the state includes.
+bool writeState(QIODevice *device, const TimelineState &state, quint64 sequence)
+{
+    QDataStream out(device);
+    out << kSnapshotMagic << kSnapshotVersion << sequence
+        << qint32(state.settings.frameRate.numerator) << qint32(state.settings.frameRate.denominator);
+    writeContents(out, state.clips, state.markers, state.audioClips);
+    out << qint32(state.settings.width) << qint32(state.settings.height) << qint32(state.settings.sampleRate);
+    out << state.sequence.toUtf8() << quint32(state.otherSequences.size());
+    for (const SequenceState &other : state.otherSequences) {
+        out << other.name.toUtf8();
+        writeContents(out, other.clips, other.markers, other.audioClips);
+    }
+    return out.status() == QDataStream::Ok;
+}
+
+// Settings older snapshots don't have are kept from state
+bool readState(QIODevice *device, TimelineState &state, quint64 &sequence)
+{
+    QDataStream in(device);
+    quint32 magic = 0;
+    quint32 version = 0;
+    qint32 numerator = 0;
+    qint32 denominator = 0;
+    in >> magic >> version >> sequence >> numerator >> denominator;
+    if (in.status() != QDataStream::Ok || magic != kSnapshotMagic || version < 1 || version > kSnapshotVersion
+        || numerator <= 0 || denominator <= 0) {
+        return false;
+    }
+
+    TimelineState loaded;
+    loaded.settings = state.settings;
+    loaded.settings.frameRate = {numerator, denominator};
+    readContents(in, version, loaded.clips, loaded.markers, loaded.audioClips);
+    if (version >= 4) {
+        qint32 width = 0;
+        qint32 height = 0;
+        qint32 sampleRate = 0;
+        in >> width >> height >> sampleRate;
+        loaded.settings.width = width;
+        loaded.settings.height = height;
+        loaded.settings.sampleRate = sampleRate;
+    }
+    if (version >= 5) {
+        QByteArray name;
+        quint32 sequenceCount = 0;
+        in >> name >> sequenceCount;
+        loaded.sequence = QString::fromUtf8(name);
+        for (quint32 i = 0; i < sequenceCount && in.status() == QDataStream::Ok; ++i) {
+            SequenceState other;
+            in >> name;
+            other.name = QString::fromUtf8(name);
+            readContents(in, version, other.clips, other.markers, other.audioClips);
+            loaded.otherSequences.append(other);
+        }
+    }
+    if (in.status() != QDataStream::Ok || !Project::isValid(loaded.settings)) {
+        return false;
+    }
+
+    state = loaded;
+    return true;
+}
+
+QByteArray encodeEdit(const TimelineEdit &edit, quint64 sequence)
+{
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out << sequence << quint8(edit.type) << edit.index << qint64(edit.time)
+        << qint64(edit.duration) << edit.value << edit.path.toUtf8();
+    // Fields only some types have follow, so older records read as before
+    if (edit.type == TimelineEdit::AddTrimmedClip) {
+        out << qint64(edit.trimStart);
+    }
+
+    QByteArray record;
+    QDataStream frame(&record, QIODevice::WriteOnly);
+    frame << quint32(payload.size()) << quint16(qChecksum(payload));
+    record.append(payload);
+    return record;
+}
+
+bool decodeEdit(const QByteArray &payload, TimelineEdit &edit, quint64 &sequence)
+{
+    QDataStream in(payload);
+    quint8 type = 0;
+    qint64 time = 0;
+    qint64 duration = 0;
+    QByteArray path;
+    qint64 trimStart = 0;
+    in >> sequence >> type >> edit.index >> time >> duration >> edit.value >> path;
+    if (type == TimelineEdit::AddTrimmedClip) {
+        in >> trimStart;
+    }
+    if (in.status() != QDataStream::Ok || type < TimelineEdit::AddClip || type > TimelineEdit::AddTrimmedClip) {
+        return false;
+    }
+    edit.type = TimelineEdit::Type(type);
+    edit.time = time;
+    edit.duration = duration;
+    edit.trimStart = trimStart;
+    edit.path = QString::fromUtf8(path);
+    return true;
+}
+}
+
+EditJournal::EditJournal(QObject *parent)
+    : QObject(parent)
+    , m_writer(nullptr)
+    , m_stopping(false)
+    , m_stats({0, 0, 0, 0, 0, 0, 0.0})
+    , m_sequence(0)
+    , m_bytesSinceSnapshot(0)
+{
+}
+
+EditJournal::~EditJournal()
+{
+    if (m_writer) {
+        // The writer drains the queue before it exits
+        {
+            QMutexLocker locker(&m_mutex);
+            m_stopping = true;
+            m_wake.wakeOne();
+        }
+        m_writer->wait();
+        delete m_writer;
+    }
+}
+
+bool EditJournal::open(const QString &dir, Timeline *timeline)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    m_dir = dir;
+    QDir().mkpath(m_dir);
+
+    TimelineState state;
+    state.settings = timeline->settings();
+    quint64 snapshotSequence = 0;
+    const bool hasSnapshot = readSnapshot(state, snapshotSequence);
+    QVector<TimelineEdit> edits;
+    quint64 last = snapshotSequence;
+    const qint64 validLength = readJournal(snapshotSequence, edits, last);
+    if (hasSnapshot || !edits.isEmpty()) {
+        timeline->restore(state, edits);
+    }
+    m_sequence = last;
+    m_stats.recoveredEdits = edits.size();
+    m_stats.recoveryMs = timer.nsecsElapsed() / 1e6;
+
+    m_journalFile.setFileName(journalPath());
+    if (!m_journalFile.open(QIODevice::ReadWrite)) {
+        qDebug() << "Failed to open edit journal" << journalPath();
+        return false;
+    }
+    // Anything after the last good record is a torn write
+    if (validLength < kHeaderSize) {
+        resetJournal();
+    } else {
+        m_journalFile.resize(validLength);
+        m_journalFile.seek(validLength);
+    }
+    m_bytesSinceSnapshot = validLength;
+
+    m_writer = QThread::create([this]() { writerLoop(); });
+    m_writer->setObjectName("edit-journal");
+    m_writer->start();
+    return true;
+}
+
+void EditJournal::append(const TimelineEdit &edit)
+{
+    if (!m_writer) {
+        return;
+    }
+
+    Item item;
+    item.record = encodeEdit(edit, ++m_sequence);
+    item.sequence = m_sequence;
+    m_bytesSinceSnapshot += item.record.size();
+
+    QMutexLocker locker(&m_mutex);
+    ++m_stats.records;
+    m_stats.recordBytes += item.record.size();
+    m_queue.append(item);
+    m_wake.wakeOne();
+}
+
+bool EditJournal::wantsSnapshot() const
+{
+    return m_writer && m_bytesSinceSnapshot >= kSnapshotThreshold;
+}
+
+void EditJournal::snapshot(const TimelineState &state)
+{
+    if (!m_writer) {
+        return;
+    }
+
+    // The clip vectors are shared, not copied, until the timeline changes
+    Item item;
+    item.state = state;
+    item.sequence = m_sequence;
+    m_bytesSinceSnapshot = 0;
+
+    QMutexLocker locker(&m_mutex);
+    m_queue.append(item);
+    m_wake.wakeOne();
+}
+
+EditJournal::Stats EditJournal::stats() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_stats;
+}
+
+double EditJournal::writeAmplification() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_stats.recordBytes > 0 ? double(m_stats.bytesWritten) / m_stats.recordBytes : 0.0;
+}
+
+QString EditJournal::journalPath() const
+{
+    return m_dir + "/journal.log";
+}
+
+QString EditJournal::snapshotPath() const
+{
+    return m_dir + "/snapshot.bin";
+}
+
+bool EditJournal::saveProject(const QString &path, const TimelineState &state)
+{
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qDebug() << "Failed to write project" << path << file.errorString();
+        return false;
+    }
+    if (!writeState(&file, state, 0) || !file.commit()) {
+        qDebug() << "Failed to write project" << path << file.errorString();
+        return false;
+    }
+    return true;
+}
+
+bool EditJournal::loadProject(const QString &path, TimelineState &state)
+{
+    QFile file(path);
+    quint64 sequence = 0;
+    if (!file.open(QIODevice::ReadOnly) || !readState(&file, state, sequence)) {
+        qDebug() << "Can't read project" << path;
+        return false;
+    }
+    return true;
+}
+
+bool EditJournal::readSnapshot(TimelineState &state, quint64 &sequence) const
+{
+    QFile file(snapshotPath());
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    if (!readState(&file, state, sequence)) {
+        qDebug() << "Ignoring unreadable snapshot" << snapshotPath();
+        return false;
+    }
+    return true;
+}
+
+qint64 EditJournal::readJournal(quint64 after, QVector<TimelineEdit> &edits, quint64 &last) const
+{
+    QFile file(journalPath());
+    if (!file.open(QIODevice::ReadOnly)) {
+        return 0;
+    }
+    const QByteArray data = file.readAll();
+    if (!data.startsWith(journalHeader())) {
+        return 0;
+    }
+
+    qint64 offset = kHeaderSize;
+    while (data.size() - offset >= kFrameSize) {
+        QDataStream frame(data.mid(offset, kFrameSize));
+        quint32 length = 0;
+        quint16 checksum = 0;
+        frame >> length >> checksum;
+        if (data.size() - offset - kFrameSize < qint64(length)) {
+            break;
+        }
+        const QByteArray payload = data.mid(offset + kFrameSize, length);
+        TimelineEdit edit;
+        quint64 sequence = 0;
+        if (quint16(qChecksum(payload)) != checksum || !decodeEdit(payload, edit, sequence)) {
+            break;
+        }
+        offset += kFrameSize + length;
+
+        // Records already folded into the snapshot are skipped
+        if (sequence > after) {
+            edits.append(edit);
+            last = sequence;
+        }
+    }
+    return offset;
+}
+
+void EditJournal::writerLoop()
+{
+    while (true) {
+        QVector<Item> batch;
+        {
+            QMutexLocker locker(&m_mutex);
+            while (m_queue.isEmpty() && !m_stopping) {
+                m_wake.wait(&m_mutex);
+            }
+            if (m_queue.isEmpty()) {
+                return;
+            }
+            batch.swap(m_queue);
+        }
+
+        // Records that queued up during the last sync share one write and
+        // one fsync; a snapshot goes in order between them
+        QByteArray records;
+        for (const Item &item : batch) {
+            if (!item.record.isEmpty()) {
+                records += item.record;
+                continue;
+            }
+            writeRecords(records);
+            records.clear();
+            writeSnapshot(item);
+        }
+        writeRecords(records);
+    }
+}
+
+void EditJournal::writeRecords(const QByteArray &records)
+{
+    if (records.isEmpty()) {
+        return;
+    }
+
+    const bool ok = m_journalFile.write(records) == records.size() && syncFile(m_journalFile);
+    if (!ok) {
+        qDebug() << "Failed to write edit journal" << m_journalFile.errorString();
+    }
+
+    QMutexLocker locker(&m_mutex);
+    m_stats.bytesWritten += records.size();
+    ++m_stats.syncs;
+}
+
+void EditJournal::writeSnapshot(const Item &item)
+{
+    // QSaveFile syncs and renames over the old snapshot, so there is always
+    // a complete one on disk
+    QSaveFile file(snapshotPath());
+    if (!file.open(QIODevice::WriteOnly)) {
+        qDebug() << "Failed to write snapshot" << snapshotPath();
+        return;
+    }
+
+    const bool written = writeState(&file, item.state, item.sequence);
+    const qint64 size = file.pos();
+    if (!written || !file.commit()) {
+        qDebug() << "Failed to write snapshot" << snapshotPath();
+        return;
+    }
+
+    // Everything in the journal is in the snapshot now. A crash before the
+    // reset only leaves records that recovery skips by sequence number.
+    resetJournal();
+
+    QMutexLocker locker(&m_mutex);
+    m_stats.bytesWritten += size + kHeaderSize;
+    ++m_stats.snapshots;
+    ++m_stats.syncs;
+}
+
+void EditJournal::resetJournal()
+{
+    m_journalFile.resize(0);
+    m_journalFile.seek(0);
+    if (m_journalFile.write(journalHeader()) != kHeaderSize || !syncFile(m_journalFile)) {
+        qDebug() << "Failed to reset edit journal" << m_journalFile.errorString();
+    }
+}
@@ -0,0 +1,412 @@
+#include "FrameCache.h"
+#include "KeyframeIndexer.h"
+#include "ImageSequence.h"
+#include <QDebug>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+const qint64 kDefaultBudget = 256 * 1024 * 1024;
+const int kDefaultWidth = 640;
+const int kDefaultHeight = 360;
+
+// Jobs span whole GOPs and at least this much, so all-intra sources
+// don't start a decoder per frame
+const Ticks kMinChunk = Timebase::kTicksPerSecond;
+
+// Timeline frames [first, end) the queued jobs produce
+struct FrameRange
+{
+    qint64 first;
+    qint64 end;
+};
+
+// Keeps ranges sorted and merged, so a lookup is a binary search
+void addRange(QVector<FrameRange> &ranges, qint64 first, qint64 end)
+{
+    if (first >= end) {
+        return;
+    }
+    int at = int(std::lower_bound(ranges.constBegin(), ranges.constEnd(), first,
+                                  [](const FrameRange &range, qint64 frame) {
+                                      return range.end < frame;
+                                  }) - ranges.constBegin());
+    int last = at;
+    for (; last < ranges.size() && ranges[last].first <= end; ++last) {
+        first = std::min(first, ranges[last].first);
+        end = std::max(end, ranges[last].end);
+    }
+    ranges.remove(at, last - at);
+    ranges.insert(at, {first, end});
+}
+
+bool isCovered(const QVector<FrameRange> &ranges, qint64 frameNumber)
+{
+    auto it = std::upper_bound(ranges.constBegin(), ranges.constEnd(), frameNumber,
+                               [](qint64 frame, const FrameRange &range) {
+                                   return frame < range.first;
+                               });
+    return it != ranges.constBegin() && frameNumber < (it - 1)->end;
+}
+}
+
+bool FrameCache::Segment::operator==(const Segment &other) const
+{
+    return source == other.source
+        && timelineStart == other.timelineStart
+        && duration == other.duration
+        && trimStart == other.trimStart
+        && isGap == other.isGap
+        && isLavfi == other.isLavfi;
+}
+
+FrameCache::FrameCache(KeyframeIndexer *indexer, JobScheduler *jobs, QObject *parent)
+    : QObject(parent)
+    , m_indexer(indexer)
+    , m_scheduler(jobs)
+    , m_lastSerial(0)
+    , m_rate({30, 1})
+    , m_budget(kDefaultBudget)
+    , m_playhead(0)
+    , m_direction(1)
+    , m_hits(0)
+    , m_misses(0)
+{
+    setFrameSize(QSize(kDefaultWidth, kDefaultHeight));
+}
+
+FrameCache::~FrameCache()
+{
+    clear();
+}
+
+void FrameCache::setSegments(const QVector<Segment> &segments, FrameRate rate)
+{
+    if (segments == m_segments && rate.numerator == m_rate.numerator
+        && rate.denominator == m_rate.denominator) {
+        return;
+    }
+
+    clear();
+    m_segments = segments;
+    m_rate = rate;
+    m_failed.clear();
+}
+
+void FrameCache::setMemoryBudget(qint64 bytes)
+{
+    m_budget = bytes;
+    evict();
+}
+
+void FrameCache::setFrameSize(const QSize &size)
+{
+    if (size == m_frameSize) {
+        return;
+    }
+
+    clear();
+    m_frameSize = size;
+    m_black = QImage(size, QImage::Format_RGB32);
+    m_black.fill(Qt::black);
+}
+
+QImage FrameCache::frame(qint64 frameNumber)
+{
+    const int segment = segmentAt(frameNumber);
+    if (segment < 0) {
+        return QImage();
+    }
+    if (m_segments[segment].isGap) {
+        ++m_hits;
+        return m_black;
+    }
+
+    auto it = m_frames.constFind(frameNumber);
+    if (it == m_frames.constEnd()) {
+        ++m_misses;
+        return QImage();
+    }
+    ++m_hits;
+    return it.value();
+}
+
+void FrameCache::prefetch(qint64 frameNumber, int direction)
+{
+    m_playhead = frameNumber;
+    m_direction = direction < 0 ? -1 : 1;
+
+    // Jobs the playhead has passed are no use any more; the one it is in
+    // is what the user is waiting for
+    for (int i = m_jobs.size() - 1; i >= 0; --i) {
+        const Job &job = m_jobs[i];
+        const bool passed = m_direction > 0 ? job.endFrame <= frameNumber : job.firstFrame > frameNumber;
+        if (passed) {
+            cancelJob(i);
+        } else if (job.firstFrame <= frameNumber && frameNumber < job.endFrame) {
+            m_scheduler->raise(job.id, JobScheduler::Interactive);
+        }
+    }
+
+    QVector<FrameRange> covered;
+    for (const Job &job : m_jobs) {
+        addRange(covered, job.firstFrame, job.endFrame);
+    }
+
+    // Half the budget is kept for frames ahead, so the ones just decoded
+    // are not evicted before they are shown
+    const int lookahead = frameBudget() / 2;
+    qint64 current = frameNumber;
+    for (int i = 0; i < lookahead; ++i, current += m_direction) {
+        const int segment = segmentAt(current);
+        if (segment < 0) {
+            break;
+        }
+        if (m_segments[segment].isGap || m_failed.contains(segment)
+            || m_frames.contains(current) || isCovered(covered, current)) {
+            continue;
+        }
+        Job job = jobFor(segment, current);
+        addRange(covered, job.firstFrame, job.endFrame);
+        start(job, current == frameNumber ? JobScheduler::Interactive : JobScheduler::Visible);
+        m_jobs.append(job);
+    }
+}
+
+qint64 FrameCache::memoryUsed() const
+{
+    return m_frames.size() * frameBytes();
+}
+
+double FrameCache::hitRate() const
+{
+    const qint64 total = lookups();
+    return total > 0 ? double(m_hits) / total : 0.0;
+}
+
+void FrameCache::resetStats()
+{
+    m_hits = 0;
+    m_misses = 0;
+}
+
+qint64 FrameCache::frameBytes() const
+{
+    return qint64(m_frameSize.width()) * m_frameSize.height() * 4;
+}
+
+qint64 FrameCache::frameAt(const Segment &segment, Ticks sourceTime, FrameRate rate)
+{
+    // Nearest timeline frame, as the source's frames rarely sit exactly
+    // on the timeline's frame grid
+    const Ticks timelineTime = segment.timelineStart + sourceTime - segment.trimStart;
+    return Timebase::toFrame(timelineTime + Timebase::frameTicks(rate) / 2, rate);
+}
+
+int FrameCache::segmentAt(qint64 frameNumber) const
+{
+    if (frameNumber < 0) {
+        return -1;
+    }
+
+    const Ticks time = Timebase::fromFrame(frameNumber, m_rate);
+    auto it = std::upper_bound(m_segments.constBegin(), m_segments.constEnd(), time,
+                               [](Ticks t, const Segment &segment) {
+                                   return t < segment.timelineStart;
+                               });
+    if (it == m_segments.constBegin()) {
+        return -1;
+    }
+    --it;
+    if (time >= it->timelineStart + it->duration) {
+        return -1;
+    }
+    return int(it - m_segments.constBegin());
+}
+
+FrameCache::Job FrameCache::jobFor(int segment, qint64 frameNumber) const
+{
+    const Segment &s = m_segments[segment];
+    const Ticks sourceTime = s.trimStart + Timebase::fromFrame(frameNumber, m_rate) - s.timelineStart;
+    const Ticks sourceEnd = s.trimStart + s.duration;
+
+    Job job;
+    job.segment = segment;
+    job.serial = 0;
+    job.id = 0;
+
+    const KeyframeIndex *keyframes = s.isLavfi ? nullptr : m_indexer->index(s.source, JobScheduler::Visible);
+    if (s.isLavfi) {
+        // Graphs are short and only decode from their start
+        job.start = s.trimStart;
+        job.end = sourceEnd;
+    } else if (keyframes) {
+        job.start = std::max<Ticks>(0, keyframes->keyframeAtOrBefore(sourceTime));
+        job.end = keyframes->keyframeAtOrAfter(std::max(job.start + kMinChunk, sourceTime + 1));
+        if (job.end < 0 || job.end > sourceEnd) {
+            job.end = sourceEnd;
+        }
+    } else {
+        // No index yet; ffmpeg finds the keyframe before each chunk itself
+        job.start = sourceTime - (sourceTime - s.trimStart) % kMinChunk;
+        job.end = std::min(job.start + kMinChunk, sourceEnd);
+    }
+
+    job.firstFrame = frameAt(s, std::max(job.start, s.trimStart), m_rate);
+    job.endFrame = frameAt(s, job.end, m_rate);
+    return job;
+}
+
+int FrameCache::frameBudget() const
+{
+    return int(std::max<qint64>(2, m_budget / frameBytes()));
+}
+
+void FrameCache::start(Job &job, JobScheduler::Priority priority)
+{
+    const Segment &segment = m_segments[job.segment];
+    QStringList arguments;
+    arguments << "-v" << "error" << "-nostdin";
+    if (segment.isLavfi) {
+        arguments << "-f" << "lavfi" << "-i" << segment.source;
+        if (job.start > 0) {
+            arguments << "-ss" << Timebase::toEdlSeconds(job.start);
+        }
+    } else {
+        arguments << "-ss" << Timebase::toEdlSeconds(job.start)
+                  << ImageSequence::inputArguments(segment.source, m_rate);
+    }
+    arguments << "-t" << Timebase::toEdlSeconds(job.end - job.start)
+              << "-an"
+              << "-vf" << QString("scale=%1:%2:force_original_aspect_ratio=decrease,"
+                                  "pad=%1:%2:(ow-iw)/2:(oh-ih)/2,setsar=1,fps=%3/%4")
+                              .arg(m_frameSize.width()).arg(m_frameSize.height())
+                              .arg(m_rate.numerator).arg(m_rate.denominator)
+              << "-f" << "rawvideo" << "-pix_fmt" << "bgra"
+              << "pipe:1";
+
+    // The scheduler caps the decodes along with every other ffmpeg
+    job.serial = ++m_lastSerial;
+    JobScheduler *jobs = m_scheduler;
+    const Job decoding = job;
+    const FrameRate rate = m_rate;
+    const QSize size = m_frameSize;
+    const quint64 serial = job.serial;
+    job.id = m_scheduler->submitProcess(priority,
+                                        [this, jobs, arguments, segment, decoding, rate, size](
+                                            const JobScheduler::Context &) {
+                                            return decode(jobs, arguments, segment, decoding, rate, size, this);
+                                        },
+                                        [this, serial](const QVariant &result) {
+                                            onFinished(serial, result.toBool());
+                                        },
+                                        QVector<JobScheduler::JobId>(), job.token);
+}
+
+// Runs on a worker. Frames reach the cache as they are decoded, through
+// calls the job's token drops once it is cancelled, so cache is only
+// touched on the GUI thread while it is alive.
+bool FrameCache::decode(JobScheduler *jobs, const QStringList &arguments, const Segment &segment, const Job &job,
+                        FrameRate rate, QSize size, FrameCache *cache)
+{
+    const qint64 bytes = qint64(size.width()) * size.height() * 4;
+    QByteArray pending;  // Partial frame
+    int decoded = 0;
+    qint64 keptFrame = -1;
+    QImage kept;
+    QByteArray errors;
+    auto readFrames = [&](const QByteArray &chunk) {
+        pending += chunk;
+        Frames frames;
+        qint64 offset = 0;
+        for (; pending.size() - offset >= bytes; offset += bytes) {
+            const Ticks sourceTime = job.start + Timebase::fromFrame(decoded, rate);
+            const qint64 frameNumber = frameAt(segment, sourceTime, rate);
+            ++decoded;
+            if (frameNumber < job.firstFrame || frameNumber >= job.endFrame) {
+                continue;
+            }
+
+            QImage image(size, QImage::Format_RGB32);
+            std::memcpy(image.bits(), pending.constData() + offset, bytes);
+            frames.append(qMakePair(frameNumber, image));
+            keptFrame = frameNumber;
+            kept = image;
+        }
+        pending = pending.mid(offset);
+        if (!frames.isEmpty()) {
+            jobs->post(job.token, [cache, frames]() { cache->addFrames(frames); });
+        }
+    };
+    const bool ok = jobs->streamProcess("ffmpeg", arguments, job.token, readFrames, &errors);
+
+    if (!ok || decoded == 0) {
+        if (!job.token.isCancelled()) {
+            qDebug() << "Shuttle decode failed:" << segment.source << QString::fromUtf8(errors).trimmed();
+        }
+        return false;
+    }
+
+    // Sources that end early hold their last frame, so the frames they
+    // don't have are not decoded again and again
+    const qint64 lastFrame = frameAt(segment, job.start + Timebase::fromFrame(decoded - 1, rate), rate);
+    if (lastFrame == keptFrame) {
+        Frames held;
+        for (qint64 f = lastFrame + 1; f < job.endFrame; ++f) {
+            held.append(qMakePair(f, kept));
+        }
+        if (!held.isEmpty()) {
+            jobs->post(job.token, [cache, held]() { cache->addFrames(held); });
+        }
+    }
+    return true;
+}
+
+void FrameCache::addFrames(const Frames &frames)
+{
+    for (const QPair<qint64, QImage> &frame : frames) {
+        m_frames.insert(frame.first, frame.second);
+    }
+    evict();
+}
+
+void FrameCache::onFinished(quint64 serial, bool ok)
+{
+    const int index = int(std::find_if(m_jobs.begin(), m_jobs.end(), [serial](const Job &j) {
+        return j.serial == serial;
+    }) - m_jobs.begin());
+    if (index >= m_jobs.size()) {
+        return;
+    }
+
+    const Job job = m_jobs.takeAt(index);
+    if (!ok) {
+        m_failed.insert(job.segment);
+    }
+}
+
+void FrameCache::cancelJob(int index)
+{
+    // A running decode is killed at its next cancellation check, on the
+    // worker rather than waited on here
+    m_jobs.takeAt(index).token.cancel();
+}
+
+void FrameCache::clear()
+{
+    while (!m_jobs.isEmpty()) {
+        cancelJob(m_jobs.size() - 1);
+    }
+    m_frames.clear();
+}
+
+void FrameCache::evict()
+{
+    const int budget = frameBudget();
+    while (m_frames.size() > budget) {
+        // Frames behind the playhead go first, then the furthest ahead
+        const qint64 behind = m_direction > 0 ? m_frames.firstKey() : m_frames.lastKey();
+        const bool isBehind = m_direction > 0 ? behind < m_playhead : behind > m_playhead;
+        m_frames.remove(isBehind ? behind : (m_direction > 0 ? m_frames.lastKey() : m_frames.firstKey()));
+    }
+}
@@ -0,0 +1,227 @@
+#include "FrameGrabber.h"
+#include "ImageSequence.h"
+#include "MemoryBudget.h"
+#include <QDebug>
+#include <QMetaObject>
+#include <algorithm>
+#include <clocale>
+
+FrameGrabber::FrameGrabber(int slotCount, QObject *parent)
+    : QObject(parent)
+    , m_mpv(nullptr)
+    , m_render(nullptr)
+    , m_frameSize(480, 270)
+    , m_frameRate{30, 1}
+    , m_requests(slotCount, Request{QString(), 0, false})
+    , m_busySlot(-1)
+    , m_nextSlot(0)
+    , m_restarted(false)
+    , m_frameQueued(false)
+    , m_cacheLimit(-1)
+{
+}
+
+FrameGrabber::~FrameGrabber()
+{
+    if (m_render) {
+        mpv_render_context_free(m_render);
+    }
+    if (m_mpv) {
+        mpv_set_wakeup_callback(m_mpv, nullptr, nullptr);
+        mpv_terminate_destroy(m_mpv);
+    }
+}
+
+void FrameGrabber::setFrameRate(FrameRate rate)
+{
+    m_frameRate = rate;
+    if (m_mpv) {
+        double fps = double(rate.numerator) / rate.denominator;
+        mpv_set_property(m_mpv, "mf-fps", MPV_FORMAT_DOUBLE, &fps);
+    }
+}
+
+bool FrameGrabber::initialize()
+{
+    // MPV uses C locale
+    std::setlocale(LC_NUMERIC, "C");
+
+    m_mpv = mpv_create();
+    if (!m_mpv) {
+        qDebug() << "failed creating frame grabber context";
+        return false;
+    }
+
+    mpv_set_option_string(m_mpv, "vo", "libmpv");
+    mpv_set_option_string(m_mpv, "aid", "no");
+    mpv_set_option_string(m_mpv, "pause", "yes");
+    mpv_set_option_string(m_mpv, "keep-open", "always");
+    mpv_set_option_string(m_mpv, "hr-seek", "yes");
+    double fps = double(m_frameRate.numerator) / m_frameRate.denominator;
+    mpv_set_option(m_mpv, "mf-fps", MPV_FORMAT_DOUBLE, &fps);
+    if (mpv_initialize(m_mpv) < 0) {
+        qDebug() << "frame grabber mpv init failed";
+        mpv_terminate_destroy(m_mpv);
+        m_mpv = nullptr;
+        return false;
+    }
+
+    mpv_render_param params[] = {
+        { MPV_RENDER_PARAM_API_TYPE, const_cast<char *>(MPV_RENDER_API_TYPE_SW) },
+        { MPV_RENDER_PARAM_INVALID, nullptr }
+    };
+    if (mpv_render_context_create(&m_render, m_mpv, params) < 0) {
+        qDebug() << "frame grabber render context init failed";
+        m_render = nullptr;
+        mpv_terminate_destroy(m_mpv);
+        m_mpv = nullptr;
+        return false;
+    }
+    mpv_render_context_set_update_callback(m_render, onUpdate, this);
+    mpv_set_wakeup_callback(m_mpv, onWakeup, this);
+    if (m_cacheLimit >= 0) {
+        MemoryBudget::setMpvCacheLimit(m_mpv, m_cacheLimit);
+    }
+    return true;
+}
+
+void FrameGrabber::setCacheLimit(qint64 bytes)
+{
+    m_cacheLimit = bytes;
+    if (m_mpv) {
+        MemoryBudget::setMpvCacheLimit(m_mpv, bytes);
+    }
+}
+
+qint64 FrameGrabber::cacheBytes() const
+{
+    return MemoryBudget::mpvCacheBytes(m_mpv);
+}
+
+void FrameGrabber::request(int slot, const QString &source, Ticks time)
+{
+    if (slot < 0 || slot >= m_requests.size()) {
+        return;
+    }
+
+    Request &request = m_requests[slot];
+    request.source = source;
+    request.time = std::max<Ticks>(0, time);
+    request.pending = true;
+    if (m_busySlot < 0) {
+        startNext();
+    }
+}
+
+void FrameGrabber::cancel()
+{
+    for (Request &request : m_requests) {
+        request.pending = false;
+    }
+}
+
+void FrameGrabber::startNext()
+{
+    // Round robin, so a slot being dragged can't starve the others
+    int slot = -1;
+    for (int i = 0; i < m_requests.size(); ++i) {
+        const int candidate = (m_nextSlot + i) % m_requests.size();
+        if (m_requests[candidate].pending) {
+            slot = candidate;
+            break;
+        }
+    }
+    if (slot < 0) {
+        return;
+    }
+    if (!m_mpv && !initialize()) {
+        cancel();
+        return;
+    }
+
+    Request &request = m_requests[slot];
+    request.pending = false;
+    m_busySlot = slot;
+    m_nextSlot = (slot + 1) % m_requests.size();
+    m_restarted = false;
+    m_frameQueued = false;
+
+    const QByteArray time = Timebase::toEdlSeconds(request.time).toUtf8();
+    if (request.source != m_loadedSource) {
+        m_loadedSource = request.source;
+        mpv_set_property_string(m_mpv, "start", time.constData());
+        const QByteArray source = ImageSequence::mpvSourceFor(request.source).toUtf8();
+        const char *cmd[] = {"loadfile", source.constData(), NULL};
+        mpv_command(m_mpv, cmd);
+    } else {
+        const char *cmd[] = {"seek", time.constData(), "absolute+exact", NULL};
+        mpv_command(m_mpv, cmd);
+    }
+}
+
+void FrameGrabber::onWakeup(void *ctx)
+{
+    FrameGrabber *self = static_cast<FrameGrabber *>(ctx);
+    QMetaObject::invokeMethod(self, "handleEvents", Qt::QueuedConnection);
+}
+
+void FrameGrabber::onUpdate(void *ctx)
+{
+    FrameGrabber *self = static_cast<FrameGrabber *>(ctx);
+    QMetaObject::invokeMethod(self, "handleUpdate", Qt::QueuedConnection);
+}
+
+void FrameGrabber::handleEvents()
+{
+    while (m_mpv) {
+        mpv_event *event = mpv_wait_event(m_mpv, 0);
+        if (event->event_id == MPV_EVENT_NONE) {
+            break;
+        }
+        if (event->event_id == MPV_EVENT_PLAYBACK_RESTART) {
+            m_restarted = true;
+            tryRender();
+        } else if (event->event_id == MPV_EVENT_END_FILE && m_busySlot >= 0) {
+            const mpv_event_end_file *end = static_cast<mpv_event_end_file *>(event->data);
+            if (end->reason == MPV_END_FILE_REASON_ERROR) {
+                qDebug() << "Frame grabber failed to open" << m_loadedSource;
+                m_loadedSource.clear();
+                m_busySlot = -1;
+                startNext();
+            }
+        }
+    }
+}
+
+void FrameGrabber::handleUpdate()
+{
+    if (m_render && (mpv_render_context_update(m_render) & MPV_RENDER_UPDATE_FRAME)) {
+        m_frameQueued = true;
+        tryRender();
+    }
+}
+
+void FrameGrabber::tryRender()
+{
+    // The seek has landed once mpv has restarted and has a frame to show
+    if (m_busySlot < 0 || !m_restarted || !m_frameQueued) {
+        return;
+    }
+
+    QImage frame(m_frameSize, QImage::Format_RGB32);
+    int size[] = {frame.width(), frame.height()};
+    size_t stride = frame.bytesPerLine();
+    mpv_render_param params[] = {
+        { MPV_RENDER_PARAM_SW_SIZE, size },
+        { MPV_RENDER_PARAM_SW_FORMAT, const_cast<char *>("bgr0") },
+        { MPV_RENDER_PARAM_SW_STRIDE, &stride },
+        { MPV_RENDER_PARAM_SW_POINTER, frame.bits() },
+        { MPV_RENDER_PARAM_INVALID, nullptr }
+    };
+    const int slot = m_busySlot;
+    m_busySlot = -1;
+    if (mpv_render_context_render(m_render, params) >= 0) {
+        emit frameReady(slot, frame);
+    }
+    startNext();
+}
@@ -0,0 +1,76 @@
+#include "FrameTap.h"
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+#include <QOpenGLFramebufferObject>
+#include <QRect>
+#include <algorithm>
+
+namespace {
+qint64 readInt(mpv_handle *mpv, const char *name)
+{
+    int64_t value = 0;
+    return mpv_get_property(mpv, name, MPV_FORMAT_INT64, &value) < 0 ? -1 : value;
+}
+
+// Where mpv put the video inside the framebuffer, in GL's bottom up
+// coordinates, from the margins it reports around it
+QRect videoRect(mpv_handle *mpv, const QSize &fboSize)
+{
+    const qint64 width = readInt(mpv, "osd-dimensions/w");
+    const qint64 height = readInt(mpv, "osd-dimensions/h");
+    if (width <= 0 || height <= 0) {
+        return QRect();
+    }
+    const double scaleX = double(fboSize.width()) / width;
+    const double scaleY = double(fboSize.height()) / height;
+    const int left = int(std::max<qint64>(0, readInt(mpv, "osd-dimensions/ml")) * scaleX);
+    const int right = int(std::max<qint64>(0, readInt(mpv, "osd-dimensions/mr")) * scaleX);
+    const int top = int(std::max<qint64>(0, readInt(mpv, "osd-dimensions/mt")) * scaleY);
+    const int bottom = int(std::max<qint64>(0, readInt(mpv, "osd-dimensions/mb")) * scaleY);
+    return QRect(left, bottom, fboSize.width() - left - right, fboSize.height() - top - bottom);
+}
+}
+
+FrameTap::FrameTap()
+    : m_target(nullptr)
+{
+}
+
+FrameTap::~FrameTap()
+{
+    // Leaked rather than deleted without a current context
+    Q_ASSERT(!m_target);
+}
+
+QImage FrameTap::capture(QOpenGLContext *context, unsigned int fbo, const QSize &fboSize, mpv_handle *mpv)
+{
+    const QRect source = videoRect(mpv, fboSize);
+    if (source.width() <= 0 || source.height() <= 0) {
+        return QImage();
+    }
+
+    const QSize size(kWidth, std::clamp(int(qint64(kWidth) * source.height() / source.width()), 1, 2 * kWidth));
+    if (!m_target || m_target->size() != size) {
+        delete m_target;
+        m_target = new QOpenGLFramebufferObject(size);
+    }
+
+    QOpenGLExtraFunctions *gl = context->extraFunctions();
+    gl->glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+    gl->glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_target->handle());
+    gl->glBlitFramebuffer(source.left(), source.top(), source.left() + source.width(), source.top() + source.height(),
+                          0, 0, size.width(), size.height(), GL_COLOR_BUFFER_BIT, GL_LINEAR);
+
+    QImage frame(size, QImage::Format_RGBA8888);
+    gl->glBindFramebuffer(GL_FRAMEBUFFER, m_target->handle());
+    gl->glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    gl->glReadPixels(0, 0, size.width(), size.height(), GL_RGBA, GL_UNSIGNED_BYTE, frame.bits());
+    gl->glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    return frame;
+}
+
+void FrameTap::release()
+{
+    delete m_target;
+    m_target = nullptr;
+}
@@ -0,0 +1,389 @@
+#include "ImageSequence.h"
+#include "ProjectSettings.h"
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QHash>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+const char kMagic[4] = {'M', 'V', 'I', 'S'};
+const quint32 kVersion = 1;
+
+// Frame numbers past this many digits are not frame numbers
+const int kMaxDigits = 9;
+
+// File layout: header, then the frame numbers present in ascending order
+struct IndexHeader
+{
+    char magic[4];
+    quint32 version;
+    qint64 directoryModified;
+    quint32 frameCount;
+    quint32 reserved;
+};
+
+QString escapePercent(QString text)
+{
+    return text.replace("%", "%%");
+}
+
+// Quotes a path for an ffconcat file directive
+QString concatQuoted(const QString &path)
+{
+    return "'" + QString(path).replace("'", "'\\''") + "'";
+}
+
+// Splits a pattern into its directory and the file name either side of
+// its one %d or %0Nd
+bool parsePattern(const QString &pattern, QString &directory, QString &prefix, int &width, QString &suffix)
+{
+    const int slash = pattern.lastIndexOf('/');
+    const QString name = pattern.mid(slash + 1);
+    QString literal;
+    width = -1;
+    for (int i = 0; i < name.size(); ++i) {
+        if (name[i] != '%') {
+            literal += name[i];
+            continue;
+        }
+        if (i + 1 < name.size() && name[i + 1] == '%') {
+            literal += '%';
+            ++i;
+            continue;
+        }
+        int end = i + 1;
+        while (end < name.size() && name[end].isDigit()) {
+            ++end;
+        }
+        if (width >= 0 || end >= name.size() || name[end] != 'd') {
+            return false;
+        }
+        width = std::max(1, name.mid(i + 1, end - i - 1).toInt());
+        prefix = literal;
+        literal.clear();
+        i = end;
+    }
+    if (width < 0) {
+        return false;
+    }
+    directory = slash >= 0 ? pattern.left(slash) : QString(".");
+    suffix = literal;
+    return true;
+}
+
+QHash<QString, ImageSequence *> &openSequences()
+{
+    static QHash<QString, ImageSequence *> sequences;
+    return sequences;
+}
+}
+
+ImageSequence::ImageSequence()
+    : m_width(0)
+    , m_data(nullptr)
+    , m_frames(nullptr)
+    , m_frameCount(0)
+{
+}
+
+ImageSequence::~ImageSequence()
+{
+    close();
+}
+
+bool ImageSequence::isSequence(const QString &path)
+{
+    // A file that happens to have %d in its name is still a file
+    QString directory;
+    QString prefix;
+    QString suffix;
+    int width = 0;
+    return parsePattern(path, directory, prefix, width, suffix) && !QFileInfo::exists(path);
+}
+
+QString ImageSequence::patternFor(const QString &framePath)
+{
+    // The number is the last run of digits before the extension
+    const QFileInfo info(framePath);
+    const QString name = info.fileName();
+    const int dot = name.lastIndexOf('.');
+    const QString stem = dot > 0 ? name.left(dot) : name;
+    int digits = stem.size();
+    while (digits > 0 && stem[digits - 1].isDigit()) {
+        --digits;
+    }
+    const int width = stem.size() - digits;
+    if (width == 0 || width > kMaxDigits) {
+        return QString();
+    }
+
+    const QString number = width > 1 ? "%0" + QString::number(width) + "d" : QString("%d");
+    return info.absolutePath() + "/" + escapePercent(stem.left(digits)) + number
+         + escapePercent(name.mid(stem.size()));
+}
+
+bool ImageSequence::open(const QString &pattern)
+{
+    close();
+    if (!parsePattern(pattern, m_directory, m_prefix, m_width, m_suffix)) {
+        return false;
+    }
+
+    // Adding or removing a frame touches the directory, so its timestamp
+    // is the one stat the index needs
+    const QFileInfo directoryInfo(m_directory);
+    if (!directoryInfo.isDir()) {
+        return false;
+    }
+    const qint64 modified = directoryInfo.lastModified().toMSecsSinceEpoch();
+
+    m_pattern = pattern;
+    const QString cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/sequences";
+    QDir().mkpath(cacheDir);
+    const QByteArray key = QFileInfo(pattern).absoluteFilePath().toUtf8();
+    m_indexPath = cacheDir + "/" + QString::fromLatin1(QCryptographicHash::hash(key, QCryptographicHash::Sha1).toHex()) + ".mvsq";
+
+    if (mapIndex(modified) || (build(modified) && mapIndex(modified))) {
+        return true;
+    }
+    close();
+    return false;
+}
+
+void ImageSequence::close()
+{
+    if (m_data) {
+        m_file.unmap(const_cast<uchar *>(m_data));
+    }
+    m_file.close();
+    m_data = nullptr;
+    m_frames = nullptr;
+    m_frameCount = 0;
+    m_concatLists.clear();
+    m_pattern.clear();
+}
+
+int ImageSequence::firstFrame() const
+{
+    return m_frameCount > 0 ? m_frames[0] : 0;
+}
+
+int ImageSequence::lastFrame() const
+{
+    return m_frameCount > 0 ? m_frames[m_frameCount - 1] : -1;
+}
+
+int ImageSequence::length() const
+{
+    return lastFrame() - firstFrame() + 1;
+}
+
+Ticks ImageSequence::duration(FrameRate rate) const
+{
+    return Timebase::fromFrame(length(), rate);
+}
+
+QString ImageSequence::framePath(int offset) const
+{
+    if (m_frameCount == 0) {
+        return QString();
+    }
+
+    // The last frame present at or before the number
+    const qint32 number = firstFrame() + std::clamp(offset, 0, length() - 1);
+    const qint32 *frame = std::upper_bound(m_frames, m_frames + m_frameCount, number) - 1;
+    return m_directory + "/" + fileName(*frame);
+}
+
+QString ImageSequence::mpvSource() const
+{
+    return "mf://@" + listPath();
+}
+
+QString ImageSequence::concatList(FrameRate rate) const
+{
+    const QString path = m_indexPath.left(m_indexPath.size() - 5)
+                       + QString(".%1_%2.ffconcat").arg(rate.numerator).arg(rate.denominator);
+    if (m_frameCount == 0 || m_concatLists.contains(path)) {
+        return m_frameCount > 0 ? path : QString();
+    }
+
+    // One entry per frame present, lasting over the hole after it. Each
+    // duration is the difference of the exact start times, so rounding
+    // doesn't add up over a long sequence.
+    QByteArray list = "ffconcat version 1.0\n";
+    for (int i = 0; i < m_frameCount; ++i) {
+        const qint32 next = i + 1 < m_frameCount ? m_frames[i + 1] : m_frames[i] + 1;
+        const Ticks start = Timebase::fromFrame(m_frames[i] - firstFrame(), rate);
+        const Ticks end = Timebase::fromFrame(next - firstFrame(), rate);
+        list += ("file " + concatQuoted(m_directory + "/" + fileName(m_frames[i])) + "\n").toUtf8();
+        list += ("duration " + Timebase::toEdlSeconds(end - start) + "\n").toUtf8();
+    }
+    // The concat demuxer drops the last entry's duration; listing the last
+    // frame again keeps it
+    list += ("file " + concatQuoted(m_directory + "/" + fileName(m_frames[m_frameCount - 1])) + "\n").toUtf8();
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly) || file.write(list) != list.size() || !file.commit()) {
+        qDebug() << "Failed to write sequence list" << path;
+        return QString();
+    }
+    m_concatLists.insert(path);
+    return path;
+}
+
+const ImageSequence *ImageSequence::find(const QString &pattern)
+{
+    QHash<QString, ImageSequence *> &sequences = openSequences();
+    auto it = sequences.constFind(pattern);
+    if (it != sequences.constEnd()) {
+        return it.value();
+    }
+
+    // A failed open is retried next time, in case the frames arrive
+    ImageSequence *sequence = new ImageSequence();
+    if (!sequence->open(pattern)) {
+        delete sequence;
+        return nullptr;
+    }
+    sequences.insert(pattern, sequence);
+    return sequence;
+}
+
+QString ImageSequence::mpvSourceFor(const QString &path)
+{
+    if (!isSequence(path)) {
+        return path;
+    }
+    const ImageSequence *sequence = find(path);
+    return sequence ? sequence->mpvSource() : path;
+}
+
+QStringList ImageSequence::inputArguments(const QString &path, FrameRate rate)
+{
+    QStringList arguments;
+    if (!isSequence(path)) {
+        arguments << "-i" << path;
+        return arguments;
+    }
+
+    // image2 would stop at the first missing frame; the list holds the one
+    // before it, as preview does
+    const ImageSequence *sequence = find(path);
+    const QString list = sequence ? sequence->concatList(rate) : QString();
+    if (list.isEmpty()) {
+        arguments << "-f" << "image2" << "-framerate" << Project::rateString(rate) << "-i" << path;
+        return arguments;
+    }
+    arguments << "-f" << "concat" << "-safe" << "0" << "-i" << list;
+    return arguments;
+}
+
+QString ImageSequence::fileName(qint32 number) const
+{
+    return m_prefix + QString("%1").arg(number, m_width, 10, QChar('0')) + m_suffix;
+}
+
+QString ImageSequence::listPath() const
+{
+    return m_indexPath.left(m_indexPath.size() - 5) + ".list";
+}
+
+bool ImageSequence::mapIndex(qint64 modified)
+{
+    m_file.setFileName(m_indexPath);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    const qint64 fileSize = m_file.size();
+    m_data = fileSize > static_cast<qint64>(sizeof(IndexHeader)) ? m_file.map(0, fileSize) : nullptr;
+    if (!m_data) {
+        m_file.close();
+        return false;
+    }
+
+    const IndexHeader *header = reinterpret_cast<const IndexHeader *>(m_data);
+    if (std::memcmp(header->magic, kMagic, sizeof(kMagic)) != 0
+        || header->version != kVersion
+        || header->directoryModified != modified
+        || header->frameCount == 0
+        || qint64(sizeof(IndexHeader) + header->frameCount * sizeof(qint32)) != fileSize
+        || !QFileInfo::exists(listPath())) {
+        m_file.unmap(const_cast<uchar *>(m_data));
+        m_file.close();
+        m_data = nullptr;
+        return false;
+    }
+
+    m_frameCount = header->frameCount;
+    m_frames = reinterpret_cast<const qint32 *>(m_data + sizeof(IndexHeader));
+    return true;
+}
+
+bool ImageSequence::build(qint64 modified) const
+{
+    // Names only; matching them needs no stat of each frame
+    const QStringList names = QDir(m_directory).entryList(QDir::Files | QDir::NoDotAndDotDot, QDir::Unsorted);
+    QVector<qint32> frames;
+    for (const QString &name : names) {
+        const int digits = name.size() - m_prefix.size() - m_suffix.size();
+        if (digits < m_width || digits > kMaxDigits
+            || !name.startsWith(m_prefix) || !name.endsWith(m_suffix)) {
+            continue;
+        }
+        // %0Nd pads to N digits and only longer numbers run past it
+        const QString number = name.mid(m_prefix.size(), digits);
+        if (digits > m_width && number[0] == '0') {
+            continue;
+        }
+        if (std::all_of(number.begin(), number.end(), [](QChar c) { return c.isDigit(); })) {
+            frames.append(number.toInt());
+        }
+    }
+    if (frames.isEmpty()) {
+        qDebug() << "No frames match" << m_pattern;
+        return false;
+    }
+    std::sort(frames.begin(), frames.end());
+    frames.erase(std::unique(frames.begin(), frames.end()), frames.end());
+
+    // mpv's mf demuxer reads this list, one file per frame with holes held
+    QByteArray list;
+    int present = 0;
+    for (qint32 number = frames.first(); number <= frames.last(); ++number) {
+        if (present + 1 < frames.size() && frames[present + 1] <= number) {
+            ++present;
+        }
+        list += (m_directory + "/" + fileName(frames[present])).toUtf8() + '\n';
+    }
+
+    IndexHeader header;
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.directoryModified = modified;
+    header.frameCount = frames.size();
+    header.reserved = 0;
+
+    // The index is written last, so a valid index always has its list
+    QSaveFile listFile(listPath());
+    QSaveFile indexFile(m_indexPath);
+    const qint64 frameBytes = qint64(frames.size()) * sizeof(qint32);
+    bool ok = listFile.open(QIODevice::WriteOnly)
+           && listFile.write(list) == list.size()
+           && listFile.commit();
+    ok = ok && indexFile.open(QIODevice::WriteOnly)
+         && indexFile.write(reinterpret_cast<const char *>(&header), sizeof(header)) == sizeof(header)
+         && indexFile.write(reinterpret_cast<const char *>(frames.constData()), frameBytes) == frameBytes
+         && indexFile.commit();
+    if (!ok) {
+        qDebug() << "Failed to write sequence index" << m_indexPath;
+    }
+    return ok;
+}
@@ -0,0 +1,571 @@
+#include "JobScheduler.h"
+#include <QMutexLocker>
+#include <QProcess>
+#include <QThread>
+#include <algorithm>
+
+namespace {
+// Latency percentiles are over the most recent jobs of each class
+const int kLatencyWindow = 200;
+
+// How often a running process checks for cancellation
+const int kPollMs = 50;
+
+// The worker the current thread is, if it is one
+thread_local const JobScheduler *tScheduler = nullptr;
+thread_local int tWorker = -1;
+thread_local const void *tJob = nullptr;     // Running on this thread
+thread_local bool tHoldsSlot = false;        // The job is a process job
+}
+
+JobScheduler::JobScheduler(int workers, QObject *parent)
+    : QObject(parent)
+    , m_stopping(false)
+    , m_ready(0)
+    , m_running(0)
+    , m_processes(0)
+    , m_steals(0)
+    , m_nextWorker(0)
+    , m_freeSlots(kMaxProcesses)
+    , m_lastId(0)
+    , m_waiting(0)
+{
+    m_clock.start();
+    for (int priority = 0; priority < PriorityCount; ++priority) {
+        m_queued[priority] = 0;
+        m_completed[priority] = 0;
+        m_cancelled[priority] = 0;
+        m_slotWaiters[priority] = 0;
+        m_processQueued[priority] = 0;
+    }
+
+    const int count = workers > 0 ? workers : std::max(2, QThread::idealThreadCount());
+    for (int i = 0; i < count; ++i) {
+        m_workers.append(new Worker());
+    }
+    for (int i = 0; i < count; ++i) {
+        m_workers[i]->thread = QThread::create([this, i]() { workerLoop(i); });
+        m_workers[i]->thread->setObjectName(QString("jobs-%1").arg(i));
+        m_workers[i]->thread->start();
+    }
+}
+
+JobScheduler::~JobScheduler()
+{
+    // Running jobs finish, or stop at their next cancellation check; the
+    // rest are dropped
+    {
+        QMutexLocker locker(&m_idleMutex);
+        m_stopping = true;
+        m_wake.wakeAll();
+    }
+    for (Worker *worker : m_workers) {
+        worker->thread->wait();
+        delete worker->thread;
+    }
+    for (Worker *worker : m_workers) {
+        for (int priority = 0; priority < PriorityCount; ++priority) {
+            for (const std::deque<Job *> *queue : {&worker->queues[priority], &worker->processQueues[priority]}) {
+                for (Job *job : *queue) {
+                    m_jobs.remove(job->id);
+                    delete job;
+                }
+            }
+        }
+        delete worker;
+    }
+    qDeleteAll(m_jobs);
+}
+
+QString JobScheduler::priorityName(Priority priority)
+{
+    switch (priority) {
+    case Interactive:
+        return "interactive";
+    case Visible:
+        return "visible";
+    case Background:
+    case PriorityCount:
+        break;
+    }
+    return "background";
+}
+
+JobScheduler::JobId JobScheduler::submit(Priority priority, Work work, Done done,
+                                         const QVector<JobId> &after, CancelToken token)
+{
+    return add(priority, std::move(work), std::move(done), after, token, false);
+}
+
+JobScheduler::JobId JobScheduler::submitProcess(Priority priority, Work work, Done done,
+                                                const QVector<JobId> &after, CancelToken token)
+{
+    return add(priority, std::move(work), std::move(done), after, token, true);
+}
+
+JobScheduler::JobId JobScheduler::add(Priority priority, Work work, Done done, const QVector<JobId> &after,
+                                      CancelToken token, bool process)
+{
+    Job *job = new Job();
+    job->priority = priority;
+    job->work = std::move(work);
+    job->done = std::move(done);
+    job->token = token;
+    job->after = after;
+    job->inputs.resize(after.size());
+    job->waitingOn = 0;
+    job->inputCancelled = false;
+    job->finished = false;
+    job->cancelled = false;
+    job->readyNs = 0;
+    job->urgency = priority;
+    job->process = process;
+
+    JobId id = 0;
+    {
+        QMutexLocker locker(&m_graphMutex);
+        id = ++m_lastId;
+        job->id = id;
+        m_jobs.insert(id, job);
+        for (int i = 0; i < after.size(); ++i) {
+            Job *input = m_jobs.value(after[i]);
+            if (!input) {
+                continue;
+            }
+            if (input->finished) {
+                job->inputs[i] = input->result;
+                job->inputCancelled = job->inputCancelled || input->cancelled;
+            } else if (!input->dependents.contains(id)) {
+                input->dependents.append(id);
+                ++job->waitingOn;
+            }
+        }
+        if (job->waitingOn > 0) {
+            ++m_waiting;
+            return id;
+        }
+    }
+    push(job);
+    return id;
+}
+
+void JobScheduler::push(Job *job)
+{
+    job->readyNs = m_clock.nsecsElapsed();
+
+    // Jobs made ready by a worker stay on it; the rest are dealt round
+    const int target = tScheduler == this ? tWorker : int(m_nextWorker++ % unsigned(m_workers.size()));
+    Worker *worker = m_workers[target];
+    Priority priority = Interactive;
+    {
+        // Raised while it waited on other jobs, it goes in at the new class
+        QMutexLocker locker(&worker->mutex);
+        priority = Priority(int(job->urgency));
+        job->priority = priority;
+        if (job->process) {
+            worker->processQueues[priority].push_back(job);
+            ++m_processQueued[priority];
+        } else {
+            worker->queues[priority].push_back(job);
+        }
+    }
+    ++m_queued[priority];
+    ++m_ready;
+
+    QMutexLocker locker(&m_idleMutex);
+    m_wake.wakeOne();
+}
+
+JobScheduler::Job *JobScheduler::take(int self)
+{
+    for (int priority = 0; priority < PriorityCount; ++priority) {
+        Job *job = takeFrom(self, priority, false);
+        // A process job is only taken with the slot it will run on
+        if (!job && m_processQueued[priority] > 0 && reserveSlot(priority)) {
+            job = takeFrom(self, priority, true);
+            if (!job) {
+                releaseSlot();
+            }
+        }
+        if (job) {
+            return job;
+        }
+    }
+    return nullptr;
+}
+
+JobScheduler::Job *JobScheduler::takeFrom(int self, int priority, bool process)
+{
+    const int count = m_workers.size();
+    for (int i = 0; i < count; ++i) {
+        Worker *worker = m_workers[(self + i) % count];
+        QMutexLocker locker(&worker->mutex);
+        std::deque<Job *> &queue = process ? worker->processQueues[priority] : worker->queues[priority];
+        if (queue.empty()) {
+            continue;
+        }
+        // Newest from our own deque, oldest from anyone else's
+        Job *job = nullptr;
+        if (i == 0) {
+            job = queue.back();
+            queue.pop_back();
+        } else {
+            job = queue.front();
+            queue.pop_front();
+            ++m_steals;
+        }
+        if (process) {
+            --m_processQueued[priority];
+        }
+        --m_queued[priority];
+        --m_ready;
+        return job;
+    }
+    return nullptr;
+}
+
+void JobScheduler::workerLoop(int self)
+{
+    tScheduler = this;
+    tWorker = self;
+    while (true) {
+        Job *job = take(self);
+        if (!job) {
+            QMutexLocker locker(&m_idleMutex);
+            if (m_stopping) {
+                return;
+            }
+            // Process jobs left queued for want of a slot are looked at
+            // again when one is freed
+            if (m_ready <= 0) {
+                m_wake.wait(&m_idleMutex);
+            } else {
+                m_wake.wait(&m_idleMutex, kPollMs);
+            }
+            continue;
+        }
+
+        if (m_stopping || job->inputCancelled || job->token.isCancelled()) {
+            if (job->process) {
+                releaseSlot();
+            }
+            finish(job, true);
+            continue;
+        }
+        ++m_running;
+        Context context;
+        context.token = job->token;
+        context.inputs = job->inputs;
+        tJob = job;
+        tHoldsSlot = job->process;
+        job->result = job->work(context);
+        tHoldsSlot = false;
+        tJob = nullptr;
+        if (job->process) {
+            releaseSlot();
+        }
+        --m_running;
+        finish(job, job->token.isCancelled());
+    }
+}
+
+void JobScheduler::finish(Job *job, bool cancelled)
+{
+    QVector<Job *> ready;
+    {
+        QMutexLocker locker(&m_graphMutex);
+        job->finished = true;
+        job->cancelled = cancelled;
+        for (JobId id : job->dependents) {
+            Job *dependent = m_jobs.value(id);
+            for (int i = 0; i < dependent->after.size(); ++i) {
+                if (dependent->after[i] == job->id) {
+                    dependent->inputs[i] = job->result;
+                }
+            }
+            dependent->inputCancelled = dependent->inputCancelled || cancelled;
+            if (--dependent->waitingOn == 0) {
+                --m_waiting;
+                ready.append(dependent);
+            }
+        }
+    }
+    for (Job *next : ready) {
+        push(next);
+    }
+
+    // One queued call carries everything finished before it runs
+    bool first = false;
+    {
+        QMutexLocker locker(&m_deliveryMutex);
+        first = m_deliveries.isEmpty();
+        m_deliveries.append({job, m_clock.nsecsElapsed()});
+    }
+    if (first) {
+        QMetaObject::invokeMethod(this, [this]() { deliver(); }, Qt::QueuedConnection);
+    }
+}
+
+void JobScheduler::deliver()
+{
+    QVector<Delivery> deliveries;
+    {
+        QMutexLocker locker(&m_deliveryMutex);
+        deliveries.swap(m_deliveries);
+    }
+
+    for (const Delivery &delivery : deliveries) {
+        Job *job = delivery.job;
+        const int priority = job->priority;
+        // A token cancelled after the work ran still drops the result, so
+        // whoever cancelled need not outlive it
+        if (job->cancelled || job->token.isCancelled()) {
+            ++m_cancelled[priority];
+        } else {
+            ++m_completed[priority];
+            QVector<double> &latency = m_latency[priority];
+            latency.append((m_clock.nsecsElapsed() - job->readyNs) / 1e6);
+            if (latency.size() > kLatencyWindow) {
+                latency.removeFirst();
+            }
+            if (job->done) {
+                job->done(job->result);
+            }
+        }
+
+        // Kept until now so jobs submitted from done can still take its
+        // result as an input
+        {
+            QMutexLocker locker(&m_graphMutex);
+            m_jobs.remove(job->id);
+        }
+        delete job;
+    }
+}
+
+void JobScheduler::raise(JobId id, Priority priority)
+{
+    {
+        QMutexLocker locker(&m_graphMutex);
+        Job *job = m_jobs.value(id);
+        if (!job || job->finished || job->urgency <= priority) {
+            return;
+        }
+        job->urgency = priority;
+
+        // A queued job moves to the same worker's deque for the new class;
+        // one not queued yet goes in at its urgency when it is pushed
+        for (Worker *worker : m_workers) {
+            QMutexLocker workerLocker(&worker->mutex);
+            std::deque<Job *> *queues = job->process ? worker->processQueues : worker->queues;
+            for (int from = priority + 1; from < PriorityCount; ++from) {
+                std::deque<Job *> &queue = queues[from];
+                auto it = std::find(queue.begin(), queue.end(), job);
+                if (it == queue.end()) {
+                    continue;
+                }
+                queue.erase(it);
+                queues[priority].push_back(job);
+                job->priority = priority;
+                if (job->process) {
+                    --m_processQueued[from];
+                    ++m_processQueued[priority];
+                }
+                --m_queued[from];
+                ++m_queued[priority];
+                break;
+            }
+        }
+    }
+
+    // A running job may be waiting for a process slot at its old urgency
+    QMutexLocker locker(&m_slotMutex);
+    m_slotFreed.wakeAll();
+}
+
+bool JobScheduler::runProcess(const QString &program, const QStringList &arguments, const CancelToken &token,
+                              QByteArray *output, int timeoutMs)
+{
+    // Process jobs already hold a slot
+    const bool holdsSlot = tHoldsSlot && tScheduler == this;
+    if (!holdsSlot && !acquireSlot(static_cast<const Job *>(tJob), token)) {
+        return false;
+    }
+    ++m_processes;
+
+    QProcess process;
+    QElapsedTimer timer;
+    timer.start();
+    process.start(program, arguments);
+    bool ok = process.waitForStarted();
+    while (ok && !process.waitForFinished(kPollMs)) {
+        if (process.state() == QProcess::NotRunning) {
+            break;
+        }
+        if (token.isCancelled() || m_stopping || (timeoutMs >= 0 && timer.elapsed() > timeoutMs)) {
+            process.kill();
+            process.waitForFinished();
+            ok = false;
+        }
+    }
+    ok = ok && process.exitStatus() == QProcess::NormalExit && process.exitCode() == 0;
+    if (output) {
+        *output = process.readAllStandardOutput();
+    }
+
+    --m_processes;
+    if (!holdsSlot) {
+        releaseSlot();
+    }
+    return ok;
+}
+
+bool JobScheduler::streamProcess(const QString &program, const QStringList &arguments, const CancelToken &token,
+                                 const Output &output, QByteArray *errors)
+{
+    const bool holdsSlot = tHoldsSlot && tScheduler == this;
+    if (!holdsSlot && !acquireSlot(static_cast<const Job *>(tJob), token)) {
+        return false;
+    }
+    ++m_processes;
+
+    QProcess process;
+    process.start(program, arguments);
+    bool ok = process.waitForStarted();
+    while (ok && process.state() != QProcess::NotRunning) {
+        if (token.isCancelled() || m_stopping) {
+            process.kill();
+            process.waitForFinished();
+            ok = false;
+            break;
+        }
+        // A child that closed its output early is waited on instead
+        QElapsedTimer waited;
+        waited.start();
+        if (!process.waitForReadyRead(kPollMs) && waited.elapsed() < kPollMs / 2) {
+            process.waitForFinished(kPollMs);
+        }
+        const QByteArray chunk = process.readAllStandardOutput();
+        if (output && !chunk.isEmpty()) {
+            output(chunk);
+        }
+    }
+    // Whatever arrived between the last read and the exit
+    const QByteArray rest = process.readAllStandardOutput();
+    if (ok && output && !rest.isEmpty()) {
+        output(rest);
+    }
+    ok = ok && process.exitStatus() == QProcess::NormalExit && process.exitCode() == 0;
+    if (errors) {
+        *errors = process.readAllStandardError();
+    }
+
+    --m_processes;
+    if (!holdsSlot) {
+        releaseSlot();
+    }
+    return ok;
+}
+
+void JobScheduler::post(const CancelToken &token, std::function<void()> call)
+{
+    QMetaObject::invokeMethod(this, [token, call]() {
+        if (!token.isCancelled()) {
+            call();
+        }
+    }, Qt::QueuedConnection);
+}
+
+bool JobScheduler::acquireSlot(const Job *job, const CancelToken &token)
+{
+    // Callers that aren't jobs are waited on directly, so they come first
+    QMutexLocker locker(&m_slotMutex);
+    int waitingAs = job ? int(job->urgency) : int(Interactive);
+    ++m_slotWaiters[waitingAs];
+    while (true) {
+        const int urgency = job ? int(job->urgency) : int(Interactive);
+        if (urgency != waitingAs) {
+            --m_slotWaiters[waitingAs];
+            ++m_slotWaiters[urgency];
+            waitingAs = urgency;
+        }
+
+        bool moreUrgent = false;
+        for (int priority = 0; priority < waitingAs; ++priority) {
+            moreUrgent = moreUrgent || m_slotWaiters[priority] > 0;
+        }
+        if (m_freeSlots > 0 && !moreUrgent) {
+            --m_freeSlots;
+            --m_slotWaiters[waitingAs];
+            return true;
+        }
+        if (token.isCancelled() || m_stopping) {
+            --m_slotWaiters[waitingAs];
+            // A more urgent waiter that gave up may have been holding
+            // the others back
+            m_slotFreed.wakeAll();
+            return false;
+        }
+        m_slotFreed.wait(&m_slotMutex, kPollMs);
+    }
+}
+
+bool JobScheduler::reserveSlot(int priority)
+{
+    // Running jobs waiting in acquireSlot at the same urgency or above
+    // were there first
+    QMutexLocker locker(&m_slotMutex);
+    for (int waiting = 0; waiting <= priority; ++waiting) {
+        if (m_slotWaiters[waiting] > 0) {
+            return false;
+        }
+    }
+    if (m_freeSlots <= 0) {
+        return false;
+    }
+    --m_freeSlots;
+    return true;
+}
+
+void JobScheduler::releaseSlot()
+{
+    {
+        QMutexLocker locker(&m_slotMutex);
+        ++m_freeSlots;
+        m_slotFreed.wakeAll();
+    }
+    // A worker may be idle with process jobs queued
+    if (m_processQueued[Interactive] + m_processQueued[Visible] + m_processQueued[Background] > 0) {
+        QMutexLocker locker(&m_idleMutex);
+        m_wake.wakeOne();
+    }
+}
+
+JobScheduler::Stats JobScheduler::stats() const
+{
+    Stats stats;
+    for (int priority = 0; priority < PriorityCount; ++priority) {
+        ClassStats &classStats = stats.classes[priority];
+        classStats.queued = m_queued[priority];
+        classStats.completed = m_completed[priority];
+        classStats.cancelled = m_cancelled[priority];
+        classStats.p50Ms = 0.0;
+        classStats.p95Ms = 0.0;
+        classStats.maxMs = 0.0;
+        if (!m_latency[priority].isEmpty()) {
+            QVector<double> sorted = m_latency[priority];
+            std::sort(sorted.begin(), sorted.end());
+            classStats.p50Ms = sorted[(sorted.size() - 1) / 2];
+            classStats.p95Ms = sorted[(sorted.size() - 1) * 95 / 100];
+            classStats.maxMs = sorted.last();
+        }
+    }
+    {
+        QMutexLocker locker(&m_graphMutex);
+        stats.waiting = m_waiting;
+    }
+    stats.running = m_running;
+    stats.processes = m_processes;
+    stats.steals = m_steals;
+    return stats;
+}
@@ -0,0 +1,218 @@
+#include "KeyframeIndex.h"
+#include <QDebug>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+const char kMagic[4] = {'M', 'V', 'K', 'I'};
+const quint32 kVersion = 1;
+
+// File layout: header, packets in pts order, keyframe packet numbers
+struct IndexHeader
+{
+    char magic[4];
+    quint32 version;
+    qint64 sourceSize;
+    qint64 sourceModified;
+    quint32 packetCount;
+    quint32 keyframeCount;
+};
+}
+
+KeyframeIndex::KeyframeIndex()
+    : m_data(nullptr)
+    , m_packets(nullptr)
+    , m_keyframes(nullptr)
+    , m_packetCount(0)
+    , m_keyframeCount(0)
+{
+}
+
+KeyframeIndex::~KeyframeIndex()
+{
+    close();
+}
+
+bool KeyframeIndex::open(const QString &indexPath)
+{
+    close();
+
+    m_file.setFileName(indexPath);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    const qint64 fileSize = m_file.size();
+    if (fileSize < static_cast<qint64>(sizeof(IndexHeader))) {
+        m_file.close();
+        return false;
+    }
+
+    m_data = m_file.map(0, fileSize);
+    if (!m_data) {
+        qDebug() << "Failed to map keyframe index" << indexPath;
+        m_file.close();
+        return false;
+    }
+
+    const IndexHeader *header = reinterpret_cast<const IndexHeader *>(m_data);
+    const qint64 expectedSize = sizeof(IndexHeader)
+                              + qint64(header->packetCount) * sizeof(Packet)
+                              + qint64(header->keyframeCount) * sizeof(quint32);
+    if (std::memcmp(header->magic, kMagic, sizeof(kMagic)) != 0
+        || header->version != kVersion
+        || header->packetCount == 0
+        || expectedSize != fileSize) {
+        close();
+        return false;
+    }
+
+    m_packetCount = header->packetCount;
+    m_keyframeCount = header->keyframeCount;
+    m_packets = reinterpret_cast<const Packet *>(m_data + sizeof(IndexHeader));
+    m_keyframes = reinterpret_cast<const quint32 *>(m_packets + m_packetCount);
+    return true;
+}
+
+void KeyframeIndex::close()
+{
+    if (m_data) {
+        m_file.unmap(const_cast<uchar *>(m_data));
+    }
+    m_file.close();
+    m_data = nullptr;
+    m_packets = nullptr;
+    m_keyframes = nullptr;
+    m_packetCount = 0;
+    m_keyframeCount = 0;
+}
+
+qint64 KeyframeIndex::sourceSize() const
+{
+    return m_data ? reinterpret_cast<const IndexHeader *>(m_data)->sourceSize : -1;
+}
+
+qint64 KeyframeIndex::sourceModified() const
+{
+    return m_data ? reinterpret_cast<const IndexHeader *>(m_data)->sourceModified : -1;
+}
+
+int KeyframeIndex::keyframeSlotAtOrBefore(Ticks time) const
+{
+    // First keyframe after time, then step back one
+    const quint32 *begin = m_keyframes;
+    const quint32 *end = m_keyframes + m_keyframeCount;
+    const quint32 *it = std::upper_bound(begin, end, time, [this](Ticks t, quint32 packet) {
+        return t < m_packets[packet].pts;
+    });
+    return static_cast<int>(it - begin) - 1;
+}
+
+Ticks KeyframeIndex::keyframeAtOrBefore(Ticks time) const
+{
+    if (m_keyframeCount == 0) {
+        return time;
+    }
+
+    const int slot = keyframeSlotAtOrBefore(time);
+    return m_packets[m_keyframes[std::max(slot, 0)]].pts;
+}
+
+Ticks KeyframeIndex::keyframeAtOrAfter(Ticks time) const
+{
+    const int slot = keyframeSlotAtOrBefore(time);
+    if (slot >= 0 && m_packets[m_keyframes[slot]].pts == time) {
+        return time;
+    }
+    if (slot + 1 >= m_keyframeCount) {
+        return -1;
+    }
+    return m_packets[m_keyframes[slot + 1]].pts;
+}
+
+Ticks KeyframeIndex::nearestKeyframe(Ticks time) const
+{
+    if (m_keyframeCount == 0) {
+        return time;
+    }
+
+    const int slot = keyframeSlotAtOrBefore(time);
+    if (slot < 0) {
+        return m_packets[m_keyframes[0]].pts;
+    }
+
+    const Ticks before = m_packets[m_keyframes[slot]].pts;
+    if (slot + 1 >= m_keyframeCount) {
+        return before;
+    }
+    const Ticks after = m_packets[m_keyframes[slot + 1]].pts;
+    return (time - before <= after - time) ? before : after;
+}
+
+KeyframeIndex::DecodeCost KeyframeIndex::decodeCost(Ticks time) const
+{
+    DecodeCost cost = {0, 0};
+    if (m_keyframeCount == 0) {
+        return cost;
+    }
+
+    const int slot = keyframeSlotAtOrBefore(time);
+    if (slot < 0) {
+        return cost;
+    }
+
+    // Approximated in pts order: every packet between the keyframe and the
+    // target frame has to be decoded before the target can be shown
+    const Packet *begin = m_packets + m_keyframes[slot];
+    const Packet *end = std::upper_bound(begin, m_packets + m_packetCount, time,
+                                         [](Ticks t, const Packet &packet) {
+                                             return t < packet.pts;
+                                         });
+    for (const Packet *packet = begin; packet + 1 < end; ++packet) {
+        ++cost.packets;
+        cost.bytes += packet->size;
+    }
+    return cost;
+}
+
+bool KeyframeIndex::write(const QString &indexPath, const QVector<Packet> &packets,
+                          qint64 sourceSize, qint64 sourceModified)
+{
+    QVector<quint32> keyframes;
+    for (int i = 0; i < packets.size(); ++i) {
+        if (packets[i].flags & Keyframe) {
+            keyframes.append(i);
+        }
+    }
+
+    IndexHeader header;
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.sourceSize = sourceSize;
+    header.sourceModified = sourceModified;
+    header.packetCount = packets.size();
+    header.keyframeCount = keyframes.size();
+
+    // Written under a temporary name so a reader never maps a partial file
+    const QString tempPath = indexPath + ".tmp";
+    QFile file(tempPath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qDebug() << "Failed to write keyframe index" << tempPath;
+        return false;
+    }
+
+    bool ok = file.write(reinterpret_cast<const char *>(&header), sizeof(header)) == sizeof(header);
+    const qint64 packetBytes = qint64(packets.size()) * sizeof(Packet);
+    const qint64 keyframeBytes = qint64(keyframes.size()) * sizeof(quint32);
+    ok = ok && file.write(reinterpret_cast<const char *>(packets.constData()), packetBytes) == packetBytes;
+    ok = ok && file.write(reinterpret_cast<const char *>(keyframes.constData()), keyframeBytes) == keyframeBytes;
+    file.close();
+
+    QFile::remove(indexPath);
+    if (!ok || !QFile::rename(tempPath, indexPath)) {
+        qDebug() << "Failed to write keyframe index" << indexPath;
+        QFile::remove(tempPath);
+        return false;
+    }
+    return true;
+}
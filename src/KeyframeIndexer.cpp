@@ -0,0 +1,195 @@
+#include "KeyframeIndexer.h"
+#include "ImageSequence.h"
+#include "Nesting.h"
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QStandardPaths>
+#include <algorithm>
+
+namespace {
+// Parses the complete lines in pending, and the rest too when flushing
+void readPackets(QByteArray &pending, QVector<KeyframeIndex::Packet> &packets, bool flush)
+{
+    // Lines look like "pts_time=1.001|dts_time=0.967|size=4120|pos=88213|flags=K__"
+    QList<QByteArray> lines = pending.split('\n');
+    pending = flush ? QByteArray() : lines.takeLast();
+
+    for (const QByteArray &line : lines) {
+        KeyframeIndex::Packet packet = {0, -1, 0, 0};
+        bool hasPts = false;
+        bool hasDts = false;
+        Ticks dts = 0;
+        for (const QByteArray &field : line.split('|')) {
+            const int equals = field.indexOf('=');
+            if (equals < 0) {
+                continue;
+            }
+            const QByteArray key = field.left(equals);
+            const QByteArray value = field.mid(equals + 1);
+            bool ok = false;
+            if (key == "pts_time") {
+                const double seconds = value.toDouble(&ok);
+                if (ok) {
+                    packet.pts = Timebase::fromSeconds(seconds);
+                    hasPts = true;
+                }
+            } else if (key == "dts_time") {
+                const double seconds = value.toDouble(&ok);
+                if (ok) {
+                    dts = Timebase::fromSeconds(seconds);
+                    hasDts = true;
+                }
+            } else if (key == "size") {
+                packet.size = value.toUInt();
+            } else if (key == "pos") {
+                packet.pos = value.toLongLong(&ok);
+                if (!ok) {
+                    packet.pos = -1;
+                }
+            } else if (key == "flags" && value.startsWith('K')) {
+                packet.flags |= KeyframeIndex::Keyframe;
+            }
+        }
+        // Some containers leave pts unset ("N/A") on packets
+        if (!hasPts && hasDts) {
+            packet.pts = dts;
+            hasPts = true;
+        }
+        if (hasPts) {
+            packets.append(packet);
+        }
+    }
+}
+
+// Runs on a worker: scans the source's packets and writes its index, for
+// the GUI thread to open
+bool scanSource(JobScheduler *jobs, const QString &source, const QString &indexPath, const CancelToken &token)
+{
+    QStringList arguments;
+    arguments << "-v" << "error"
+              << "-select_streams" << "v:0"
+              << "-show_entries" << "packet=pts_time,dts_time,size,pos,flags"
+              << "-of" << "compact=p=0"
+              << source;
+    QByteArray pending;
+    QVector<KeyframeIndex::Packet> packets;
+    const bool ok = jobs->streamProcess("ffprobe", arguments, token, [&pending, &packets](const QByteArray &chunk) {
+        pending += chunk;
+        readPackets(pending, packets, false);
+    });
+    readPackets(pending, packets, true);
+    if (!ok || packets.isEmpty()) {
+        if (!token.isCancelled()) {
+            qDebug() << "Keyframe scan failed for" << source;
+        }
+        return false;
+    }
+
+    // Packets arrive in decode order; lookups want presentation order,
+    // rebased the way mpv rebases the file's start time
+    std::stable_sort(packets.begin(), packets.end(),
+                     [](const KeyframeIndex::Packet &a, const KeyframeIndex::Packet &b) {
+                         return a.pts < b.pts;
+                     });
+    const Ticks firstPts = packets.first().pts;
+    for (KeyframeIndex::Packet &packet : packets) {
+        packet.pts -= firstPts;
+    }
+
+    const QFileInfo info(source);
+    return KeyframeIndex::write(indexPath, packets, info.size(), info.lastModified().toMSecsSinceEpoch());
+}
+}
+
+KeyframeIndexer::KeyframeIndexer(JobScheduler *jobs, QObject *parent)
+    : QObject(parent)
+    , m_jobs(jobs)
+{
+    m_cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/keyframes";
+    QDir().mkpath(m_cacheDir);
+}
+
+KeyframeIndexer::~KeyframeIndexer()
+{
+    m_token.cancel();
+    qDeleteAll(m_indexes);
+}
+
+const KeyframeIndex *KeyframeIndexer::index(const QString &source, JobScheduler::Priority priority)
+{
+    auto it = m_indexes.constFind(source);
+    if (it != m_indexes.constEnd()) {
+        if (m_scans.contains(source)) {
+            m_jobs->raise(m_scans.value(source), priority);
+        }
+        return it.value();
+    }
+
+    if (openCached(source)) {
+        return m_indexes.value(source);
+    }
+
+    // Every frame of an image sequence is its own keyframe, and there is
+    // no container to scan; compound clips have no file at all
+    if (ImageSequence::isSequence(source) || Nesting::isCompound(source)) {
+        m_indexes.insert(source, nullptr);
+        return nullptr;
+    }
+
+    // Null until the scan finishes; failed scans stay null
+    m_indexes.insert(source, nullptr);
+    scan(source, priority);
+    return nullptr;
+}
+
+QString KeyframeIndexer::indexPathFor(const QString &source) const
+{
+    const QByteArray key = QFileInfo(source).absoluteFilePath().toUtf8();
+    return m_cacheDir + "/" + QString::fromLatin1(QCryptographicHash::hash(key, QCryptographicHash::Sha1).toHex()) + ".kfi";
+}
+
+bool KeyframeIndexer::openCached(const QString &source)
+{
+    const QFileInfo info(source);
+    if (!info.exists()) {
+        return false;
+    }
+
+    KeyframeIndex *index = new KeyframeIndex();
+    if (!index->open(indexPathFor(source))
+        || index->sourceSize() != info.size()
+        || index->sourceModified() != info.lastModified().toMSecsSinceEpoch()) {
+        delete index;
+        return false;
+    }
+
+    delete m_indexes.value(source);
+    m_indexes.insert(source, index);
+    return true;
+}
+
+void KeyframeIndexer::scan(const QString &source, JobScheduler::Priority priority)
+{
+    // The scheduler caps how many scans run beside the other ffmpegs
+    JobScheduler *jobs = m_jobs;
+    const QString indexPath = indexPathFor(source);
+    const CancelToken token = m_token;
+    const JobScheduler::JobId id =
+        m_jobs->submitProcess(priority,
+                              [jobs, source, indexPath, token](const JobScheduler::Context &) {
+                                  return scanSource(jobs, source, indexPath, token);
+                              },
+                              [this, source](const QVariant &result) {
+                                  m_scans.remove(source);
+                                  if (result.toBool() && openCached(source)) {
+                                      emit indexed(source);
+                                  } else {
+                                      emit failed(source);
+                                  }
+                              },
+                              QVector<JobScheduler::JobId>(), token);
+    m_scans.insert(source, id);
+}
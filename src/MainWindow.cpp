@@ -1,14 +1,52 @@
 #include "MainWindow.h"
 #include "Timeline.h"
 #include "MpvVideoWidget.h"
+#include "MpvVideoWindow.h"
+#include "MediaBin.h"
+#include "JobScheduler.h"
+#include "KeyframeIndexer.h"
+#include "MemoryBudget.h"
+#include "MemoryPanel.h"
+#include "SmartExporter.h"
+#include "TransitionCache.h"
+#include "ConformCache.h"
+#include "FrameCache.h"
+#include "ShuttleView.h"
+#include "EditJournal.h"
+#include "PlaybackMetrics.h"
+#include "MetricsPanel.h"
+#include "VideoScopes.h"
+#include "ScopesPanel.h"
+#include "AngleViewer.h"
+#include "FrameGrabber.h"
+#include "TrimPreview.h"
+#include "AudioMixer.h"
+#include "ImageSequence.h"
+#include "SequencePrefetcher.h"
+#include "SequenceFlattener.h"
+#include "SegmentBuilder.h"
+#include "Nesting.h"
+#include "AutomationServer.h"
+#include "StartupProfile.h"
 #include <QAction>
+#include <QApplication>
+#include <QDockWidget>
 #include <QFile>
 #include <QFileDialog>
 #include <QHBoxLayout>
+#include <QInputDialog>
 #include <QKeySequence>
+#include <QLabel>
 #include <QMenu>
 #include <QMenuBar>
+#include <QMessageBox>
+#include <QProgressDialog>
+#include <QSet>
 #include <QSlider>
+#include <QStackedWidget>
+#include <QStandardPaths>
+#include <QStatusBar>
+#include <QThread>
 #include <QToolButton>
 #include <QTimer>
 #include <QVBoxLayout>
@@ -18,21 +56,108 @@
 #include <cmath>
 #include <clocale>
 
+namespace {
+const int kMaxShuttleSpeed = 4;
+
+// Span of program around the playhead loaded into mpv. The next window is
+// queued once playback is this close to the end of the current one.
+const double kDefaultPreviewWindowSeconds = 300.0;
+const Ticks kPreviewWindowLead = 15 * Timebase::kTicksPerSecond;
+
+// What each cache asks of the memory budget, and the least it can work
+// with. The preview's demuxer cache is the one that keeps playback fed.
+const qint64 kMiB = 1024 * 1024;
+const qint64 kPreviewCacheWanted = 512 * kMiB;
+const qint64 kPreviewCacheMinimum = 64 * kMiB;
+const qint64 kSideCacheWanted = 64 * kMiB;
+const qint64 kSideCacheMinimum = 8 * kMiB;
+const qint64 kShuttleFramesMinimum = 32 * kMiB;
+
+// Image sequence frames are read this far ahead of the playhead
+const Ticks kSequenceReadAhead = 2 * Timebase::kTicksPerSecond;
+
+// Runs on a worker thread: loading libmpv's codecs and config is the
+// slowest part of startup
+mpv_handle *createMpv()
+{
+    mpv_handle *mpv = mpv_create();
+    if (!mpv) {
+        qDebug() << "failed creating context";
+        return nullptr;
+    }
+
+    // Enable default bindings
+    mpv_set_option_string(mpv, "input-default-bindings", "yes");
+    mpv_set_option_string(mpv, "input-vo-keyboard", "yes");
+
+    // Use libmpv render API (required on Wayland)
+    mpv_set_option_string(mpv, "vo", "libmpv");
+
+    // Opens the next preview window while the current one plays
+    mpv_set_option_string(mpv, "prefetch-playlist", "yes");
+
+    // A restored timeline opens paused at the start
+    mpv_set_option_string(mpv, "pause", "yes");
+
+    // Initialize the MPV instance
+    if (mpv_initialize(mpv) < 0) {
+        qDebug() << "mpv init failed";
+        mpv_terminate_destroy(mpv);
+        return nullptr;
+    }
+    return mpv;
+}
+}
+
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
     , mpv(nullptr)
+    , mpvInitThread(nullptr)
+    , pendingMpv(nullptr)
+    , startupStage(StartupPainting)
+    , printStartupTimings(false)
+    , headless(false)
     , videoContainer(nullptr)
+    , videoWindow(nullptr)
     , playPauseButton(nullptr)
     , seekSlider(nullptr)
     , positionTimer(nullptr)
+    , rendersWaiting(false)
     , userSeeking(false)
     , mediaDuration(0.0)
     , timeline(nullptr)
+    , mediaBin(nullptr)
+    , jobScheduler(nullptr)
+    , keyframeIndexer(nullptr)
+    , smartExporter(nullptr)
+    , transitionCache(nullptr)
+    , conformCache(nullptr)
+    , frameCache(nullptr)
+    , shuttleView(nullptr)
+    , videoStack(nullptr)
+    , shuttleTimer(nullptr)
+    , shuttleSpeed(0)
+    , shuttlePosition(0)
+    , editJournal(nullptr)
+    , journalLabel(nullptr)
+    , playbackMetrics(nullptr)
+    , memoryBudget(nullptr)
+    , videoScopes(nullptr)
+    , angleViewer(nullptr)
+    , trimPreview(nullptr)
+    , frameGrabber(nullptr)
+    , audioMixer(nullptr)
+    , mixingAudio(false)
+    , sequencePrefetcher(nullptr)
+    , sequenceFlattener(nullptr)
+    , automationServer(nullptr)
+    , edlWindowSpan(Timebase::fromSeconds(kDefaultPreviewWindowSeconds))
     , usingTimelinePlaylist(false)
     , currentTimelinePos(0.0)
 {
+    // mpv and the session load once the window has painted
     setupUI();
-    initializeMpv();
+    StartupProfile::mark("window built");
 }
 
 void MainWindow::setupUI()
@@ -41,6 +166,10 @@ void MainWindow::setupUI()
     QAction *openAction = fileMenu->addAction(tr("&Open..."));
     openAction->setShortcut(QKeySequence::Open);
     connect(openAction, &QAction::triggered, this, &MainWindow::openFile);
+    QAction *exportAction = fileMenu->addAction(tr("&Export Timeline..."));
+    connect(exportAction, &QAction::triggered, this, &MainWindow::exportTimeline);
+    QAction *settingsAction = fileMenu->addAction(tr("Project &Settings..."));
+    connect(settingsAction, &QAction::triggered, this, &MainWindow::editProjectSettings);
 
     // Create a central widget and layout
     QWidget *centralWidget = new QWidget(this);
@@ -48,10 +177,30 @@ void MainWindow::setupUI()
     QVBoxLayout *layout = new QVBoxLayout(centralWidget);
     layout->setContentsMargins(0, 0, 0, 0);
 
-    // Create a container for the video
-    videoContainer = new MpvVideoWidget(this);
-    videoContainer->setMinimumSize(640, 480);
-    layout->addWidget(videoContainer, 2);
+    // Create a container for the video. With --render-thread mpv renders
+    // on its own thread so GUI work can't delay frames.
+    videoStack = new QStackedWidget(this);
+    // The surface feeds the scopes small copies of the frames it renders
+    videoScopes = new VideoScopes(this);
+    if (QApplication::arguments().contains("--render-thread") && MpvVideoWindow::isSupported()) {
+        videoWindow = new MpvVideoWindow();
+        videoWindow->setScopes(videoScopes);
+        QWidget *windowContainer = QWidget::createWindowContainer(videoWindow, videoStack);
+        windowContainer->setMinimumSize(640, 480);
+        videoStack->addWidget(windowContainer);
+    } else {
+        videoContainer = new MpvVideoWidget(videoStack);
+        videoContainer->setScopes(videoScopes);
+        videoContainer->setMinimumSize(640, 480);
+        videoStack->addWidget(videoContainer);
+    }
+    // Reverse and fast shuttle show cached frames in place of mpv's output
+    shuttleView = new ShuttleView(videoStack);
+    videoStack->addWidget(shuttleView);
+    // Dragging a clip edge shows its new in and out frames here
+    trimPreview = new TrimPreview(videoStack);
+    videoStack->addWidget(trimPreview);
+    layout->addWidget(videoStack, 2);
 
     QWidget *controlsWidget = new QWidget(this);
     QHBoxLayout *controlsLayout = new QHBoxLayout(controlsWidget);
@@ -66,6 +215,7 @@ void MainWindow::setupUI()
     seekSlider->setEnabled(false);
     connect(seekSlider, &QSlider::sliderPressed, this, &MainWindow::beginSeek);
     connect(seekSlider, &QSlider::sliderReleased, this, &MainWindow::endSeek);
+    connect(seekSlider, &QSlider::sliderMoved, this, &MainWindow::scrubTo);
 
     controlsLayout->addWidget(playPauseButton);
     controlsLayout->addWidget(seekSlider, 1);
@@ -76,56 +226,332 @@ void MainWindow::setupUI()
     connect(positionTimer, &QTimer::timeout, this, &MainWindow::updatePosition);
     positionTimer->start();
 
+    journalLabel = new QLabel(this);
+    statusBar()->addPermanentWidget(journalLabel);
+    connect(positionTimer, &QTimer::timeout, this, &MainWindow::updateJournalStats);
+
+    shuttleTimer = new QTimer(this);
+    shuttleTimer->setTimerType(Qt::PreciseTimer);
+    connect(shuttleTimer, &QTimer::timeout, this, &MainWindow::shuttleTick);
+
+    // Edits made together, as a burst of ripples, share one rebuild
+    rebuildTimer = new QTimer(this);
+    rebuildTimer->setSingleShot(true);
+    rebuildTimer->setInterval(0);
+    connect(rebuildTimer, &QTimer::timeout, this, [this]() {
+        rendersWaiting = false;
+        rebuildTimelineEDL(true);
+    });
+
+    // Shared by the background work below; created first so it is
+    // destroyed before anything its results are delivered to
+    jobScheduler = new JobScheduler(0, this);
+
     // Create timeline widget
     timeline = new Timeline(this);
     layout->addWidget(timeline, 1);
+    timeline->setJobScheduler(jobScheduler);
+    keyframeIndexer = new KeyframeIndexer(jobScheduler, this);
+    timeline->setKeyframeIndexer(keyframeIndexer);
+    smartExporter = new SmartExporter(keyframeIndexer, jobScheduler, this);
+    audioMixer = new AudioMixer(jobScheduler, this);
+    smartExporter->setAudioMixer(audioMixer);
+    connect(audioMixer, &AudioMixer::sourcesChanged, this, &MainWindow::onTimelineChanged);
+    sequencePrefetcher = new SequencePrefetcher(jobScheduler, this);
+    transitionCache = new TransitionCache(jobScheduler, this);
+    timeline->setTransitionCache(transitionCache);
+    connect(transitionCache, &TransitionCache::rendered, this, &MainWindow::onRenderFinished);
+    // Gaps and mismatched sources switch to their renders as they finish
+    conformCache = new ConformCache(jobScheduler, this);
+    connect(conformCache, &ConformCache::rendered, this, &MainWindow::onRenderFinished);
+    sequenceFlattener = new SequenceFlattener(timeline);
+    segmentBuilder = new SegmentBuilder(timeline, conformCache, transitionCache, sequenceFlattener);
+    frameCache = new FrameCache(keyframeIndexer, jobScheduler, this);
+
+    QMenu *editMenu = menuBar()->addMenu(tr("&Edit"));
+    QAction *keyframeSnapAction = editMenu->addAction(tr("Snap Trims to &Keyframes"));
+    keyframeSnapAction->setCheckable(true);
+    connect(keyframeSnapAction, &QAction::toggled, timeline, &Timeline::setKeyframeSnapEnabled);
+
+    QMenu *playbackMenu = menuBar()->addMenu(tr("&Playback"));
+    QAction *reverseAction = playbackMenu->addAction(tr("Shuttle &Reverse"));
+    reverseAction->setShortcut(QKeySequence(Qt::Key_J));
+    connect(reverseAction, &QAction::triggered, this, &MainWindow::shuttleReverse);
+    QAction *stopAction = playbackMenu->addAction(tr("&Pause"));
+    stopAction->setShortcut(QKeySequence(Qt::Key_K));
+    connect(stopAction, &QAction::triggered, this, &MainWindow::shuttleStop);
+    QAction *forwardAction = playbackMenu->addAction(tr("Shuttle &Forward"));
+    forwardAction->setShortcut(QKeySequence(Qt::Key_L));
+    connect(forwardAction, &QAction::triggered, this, &MainWindow::shuttleForward);
     
     // Connect timeline signals
     connect(timeline, &Timeline::clipSelected, this, &MainWindow::onClipSelected);
     connect(timeline, &Timeline::timelineChanged, this, &MainWindow::onTimelineChanged);
+
+    // Trim frames come from a decoder of their own, so the main preview
+    // stays as it is until the trim is committed
+    frameGrabber = new FrameGrabber(2, this);
+    connect(frameGrabber, &FrameGrabber::frameReady, trimPreview, &TrimPreview::setFrame);
+    connect(timeline, &Timeline::trimming, this, &MainWindow::showTrimFrames);
+    connect(timeline, &Timeline::trimFinished, this, [this]() {
+        frameGrabber->cancel();
+        videoStack->setCurrentIndex(0);
+    });
+
+    // Media bin; assets are dragged from it onto the timeline
+    QDockWidget *mediaDock = new QDockWidget(tr("Media Bin"), this);
+    mediaBin = new MediaBin(jobScheduler, mediaDock);
+    mediaDock->setWidget(mediaBin);
+    addDockWidget(Qt::LeftDockWidgetArea, mediaDock);
+
+    // Playback health; --metrics-file <path> moves the snapshot file, and
+    // a path ending in .prom switches it to Prometheus text
+    playbackMetrics = new PlaybackMetrics(this);
+    playbackMetrics->setJobScheduler(jobScheduler);
+    playbackMetrics->setSequenceFlattener(sequenceFlattener);
+    const QStringList arguments = QApplication::arguments();
+    const int metricsArgument = arguments.indexOf("--metrics-file");
+    if (metricsArgument >= 0 && metricsArgument + 1 < arguments.size()) {
+        playbackMetrics->setExportPath(arguments[metricsArgument + 1]);
+    } else {
+        const QString dir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+        QDir().mkpath(dir);
+        playbackMetrics->setExportPath(dir + "/metrics.json");
+    }
+
+    // --preview-window <seconds> sets the span of program loaded into mpv
+    // around the playhead; 0 loads the whole timeline
+    const int windowArgument = arguments.indexOf("--preview-window");
+    if (windowArgument >= 0 && windowArgument + 1 < arguments.size()) {
+        edlWindowSpan = std::max<Ticks>(0, Timebase::fromSeconds(arguments[windowArgument + 1].toDouble()));
+    }
+
+    // --startup-timings prints each startup phase once the editor is usable
+    printStartupTimings = arguments.contains("--startup-timings");
+
+    QDockWidget *metricsDock = new QDockWidget(tr("Playback Metrics"), this);
+    metricsDock->setWidget(new MetricsPanel(playbackMetrics, metricsDock));
+    addDockWidget(Qt::RightDockWidgetArea, metricsDock);
+
+    // Scopes only run while their dock is showing
+    QDockWidget *scopesDock = new QDockWidget(tr("Video Scopes"), this);
+    scopesDock->setWidget(new ScopesPanel(videoScopes, scopesDock));
+    addDockWidget(Qt::RightDockWidgetArea, scopesDock);
+    scopesDock->hide();
+
+    // Clicking an angle cuts the multicam clip to it at the playhead
+    QDockWidget *angleDock = new QDockWidget(tr("Multicam Angles"), this);
+    angleViewer = new AngleViewer(angleDock);
+    angleDock->setWidget(angleViewer);
+    addDockWidget(Qt::RightDockWidgetArea, angleDock);
+    connect(angleViewer, &AngleViewer::angleClicked, this, [this](int angle) {
+        timeline->cutToAngle(timeline->playheadPosition(), angle);
+    });
+
+    // Every cache holds its memory under one ceiling, set in MiB with
+    // --memory-budget <MiB> or from the Memory dock. The preview's demuxer
+    // joins once mpv is up.
+    memoryBudget = new MemoryBudget(this);
+    const int budgetArgument = arguments.indexOf("--memory-budget");
+    if (budgetArgument >= 0 && budgetArgument + 1 < arguments.size()) {
+        memoryBudget->setCeiling(arguments[budgetArgument + 1].toLongLong() * kMiB);
+    }
+    memoryBudget->add("Shuttle frames", MemoryBudget::Normal, frameCache->memoryBudget(), kShuttleFramesMinimum,
+                      [this]() { return frameCache->memoryUsed(); },
+                      [this](qint64 bytes) { frameCache->setMemoryBudget(bytes); });
+    memoryBudget->add("Multicam demuxer", MemoryBudget::Low, kSideCacheWanted, kSideCacheMinimum,
+                      [this]() { return angleViewer->cacheBytes(); },
+                      [this](qint64 bytes) { angleViewer->setCacheLimit(bytes); });
+    memoryBudget->add("Trim frames demuxer", MemoryBudget::Low, kSideCacheWanted, kSideCacheMinimum,
+                      [this]() { return frameGrabber->cacheBytes(); },
+                      [this](qint64 bytes) { frameGrabber->setCacheLimit(bytes); });
+    memoryBudget->add("Video scopes", MemoryBudget::Normal, 0, 0,
+                      [this]() { return videoScopes->memoryUsed(); });
+    playbackMetrics->setMemoryBudget(memoryBudget);
+
+    // Pipeline tools drive the timeline over JSON-RPC; --automation <name>
+    // listens on a local socket of that name
+    automationServer = new AutomationServer(timeline, this);
+    automationServer->setSeek([this](Ticks time) {
+        timeline->setPlayheadPosition(time);
+        seekToTimelineTime(Timebase::toSeconds(time));
+    });
+    automationServer->setRender([this](const QString &path) { return startExport(path); });
+    connect(smartExporter, &SmartExporter::finished, automationServer, &AutomationServer::renderFinished);
+    const int automationArgument = arguments.indexOf("--automation");
+    if (automationArgument >= 0 && automationArgument + 1 < arguments.size()) {
+        automationServer->listen(arguments[automationArgument + 1]);
+    }
+
+    QDockWidget *memoryDock = new QDockWidget(tr("Memory"), this);
+    memoryDock->setWidget(new MemoryPanel(memoryBudget, memoryDock));
+    addDockWidget(Qt::RightDockWidgetArea, memoryDock);
+    memoryDock->hide();
 }
 
 MainWindow::~MainWindow()
 {
+    if (mpvInitThread) {
+        mpvInitThread->wait();
+        delete mpvInitThread;
+        if (pendingMpv) {
+            mpv_terminate_destroy(pendingMpv);
+        }
+    }
     if (videoContainer) {
         videoContainer->shutdown();
     }
+    if (videoWindow) {
+        videoWindow->shutdown();
+    }
     if (mpv) {
+        mpv_set_wakeup_callback(mpv, nullptr, nullptr);
         mpv_terminate_destroy(mpv);
     }
+    delete segmentBuilder;
+    delete sequenceFlattener;
 }
 
-void MainWindow::initializeMpv()
+void MainWindow::paintEvent(QPaintEvent *event)
+{
+    QMainWindow::paintEvent(event);
+
+    if (startupStage == StartupPainting) {
+        startupStage = StartupLoading;
+        StartupProfile::mark("first paint");
+        QTimer::singleShot(0, this, &MainWindow::startDeferredInit);
+    } else if (startupStage == StartupReady) {
+        // The first frame with mpv up and the session loaded
+        startupStage = StartupDone;
+        StartupProfile::mark("interactive");
+        playbackMetrics->setTimeToInteractive(StartupProfile::elapsedMs());
+        if (printStartupTimings) {
+            StartupProfile::print();
+        }
+        QTimer::singleShot(0, this, &MainWindow::warmCaches);
+    }
+}
+
+void MainWindow::startDeferredInit()
 {
     // MPV uses C locale
     std::setlocale(LC_NUMERIC, "C");
 
-    mpv = mpv_create();
-    if (!mpv) {
-        qDebug() << "failed creating context";
-        return;
+    // The session is restored while mpv starts, and loaded into it after
+    mpvInitThread = QThread::create([this]() { pendingMpv = createMpv(); });
+    connect(mpvInitThread, &QThread::finished, this, &MainWindow::onMpvReady);
+    mpvInitThread->start();
+
+    if (!headless) {
+        restoreSession();
+        StartupProfile::mark("session restored");
     }
+}
 
-    // Enable default bindings
-    mpv_set_option_string(mpv, "input-default-bindings", "yes");
-    mpv_set_option_string(mpv, "input-vo-keyboard", "yes");
+void MainWindow::startHeadless()
+{
+    // Nothing paints, so startup runs now
+    headless = true;
+    startupStage = StartupLoading;
+    startDeferredInit();
+    connect(automationServer, &AutomationServer::inputClosed, QApplication::instance(), &QApplication::quit);
+    automationServer->attachStdio();
+}
 
-    // Use libmpv render API (required on Wayland)
-    mpv_set_option_string(mpv, "vo", "libmpv");
+void MainWindow::onMpvReady()
+{
+    delete mpvInitThread;
+    mpvInitThread = nullptr;
+    mpv = pendingMpv;
+    pendingMpv = nullptr;
+    StartupProfile::mark("mpv initialized");
 
-    // Initialize the MPV instance
-    if (mpv_initialize(mpv) < 0) {
-        qDebug() << "mpv init failed";
-        return;
+    if (mpv) {
+        initializeMpv();
+        rebuildTimelineEDL(false);
+        StartupProfile::mark("timeline loaded");
     }
 
+    startupStage = StartupReady;
+    update();
+}
+
+void MainWindow::initializeMpv()
+{
+    // The audio tracks' mix plays from mvmix:// streams in the EDL
+    audioMixer->registerProtocol(mpv);
+
     if (videoContainer) {
         videoContainer->setMpv(mpv);
     }
-    
-    // Play a test video (optional, can be removed later)
-    // const char *cmd[] = {"loadfile", "https://commondatastorage.googleapis.com/gtv-videos-bucket/sample/BigBuckBunny.mp4", NULL};
-    // mpv_command(mpv, cmd);
+    if (videoWindow) {
+        videoWindow->setMpv(mpv);
+    }
+    playbackMetrics->setMpv(mpv);
+    memoryBudget->add("Preview demuxer", MemoryBudget::High, kPreviewCacheWanted, kPreviewCacheMinimum,
+                      [this]() { return MemoryBudget::mpvCacheBytes(mpv); },
+                      [this](qint64 bytes) { MemoryBudget::setMpvCacheLimit(mpv, bytes); });
+    mpv_set_wakeup_callback(mpv, onMpvEvents, this);
+}
+
+void MainWindow::warmCaches()
+{
+    // Keyframe indexes are otherwise loaded on first use; each source is
+    // opened from the cache or queued for a background scan
+    QSet<QString> sources;
+    for (const Clip &clip : timeline->clips()) {
+        sources.insert(clip.filePath());
+    }
+    for (const QString &source : sources) {
+        keyframeIndexer->index(source);
+    }
+}
+
+void MainWindow::onMpvEvents(void *ctx)
+{
+    // Called from mpv's threads; events are read on the GUI thread
+    MainWindow *self = static_cast<MainWindow *>(ctx);
+    QMetaObject::invokeMethod(self, "handleMpvEvents", Qt::QueuedConnection);
+}
+
+void MainWindow::handleMpvEvents()
+{
+    while (mpv) {
+        mpv_event *event = mpv_wait_event(mpv, 0);
+        if (event->event_id == MPV_EVENT_NONE) {
+            break;
+        }
+        if (event->event_id == MPV_EVENT_PLAYBACK_RESTART) {
+            playbackMetrics->playbackRestarted();
+        } else if (event->event_id == MPV_EVENT_FILE_LOADED) {
+            dropPlayedEdlWindows();
+        }
+    }
+}
+
+void MainWindow::restoreSession()
+{
+    editJournal = new EditJournal(this);
+    const QString dir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/session";
+    if (editJournal->open(dir, timeline)) {
+        timeline->setJournal(editJournal);
+    }
+    updateJournalStats();
+}
+
+void MainWindow::updateJournalStats()
+{
+    if (!editJournal) {
+        return;
+    }
+
+    const EditJournal::Stats stats = editJournal->stats();
+    journalLabel->setText(tr("Autosave: %1 edits, %2 syncs, %3x written | Recovered %4 edits in %5 ms")
+                              .arg(stats.records)
+                              .arg(stats.syncs)
+                              .arg(editJournal->writeAmplification(), 0, 'f', 2)
+                              .arg(stats.recoveredEdits)
+                              .arg(stats.recoveryMs, 0, 'f', 1));
 }
 
 void MainWindow::openFile()
@@ -160,20 +586,237 @@ void MainWindow::openFile()
     updatePlayButton(true);
 }
 
+void MainWindow::exportTimeline()
+{
+    if (timelineSegments.isEmpty()) {
+        QMessageBox::information(this, tr("Export Timeline"), tr("Add clips to the timeline first."));
+        return;
+    }
+
+    const QString fileName = QFileDialog::getSaveFileName(
+        this,
+        tr("Export Timeline"),
+        QString(),
+        tr("Video Files (*.mkv *.mp4 *.mov)"));
+    if (fileName.isEmpty()) {
+        return;
+    }
+
+    if (smartExporter->isRunning()) {
+        QMessageBox::information(this, tr("Export Timeline"), tr("An export is already running."));
+        return;
+    }
+
+    QProgressDialog *progressDialog = new QProgressDialog(tr("Exporting..."), tr("Cancel"), 0, 0, this);
+    progressDialog->setWindowModality(Qt::WindowModal);
+    progressDialog->setAutoClose(false);
+    progressDialog->setAutoReset(false);
+    progressDialog->setMinimumDuration(0);
+    connect(progressDialog, &QProgressDialog::canceled, smartExporter, &SmartExporter::cancel);
+    connect(smartExporter, &SmartExporter::progress, progressDialog, [progressDialog](int done, int total) {
+        progressDialog->setMaximum(total);
+        progressDialog->setValue(done);
+    });
+    QStringList workerLines;
+    for (int i = 0; i < smartExporter->workerCount(); ++i) {
+        workerLines.append(tr("Worker %1: idle").arg(i + 1));
+    }
+    connect(smartExporter, &SmartExporter::workerProgress, progressDialog,
+            [this, progressDialog, workerLines](int worker, int piece, int percent) mutable {
+        workerLines[worker] = piece < 0 ? tr("Worker %1: idle").arg(worker + 1)
+                                        : tr("Worker %1: chunk %2 (%3%)").arg(worker + 1).arg(piece + 1).arg(percent);
+        progressDialog->setLabelText(workerLines.join('\n'));
+    });
+    connect(smartExporter, &SmartExporter::finished, progressDialog, [this, progressDialog](bool ok, const QString &report) {
+        progressDialog->deleteLater();
+        if (ok) {
+            QMessageBox::information(this, tr("Export Finished"), report);
+        } else {
+            QMessageBox::warning(this, tr("Export Failed"), report);
+        }
+    });
+    startExport(fileName);
+}
+
+bool MainWindow::startExport(const QString &fileName)
+{
+    // Without mpv, as when headless, nothing else keeps the segments current
+    flushTimelineRebuild();
+    if (!mpv) {
+        buildTimelineSegments();
+    }
+    if (timelineSegments.isEmpty() || smartExporter->isRunning()) {
+        return false;
+    }
+
+    QVector<ExportSegment> segments;
+    for (const TimelineSegment &segment : timelineSegments) {
+        if (!segment.lavfiGraph.isEmpty()) {
+            segments.append({segment.lavfiGraph, 0, segment.duration, false, true});
+        } else {
+            segments.append({segment.source, segment.trimStart, segment.duration, segment.isGap, false});
+        }
+    }
+    smartExporter->setProjectSettings(timeline->settings());
+    smartExporter->start(segments, fileName);
+    return true;
+}
+
+void MainWindow::editProjectSettings()
+{
+    bool ok = false;
+    const QString text = QInputDialog::getText(this, tr("Project Settings"),
+                                               tr("Size, frame rate and sample rate:"),
+                                               QLineEdit::Normal, Project::encode(timeline->settings()), &ok);
+    if (!ok) {
+        return;
+    }
+    ProjectSettings settings;
+    if (!Project::decode(text, settings)) {
+        QMessageBox::warning(this, tr("Project Settings"),
+                             tr("Expected size, frame rate and sample rate, e.g. 1920x1080, 30000/1001, 48000; got %1")
+                                 .arg(text));
+        return;
+    }
+    timeline->setSettings(settings);
+}
+
 void MainWindow::playPause()
 {
     if (!mpv) {
         return;
     }
 
+    if (shuttleTimer->isActive()) {
+        shuttle(0);
+        return;
+    }
+
     int paused = 0;
     if (mpv_get_property(mpv, "pause", MPV_FORMAT_FLAG, &paused) < 0) {
         return;
     }
 
-    int newPaused = paused ? 0 : 1;
-    mpv_set_property(mpv, "pause", MPV_FORMAT_FLAG, &newPaused);
-    updatePlayButton(newPaused == 0);
+    shuttle(paused ? 1 : 0);
+}
+
+void MainWindow::shuttleReverse()
+{
+    const int speed = currentShuttleSpeed();
+    shuttle(speed < 0 ? std::max(speed * 2, -kMaxShuttleSpeed) : -1);
+}
+
+void MainWindow::shuttleStop()
+{
+    shuttle(0);
+}
+
+void MainWindow::shuttleForward()
+{
+    const int speed = currentShuttleSpeed();
+    shuttle(speed > 0 ? std::min(speed * 2, kMaxShuttleSpeed) : 1);
+}
+
+int MainWindow::currentShuttleSpeed() const
+{
+    if (shuttleTimer->isActive()) {
+        return shuttleSpeed;
+    }
+
+    int paused = 1;
+    if (mpv) {
+        mpv_get_property(mpv, "pause", MPV_FORMAT_FLAG, &paused);
+    }
+    return paused ? 0 : std::max(shuttleSpeed, 1);
+}
+
+void MainWindow::shuttle(int speed)
+{
+    if (!mpv || !playPauseButton->isEnabled()) {
+        return;
+    }
+
+    if (speed < 0 && !usingTimelinePlaylist) {
+        statusBar()->showMessage(tr("Reverse shuttle plays the timeline; add the file to it first"), 3000);
+        return;
+    }
+
+    // Reverse and fast timeline shuttle run from the frame cache
+    if (usingTimelinePlaylist && (speed < 0 || speed > 1)) {
+        if (!shuttleTimer->isActive()) {
+            double position = currentTimelinePos;
+            timelinePositionForMpv(position);
+            shuttlePosition = Timebase::fromSeconds(position);
+            int paused = 1;
+            mpv_set_property(mpv, "pause", MPV_FORMAT_FLAG, &paused);
+
+            const FrameRate rate = timeline->frameRate();
+            shuttleTimer->setInterval(std::max(1, 1000 * rate.denominator / rate.numerator));
+            frameCache->resetStats();
+            shuttleClock.start();
+            shuttleTimer->start();
+            videoStack->setCurrentWidget(shuttleView);
+        }
+        shuttleSpeed = speed;
+        shuttleView->setSpeed(speed);
+        updatePlayButton(true);
+        return;
+    }
+
+    // Pause, 1x and fast forward through a single file are left to mpv,
+    // which keeps the sound
+    if (shuttleTimer->isActive()) {
+        shuttleTimer->stop();
+        videoStack->setCurrentIndex(0);
+        seekToTimelineTime(Timebase::toSeconds(shuttlePosition));
+    }
+    shuttleSpeed = speed;
+    double rate = std::max(speed, 1);
+    mpv_set_property(mpv, "speed", MPV_FORMAT_DOUBLE, &rate);
+    int paused = speed == 0 ? 1 : 0;
+    mpv_set_property(mpv, "pause", MPV_FORMAT_FLAG, &paused);
+    updatePlayButton(paused == 0);
+}
+
+void MainWindow::shuttleTick()
+{
+    if (!usingTimelinePlaylist || timelineSegments.isEmpty()) {
+        shuttle(0);
+        return;
+    }
+
+    // The clock keeps running through cache misses; the last frame stays
+    // up rather than playback stalling
+    const FrameRate rate = timeline->frameRate();
+    const Ticks end = std::max<Ticks>(0, timeline->totalDuration() - Timebase::frameTicks(rate));
+    shuttlePosition += Timebase::fromSeconds(shuttleClock.nsecsElapsed() / 1e9) * shuttleSpeed;
+    shuttleClock.restart();
+
+    bool atEnd = false;
+    if (shuttlePosition <= 0) {
+        shuttlePosition = 0;
+        atEnd = shuttleSpeed < 0;
+    } else if (shuttlePosition >= end) {
+        shuttlePosition = end;
+        atEnd = shuttleSpeed > 0;
+    }
+
+    const qint64 frame = Timebase::toFrame(shuttlePosition, rate);
+    const QImage image = frameCache->frame(frame);
+    if (!image.isNull()) {
+        shuttleView->setFrame(image);
+    }
+    frameCache->prefetch(frame, shuttleSpeed);
+
+    currentTimelinePos = Timebase::toSeconds(shuttlePosition);
+    seekSlider->blockSignals(true);
+    seekSlider->setValue(static_cast<int>(currentTimelinePos * 1000.0));
+    seekSlider->blockSignals(false);
+    timeline->setPlayheadPosition(shuttlePosition);
+
+    if (atEnd) {
+        shuttle(0);
+    }
 }
 
 void MainWindow::updatePosition()
@@ -182,10 +825,17 @@ void MainWindow::updatePosition()
         return;
     }
 
+    updateFrameStats();
+
+    // The shuttle tick moves the slider and playhead itself
+    if (shuttleTimer->isActive()) {
+        return;
+    }
+
     // For EDL playback, position is continuous across all clips
     if (usingTimelinePlaylist && !timelineSegments.isEmpty()) {
         double position = 0.0;
-        if (mpv_get_property(mpv, "time-pos", MPV_FORMAT_DOUBLE, &position) >= 0) {
+        if (timelinePositionForMpv(position)) {
             currentTimelinePos = position;
             const int sliderValue = static_cast<int>(position * 1000.0);
             seekSlider->blockSignals(true);
@@ -194,7 +844,7 @@ void MainWindow::updatePosition()
             
             // Update timeline playhead position for real-time preview
             if (timeline) {
-                timeline->setPlayheadPosition(position);
+                timeline->setPlayheadPosition(Timebase::fromSeconds(position));
             }
         }
 
@@ -202,8 +852,24 @@ void MainWindow::updatePosition()
         if (mpv_get_property(mpv, "pause", MPV_FORMAT_FLAG, &paused) >= 0) {
             updatePlayButton(paused == 0);
         }
+        syncAngleViewer(paused == 0);
+
+        if (rendersWaiting && currentShuttleSpeed() == 0) {
+            onTimelineChanged();
+        }
+
+        if (paused == 0) {
+            prefetchSequenceFrames(Timebase::fromSeconds(currentTimelinePos));
+        }
+
+        // Queue the next window well before playback runs out of this one
+        if (paused == 0 && edlWindows.size() == 1
+            && edlWindows[0].end - Timebase::fromSeconds(currentTimelinePos) < kPreviewWindowLead) {
+            appendNextEdlWindow();
+        }
         return;
     }
+    angleViewer->clear();
 
     double duration = 0.0;
     if (mpv_get_property(mpv, "duration", MPV_FORMAT_DOUBLE, &duration) >= 0 && duration > 0.0) {
@@ -222,7 +888,7 @@ void MainWindow::updatePosition()
         
         // Update timeline playhead for single file playback
         if (timeline) {
-            timeline->setPlayheadPosition(position);
+            timeline->setPlayheadPosition(Timebase::fromSeconds(position));
         }
     }
 
@@ -232,8 +898,109 @@ void MainWindow::updatePosition()
     }
 }
 
+void MainWindow::prefetchSequenceFrames(Ticks playhead)
+{
+    int index = 0;
+    Ticks localPos = 0;
+    if (!segmentForTimelineTime(playhead, index, localPos)) {
+        return;
+    }
+
+    const FrameRate rate = timeline->frameRate();
+    const Ticks end = playhead + kSequenceReadAhead;
+    QStringList paths;
+    for (int i = index; i < timelineSegments.size() && timelineSegments[i].timelineStart < end; ++i) {
+        const TimelineSegment &segment = timelineSegments[i];
+        if (segment.isGap || !segment.lavfiGraph.isEmpty() || !ImageSequence::isSequence(segment.source)) {
+            continue;
+        }
+        const ImageSequence *sequence = ImageSequence::find(segment.source);
+        if (!sequence) {
+            continue;
+        }
+        const Ticks from = segment.trimStart + std::max(playhead, segment.timelineStart) - segment.timelineStart;
+        const Ticks to = segment.trimStart + std::min(end, segment.timelineStart + segment.duration) - segment.timelineStart;
+        for (qint64 frame = Timebase::toFrame(from, rate); frame < Timebase::toFrame(to, rate); ++frame) {
+            paths.append(sequence->framePath(int(frame)));
+        }
+    }
+    if (!paths.isEmpty()) {
+        sequencePrefetcher->prefetch(paths);
+    }
+}
+
+void MainWindow::syncAngleViewer(bool playing)
+{
+    const Ticks playhead = timeline->playheadPosition();
+    const int index = timeline->multicamClipAt(playhead);
+    if (index < 0) {
+        angleViewer->clear();
+        return;
+    }
+
+    const Clip &clip = timeline->clips()[index];
+    const Ticks groupTime = clip.groupTime() + playhead - clip.startTime();
+    angleViewer->setAngles(clip.angles(), clip.activeAngle(), groupTime);
+    angleViewer->syncTo(groupTime, playing);
+}
+
+void MainWindow::showTrimFrames(const QString &source, Ticks inPoint, Ticks outPoint, bool inEdge)
+{
+    // A compound clip has no one file to grab frames from
+    if (Nesting::isCompound(source)) {
+        return;
+    }
+
+    // Both frames when the drag starts, then only the edge that moves
+    const bool starting = videoStack->currentWidget() != trimPreview;
+    if (starting) {
+        if (shuttleTimer->isActive()) {
+            shuttle(0);
+        }
+        trimPreview->clear();
+        videoStack->setCurrentWidget(trimPreview);
+    }
+    trimPreview->setTimes(inPoint, outPoint);
+    if (starting || inEdge) {
+        frameGrabber->request(TrimPreview::InPoint, source, inPoint);
+    }
+    if (starting || !inEdge) {
+        frameGrabber->request(TrimPreview::OutPoint, source, outPoint);
+    }
+}
+
+void MainWindow::updateFrameStats()
+{
+    // Frames dropped by the decoder or output and frames shown late,
+    // to check that presentation keeps up while the GUI is busy
+    int64_t dropped = 0;
+    int64_t decoderDropped = 0;
+    int64_t delayed = 0;
+    if (mpv_get_property(mpv, "frame-drop-count", MPV_FORMAT_INT64, &dropped) < 0) {
+        return;
+    }
+    mpv_get_property(mpv, "decoder-frame-drop-count", MPV_FORMAT_INT64, &decoderDropped);
+    mpv_get_property(mpv, "vo-delayed-frame-count", MPV_FORMAT_INT64, &delayed);
+
+    QString message = tr("%1 | Dropped frames: %2 (decoder %3) | Delayed: %4")
+                          .arg(videoWindow ? tr("Render thread") : tr("GUI thread"))
+                          .arg(dropped)
+                          .arg(decoderDropped)
+                          .arg(delayed);
+    if (frameCache->lookups() > 0) {
+        message += tr(" | Shuttle cache: %1 / %2 MiB, %3% hits")
+                       .arg(frameCache->memoryUsed() / (1024 * 1024))
+                       .arg(frameCache->memoryBudget() / (1024 * 1024))
+                       .arg(qRound(frameCache->hitRate() * 100.0));
+    }
+    statusBar()->showMessage(message);
+}
+
 void MainWindow::beginSeek()
 {
+    if (shuttleTimer->isActive()) {
+        shuttle(0);
+    }
     userSeeking = true;
 }
 
@@ -249,11 +1016,51 @@ void MainWindow::endSeek()
     if (usingTimelinePlaylist) {
         seekToTimelineTime(position);
     } else {
+        playbackMetrics->beginSeek();
         mpv_set_property(mpv, "time-pos", MPV_FORMAT_DOUBLE, &position);
     }
     userSeeking = false;
 }
 
+void MainWindow::scrubTo(int sliderValue)
+{
+    if (!mpv) {
+        return;
+    }
+
+    // While dragging, land on keyframes so each seek decodes one frame;
+    // the exact seek happens on release
+    double position = sliderValue / 1000.0;
+    if (usingTimelinePlaylist) {
+        int index = -1;
+        Ticks localPos = 0;
+        if (segmentForTimelineTime(Timebase::fromSeconds(position), index, localPos)
+            && !timelineSegments[index].isGap && !timelineSegments[index].isTransition) {
+            const TimelineSegment &segment = timelineSegments[index];
+            if (const KeyframeIndex *keyframes = keyframeIndexer->index(segment.source, JobScheduler::Visible)) {
+                const Ticks keyframe = keyframes->nearestKeyframe(segment.trimStart + localPos) - segment.trimStart;
+                if (keyframe >= 0 && keyframe < segment.duration) {
+                    position = Timebase::toSeconds(segment.timelineStart + keyframe);
+                }
+            }
+        }
+        currentTimelinePos = position;
+
+        // Outside the loaded window the preview is reloaded around it
+        const Ticks time = Timebase::fromSeconds(position);
+        if (edlWindows.isEmpty() || time < edlWindows[0].start || time >= edlWindows[0].end) {
+            loadEdlWindow(time);
+            return;
+        }
+        position -= Timebase::toSeconds(edlWindows[0].start);
+    }
+
+    const QByteArray target = QByteArray::number(position, 'f', 6);
+    const char *cmd[] = {"seek", target.constData(), "absolute+keyframes", NULL};
+    playbackMetrics->beginSeek();
+    mpv_command(mpv, cmd);
+}
+
 void MainWindow::updatePlayButton(bool isPlaying)
 {
     if (!playPauseButton) {
@@ -270,15 +1077,34 @@ void MainWindow::onClipSelected(int index)
     if (index >= 0 && index < clips.size()) {
         const Clip &clip = clips[index];
         // Seek to the clip's start time in the EDL stream
-        seekToTimelineTime(clip.startTime());
+        seekToTimelineTime(Timebase::toSeconds(clip.startTime()));
     }
 }
 
 void MainWindow::onTimelineChanged()
 {
-    // Rebuild MPV EDL stream immediately when timeline changes
-    // This enables real-time preview of timeline edits
-    rebuildTimelineEDL(true);
+    // Rebuild the MPV EDL stream once control returns to the event loop,
+    // so the preview follows edits without rebuilding for each of a burst
+    rebuildTimer->start();
+}
+
+void MainWindow::onRenderFinished()
+{
+    // Switching to a render reloads the preview, which would stutter
+    // playback, so renders finishing mid-play wait for the next pause
+    if (currentShuttleSpeed() != 0) {
+        rendersWaiting = true;
+        return;
+    }
+    onTimelineChanged();
+}
+
+void MainWindow::flushTimelineRebuild()
+{
+    if (rebuildTimer->isActive()) {
+        rebuildTimer->stop();
+        rebuildTimelineEDL(true);
+    }
 }
 
 void MainWindow::rebuildTimelinePlaylist(bool preservePosition)
@@ -291,44 +1117,7 @@ void MainWindow::rebuildTimelinePlaylist(bool preservePosition)
     int paused = 0;
     mpv_get_property(mpv, "pause", MPV_FORMAT_FLAG, &paused);
 
-    timelineSegments.clear();
-    QVector<Clip> sortedClips = timeline->clips();
-    std::sort(sortedClips.begin(), sortedClips.end(), [](const Clip &a, const Clip &b) {
-        return a.startTime() < b.startTime();
-    });
-
-    double cursor = 0.0;
-    for (const Clip &clip : sortedClips) {
-        if (clip.duration() <= 0.0) {
-            continue;
-        }
-
-        double start = clip.startTime();
-        if (start < 0.0) {
-            start = 0.0;
-        }
-
-        if (start > cursor) {
-            TimelineSegment gapSegment;
-            gapSegment.timelineStart = cursor;
-            gapSegment.duration = start - cursor;
-            gapSegment.trimStart = 0.0;
-            gapSegment.isGap = true;
-            gapSegment.source = QString("lavfi:color=c=black:s=1280x720:r=30:d=%1")
-                                   .arg(gapSegment.duration, 0, 'f', 3);
-            timelineSegments.append(gapSegment);
-            cursor = start;
-        }
-
-        TimelineSegment segment;
-        segment.timelineStart = start;
-        segment.duration = clip.duration();
-        segment.trimStart = clip.trimStart();
-        segment.isGap = false;
-        segment.source = clip.filePath();
-        timelineSegments.append(segment);
-        cursor = std::max(cursor, start + clip.duration());
-    }
+    buildTimelineSegments();
 
     if (timelineSegments.isEmpty()) {
         const char *cmd[] = {"playlist-clear", NULL};
@@ -347,15 +1136,17 @@ void MainWindow::rebuildTimelinePlaylist(bool preservePosition)
 
     bool first = true;
     for (const TimelineSegment &segment : timelineSegments) {
-        QByteArray sourceBytes = QFile::encodeName(segment.source);
+        // Gaps are EDL parts of the filler
+        const QString source = segment.isGap ? "edl://" + segment.source : ImageSequence::mpvSourceFor(segment.source);
+        QByteArray sourceBytes = QFile::encodeName(source);
         const char *mode = first ? "replace" : "append";
         QByteArray startOption;
         QByteArray endOption;
         if (!segment.isGap) {
-            double clipStart = segment.trimStart;
-            double clipEnd = segment.trimStart + segment.duration;
-            startOption = QByteArray("start=") + QByteArray::number(clipStart, 'f', 3);
-            endOption = QByteArray("end=") + QByteArray::number(clipEnd, 'f', 3);
+            Ticks clipStart = segment.trimStart;
+            Ticks clipEnd = segment.trimStart + segment.duration;
+            startOption = QByteArray("start=") + Timebase::toEdlSeconds(clipStart).toUtf8();
+            endOption = QByteArray("end=") + Timebase::toEdlSeconds(clipEnd).toUtf8();
         }
 
         if (!segment.isGap) {
@@ -369,7 +1160,7 @@ void MainWindow::rebuildTimelinePlaylist(bool preservePosition)
     }
 
     usingTimelinePlaylist = true;
-    mediaDuration = timeline->totalDuration();
+    mediaDuration = Timebase::toSeconds(timeline->totalDuration());
     seekSlider->setRange(0, static_cast<int>(mediaDuration * 1000.0));
     playPauseButton->setEnabled(true);
     seekSlider->setEnabled(true);
@@ -381,70 +1172,35 @@ void MainWindow::rebuildTimelinePlaylist(bool preservePosition)
     mpv_set_property(mpv, "pause", MPV_FORMAT_FLAG, &paused);
 }
 
-QString MainWindow::generateEDLString() const
+void MainWindow::buildTimelineSegments()
 {
-    // MPV EDL format: edl://[clip1];[clip2];[clip3]...
-    // Each clip: [file_path,start,length] or [file_path]
-    // Example: edl://video1.mp4,10,5;video2.mp4,0,3
-    
-    if (!timeline) {
-        return QString();
-    }
-    
-    QVector<Clip> sortedClips = timeline->clips();
-    std::sort(sortedClips.begin(), sortedClips.end(), [](const Clip &a, const Clip &b) {
-        return a.startTime() < b.startTime();
-    });
-    
-    QStringList edlParts;
-    double cursor = 0.0;
-    
-    for (const Clip &clip : sortedClips) {
-        if (clip.duration() <= 0.0) {
-            continue;
-        }
-        
-        double start = clip.startTime();
-        if (start < 0.0) {
-            start = 0.0;
-        }
-        
-        // Add black gap if needed
-        if (start > cursor) {
-            double gapDuration = start - cursor;
-            QString gapClip = QString("lavfi:color=c=black:s=1280x720:r=30:d=%1")
-                                .arg(gapDuration, 0, 'f', 3);
-            edlParts.append(gapClip);
-            cursor = start;
-        }
-        
-        // Add the actual clip with trimming
-        QString filePath = clip.filePath();
-        double trimStart = clip.trimStart();
-        double duration = clip.duration();
-        
-        // Escape special characters in file path
-        filePath.replace(";", "\\;");
-        filePath.replace(",", "\\,");
-        
-        QString clipPart;
-        if (trimStart > 0.0 || duration > 0.0) {
-            clipPart = QString("%1,%2,%3")
-                        .arg(filePath)
-                        .arg(trimStart, 0, 'f', 3)
-                        .arg(duration, 0, 'f', 3);
-        } else {
-            clipPart = filePath;
-        }
-        
-        edlParts.append(clipPart);
-        cursor = std::max(cursor, start + duration);
+    timelineSegments = segmentBuilder->build();
+    audioMixer->setClips(timeline->audioClips(), timeline->totalDuration());
+
+    QVector<FrameCache::Segment> cacheSegments;
+    for (const TimelineSegment &segment : timelineSegments) {
+        const bool isLavfi = !segment.lavfiGraph.isEmpty();
+        cacheSegments.append({isLavfi ? segment.lavfiGraph : segment.source, segment.timelineStart,
+                              segment.duration, segment.trimStart, segment.isGap, isLavfi});
     }
-    
+    frameCache->setSegments(cacheSegments, timeline->frameRate());
+}
+
+QString MainWindow::generateEDLString(int first, int last) const
+{
+    QStringList edlParts = segmentBuilder->edlParts(timelineSegments, first, last);
     if (edlParts.isEmpty()) {
         return QString();
     }
     
+    // The audio tracks' mix for the same span, as a second stream
+    if (!audioMixer->isEmpty()) {
+        const Ticks start = timelineSegments[first].timelineStart;
+        const TimelineSegment &end = timelineSegments[std::min<int>(last, timelineSegments.size() - 1)];
+        edlParts.append("!new_stream");
+        edlParts.append(audioMixer->edlPart(start, end.timelineStart + end.duration - start));
+    }
+    
     return "edl://" + edlParts.join(";");
 }
 
@@ -459,44 +1215,7 @@ void MainWindow::rebuildTimelineEDL(bool preservePosition)
     mpv_get_property(mpv, "pause", MPV_FORMAT_FLAG, &paused);
     
     // Build timeline segments for position tracking
-    timelineSegments.clear();
-    QVector<Clip> sortedClips = timeline->clips();
-    std::sort(sortedClips.begin(), sortedClips.end(), [](const Clip &a, const Clip &b) {
-        return a.startTime() < b.startTime();
-    });
-    
-    double cursor = 0.0;
-    for (const Clip &clip : sortedClips) {
-        if (clip.duration() <= 0.0) {
-            continue;
-        }
-        
-        double start = clip.startTime();
-        if (start < 0.0) {
-            start = 0.0;
-        }
-        
-        if (start > cursor) {
-            TimelineSegment gapSegment;
-            gapSegment.timelineStart = cursor;
-            gapSegment.duration = start - cursor;
-            gapSegment.trimStart = 0.0;
-            gapSegment.isGap = true;
-            gapSegment.source = QString("lavfi:color=c=black:s=1280x720:r=30:d=%1")
-                                   .arg(gapSegment.duration, 0, 'f', 3);
-            timelineSegments.append(gapSegment);
-            cursor = start;
-        }
-        
-        TimelineSegment segment;
-        segment.timelineStart = start;
-        segment.duration = clip.duration();
-        segment.trimStart = clip.trimStart();
-        segment.isGap = false;
-        segment.source = clip.filePath();
-        timelineSegments.append(segment);
-        cursor = std::max(cursor, start + clip.duration());
-    }
+    buildTimelineSegments();
     
     if (timelineSegments.isEmpty()) {
         const char *cmd[] = {"stop", NULL};
@@ -510,60 +1229,154 @@ void MainWindow::rebuildTimelineEDL(bool preservePosition)
         return;
     }
     
-    // Generate EDL string
-    QString edlString = generateEDLString();
-    if (edlString.isEmpty()) {
-        return;
-    }
-    
-    qDebug() << "EDL String:" << edlString;
-    
-    // Load the EDL as a single continuous stream
-    QByteArray edlBytes = edlString.toUtf8();
-    const char *cmd[] = {"loadfile", edlBytes.constData(), NULL};
-    mpv_command(mpv, cmd);
-    
     usingTimelinePlaylist = true;
-    mediaDuration = timeline->totalDuration();
+    mediaDuration = Timebase::toSeconds(timeline->totalDuration());
     seekSlider->setRange(0, static_cast<int>(mediaDuration * 1000.0));
     playPauseButton->setEnabled(true);
     seekSlider->setEnabled(true);
     
+    // Load the window of the EDL around the playhead as one continuous
+    // stream
+    double seekPos = 0.0;
     if (preservePosition) {
-        // For EDL, we can seek directly to timeline position
-        double seekPos = previousTimelinePos;
-        if (seekPos < 0.0) seekPos = 0.0;
-        if (seekPos > mediaDuration) seekPos = mediaDuration;
-        
-        mpv_set_property(mpv, "time-pos", MPV_FORMAT_DOUBLE, &seekPos);
-        currentTimelinePos = seekPos;
+        seekPos = std::min(std::max(previousTimelinePos, 0.0), mediaDuration);
+    }
+    // Image sequences play at the timeline's rate; mpv's EDL has no rate
+    // per part
+    const FrameRate rate = timeline->frameRate();
+    double sequenceFps = double(rate.numerator) / rate.denominator;
+    mpv_set_property(mpv, "mf-fps", MPV_FORMAT_DOUBLE, &sequenceFps);
+    // Gaps, transitions and conformed sources all carry audio at the
+    // project's rate, so the audio output stays open across cuts
+    int64_t sampleRate = timeline->settings().sampleRate;
+    mpv_set_property(mpv, "audio-samplerate", MPV_FORMAT_INT64, &sampleRate);
+    frameGrabber->setFrameRate(rate);
+
+    // With audio tracks the EDL's second audio track is their mix, played
+    // over the clips' own audio
+    if (mixingAudio != !audioMixer->isEmpty()) {
+        mixingAudio = !audioMixer->isEmpty();
+        const char *graph = mixingAudio ? "[aid1] [aid2] amix=inputs=2:duration=first:normalize=0 [ao]" : "";
+        mpv_set_property_string(mpv, "lavfi-complex", graph);
     }
     
+    playbackMetrics->beginRebuild();
+    loadEdlWindow(Timebase::fromSeconds(seekPos));
+    
     mpv_set_property(mpv, "pause", MPV_FORMAT_FLAG, &paused);
 }
 
+MainWindow::EdlWindow MainWindow::edlWindowFrom(int first, Ticks end) const
+{
+    // Whole segments, up to the one containing end
+    EdlWindow window;
+    window.first = first;
+    window.last = timelineSegments.size() - 1;
+    if (edlWindowSpan > 0) {
+        auto it = std::upper_bound(timelineSegments.begin() + first, timelineSegments.end(), end,
+                                   [](Ticks time, const TimelineSegment &segment) {
+                                       return time < segment.timelineStart;
+                                   });
+        window.last = std::max<int>(first, int(it - timelineSegments.begin()) - 1);
+    }
+    window.start = timelineSegments[window.first].timelineStart;
+    window.end = timelineSegments[window.last].timelineStart + timelineSegments[window.last].duration;
+    return window;
+}
+
+void MainWindow::loadEdlWindow(Ticks center)
+{
+    if (timelineSegments.isEmpty()) {
+        return;
+    }
+
+    int first = 0;
+    if (edlWindowSpan > 0) {
+        const Ticks from = center - edlWindowSpan / 2;
+        auto it = std::upper_bound(timelineSegments.begin(), timelineSegments.end(), from,
+                                   [](Ticks time, const TimelineSegment &segment) {
+                                       return time < segment.timelineStart;
+                                   });
+        first = std::max<int>(0, int(it - timelineSegments.begin()) - 1);
+    }
+    const EdlWindow window = edlWindowFrom(first, center + edlWindowSpan / 2);
+
+    const QString edlString = generateEDLString(window.first, window.last);
+
+    // The position goes with the load; setting time-pos after loadfile
+    // would still apply to the file being replaced
+    QByteArray edlBytes = edlString.toUtf8();
+    QByteArray startOption = QByteArray("start=") + Timebase::toEdlSeconds(center - window.start).toUtf8();
+    const char *cmd[] = {"loadfile", edlBytes.constData(), "replace", startOption.constData(), NULL};
+    mpv_command(mpv, cmd);
+    edlWindows.clear();
+    edlWindows.append(window);
+
+    currentTimelinePos = Timebase::toSeconds(center);
+}
+
+void MainWindow::appendNextEdlWindow()
+{
+    const EdlWindow &current = edlWindows.last();
+    if (current.last + 1 >= timelineSegments.size()) {
+        return;
+    }
+
+    // Starts where the current window ends, so mpv plays straight on
+    const int first = current.last + 1;
+    const EdlWindow window = edlWindowFrom(first, timelineSegments[first].timelineStart + edlWindowSpan);
+    QByteArray edlBytes = generateEDLString(window.first, window.last).toUtf8();
+    const char *cmd[] = {"loadfile", edlBytes.constData(), "append", NULL};
+    mpv_command(mpv, cmd);
+    edlWindows.append(window);
+}
+
+void MainWindow::dropPlayedEdlWindows()
+{
+    int64_t playlistPos = 0;
+    if (mpv_get_property(mpv, "playlist-pos", MPV_FORMAT_INT64, &playlistPos) < 0) {
+        return;
+    }
+    for (; playlistPos > 0 && edlWindows.size() > 1; --playlistPos) {
+        const char *cmd[] = {"playlist-remove", "0", NULL};
+        mpv_command(mpv, cmd);
+        edlWindows.removeFirst();
+    }
+}
+
 void MainWindow::seekToTimelineTime(double timelineTime)
 {
     if (!mpv) {
         return;
     }
+    flushTimelineRebuild();
 
     if (timelineTime < 0.0) {
         timelineTime = 0.0;
     }
 
-    double totalDuration = timeline ? timeline->totalDuration() : mediaDuration;
+    double totalDuration = timeline ? Timebase::toSeconds(timeline->totalDuration()) : mediaDuration;
     if (totalDuration > 0.0 && timelineTime > totalDuration) {
         timelineTime = totalDuration;
     }
 
-    // For EDL playback, we can seek directly to the timeline position
-    // since EDL creates a continuous stream
-    mpv_set_property(mpv, "time-pos", MPV_FORMAT_DOUBLE, &timelineTime);
+    // Inside the loaded window the EDL is one continuous stream and the
+    // seek is direct; anywhere else the window is reloaded around it
+    playbackMetrics->beginSeek();
+    const Ticks time = Timebase::fromSeconds(timelineTime);
+    if (usingTimelinePlaylist && (edlWindows.isEmpty() || time < edlWindows[0].start || time >= edlWindows[0].end)) {
+        loadEdlWindow(time);
+        return;
+    }
+    double position = timelineTime;
+    if (usingTimelinePlaylist) {
+        position -= Timebase::toSeconds(edlWindows[0].start);
+    }
+    mpv_set_property(mpv, "time-pos", MPV_FORMAT_DOUBLE, &position);
     currentTimelinePos = timelineTime;
 }
 
-bool MainWindow::segmentForTimelineTime(double timelineTime, int &index, double &localPos) const
+bool MainWindow::segmentForTimelineTime(Ticks timelineTime, int &index, Ticks &localPos) const
 {
     if (timelineSegments.isEmpty()) {
         return false;
@@ -580,7 +1393,7 @@ bool MainWindow::segmentForTimelineTime(double timelineTime, int &index, double
 
     const TimelineSegment &lastSegment = timelineSegments.last();
     index = timelineSegments.size() - 1;
-    localPos = std::max(0.0, lastSegment.duration - 0.01);
+    localPos = std::max<Ticks>(0, lastSegment.duration - Timebase::kTicksPerSecond / 100);
     return true;
 }
 
@@ -600,11 +1413,11 @@ bool MainWindow::timelinePositionForMpv(double &timelinePos) const
         return false;
     }
 
-    if (playlistPos < 0 || playlistPos >= timelineSegments.size()) {
+    // Each playlist entry is one window of the EDL
+    if (playlistPos < 0 || playlistPos >= edlWindows.size()) {
         return false;
     }
 
-    const TimelineSegment &segment = timelineSegments.at(static_cast<int>(playlistPos));
-    timelinePos = segment.timelineStart + position;
+    timelinePos = Timebase::toSeconds(edlWindows.at(static_cast<int>(playlistPos)).start) + position;
     return true;
 }
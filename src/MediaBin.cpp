@@ -0,0 +1,291 @@
+#include "MediaBin.h"
+#include "MediaProber.h"
+#include <QDirIterator>
+#include <QDoubleSpinBox>
+#include <QElapsedTimer>
+#include <QFileDialog>
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QLabel>
+#include <QLineEdit>
+#include <QMimeData>
+#include <QPushButton>
+#include <QSpinBox>
+#include <QTableView>
+#include <QTimer>
+#include <QVBoxLayout>
+#include <algorithm>
+
+namespace {
+enum Column {
+    NameColumn,
+    DurationColumn,
+    ResolutionColumn,
+    CodecColumn,
+    PathColumn,
+    ColumnCount
+};
+
+const QStringList kVideoPatterns = {
+    "*.mp4", "*.mkv", "*.avi", "*.mov", "*.webm", "*.mpg", "*.mpeg", "*.m4v", "*.mxf"
+};
+}
+
+MediaBinModel::MediaBinModel(const MediaIndex *index, QObject *parent)
+    : QAbstractTableModel(parent)
+    , m_index(index)
+{
+}
+
+void MediaBinModel::setResults(const QVector<int> &ids)
+{
+    beginResetModel();
+    m_ids = ids;
+    endResetModel();
+}
+
+int MediaBinModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : m_ids.size();
+}
+
+int MediaBinModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : ColumnCount;
+}
+
+QVariant MediaBinModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_ids.size()) {
+        return QVariant();
+    }
+
+    const MediaAsset &asset = m_index->asset(m_ids[index.row()]);
+    if (role == Qt::ToolTipRole) {
+        return asset.path;
+    }
+    if (role != Qt::DisplayRole) {
+        return QVariant();
+    }
+
+    switch (index.column()) {
+    case NameColumn:
+        return asset.name;
+    case DurationColumn:
+        return QString::number(Timebase::toSeconds(asset.duration), 'f', 2) + "s";
+    case ResolutionColumn:
+        return asset.width > 0 ? QString("%1x%2").arg(asset.width).arg(asset.height) : QString();
+    case CodecColumn:
+        return asset.codec;
+    case PathColumn:
+        return asset.path;
+    }
+    return QVariant();
+}
+
+QVariant MediaBinModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole) {
+        return QVariant();
+    }
+
+    switch (section) {
+    case NameColumn:
+        return QString("Name");
+    case DurationColumn:
+        return QString("Duration");
+    case ResolutionColumn:
+        return QString("Resolution");
+    case CodecColumn:
+        return QString("Codec");
+    case PathColumn:
+        return QString("Path");
+    }
+    return QVariant();
+}
+
+Qt::ItemFlags MediaBinModel::flags(const QModelIndex &index) const
+{
+    if (!index.isValid()) {
+        return Qt::NoItemFlags;
+    }
+    return Qt::ItemIsEnabled | Qt::ItemIsSelectable | Qt::ItemIsDragEnabled;
+}
+
+QStringList MediaBinModel::mimeTypes() const
+{
+    return QStringList() << kMediaMimeType;
+}
+
+QMimeData *MediaBinModel::mimeData(const QModelIndexList &indexes) const
+{
+    // One entry per selected row, in row order
+    QVector<int> rows;
+    for (const QModelIndex &index : indexes) {
+        if (index.isValid() && !rows.contains(index.row())) {
+            rows.append(index.row());
+        }
+    }
+    std::sort(rows.begin(), rows.end());
+
+    QByteArray payload;
+    for (int row : rows) {
+        const MediaAsset &asset = m_index->asset(m_ids[row]);
+        payload += asset.path.toUtf8() + '\t' + QByteArray::number(asset.duration) + '\n';
+    }
+
+    QMimeData *mimeData = new QMimeData();
+    mimeData->setData(kMediaMimeType, payload);
+    return mimeData;
+}
+
+MediaBin::MediaBin(JobScheduler *jobs, QWidget *parent)
+    : QWidget(parent)
+    , m_prober(new MediaProber(jobs, this))
+    , m_model(new MediaBinModel(&m_index, this))
+    , m_lastSearchMs(0.0)
+{
+    setupUI();
+
+    m_refreshTimer = new QTimer(this);
+    m_refreshTimer->setSingleShot(true);
+    m_refreshTimer->setInterval(150);
+    connect(m_refreshTimer, &QTimer::timeout, this, &MediaBin::refreshResults);
+
+    connect(m_prober, &MediaProber::probed, this, &MediaBin::onProbed);
+    connect(m_prober, &MediaProber::failed, this, [this]() {
+        m_refreshTimer->start();
+    });
+}
+
+void MediaBin::setupUI()
+{
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->setContentsMargins(4, 4, 4, 4);
+
+    QHBoxLayout *importLayout = new QHBoxLayout();
+    QPushButton *importButton = new QPushButton("Import...", this);
+    QPushButton *importFolderButton = new QPushButton("Import Folder...", this);
+    importLayout->addWidget(importButton);
+    importLayout->addWidget(importFolderButton);
+    importLayout->addStretch();
+    layout->addLayout(importLayout);
+    connect(importButton, &QPushButton::clicked, this, &MediaBin::onImportClicked);
+    connect(importFolderButton, &QPushButton::clicked, this, &MediaBin::onImportFolderClicked);
+
+    m_searchEdit = new QLineEdit(this);
+    m_searchEdit->setPlaceholderText("Search name, path, codec, tags");
+    m_searchEdit->setClearButtonEnabled(true);
+    layout->addWidget(m_searchEdit);
+    connect(m_searchEdit, &QLineEdit::textChanged, this, &MediaBin::refreshResults);
+
+    // Range filters, 0 meaning unbounded
+    QHBoxLayout *filterLayout = new QHBoxLayout();
+    m_minDuration = new QDoubleSpinBox(this);
+    m_maxDuration = new QDoubleSpinBox(this);
+    m_minHeight = new QSpinBox(this);
+    m_minDuration->setRange(0.0, 86400.0);
+    m_maxDuration->setRange(0.0, 86400.0);
+    m_minHeight->setRange(0, 8640);
+    m_minDuration->setSuffix(" s");
+    m_maxDuration->setSuffix(" s");
+    m_minHeight->setSuffix(" p");
+    filterLayout->addWidget(new QLabel("Duration", this));
+    filterLayout->addWidget(m_minDuration);
+    filterLayout->addWidget(new QLabel("to", this));
+    filterLayout->addWidget(m_maxDuration);
+    filterLayout->addWidget(new QLabel("Min height", this));
+    filterLayout->addWidget(m_minHeight);
+    layout->addLayout(filterLayout);
+    connect(m_minDuration, &QDoubleSpinBox::valueChanged, this, &MediaBin::refreshResults);
+    connect(m_maxDuration, &QDoubleSpinBox::valueChanged, this, &MediaBin::refreshResults);
+    connect(m_minHeight, &QSpinBox::valueChanged, this, &MediaBin::refreshResults);
+
+    QTableView *view = new QTableView(this);
+    view->setModel(m_model);
+    view->setSelectionBehavior(QAbstractItemView::SelectRows);
+    view->setSelectionMode(QAbstractItemView::ExtendedSelection);
+    view->setDragEnabled(true);
+    view->setDragDropMode(QAbstractItemView::DragOnly);
+    view->verticalHeader()->hide();
+    view->horizontalHeader()->setStretchLastSection(true);
+    layout->addWidget(view, 1);
+
+    m_statusLabel = new QLabel(this);
+    layout->addWidget(m_statusLabel);
+    updateStatus(0);
+}
+
+void MediaBin::importFiles(const QStringList &paths)
+{
+    // The prober skips those it is already probing
+    QStringList pending;
+    for (const QString &path : paths) {
+        if (!m_index.contains(path)) {
+            pending.append(path);
+        }
+    }
+    m_prober->enqueue(pending);
+    updateStatus(m_model->rowCount());
+}
+
+void MediaBin::onImportClicked()
+{
+    const QStringList fileNames = QFileDialog::getOpenFileNames(
+        this,
+        "Import Media",
+        QString(),
+        "Video Files (" + kVideoPatterns.join(' ') + ");;All Files (*)");
+    importFiles(fileNames);
+}
+
+void MediaBin::onImportFolderClicked()
+{
+    const QString folder = QFileDialog::getExistingDirectory(this, "Import Folder");
+    if (folder.isEmpty()) {
+        return;
+    }
+
+    QStringList paths;
+    QDirIterator it(folder, kVideoPatterns, QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        paths.append(it.next());
+    }
+    importFiles(paths);
+}
+
+void MediaBin::onProbed(const MediaAsset &asset)
+{
+    m_index.addAsset(asset);
+    if (!m_refreshTimer->isActive()) {
+        m_refreshTimer->start();
+    }
+}
+
+void MediaBin::refreshResults()
+{
+    MediaFilter filter;
+    filter.minDuration = Timebase::fromSeconds(m_minDuration->value());
+    filter.maxDuration = Timebase::fromSeconds(m_maxDuration->value());
+    filter.minHeight = m_minHeight->value();
+
+    QElapsedTimer timer;
+    timer.start();
+    const QVector<int> ids = m_index.search(m_searchEdit->text(), filter);
+    m_lastSearchMs = timer.nsecsElapsed() / 1000000.0;
+
+    m_model->setResults(ids);
+    updateStatus(ids.size());
+}
+
+void MediaBin::updateStatus(int shown)
+{
+    QString status = QString("%1 of %2 assets, search %3 ms")
+                         .arg(shown)
+                         .arg(m_index.size())
+                         .arg(m_lastSearchMs, 0, 'f', 2);
+    if (m_prober->pendingCount() > 0) {
+        status += QString(", probing %1").arg(m_prober->pendingCount());
+    }
+    m_statusLabel->setText(status);
+}
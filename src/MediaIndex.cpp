@@ -0,0 +1,190 @@
+#include "MediaIndex.h"
+#include <algorithm>
+#include <iterator>
+
+namespace {
+quint64 trigramKey(const QString &text, int pos)
+{
+    return (static_cast<quint64>(text.at(pos).unicode()) << 32)
+         | (static_cast<quint64>(text.at(pos + 1).unicode()) << 16)
+         | static_cast<quint64>(text.at(pos + 2).unicode());
+}
+
+QVector<int> intersectSorted(const QVector<int> &a, const QVector<int> &b)
+{
+    QVector<int> result;
+    std::set_intersection(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(result));
+    return result;
+}
+}
+
+int MediaIndex::addAsset(const MediaAsset &asset)
+{
+    auto existing = m_idsByPath.constFind(asset.path);
+    if (existing != m_idsByPath.constEnd()) {
+        return existing.value();
+    }
+
+    const int id = m_assets.size();
+    m_assets.append(asset);
+    m_idsByPath.insert(asset.path, id);
+
+    // Path separators, dots and underscores split the path into tokens
+    QString text = asset.name + ' ' + asset.path + ' ' + asset.codec;
+    for (QChar &c : text) {
+        if (c == '/' || c == '\\' || c == '_' || c == '.' || c == '-') {
+            c = ' ';
+        }
+    }
+    text = text.toLower();
+    m_searchText.append(text);
+    indexText(id, text);
+
+    auto pos = std::upper_bound(m_byDuration.begin(), m_byDuration.end(), qMakePair(asset.duration, id));
+    m_byDuration.insert(pos, qMakePair(asset.duration, id));
+
+    if (!asset.tags.isEmpty()) {
+        QStringList tags = asset.tags;
+        m_assets[id].tags.clear();
+        addTags(id, tags);
+    }
+    return id;
+}
+
+void MediaIndex::addTags(int id, const QStringList &tags)
+{
+    if (id < 0 || id >= m_assets.size() || tags.isEmpty()) {
+        return;
+    }
+
+    m_assets[id].tags.append(tags);
+    const QString text = ' ' + tags.join(' ').toLower();
+    m_searchText[id] += text;
+    indexText(id, text);
+}
+
+void MediaIndex::indexText(int id, const QString &text)
+{
+    QVector<quint64> keys;
+    keys.reserve(text.size());
+    for (int i = 0; i + 2 < text.size(); ++i) {
+        keys.append(trigramKey(text, i));
+    }
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+    for (quint64 key : keys) {
+        QVector<int> &ids = m_trigrams[key];
+        // Ids are usually appended in order; tags added later need an insert
+        if (ids.isEmpty() || ids.last() < id) {
+            ids.append(id);
+        } else {
+            auto pos = std::lower_bound(ids.begin(), ids.end(), id);
+            if (pos == ids.end() || *pos != id) {
+                ids.insert(pos, id);
+            }
+        }
+    }
+}
+
+QVector<int> MediaIndex::search(const QString &query, const MediaFilter &filter) const
+{
+    const QStringList terms = query.toLower().split(' ', Qt::SkipEmptyParts);
+
+    // Narrow with the trigram index first, shortest posting lists first
+    QVector<int> candidates;
+    bool narrowed = false;
+    for (const QString &term : terms) {
+        if (term.size() < 3) {
+            continue;
+        }
+        QVector<int> ids = idsForTerm(term);
+        candidates = narrowed ? intersectSorted(candidates, ids) : ids;
+        narrowed = true;
+        if (candidates.isEmpty()) {
+            return candidates;
+        }
+    }
+
+    if (!narrowed) {
+        if (filter.minDuration > 0 || filter.maxDuration > 0) {
+            candidates = idsInDurationRange(filter);
+        } else {
+            candidates.resize(m_assets.size());
+            for (int i = 0; i < candidates.size(); ++i) {
+                candidates[i] = i;
+            }
+        }
+    }
+
+    // Trigrams can match out of order, so confirm each candidate
+    QVector<int> results;
+    results.reserve(candidates.size());
+    for (int id : candidates) {
+        if (matches(id, terms, filter)) {
+            results.append(id);
+        }
+    }
+    return results;
+}
+
+QVector<int> MediaIndex::idsForTerm(const QString &term) const
+{
+    QVector<const QVector<int> *> lists;
+    for (int i = 0; i + 2 < term.size(); ++i) {
+        auto it = m_trigrams.constFind(trigramKey(term, i));
+        if (it == m_trigrams.constEnd()) {
+            return QVector<int>();
+        }
+        lists.append(&it.value());
+    }
+    std::sort(lists.begin(), lists.end(), [](const QVector<int> *a, const QVector<int> *b) {
+        return a->size() < b->size();
+    });
+
+    QVector<int> ids = *lists.first();
+    for (int i = 1; i < lists.size() && !ids.isEmpty(); ++i) {
+        ids = intersectSorted(ids, *lists[i]);
+    }
+    return ids;
+}
+
+QVector<int> MediaIndex::idsInDurationRange(const MediaFilter &filter) const
+{
+    auto begin = std::lower_bound(m_byDuration.begin(), m_byDuration.end(),
+                                  qMakePair(filter.minDuration, -1));
+    auto end = m_byDuration.end();
+    if (filter.maxDuration > 0) {
+        end = std::upper_bound(begin, m_byDuration.end(), qMakePair(filter.maxDuration, int(m_assets.size())));
+    }
+
+    QVector<int> ids;
+    ids.reserve(static_cast<int>(end - begin));
+    for (auto it = begin; it != end; ++it) {
+        ids.append(it->second);
+    }
+    std::sort(ids.begin(), ids.end());
+    return ids;
+}
+
+bool MediaIndex::matches(int id, const QStringList &terms, const MediaFilter &filter) const
+{
+    const MediaAsset &asset = m_assets[id];
+    if (asset.duration < filter.minDuration) {
+        return false;
+    }
+    if (filter.maxDuration > 0 && asset.duration > filter.maxDuration) {
+        return false;
+    }
+    if (asset.height < filter.minHeight) {
+        return false;
+    }
+
+    const QString &text = m_searchText[id];
+    for (const QString &term : terms) {
+        if (!text.contains(term)) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,74 @@
+#include "MediaProber.h"
+#include "JobScheduler.h"
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+namespace {
+// Parsed on the worker; an invalid variant for a failed probe
+QVariant probe(JobScheduler *jobs, const QString &path, const CancelToken &token)
+{
+    QStringList arguments;
+    arguments << "-v" << "error"
+              << "-select_streams" << "v:0"
+              << "-show_entries" << "format=duration:stream=codec_name,width,height"
+              << "-of" << "json"
+              << path;
+    QByteArray output;
+    if (!jobs->runProcess("ffprobe", arguments, token, &output)) {
+        return QVariant();
+    }
+    const QJsonObject root = QJsonDocument::fromJson(output).object();
+    if (!root.contains("format")) {
+        return QVariant();
+    }
+
+    const QJsonArray streams = root.value("streams").toArray();
+    const QJsonObject stream = streams.isEmpty() ? QJsonObject() : streams.at(0).toObject();
+    MediaAsset asset;
+    asset.path = path;
+    asset.name = QFileInfo(path).fileName();
+    asset.duration = Timebase::fromSeconds(root.value("format").toObject().value("duration").toString().toDouble());
+    asset.width = stream.value("width").toInt();
+    asset.height = stream.value("height").toInt();
+    asset.codec = stream.value("codec_name").toString();
+    return QVariant::fromValue(asset);
+}
+}
+
+MediaProber::MediaProber(JobScheduler *jobs, QObject *parent)
+    : QObject(parent)
+    , m_jobs(jobs)
+{
+}
+
+MediaProber::~MediaProber()
+{
+    m_token.cancel();
+}
+
+void MediaProber::enqueue(const QStringList &paths)
+{
+    // Probes fill in the bin as they finish; the scheduler caps how many
+    // ffprobes run at once
+    for (const QString &path : paths) {
+        if (m_pending.contains(path)) {
+            continue;
+        }
+        m_pending.insert(path);
+        JobScheduler *jobs = m_jobs;
+        const CancelToken token = m_token;
+        m_jobs->submit(JobScheduler::Visible,
+                       [jobs, path, token](const JobScheduler::Context &) { return probe(jobs, path, token); },
+                       [this, path](const QVariant &result) {
+                           m_pending.remove(path);
+                           if (result.isValid()) {
+                               emit probed(result.value<MediaAsset>());
+                           } else {
+                               emit failed(path);
+                           }
+                       },
+                       QVector<JobScheduler::JobId>(), m_token);
+    }
+}
@@ -0,0 +1,233 @@
+#include "MemoryBudget.h"
+#include <QTimer>
+#include <mpv/client.h>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+const int kPollInterval = 1000;
+
+// Caches at or over their limit are left alone unless it moves this much,
+// so a cache near the line isn't cleared and refilled every second
+const qint64 kMinChange = 4 * 1024 * 1024;
+
+// Limits cut under pressure come back only once usage is this far below
+// the ceiling, so the caches don't refill straight back over it
+const int kRestorePercent = 80;
+}
+
+MemoryBudget::MemoryBudget(QObject *parent)
+    : QObject(parent)
+    , m_timer(new QTimer(this))
+    , m_ceiling(kDefaultCeiling)
+    , m_peak(0)
+    , m_pressureEvents(0)
+    , m_nextId(0)
+    , m_relieved(false)
+{
+    m_timer->setInterval(kPollInterval);
+    connect(m_timer, &QTimer::timeout, this, &MemoryBudget::poll);
+    m_timer->start();
+}
+
+int MemoryBudget::add(const QString &name, Priority priority, qint64 wanted, qint64 minimum, Usage usage,
+                      Resize resize)
+{
+    Entry entry;
+    entry.id = m_nextId++;
+    entry.holder = {name, priority, wanted, std::min(minimum, wanted), resize ? 0 : -1, 0};
+    entry.usage = std::move(usage);
+    entry.resize = std::move(resize);
+    m_entries.append(entry);
+    rebalance();
+    return entry.id;
+}
+
+void MemoryBudget::remove(int id)
+{
+    for (int i = 0; i < m_entries.size(); ++i) {
+        if (m_entries[i].id == id) {
+            m_entries.removeAt(i);
+            rebalance();
+            return;
+        }
+    }
+}
+
+void MemoryBudget::setCeiling(qint64 bytes)
+{
+    if (bytes <= 0 || bytes == m_ceiling) {
+        return;
+    }
+    m_ceiling = bytes;
+    m_relieved = false;
+    rebalance();
+    emit updated();
+}
+
+QVector<MemoryBudget::Holder> MemoryBudget::holders() const
+{
+    QVector<Holder> holders;
+    for (const Entry &entry : m_entries) {
+        holders.append(entry.holder);
+    }
+    return holders;
+}
+
+qint64 MemoryBudget::used() const
+{
+    qint64 total = 0;
+    for (const Entry &entry : m_entries) {
+        total += entry.holder.bytes;
+    }
+    return total;
+}
+
+void MemoryBudget::rebalance(bool allowGrowth)
+{
+    // What the fixed holders already have is spent, then every cache gets
+    // its minimum, then the rest goes highest priority first
+    qint64 available = m_ceiling;
+    for (Entry &entry : m_entries) {
+        if (!entry.resize) {
+            entry.holder.bytes = entry.usage ? std::max<qint64>(0, entry.usage()) : 0;
+            available -= entry.holder.bytes;
+        }
+    }
+
+    QVector<qint64> limits(m_entries.size(), 0);
+    for (int i = 0; i < m_entries.size(); ++i) {
+        if (m_entries[i].resize) {
+            limits[i] = m_entries[i].holder.minimum;
+            available -= limits[i];
+        }
+    }
+    for (int priority = High; priority >= Low; --priority) {
+        for (int i = 0; i < m_entries.size(); ++i) {
+            const Holder &holder = m_entries[i].holder;
+            if (m_entries[i].resize && holder.priority == priority && available > 0) {
+                const qint64 extra = std::min(available, holder.wanted - limits[i]);
+                limits[i] += extra;
+                available -= extra;
+            }
+        }
+    }
+
+    for (int i = 0; i < m_entries.size(); ++i) {
+        if (m_entries[i].resize) {
+            const qint64 limit = m_entries[i].holder.limit;
+            applyLimit(m_entries[i], allowGrowth ? limits[i] : std::min(limits[i], limit));
+        }
+    }
+}
+
+void MemoryBudget::applyLimit(Entry &entry, qint64 limit)
+{
+    if (limit == entry.holder.limit) {
+        return;
+    }
+    entry.holder.limit = limit;
+    entry.resize(limit);
+}
+
+void MemoryBudget::relieve(qint64 excess)
+{
+    // Lowest priority first, and within a class the biggest, each down to
+    // no less than its minimum
+    QVector<int> order;
+    for (int i = 0; i < m_entries.size(); ++i) {
+        if (m_entries[i].resize) {
+            order.append(i);
+        }
+    }
+    std::sort(order.begin(), order.end(), [this](int a, int b) {
+        const Holder &first = m_entries[a].holder;
+        const Holder &second = m_entries[b].holder;
+        if (first.priority != second.priority) {
+            return first.priority < second.priority;
+        }
+        return first.bytes > second.bytes;
+    });
+
+    for (int i : order) {
+        if (excess <= 0) {
+            break;
+        }
+        Entry &entry = m_entries[i];
+        const qint64 target = std::max(entry.holder.minimum, std::min(entry.holder.bytes, entry.holder.limit) - excess);
+        const qint64 freed = std::max<qint64>(0, entry.holder.bytes - target);
+        if (target < entry.holder.limit) {
+            applyLimit(entry, target);
+        }
+        excess -= freed;
+    }
+}
+
+void MemoryBudget::poll()
+{
+    qint64 total = 0;
+    bool fixedGrew = false;
+    for (Entry &entry : m_entries) {
+        const qint64 bytes = entry.usage ? std::max<qint64>(0, entry.usage()) : 0;
+        fixedGrew = fixedGrew || (!entry.resize && bytes > entry.holder.bytes + kMinChange);
+        entry.holder.bytes = bytes;
+        total += bytes;
+    }
+    m_peak = std::max(m_peak, total);
+
+    // After relieving pressure the cut limits hold until usage is well
+    // below the ceiling; restoring them sooner would refill the caches
+    // straight back over it on the next poll
+    if (m_relieved && total < m_ceiling / 100 * kRestorePercent) {
+        m_relieved = false;
+    }
+
+    if (total > m_ceiling) {
+        ++m_pressureEvents;
+        m_relieved = true;
+        relieve(total - m_ceiling);
+    } else if (fixedGrew) {
+        rebalance(!m_relieved);
+    } else if (!m_relieved) {
+        // Room given back by a fixed holder, or taken in relieving
+        // pressure, returns to the caches once usage allows
+        qint64 granted = 0;
+        for (const Entry &entry : m_entries) {
+            granted += entry.resize ? entry.holder.limit : entry.holder.bytes;
+        }
+        if (m_ceiling - granted > kMinChange) {
+            rebalance();
+        }
+    }
+    emit updated();
+}
+
+qint64 MemoryBudget::mpvCacheBytes(mpv_handle *mpv)
+{
+    mpv_node node;
+    if (!mpv || mpv_get_property(mpv, "demuxer-cache-state", MPV_FORMAT_NODE, &node) < 0) {
+        return 0;
+    }
+    qint64 bytes = 0;
+    if (node.format == MPV_FORMAT_NODE_MAP) {
+        const mpv_node_list *map = node.u.list;
+        for (int i = 0; i < map->num; ++i) {
+            if (std::strcmp(map->keys[i], "total-bytes") == 0 && map->values[i].format == MPV_FORMAT_INT64) {
+                bytes = map->values[i].u.int64;
+            }
+        }
+    }
+    mpv_free_node_contents(&node);
+    return bytes;
+}
+
+void MemoryBudget::setMpvCacheLimit(mpv_handle *mpv, qint64 bytes)
+{
+    if (!mpv) {
+        return;
+    }
+    const QByteArray ahead = QByteArray::number(bytes - bytes / 4);
+    const QByteArray back = QByteArray::number(bytes / 4);
+    mpv_set_property_string(mpv, "demuxer-max-bytes", ahead.constData());
+    mpv_set_property_string(mpv, "demuxer-max-back-bytes", back.constData());
+}
@@ -0,0 +1,87 @@
+#include "MemoryPanel.h"
+#include "MemoryBudget.h"
+#include <QHeaderView>
+#include <QLabel>
+#include <QSpinBox>
+#include <QTableWidget>
+#include <QVBoxLayout>
+
+namespace {
+const qint64 kMiB = 1024 * 1024;
+
+QString mibText(qint64 bytes)
+{
+    return QString("%1 MiB").arg(double(bytes) / kMiB, 0, 'f', 1);
+}
+
+QString priorityText(MemoryBudget::Priority priority)
+{
+    switch (priority) {
+    case MemoryBudget::Low:
+        return "Low";
+    case MemoryBudget::Normal:
+        return "Normal";
+    case MemoryBudget::High:
+        break;
+    }
+    return "High";
+}
+}
+
+MemoryPanel::MemoryPanel(MemoryBudget *budget, QWidget *parent)
+    : QWidget(parent)
+    , m_budget(budget)
+{
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    m_ceiling = new QSpinBox(this);
+    m_ceiling->setRange(256, 1024 * 1024);
+    m_ceiling->setSingleStep(256);
+    m_ceiling->setSuffix(tr(" MiB ceiling"));
+    m_ceiling->setValue(int(m_budget->ceiling() / kMiB));
+    m_summary = new QLabel(this);
+    m_holders = new QTableWidget(this);
+    m_holders->setColumnCount(4);
+    m_holders->setHorizontalHeaderLabels(QStringList() << tr("Cache") << tr("Priority") << tr("Holds") << tr("Limit"));
+    m_holders->setEditTriggers(QTableWidget::NoEditTriggers);
+    m_holders->verticalHeader()->hide();
+    m_holders->horizontalHeader()->setStretchLastSection(true);
+
+    layout->addWidget(m_ceiling);
+    layout->addWidget(m_summary);
+    layout->addWidget(m_holders, 1);
+
+    connect(m_ceiling, &QSpinBox::valueChanged, this, [this](int mib) {
+        m_budget->setCeiling(mib * kMiB);
+    });
+    connect(m_budget, &MemoryBudget::updated, this, &MemoryPanel::refresh);
+    refresh();
+}
+
+void MemoryPanel::refresh()
+{
+    m_summary->setText(tr("%1 of %2 (peak %3), %4 pressure events")
+                           .arg(mibText(m_budget->used()))
+                           .arg(mibText(m_budget->ceiling()))
+                           .arg(mibText(m_budget->peak()))
+                           .arg(m_budget->pressureEvents()));
+
+    const QVector<MemoryBudget::Holder> holders = m_budget->holders();
+    m_holders->setRowCount(holders.size());
+    for (int row = 0; row < holders.size(); ++row) {
+        const MemoryBudget::Holder &holder = holders[row];
+        const QString texts[4] = {
+            holder.name,
+            priorityText(holder.priority),
+            mibText(holder.bytes),
+            holder.limit < 0 ? tr("Fixed") : mibText(holder.limit),
+        };
+        for (int column = 0; column < 4; ++column) {
+            QTableWidgetItem *item = m_holders->item(row, column);
+            if (!item) {
+                item = new QTableWidgetItem();
+                m_holders->setItem(row, column, item);
+            }
+            item->setText(texts[column]);
+        }
+    }
+}
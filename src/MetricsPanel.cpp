@@ -0,0 +1,125 @@
+#include "MetricsPanel.h"
+#include "PlaybackMetrics.h"
+#include "JobScheduler.h"
+#include "SequenceFlattener.h"
+#include <QFormLayout>
+#include <QLabel>
+
+namespace {
+QString countText(qint64 value)
+{
+    return value < 0 ? QString("-") : QString::number(value);
+}
+
+QString latencyText(const PlaybackMetrics::Latency &latency)
+{
+    if (latency.count == 0) {
+        return QString("-");
+    }
+    return QString("%1 ms (p50 %2, p95 %3, max %4, n=%5)")
+        .arg(latency.lastMs, 0, 'f', 1)
+        .arg(latency.p50Ms, 0, 'f', 1)
+        .arg(latency.p95Ms, 0, 'f', 1)
+        .arg(latency.maxMs, 0, 'f', 1)
+        .arg(latency.count);
+}
+
+// Per class, most urgent first
+QString jobQueuesText(const JobScheduler::Stats &stats)
+{
+    return QString("%1 / %2 / %3 queued, %4 waiting, %5 running, %6 processes")
+        .arg(stats.classes[JobScheduler::Interactive].queued)
+        .arg(stats.classes[JobScheduler::Visible].queued)
+        .arg(stats.classes[JobScheduler::Background].queued)
+        .arg(stats.waiting)
+        .arg(stats.running)
+        .arg(stats.processes);
+}
+
+QString jobLatencyText(const JobScheduler::Stats &stats)
+{
+    QStringList parts;
+    for (int priority = 0; priority < JobScheduler::PriorityCount; ++priority) {
+        parts.append(QString("%1 p95 %2 ms")
+                         .arg(JobScheduler::priorityName(JobScheduler::Priority(priority)))
+                         .arg(stats.classes[priority].p95Ms, 0, 'f', 1));
+    }
+    return parts.join(", ");
+}
+
+QString nestingText(const SequenceFlattener::Stats &stats)
+{
+    return QString("depth %1, %2 reused / %3 flattened in %4 ms, %5 cached")
+        .arg(stats.depth)
+        .arg(stats.passHits)
+        .arg(stats.passMisses)
+        .arg(stats.lastPassMs, 0, 'f', 2)
+        .arg(stats.cached);
+}
+}
+
+MetricsPanel::MetricsPanel(PlaybackMetrics *metrics, QWidget *parent)
+    : QWidget(parent)
+    , m_metrics(metrics)
+{
+    QFormLayout *layout = new QFormLayout(this);
+    m_frameDrops = new QLabel(this);
+    m_decoderFrameDrops = new QLabel(this);
+    m_delayedFrames = new QLabel(this);
+    m_cacheDuration = new QLabel(this);
+    m_cacheSpeed = new QLabel(this);
+    m_filterFps = new QLabel(this);
+    m_rebuildLatency = new QLabel(this);
+    m_seekLatency = new QLabel(this);
+    m_timeToInteractive = new QLabel(this);
+    m_jobQueues = new QLabel(this);
+    m_jobLatency = new QLabel(this);
+    m_jobLatency->setWordWrap(true);
+    m_nesting = new QLabel(this);
+    m_exportPath = new QLabel(this);
+    m_exportPath->setTextInteractionFlags(Qt::TextSelectableByMouse);
+    m_exportPath->setWordWrap(true);
+
+    layout->addRow(tr("Dropped frames"), m_frameDrops);
+    layout->addRow(tr("Decoder drops"), m_decoderFrameDrops);
+    layout->addRow(tr("Delayed frames"), m_delayedFrames);
+    layout->addRow(tr("Cache ahead"), m_cacheDuration);
+    layout->addRow(tr("Cache speed"), m_cacheSpeed);
+    layout->addRow(tr("Filter FPS"), m_filterFps);
+    layout->addRow(tr("Rebuild latency"), m_rebuildLatency);
+    layout->addRow(tr("Seek latency"), m_seekLatency);
+    layout->addRow(tr("Time to interactive"), m_timeToInteractive);
+    layout->addRow(tr("Job queues"), m_jobQueues);
+    layout->addRow(tr("Job latency"), m_jobLatency);
+    layout->addRow(tr("Nested sequences"), m_nesting);
+    layout->addRow(tr("Snapshot file"), m_exportPath);
+
+    connect(m_metrics, &PlaybackMetrics::updated, this, &MetricsPanel::refresh);
+    refresh();
+}
+
+void MetricsPanel::refresh()
+{
+    const PlaybackMetrics::Sample sample = m_metrics->sample();
+    m_frameDrops->setText(countText(sample.frameDrops));
+    m_decoderFrameDrops->setText(countText(sample.decoderFrameDrops));
+    m_delayedFrames->setText(countText(sample.delayedFrames));
+    m_cacheDuration->setText(sample.cacheDuration < 0 ? QString("-") : tr("%1 s").arg(sample.cacheDuration, 0, 'f', 1));
+    m_cacheSpeed->setText(sample.cacheSpeed < 0 ? QString("-") : tr("%1 KiB/s").arg(sample.cacheSpeed / 1024));
+    m_filterFps->setText(sample.filterFps < 0 ? QString("-") : QString::number(sample.filterFps, 'f', 2));
+    m_rebuildLatency->setText(latencyText(m_metrics->rebuildLatency()));
+    m_seekLatency->setText(latencyText(m_metrics->seekLatency()));
+    const double startupMs = m_metrics->timeToInteractiveMs();
+    m_timeToInteractive->setText(startupMs < 0 ? QString("-") : tr("%1 ms").arg(startupMs, 0, 'f', 1));
+    if (const JobScheduler *jobs = m_metrics->jobScheduler()) {
+        const JobScheduler::Stats stats = jobs->stats();
+        m_jobQueues->setText(jobQueuesText(stats));
+        m_jobLatency->setText(jobLatencyText(stats));
+    } else {
+        m_jobQueues->setText("-");
+        m_jobLatency->setText("-");
+    }
+    const SequenceFlattener *flattener = m_metrics->sequenceFlattener();
+    m_nesting->setText(flattener ? nestingText(flattener->stats()) : QString("-"));
+    m_exportPath->setText(m_metrics->exportPath().isEmpty() ? tr("Off") : m_metrics->exportPath());
+}
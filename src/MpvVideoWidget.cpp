@@ -1,4 +1,5 @@
 #include "MpvVideoWidget.h"
+#include "VideoScopes.h"
 #include <QOpenGLContext>
 #include <QMetaObject>
 #include <QDebug>
@@ -8,6 +9,7 @@ MpvVideoWidget::MpvVideoWidget(QWidget *parent)
     : QOpenGLWidget(parent)
     , mpv(nullptr)
     , mpvGl(nullptr)
+    , scopes(nullptr)
 {
     setUpdateBehavior(QOpenGLWidget::NoPartialUpdate);
 }
@@ -27,6 +29,11 @@ void MpvVideoWidget::setMpv(mpv_handle *handle)
 
 void MpvVideoWidget::shutdown()
 {
+    if (context()) {
+        makeCurrent();
+        tap.release();
+        doneCurrent();
+    }
     if (mpvGl) {
         mpv_render_context_free(mpvGl);
         mpvGl = nullptr;
@@ -64,6 +71,11 @@ void MpvVideoWidget::paintGL()
         { MPV_RENDER_PARAM_INVALID, nullptr }
     };
     mpv_render_context_render(mpvGl, params);
+
+    // The scopes take a small copy of some of the frames
+    if (scopes && scopes->wantsFrame()) {
+        scopes->submit(tap.capture(context(), defaultFramebufferObject(), QSize(fbo.w, fbo.h), mpv));
+    }
 }
 
 void MpvVideoWidget::resizeGL(int w, int h)
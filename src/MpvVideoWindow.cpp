@@ -0,0 +1,187 @@
+#include "MpvVideoWindow.h"
+#include "FrameTap.h"
+#include "VideoScopes.h"
+#include <QCoreApplication>
+#include <QOpenGLContext>
+#include <QMutexLocker>
+#include <QThread>
+#include <QDebug>
+#include <mpv/render_gl.h>
+
+MpvVideoWindow::MpvVideoWindow(QWindow *parent)
+    : QWindow(parent)
+    , mpv(nullptr)
+    , glContext(nullptr)
+    , renderThread(nullptr)
+    , updatePending(false)
+    , resizePending(false)
+    , stopRequested(false)
+{
+    setSurfaceType(QWindow::OpenGLSurface);
+}
+
+MpvVideoWindow::~MpvVideoWindow()
+{
+    shutdown();
+}
+
+bool MpvVideoWindow::isSupported()
+{
+    return QOpenGLContext::supportsThreadedOpenGL();
+}
+
+void MpvVideoWindow::setMpv(mpv_handle *handle)
+{
+    mpv = handle;
+    if (mpv && isExposed()) {
+        startRendering();
+    }
+}
+
+void MpvVideoWindow::shutdown()
+{
+    if (renderThread) {
+        {
+            QMutexLocker locker(&renderMutex);
+            stopRequested = true;
+            renderCondition.wakeOne();
+        }
+        renderThread->wait();
+        delete renderThread;
+        renderThread = nullptr;
+    }
+    delete glContext;
+    glContext = nullptr;
+    mpv = nullptr;
+}
+
+void MpvVideoWindow::exposeEvent(QExposeEvent *event)
+{
+    Q_UNUSED(event);
+    if (isExposed()) {
+        updateFramebufferSize();
+        if (mpv) {
+            startRendering();
+        }
+    }
+}
+
+void MpvVideoWindow::resizeEvent(QResizeEvent *event)
+{
+    Q_UNUSED(event);
+    updateFramebufferSize();
+}
+
+void MpvVideoWindow::updateFramebufferSize()
+{
+    const qreal dpr = devicePixelRatio();
+    QMutexLocker locker(&renderMutex);
+    framebufferSize = QSize(static_cast<int>(width() * dpr), static_cast<int>(height() * dpr));
+    resizePending = true;
+    renderCondition.wakeOne();
+}
+
+void MpvVideoWindow::startRendering()
+{
+    if (renderThread) {
+        return;
+    }
+
+    glContext = new QOpenGLContext();
+    glContext->setFormat(requestedFormat());
+    if (!glContext->create()) {
+        qDebug() << "failed creating render thread GL context";
+        delete glContext;
+        glContext = nullptr;
+        return;
+    }
+
+    stopRequested = false;
+    renderThread = QThread::create([this]() { renderLoop(); });
+    renderThread->setObjectName("mpv-render");
+    glContext->moveToThread(renderThread);
+    renderThread->start();
+}
+
+void MpvVideoWindow::renderLoop()
+{
+    glContext->makeCurrent(this);
+
+    mpv_render_context *mpvGl = nullptr;
+    mpv_opengl_init_params glInit = { getProcAddress, this };
+    mpv_render_param initParams[] = {
+        { MPV_RENDER_PARAM_API_TYPE, const_cast<char *>(MPV_RENDER_API_TYPE_OPENGL) },
+        { MPV_RENDER_PARAM_OPENGL_INIT_PARAMS, &glInit },
+        { MPV_RENDER_PARAM_INVALID, nullptr }
+    };
+    if (mpv_render_context_create(&mpvGl, mpv, initParams) < 0) {
+        qDebug() << "mpv render context init failed";
+        glContext->doneCurrent();
+        glContext->moveToThread(QCoreApplication::instance()->thread());
+        return;
+    }
+    // Called from mpv's threads; wakes this loop without touching the GUI thread
+    mpv_render_context_set_update_callback(mpvGl, onMpvUpdate, this);
+
+    FrameTap tap;
+    QMutexLocker locker(&renderMutex);
+    while (!stopRequested) {
+        if (!updatePending && !resizePending) {
+            renderCondition.wait(&renderMutex);
+            continue;
+        }
+        const bool redraw = resizePending;
+        const QSize size = framebufferSize;
+        updatePending = false;
+        resizePending = false;
+        locker.unlock();
+
+        const uint64_t flags = mpv_render_context_update(mpvGl);
+        if ((flags & MPV_RENDER_UPDATE_FRAME) || redraw) {
+            mpv_opengl_fbo fbo = {
+                static_cast<int>(glContext->defaultFramebufferObject()),
+                size.width(),
+                size.height(),
+                0
+            };
+            int flip = 1;
+            mpv_render_param params[] = {
+                { MPV_RENDER_PARAM_OPENGL_FBO, &fbo },
+                { MPV_RENDER_PARAM_FLIP_Y, &flip },
+                { MPV_RENDER_PARAM_INVALID, nullptr }
+            };
+            mpv_render_context_render(mpvGl, params);
+            if (scopes && scopes->wantsFrame()) {
+                scopes->submit(tap.capture(glContext, glContext->defaultFramebufferObject(), size, mpv));
+            }
+            glContext->swapBuffers(this);
+            mpv_render_context_report_swap(mpvGl);
+        }
+
+        locker.relock();
+    }
+    locker.unlock();
+
+    tap.release();
+    mpv_render_context_free(mpvGl);
+    glContext->doneCurrent();
+    glContext->moveToThread(QCoreApplication::instance()->thread());
+}
+
+void *MpvVideoWindow::getProcAddress(void *ctx, const char *name)
+{
+    Q_UNUSED(ctx);
+    QOpenGLContext *glctx = QOpenGLContext::currentContext();
+    if (!glctx) {
+        return nullptr;
+    }
+    return reinterpret_cast<void *>(glctx->getProcAddress(QByteArray(name)));
+}
+
+void MpvVideoWindow::onMpvUpdate(void *ctx)
+{
+    MpvVideoWindow *self = static_cast<MpvVideoWindow *>(ctx);
+    QMutexLocker locker(&self->renderMutex);
+    self->updatePending = true;
+    self->renderCondition.wakeOne();
+}
@@ -0,0 +1,78 @@
+#include "Multicam.h"
+#include <QStringList>
+
+namespace Multicam {
+
+int columns(int count)
+{
+    return count > 1 ? 2 : 1;
+}
+
+int rows(int count)
+{
+    return count > 2 ? 2 : 1;
+}
+
+QString angleSource(const CameraAngle &angle)
+{
+    // Length-prefixed so the path needs no escaping
+    return QString("edl://%%1%%2,%3")
+        .arg(angle.path.toUtf8().size())
+        .arg(angle.path, Timebase::toEdlSeconds(angle.syncOffset));
+}
+
+QString gridGraph(int count)
+{
+    QString graph;
+    QString inputs;
+    for (int i = 0; i < count; ++i) {
+        graph += QString("[vid%1]scale=%2:%3:force_original_aspect_ratio=decrease,"
+                         "pad=%2:%3:(ow-iw)/2:(oh-ih)/2,setsar=1[a%4];")
+                     .arg(i + 1)
+                     .arg(kAngleWidth)
+                     .arg(kAngleHeight)
+                     .arg(i);
+        inputs += QString("[a%1]").arg(i);
+    }
+
+    if (count == 2) {
+        return graph + inputs + "hstack=inputs=2[vo]";
+    }
+    // The empty cell of a three-angle grid is filled black
+    const QString layout = count == 3 ? "0_0|w0_0|0_h0" : "0_0|w0_0|0_h0|w0_h0";
+    return graph + inputs + QString("xstack=inputs=%1:layout=%2:fill=black[vo]").arg(count).arg(layout);
+}
+
+int angleAt(int count, double x, double y)
+{
+    if (x < 0.0 || x >= 1.0 || y < 0.0 || y >= 1.0) {
+        return -1;
+    }
+    const int angle = int(y * rows(count)) * columns(count) + int(x * columns(count));
+    return angle < count ? angle : -1;
+}
+
+QString encodeAngles(const QVector<CameraAngle> &angles)
+{
+    QStringList lines;
+    for (const CameraAngle &angle : angles) {
+        lines.append(QString::number(angle.syncOffset) + '\t' + angle.path);
+    }
+    return lines.join('\n');
+}
+
+QVector<CameraAngle> decodeAngles(const QString &encoded)
+{
+    QVector<CameraAngle> angles;
+    const QStringList lines = encoded.split('\n');
+    for (const QString &line : lines) {
+        const int tab = line.indexOf('\t');
+        if (tab <= 0) {
+            continue;
+        }
+        angles.append({line.mid(tab + 1), line.left(tab).toLongLong()});
+    }
+    return angles;
+}
+
+}
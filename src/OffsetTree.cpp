@@ -0,0 +1,292 @@
+#include "OffsetTree.h"
+
+OffsetTree::OffsetTree()
+    : m_root(-1)
+    , m_seed(0x9e3779b9u)
+    , m_settled(true)
+{
+}
+
+void OffsetTree::clear()
+{
+    m_nodes.clear();
+    m_free.clear();
+    m_root = -1;
+    m_settled = true;
+}
+
+void OffsetTree::assign(const QVector<Ticks> &times)
+{
+    clear();
+    m_nodes.reserve(times.size());
+
+    // Cartesian tree over the priorities: each node pops the lower
+    // priority nodes off the right spine and takes them as its left subtree
+    QVector<int> spine;
+    for (Ticks time : times) {
+        const int node = newNode(time);
+        int last = -1;
+        while (!spine.isEmpty() && m_nodes[spine.last()].priority < m_nodes[node].priority) {
+            last = spine.takeLast();
+        }
+        m_nodes[node].left = last;
+        if (!spine.isEmpty()) {
+            m_nodes[spine.last()].right = node;
+        }
+        spine.append(node);
+    }
+    m_root = spine.isEmpty() ? -1 : spine.first();
+
+    // Sizes and parents are filled children first, in reverse preorder
+    QVector<int> stack;
+    QVector<int> postOrder;
+    postOrder.reserve(m_nodes.size());
+    if (m_root >= 0) {
+        stack.append(m_root);
+    }
+    while (!stack.isEmpty()) {
+        const int node = stack.takeLast();
+        postOrder.append(node);
+        if (m_nodes[node].left >= 0) {
+            stack.append(m_nodes[node].left);
+        }
+        if (m_nodes[node].right >= 0) {
+            stack.append(m_nodes[node].right);
+        }
+    }
+    for (int i = postOrder.size() - 1; i >= 0; --i) {
+        pull(postOrder[i]);
+    }
+    if (m_root >= 0) {
+        m_nodes[m_root].parent = -1;
+    }
+}
+
+int OffsetTree::insert(int position, Ticks time)
+{
+    const int node = newNode(time);
+    int first = -1;
+    int rest = -1;
+    split(m_root, position, first, rest);
+    m_root = merge(merge(first, node), rest);
+    m_nodes[m_root].parent = -1;
+    return node;
+}
+
+void OffsetTree::remove(int node)
+{
+    int first = -1;
+    int rest = -1;
+    int removed = -1;
+    int after = -1;
+    split(m_root, positionOf(node), first, rest);
+    split(rest, 1, removed, after);
+    m_root = merge(first, after);
+    if (m_root >= 0) {
+        m_nodes[m_root].parent = -1;
+    }
+    m_free.append(removed);
+}
+
+void OffsetTree::shiftFrom(int position, Ticks delta)
+{
+    if (position >= size() || delta == 0) {
+        return;
+    }
+
+    int first = -1;
+    int rest = -1;
+    split(m_root, position, first, rest);
+    m_nodes[rest].time += delta;
+    m_nodes[rest].shift += delta;
+    m_settled = false;
+    m_root = merge(first, rest);
+    m_nodes[m_root].parent = -1;
+}
+
+int OffsetTree::positionOf(int node) const
+{
+    int position = sizeOf(m_nodes[node].left);
+    for (int parent = m_nodes[node].parent; parent >= 0; node = parent, parent = m_nodes[node].parent) {
+        if (m_nodes[parent].right == node) {
+            position += sizeOf(m_nodes[parent].left) + 1;
+        }
+    }
+    return position;
+}
+
+int OffsetTree::nodeAt(int position) const
+{
+    for (int node = m_root; node >= 0;) {
+        const int leftSize = sizeOf(m_nodes[node].left);
+        if (position < leftSize) {
+            node = m_nodes[node].left;
+        } else if (position == leftSize) {
+            return node;
+        } else {
+            position -= leftSize + 1;
+            node = m_nodes[node].right;
+        }
+    }
+    return -1;
+}
+
+Ticks OffsetTree::timeOf(int node) const
+{
+    Ticks time = m_nodes[node].time;
+    if (m_settled) {
+        return time;
+    }
+    for (int parent = m_nodes[node].parent; parent >= 0; parent = m_nodes[parent].parent) {
+        time += m_nodes[parent].shift;
+    }
+    return time;
+}
+
+int OffsetTree::lowerBound(Ticks time) const
+{
+    return bound(time, false);
+}
+
+int OffsetTree::upperBound(Ticks time) const
+{
+    return bound(time, true);
+}
+
+void OffsetTree::settle()
+{
+    if (m_settled) {
+        return;
+    }
+
+    QVector<int> stack;
+    if (m_root >= 0) {
+        stack.append(m_root);
+    }
+    while (!stack.isEmpty()) {
+        const int node = stack.takeLast();
+        push(node);
+        if (m_nodes[node].left >= 0) {
+            stack.append(m_nodes[node].left);
+        }
+        if (m_nodes[node].right >= 0) {
+            stack.append(m_nodes[node].right);
+        }
+    }
+    m_settled = true;
+}
+
+int OffsetTree::newNode(Ticks time)
+{
+    const Node node = {time, 0, -1, -1, -1, 1, nextPriority()};
+    if (!m_free.isEmpty()) {
+        const int reused = m_free.takeLast();
+        m_nodes[reused] = node;
+        return reused;
+    }
+    m_nodes.append(node);
+    return m_nodes.size() - 1;
+}
+
+quint32 OffsetTree::nextPriority()
+{
+    // xorshift32; only the balance depends on it
+    m_seed ^= m_seed << 13;
+    m_seed ^= m_seed >> 17;
+    m_seed ^= m_seed << 5;
+    return m_seed;
+}
+
+void OffsetTree::push(int node)
+{
+    Node &n = m_nodes[node];
+    if (n.shift == 0) {
+        return;
+    }
+    for (int child : {n.left, n.right}) {
+        if (child >= 0) {
+            m_nodes[child].time += n.shift;
+            m_nodes[child].shift += n.shift;
+        }
+    }
+    n.shift = 0;
+}
+
+void OffsetTree::pull(int node)
+{
+    Node &n = m_nodes[node];
+    n.size = 1 + sizeOf(n.left) + sizeOf(n.right);
+    if (n.left >= 0) {
+        m_nodes[n.left].parent = node;
+    }
+    if (n.right >= 0) {
+        m_nodes[n.right].parent = node;
+    }
+}
+
+void OffsetTree::split(int node, int count, int &first, int &rest)
+{
+    if (node < 0) {
+        first = -1;
+        rest = -1;
+        return;
+    }
+
+    push(node);
+    const int leftSize = sizeOf(m_nodes[node].left);
+    if (count <= leftSize) {
+        split(m_nodes[node].left, count, first, m_nodes[node].left);
+        pull(node);
+        rest = node;
+    } else {
+        split(m_nodes[node].right, count - leftSize - 1, m_nodes[node].right, rest);
+        pull(node);
+        first = node;
+    }
+    if (first >= 0) {
+        m_nodes[first].parent = -1;
+    }
+    if (rest >= 0) {
+        m_nodes[rest].parent = -1;
+    }
+}
+
+int OffsetTree::merge(int first, int rest)
+{
+    if (first < 0) {
+        return rest;
+    }
+    if (rest < 0) {
+        return first;
+    }
+
+    if (m_nodes[first].priority > m_nodes[rest].priority) {
+        push(first);
+        m_nodes[first].right = merge(m_nodes[first].right, rest);
+        pull(first);
+        return first;
+    }
+    push(rest);
+    m_nodes[rest].left = merge(first, m_nodes[rest].left);
+    pull(rest);
+    return rest;
+}
+
+int OffsetTree::bound(Ticks time, bool inclusive) const
+{
+    // Descends once, adding each ancestor's pending shift on the way
+    int position = 0;
+    Ticks shift = 0;
+    for (int node = m_root; node >= 0;) {
+        const Node &n = m_nodes[node];
+        const Ticks at = n.time + shift;
+        shift += n.shift;
+        if (at < time || (inclusive && at == time)) {
+            position += sizeOf(n.left) + 1;
+            node = n.right;
+        } else {
+            node = n.left;
+        }
+    }
+    return position;
+}
@@ -0,0 +1,347 @@
+#include "PlaybackMetrics.h"
+#include "JobScheduler.h"
+#include "MemoryBudget.h"
+#include "SequenceFlattener.h"
+#include <QDateTime>
+#include <QDebug>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QTimer>
+#include <algorithm>
+
+namespace {
+const int kSampleInterval = 1000;
+
+// Latency percentiles are over the most recent operations
+const int kLatencyWindow = 200;
+
+// A rebuild or seek with no playback restart after this is dropped
+const qint64 kPendingTimeout = 10000;
+
+qint64 readInt(mpv_handle *mpv, const char *name)
+{
+    int64_t value = 0;
+    if (!mpv || mpv_get_property(mpv, name, MPV_FORMAT_INT64, &value) < 0) {
+        return -1;
+    }
+    return value;
+}
+
+double readDouble(mpv_handle *mpv, const char *name)
+{
+    double value = 0.0;
+    if (!mpv || mpv_get_property(mpv, name, MPV_FORMAT_DOUBLE, &value) < 0) {
+        return -1.0;
+    }
+    return value;
+}
+
+QJsonValue jsonValue(double value)
+{
+    return value < 0 ? QJsonValue() : QJsonValue(value);
+}
+
+QJsonObject latencyJson(const PlaybackMetrics::Latency &latency)
+{
+    QJsonObject object;
+    object["count"] = latency.count;
+    object["last"] = latency.lastMs;
+    object["p50"] = latency.p50Ms;
+    object["p95"] = latency.p95Ms;
+    object["max"] = latency.maxMs;
+    object["total"] = latency.totalMs;
+    return object;
+}
+
+void addMetric(QByteArray &out, const char *name, const char *type, const char *help, double value)
+{
+    if (value < 0) {
+        return;
+    }
+    out += QByteArray("# HELP ") + name + ' ' + help + '\n';
+    out += QByteArray("# TYPE ") + name + ' ' + type + '\n';
+    out += QByteArray(name) + ' ' + QByteArray::number(value, 'g', 12) + '\n';
+}
+
+// One line per priority class under a shared HELP and TYPE
+void addClassMetric(QByteArray &out, const char *name, const char *type, const char *help,
+                    const JobScheduler::Stats &stats, double (*value)(const JobScheduler::ClassStats &))
+{
+    out += QByteArray("# HELP ") + name + ' ' + help + '\n';
+    out += QByteArray("# TYPE ") + name + ' ' + type + '\n';
+    for (int priority = 0; priority < JobScheduler::PriorityCount; ++priority) {
+        out += QByteArray(name) + "{class=\""
+             + JobScheduler::priorityName(JobScheduler::Priority(priority)).toLatin1() + "\"} "
+             + QByteArray::number(value(stats.classes[priority]), 'g', 12) + '\n';
+    }
+}
+
+void addSummary(QByteArray &out, const char *name, const char *help, const PlaybackMetrics::Latency &latency)
+{
+    out += QByteArray("# HELP ") + name + ' ' + help + '\n';
+    out += QByteArray("# TYPE ") + name + " summary\n";
+    out += QByteArray(name) + "{quantile=\"0.5\"} " + QByteArray::number(latency.p50Ms / 1000.0, 'g', 12) + '\n';
+    out += QByteArray(name) + "{quantile=\"0.95\"} " + QByteArray::number(latency.p95Ms / 1000.0, 'g', 12) + '\n';
+    out += QByteArray(name) + "_sum " + QByteArray::number(latency.totalMs / 1000.0, 'g', 12) + '\n';
+    out += QByteArray(name) + "_count " + QByteArray::number(latency.count) + '\n';
+}
+}
+
+PlaybackMetrics::PlaybackMetrics(QObject *parent)
+    : QObject(parent)
+    , m_mpv(nullptr)
+    , m_timer(new QTimer(this))
+    , m_sample({-1, -1, -1, -1.0, -1, -1.0})
+    , m_pending(None)
+    , m_rebuild({QVector<double>(), 0, 0.0})
+    , m_seek({QVector<double>(), 0, 0.0})
+    , m_timeToInteractiveMs(-1.0)
+    , m_jobs(nullptr)
+    , m_memory(nullptr)
+    , m_flattener(nullptr)
+{
+    m_timer->setInterval(kSampleInterval);
+    connect(m_timer, &QTimer::timeout, this, &PlaybackMetrics::poll);
+    m_timer->start();
+}
+
+void PlaybackMetrics::setMpv(mpv_handle *handle)
+{
+    m_mpv = handle;
+}
+
+void PlaybackMetrics::setExportPath(const QString &path)
+{
+    m_exportPath = path;
+}
+
+void PlaybackMetrics::setTimeToInteractive(double ms)
+{
+    m_timeToInteractiveMs = ms;
+    emit updated();
+}
+
+void PlaybackMetrics::beginRebuild()
+{
+    m_pending = Rebuild;
+    m_pendingTimer.start();
+}
+
+void PlaybackMetrics::beginSeek()
+{
+    // A seek issued as part of a rebuild belongs to the rebuild
+    if (m_pending == Rebuild) {
+        return;
+    }
+    m_pending = Seek;
+    m_pendingTimer.start();
+}
+
+void PlaybackMetrics::playbackRestarted()
+{
+    if (m_pending == None) {
+        return;
+    }
+
+    const double ms = m_pendingTimer.nsecsElapsed() / 1e6;
+    record(m_pending == Rebuild ? m_rebuild : m_seek, ms);
+    m_pending = None;
+    emit updated();
+}
+
+PlaybackMetrics::Latency PlaybackMetrics::summarize(const Series &series)
+{
+    Latency latency = {series.count, 0.0, 0.0, 0.0, 0.0, series.totalMs};
+    if (series.recent.isEmpty()) {
+        return latency;
+    }
+
+    QVector<double> sorted = series.recent;
+    std::sort(sorted.begin(), sorted.end());
+    latency.lastMs = series.recent.last();
+    latency.p50Ms = sorted[(sorted.size() - 1) / 2];
+    latency.p95Ms = sorted[(sorted.size() - 1) * 95 / 100];
+    latency.maxMs = sorted.last();
+    return latency;
+}
+
+void PlaybackMetrics::record(Series &series, double ms)
+{
+    series.recent.append(ms);
+    if (series.recent.size() > kLatencyWindow) {
+        series.recent.removeFirst();
+    }
+    ++series.count;
+    series.totalMs += ms;
+}
+
+void PlaybackMetrics::poll()
+{
+    m_sample.frameDrops = readInt(m_mpv, "frame-drop-count");
+    m_sample.decoderFrameDrops = readInt(m_mpv, "decoder-frame-drop-count");
+    m_sample.delayedFrames = readInt(m_mpv, "vo-delayed-frame-count");
+    m_sample.cacheDuration = readDouble(m_mpv, "demuxer-cache-duration");
+    m_sample.cacheSpeed = readInt(m_mpv, "cache-speed");
+    m_sample.filterFps = readDouble(m_mpv, "estimated-vf-fps");
+
+    if (m_pending != None && m_pendingTimer.elapsed() > kPendingTimeout) {
+        m_pending = None;
+    }
+
+    emit updated();
+    writeSnapshot();
+}
+
+void PlaybackMetrics::writeSnapshot() const
+{
+    if (m_exportPath.isEmpty()) {
+        return;
+    }
+
+    // Replaced atomically, so a grader never reads half a snapshot
+    QSaveFile file(m_exportPath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qDebug() << "Failed to write metrics" << m_exportPath;
+        return;
+    }
+    file.write(m_exportPath.endsWith(".prom") ? toPrometheus() : toJson());
+    if (!file.commit()) {
+        qDebug() << "Failed to write metrics" << m_exportPath;
+    }
+}
+
+QByteArray PlaybackMetrics::toJson() const
+{
+    QJsonObject object;
+    object["timestamp"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODateWithMs);
+    object["frame_drops"] = jsonValue(m_sample.frameDrops);
+    object["decoder_frame_drops"] = jsonValue(m_sample.decoderFrameDrops);
+    object["delayed_frames"] = jsonValue(m_sample.delayedFrames);
+    object["demuxer_cache_seconds"] = jsonValue(m_sample.cacheDuration);
+    object["cache_speed_bytes"] = jsonValue(m_sample.cacheSpeed);
+    object["filter_fps"] = jsonValue(m_sample.filterFps);
+    object["rebuild_latency_ms"] = latencyJson(rebuildLatency());
+    object["seek_latency_ms"] = latencyJson(seekLatency());
+    object["time_to_interactive_ms"] = jsonValue(m_timeToInteractiveMs);
+    if (m_jobs) {
+        const JobScheduler::Stats stats = m_jobs->stats();
+        QJsonObject jobs;
+        for (int priority = 0; priority < JobScheduler::PriorityCount; ++priority) {
+            const JobScheduler::ClassStats &classStats = stats.classes[priority];
+            QJsonObject jobClass;
+            jobClass["queued"] = classStats.queued;
+            jobClass["completed"] = classStats.completed;
+            jobClass["cancelled"] = classStats.cancelled;
+            jobClass["p50"] = classStats.p50Ms;
+            jobClass["p95"] = classStats.p95Ms;
+            jobClass["max"] = classStats.maxMs;
+            jobs[JobScheduler::priorityName(JobScheduler::Priority(priority))] = jobClass;
+        }
+        jobs["waiting"] = stats.waiting;
+        jobs["running"] = stats.running;
+        jobs["processes"] = stats.processes;
+        jobs["steals"] = stats.steals;
+        object["jobs"] = jobs;
+    }
+    if (m_memory) {
+        QJsonObject memory;
+        memory["ceiling_bytes"] = m_memory->ceiling();
+        memory["used_bytes"] = m_memory->used();
+        memory["peak_bytes"] = m_memory->peak();
+        memory["pressure_events"] = m_memory->pressureEvents();
+        QJsonArray holders;
+        for (const MemoryBudget::Holder &holder : m_memory->holders()) {
+            QJsonObject entry;
+            entry["name"] = holder.name;
+            entry["bytes"] = holder.bytes;
+            entry["limit_bytes"] = jsonValue(holder.limit);
+            holders.append(entry);
+        }
+        memory["holders"] = holders;
+        object["memory"] = memory;
+    }
+    if (m_flattener) {
+        const SequenceFlattener::Stats stats = m_flattener->stats();
+        QJsonObject nesting;
+        nesting["depth"] = stats.depth;
+        nesting["cached_sequences"] = stats.cached;
+        nesting["rebuild_hits"] = stats.passHits;
+        nesting["rebuild_misses"] = stats.passMisses;
+        nesting["hits"] = stats.hits;
+        nesting["misses"] = stats.misses;
+        nesting["rebuild_ms"] = stats.lastPassMs;
+        object["nesting"] = nesting;
+    }
+    return QJsonDocument(object).toJson();
+}
+
+QByteArray PlaybackMetrics::toPrometheus() const
+{
+    QByteArray out;
+    addMetric(out, "mvideo_frame_drops_total", "counter",
+              "Frames dropped by the video output.", m_sample.frameDrops);
+    addMetric(out, "mvideo_decoder_frame_drops_total", "counter",
+              "Frames dropped by the decoder.", m_sample.decoderFrameDrops);
+    addMetric(out, "mvideo_delayed_frames_total", "counter",
+              "Frames presented late.", m_sample.delayedFrames);
+    addMetric(out, "mvideo_demuxer_cache_seconds", "gauge",
+              "Media buffered ahead of the playhead.", m_sample.cacheDuration);
+    addMetric(out, "mvideo_cache_speed_bytes", "gauge",
+              "Bytes per second read into the cache.", m_sample.cacheSpeed);
+    addMetric(out, "mvideo_filter_fps", "gauge",
+              "Estimated frame rate out of the video filters.", m_sample.filterFps);
+    addSummary(out, "mvideo_rebuild_latency_seconds",
+               "Time from a timeline rebuild to its first frame.", rebuildLatency());
+    addSummary(out, "mvideo_seek_latency_seconds",
+               "Time from a seek to playback restarting.", seekLatency());
+    addMetric(out, "mvideo_time_to_interactive_seconds", "gauge",
+              "Time from process start to the first interactive frame.",
+              m_timeToInteractiveMs < 0 ? -1.0 : m_timeToInteractiveMs / 1000.0);
+    if (m_jobs) {
+        const JobScheduler::Stats stats = m_jobs->stats();
+        addClassMetric(out, "mvideo_jobs_queued", "gauge", "Jobs ready and waiting for a worker.", stats,
+                       [](const JobScheduler::ClassStats &c) { return double(c.queued); });
+        addClassMetric(out, "mvideo_jobs_completed_total", "counter", "Jobs whose results were delivered.", stats,
+                       [](const JobScheduler::ClassStats &c) { return double(c.completed); });
+        addClassMetric(out, "mvideo_jobs_cancelled_total", "counter", "Jobs dropped after cancellation.", stats,
+                       [](const JobScheduler::ClassStats &c) { return double(c.cancelled); });
+        addClassMetric(out, "mvideo_job_latency_p95_seconds", "gauge",
+                       "Recent 95th percentile time from a job being ready to its result being delivered.", stats,
+                       [](const JobScheduler::ClassStats &c) { return c.p95Ms / 1000.0; });
+        addMetric(out, "mvideo_jobs_waiting", "gauge", "Jobs waiting on other jobs.", stats.waiting);
+        addMetric(out, "mvideo_jobs_running", "gauge", "Jobs running on a worker.", stats.running);
+        addMetric(out, "mvideo_job_processes", "gauge", "External processes run by jobs.", stats.processes);
+        addMetric(out, "mvideo_job_steals_total", "counter", "Jobs taken from another worker's queue.", stats.steals);
+    }
+    if (m_memory) {
+        addMetric(out, "mvideo_memory_ceiling_bytes", "gauge", "Memory all caches together may hold.",
+                  m_memory->ceiling());
+        addMetric(out, "mvideo_memory_used_bytes", "gauge", "Memory the caches hold.", m_memory->used());
+        addMetric(out, "mvideo_memory_peak_bytes", "gauge", "Most memory the caches have held at once.",
+                  m_memory->peak());
+        addMetric(out, "mvideo_memory_pressure_events_total", "counter",
+                  "Times the caches were found over the ceiling and told to shrink.", m_memory->pressureEvents());
+        const QVector<MemoryBudget::Holder> holders = m_memory->holders();
+        out += "# HELP mvideo_memory_holder_bytes Memory one cache holds.\n";
+        out += "# TYPE mvideo_memory_holder_bytes gauge\n";
+        for (const MemoryBudget::Holder &holder : holders) {
+            out += QByteArray("mvideo_memory_holder_bytes{holder=\"") + holder.name.toUtf8() + "\"} "
+                 + QByteArray::number(holder.bytes) + '\n';
+        }
+    }
+    if (m_flattener) {
+        const SequenceFlattener::Stats stats = m_flattener->stats();
+        addMetric(out, "mvideo_nesting_depth", "gauge", "Deepest sequence nesting in the last rebuild.", stats.depth);
+        addMetric(out, "mvideo_nested_sequences_cached", "gauge", "Nested sequences held flattened.", stats.cached);
+        addMetric(out, "mvideo_nested_flatten_hits_total", "counter",
+                  "Nested sequences reused from the flattening cache.", stats.hits);
+        addMetric(out, "mvideo_nested_flatten_misses_total", "counter",
+                  "Nested sequences flattened again after an edit.", stats.misses);
+        addMetric(out, "mvideo_nested_flatten_seconds", "gauge",
+                  "Time the last rebuild spent laying out the timeline and its nested sequences.",
+                  stats.lastPassMs / 1000.0);
+    }
+    return out;
+}
@@ -0,0 +1,91 @@
+#include "ProjectSettings.h"
+#include <QStringList>
+#include <cmath>
+#include <numeric>
+
+namespace {
+const int kMaxSize = 8192;
+
+// NTSC rates are written 23.976, 29.97 and 59.94 but are n/1001 exactly
+bool parseRate(const QString &text, FrameRate &rate)
+{
+    bool ok = false;
+    if (text.contains('/')) {
+        const QStringList parts = text.split('/');
+        rate.numerator = parts[0].trimmed().toInt(&ok);
+        bool denominatorOk = false;
+        rate.denominator = parts.size() == 2 ? parts[1].trimmed().toInt(&denominatorOk) : 0;
+        ok = ok && denominatorOk;
+    } else {
+        const double fps = text.trimmed().toDouble(&ok);
+        const qint64 ntsc = std::llround(fps * 1001.0);
+        if (ok && ntsc % 1000 == 0 && std::abs(ntsc / 1001.0 - fps) < 0.001 && std::abs(fps - std::round(fps)) > 0.001) {
+            rate = {int(ntsc), 1001};
+        } else {
+            rate = {int(std::llround(fps * 1000.0)), 1000};
+        }
+    }
+    if (!ok || rate.numerator <= 0 || rate.denominator <= 0) {
+        return false;
+    }
+    const int divisor = std::gcd(rate.numerator, rate.denominator);
+    rate = {rate.numerator / divisor, rate.denominator / divisor};
+    return true;
+}
+}
+
+namespace Project {
+
+ProjectSettings defaults()
+{
+    return {1920, 1080, {30, 1}, 48000};
+}
+
+bool isValid(const ProjectSettings &settings)
+{
+    // 4:2:0 needs even sizes, and the tick rate must divide into frames
+    // and samples exactly
+    return settings.width >= 16 && settings.width <= kMaxSize && settings.width % 2 == 0
+        && settings.height >= 16 && settings.height <= kMaxSize && settings.height % 2 == 0
+        && settings.frameRate.numerator > 0 && settings.frameRate.denominator > 0
+        && Timebase::kTicksPerSecond * settings.frameRate.denominator % settings.frameRate.numerator == 0
+        && settings.sampleRate > 0 && Timebase::kTicksPerSecond % settings.sampleRate == 0;
+}
+
+QString rateString(FrameRate rate)
+{
+    return QString("%1/%2").arg(rate.numerator).arg(rate.denominator);
+}
+
+QString encode(const ProjectSettings &settings)
+{
+    return QString("%1x%2, %3, %4")
+        .arg(settings.width)
+        .arg(settings.height)
+        .arg(rateString(settings.frameRate))
+        .arg(settings.sampleRate);
+}
+
+bool decode(const QString &text, ProjectSettings &settings)
+{
+    const QStringList fields = text.split(',');
+    if (fields.size() != 3) {
+        return false;
+    }
+    const QStringList size = fields[0].trimmed().split('x');
+    ProjectSettings decoded;
+    bool widthOk = false;
+    bool heightOk = false;
+    bool rateOk = false;
+    decoded.width = size.value(0).toInt(&widthOk);
+    decoded.height = size.value(1).toInt(&heightOk);
+    decoded.sampleRate = fields[2].trimmed().toInt(&rateOk);
+    if (size.size() != 2 || !widthOk || !heightOk || !rateOk
+        || !parseRate(fields[1], decoded.frameRate) || !isValid(decoded)) {
+        return false;
+    }
+    settings = decoded;
+    return true;
+}
+
+}
@@ -0,0 +1,182 @@
+#include "ScopeKernels.h"
+#include <vector>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define MVIDEO_SCOPE_SSE2
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define MVIDEO_SCOPE_NEON
+#endif
+
+namespace {
+// BT.709 in sevenths of a bit: each row sums to 128 (luma) or 0 (chroma),
+// and every product fits a signed 16-bit lane
+const int kYr = 27, kYg = 92, kYb = 9;
+const int kCbR = -15, kCbG = -49, kCbB = 64;
+const int kCrR = 64, kCrG = -58, kCrB = -6;
+
+inline uchar clampLevel(int value)
+{
+    return value < 0 ? 0 : (value > 255 ? 255 : uchar(value));
+}
+
+#if defined(MVIDEO_SCOPE_SSE2)
+// Eight pixels' red, green and blue widened to 16-bit lanes
+inline void loadRgb(const uchar *rgba, __m128i &r, __m128i &g, __m128i &b)
+{
+    const __m128i mask = _mm_set1_epi32(0xff);
+    const __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rgba));
+    const __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rgba + 16));
+    r = _mm_packs_epi32(_mm_and_si128(lo, mask), _mm_and_si128(hi, mask));
+    g = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(lo, 8), mask), _mm_and_si128(_mm_srli_epi32(hi, 8), mask));
+    b = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(lo, 16), mask), _mm_and_si128(_mm_srli_epi32(hi, 16), mask));
+}
+
+// (kr * r + kg * g + kb * b + 64) >> 7, plus offset, saturated to bytes
+inline __m128i weigh(__m128i r, __m128i g, __m128i b, int kr, int kg, int kb, int offset)
+{
+    __m128i sum = _mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(short(kr))),
+                                _mm_mullo_epi16(g, _mm_set1_epi16(short(kg))));
+    sum = _mm_add_epi16(sum, _mm_mullo_epi16(b, _mm_set1_epi16(short(kb))));
+    sum = _mm_srai_epi16(_mm_add_epi16(sum, _mm_set1_epi16(64)), 7);
+    sum = _mm_add_epi16(sum, _mm_set1_epi16(short(offset)));
+    return _mm_packus_epi16(sum, sum);
+}
+#elif defined(MVIDEO_SCOPE_NEON)
+inline uint8x8_t weigh(uint8x8x4_t pixels, int kr, int kg, int kb, int offset)
+{
+    const int16x8_t r = vreinterpretq_s16_u16(vmovl_u8(pixels.val[0]));
+    const int16x8_t g = vreinterpretq_s16_u16(vmovl_u8(pixels.val[1]));
+    const int16x8_t b = vreinterpretq_s16_u16(vmovl_u8(pixels.val[2]));
+    int16x8_t sum = vmulq_n_s16(r, short(kr));
+    sum = vmlaq_n_s16(sum, g, short(kg));
+    sum = vmlaq_n_s16(sum, b, short(kb));
+    sum = vshrq_n_s16(vaddq_s16(sum, vdupq_n_s16(64)), 7);
+    return vqmovun_s16(vaddq_s16(sum, vdupq_n_s16(short(offset))));
+}
+#endif
+
+inline int weighPixel(const uchar *pixel, int kr, int kg, int kb)
+{
+    return (kr * pixel[0] + kg * pixel[1] + kb * pixel[2] + 64) >> 7;
+}
+}
+
+namespace ScopeKernels {
+
+void lumaRow(const uchar *rgba, int width, uchar *luma)
+{
+    int x = 0;
+#if defined(MVIDEO_SCOPE_SSE2)
+    for (; x + 8 <= width; x += 8) {
+        __m128i r, g, b;
+        loadRgb(rgba + 4 * x, r, g, b);
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(luma + x), weigh(r, g, b, kYr, kYg, kYb, 0));
+    }
+#elif defined(MVIDEO_SCOPE_NEON)
+    for (; x + 8 <= width; x += 8) {
+        vst1_u8(luma + x, weigh(vld4_u8(rgba + 4 * x), kYr, kYg, kYb, 0));
+    }
+#endif
+    for (; x < width; ++x) {
+        luma[x] = clampLevel(weighPixel(rgba + 4 * x, kYr, kYg, kYb));
+    }
+}
+
+void chromaRow(const uchar *rgba, int width, uchar *cb, uchar *cr)
+{
+    int x = 0;
+#if defined(MVIDEO_SCOPE_SSE2)
+    for (; x + 8 <= width; x += 8) {
+        __m128i r, g, b;
+        loadRgb(rgba + 4 * x, r, g, b);
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(cb + x), weigh(r, g, b, kCbR, kCbG, kCbB, 128));
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(cr + x), weigh(r, g, b, kCrR, kCrG, kCrB, 128));
+    }
+#elif defined(MVIDEO_SCOPE_NEON)
+    for (; x + 8 <= width; x += 8) {
+        const uint8x8x4_t pixels = vld4_u8(rgba + 4 * x);
+        vst1_u8(cb + x, weigh(pixels, kCbR, kCbG, kCbB, 128));
+        vst1_u8(cr + x, weigh(pixels, kCrR, kCrG, kCrB, 128));
+    }
+#endif
+    for (; x < width; ++x) {
+        cb[x] = clampLevel(weighPixel(rgba + 4 * x, kCbR, kCbG, kCbB) + 128);
+        cr[x] = clampLevel(weighPixel(rgba + 4 * x, kCrR, kCrG, kCrB) + 128);
+    }
+}
+
+void waveform(const uchar *rgba, int width, int height, int stride, quint32 *bins)
+{
+    std::vector<uchar> luma(width);
+    for (int y = 0; y < height; ++y) {
+        lumaRow(rgba + qint64(y) * stride, width, luma.data());
+        quint32 *column = bins;
+        for (int x = 0; x < width; ++x, column += kLevels) {
+            ++column[luma[x]];
+        }
+    }
+}
+
+void parade(const uchar *rgba, int width, int height, int stride, quint32 *bins)
+{
+    // The levels are the bytes themselves, so there is nothing to convert
+    const qint64 plane = qint64(width) * kLevels;
+    for (int y = 0; y < height; ++y) {
+        const uchar *pixel = rgba + qint64(y) * stride;
+        quint32 *column = bins;
+        for (int x = 0; x < width; ++x, pixel += 4, column += kLevels) {
+            ++column[pixel[0]];
+            ++column[plane + pixel[1]];
+            ++column[2 * plane + pixel[2]];
+        }
+    }
+}
+
+void vectorscope(const uchar *rgba, int width, int height, int stride, quint32 *bins)
+{
+    std::vector<uchar> cb(width);
+    std::vector<uchar> cr(width);
+    for (int y = 0; y < height; ++y) {
+        chromaRow(rgba + qint64(y) * stride, width, cb.data(), cr.data());
+        for (int x = 0; x < width; ++x) {
+            ++bins[cr[x] * kLevels + cb[x]];
+        }
+    }
+}
+
+void histogram(const uchar *rgba, int width, int height, int stride, quint32 *bins)
+{
+    // Two sets of bins taken in turn, so runs of equal pixels don't wait
+    // on their own increments
+    std::vector<quint32> odd(4 * kLevels, 0);
+    std::vector<uchar> luma(width);
+    for (int y = 0; y < height; ++y) {
+        const uchar *row = rgba + qint64(y) * stride;
+        lumaRow(row, width, luma.data());
+        int x = 0;
+        for (; x + 2 <= width; x += 2) {
+            const uchar *pixel = row + 4 * x;
+            ++bins[pixel[0]];
+            ++bins[kLevels + pixel[1]];
+            ++bins[2 * kLevels + pixel[2]];
+            ++bins[3 * kLevels + luma[x]];
+            ++odd[pixel[4]];
+            ++odd[kLevels + pixel[5]];
+            ++odd[2 * kLevels + pixel[6]];
+            ++odd[3 * kLevels + luma[x + 1]];
+        }
+        if (x < width) {
+            const uchar *pixel = row + 4 * x;
+            ++bins[pixel[0]];
+            ++bins[kLevels + pixel[1]];
+            ++bins[2 * kLevels + pixel[2]];
+            ++bins[3 * kLevels + luma[x]];
+        }
+    }
+    for (int i = 0; i < 4 * kLevels; ++i) {
+        bins[i] += odd[i];
+    }
+}
+
+} // namespace ScopeKernels
@@ -0,0 +1,79 @@
+#include "ScopesPanel.h"
+#include "VideoScopes.h"
+#include <QPainter>
+
+namespace {
+const int kTitleHeight = 16;
+
+const char *const kScopeNames[VideoScopes::ScopeCount] = {
+    "Waveform", "RGB Parade", "Vectorscope", "Histogram"
+};
+}
+
+ScopesPanel::ScopesPanel(VideoScopes *scopes, QWidget *parent)
+    : QWidget(parent)
+    , m_scopes(scopes)
+{
+    // Redrawn as often as the scopes update, which is throttled
+    connect(m_scopes, &VideoScopes::updated, this, [this]() { update(); });
+}
+
+QSize ScopesPanel::sizeHint() const
+{
+    return QSize(520, 2 * (256 + kTitleHeight) + kTitleHeight);
+}
+
+void ScopesPanel::showEvent(QShowEvent *event)
+{
+    QWidget::showEvent(event);
+    m_scopes->setEnabled(true);
+}
+
+void ScopesPanel::hideEvent(QHideEvent *event)
+{
+    QWidget::hideEvent(event);
+    m_scopes->setEnabled(false);
+}
+
+void ScopesPanel::paintEvent(QPaintEvent *event)
+{
+    Q_UNUSED(event);
+    QPainter painter(this);
+    painter.fillRect(rect(), QColor(20, 20, 20));
+    painter.setPen(QColor(200, 200, 200));
+
+    const int cellWidth = width() / 2;
+    const int cellHeight = (height() - kTitleHeight) / 2;
+    for (int scope = 0; scope < VideoScopes::ScopeCount; ++scope) {
+        const QRect cell((scope % 2) * cellWidth, (scope / 2) * cellHeight, cellWidth, cellHeight);
+        const double ms = m_scopes->computeMs(VideoScopes::Scope(scope));
+        const QString title = ms < 0 ? QString(kScopeNames[scope])
+                                     : QString("%1  %2 ms").arg(kScopeNames[scope]).arg(ms, 0, 'f', 2);
+        painter.drawText(QRect(cell.left() + 4, cell.top(), cell.width() - 8, kTitleHeight),
+                         Qt::AlignLeft | Qt::AlignVCenter, title);
+
+        const QRect area = cell.adjusted(4, kTitleHeight, -4, -4);
+        const QImage image = m_scopes->image(VideoScopes::Scope(scope));
+        if (image.isNull() || area.isEmpty()) {
+            continue;
+        }
+        // The vectorscope keeps its square, the rest fill their cell
+        QRect target = area;
+        if (scope == VideoScopes::Vectorscope) {
+            const int side = std::min(area.width(), area.height());
+            target = QRect(area.center().x() - side / 2, area.top(), side, side);
+            painter.drawImage(target, image);
+            painter.setPen(QColor(90, 90, 90));
+            painter.drawEllipse(target);
+            painter.drawLine(target.center().x(), target.top(), target.center().x(), target.bottom());
+            painter.drawLine(target.left(), target.center().y(), target.right(), target.center().y());
+            painter.setPen(QColor(200, 200, 200));
+        } else {
+            painter.drawImage(target, image);
+        }
+    }
+
+    const double fps = m_scopes->framesPerSecond();
+    painter.drawText(QRect(4, height() - kTitleHeight, width() - 8, kTitleHeight), Qt::AlignLeft | Qt::AlignVCenter,
+                     tr("%1 updates/s, at most %2").arg(fps, 0, 'f', 1).arg(VideoScopes::kMaxRate));
+}
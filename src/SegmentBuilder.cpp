@@ -0,0 +1,207 @@
+#include "SegmentBuilder.h"
+#include "ConformCache.h"
+#include "ImageSequence.h"
+#include "Nesting.h"
+#include "SequenceFlattener.h"
+#include "Timeline.h"
+#include "Transition.h"
+#include "TransitionCache.h"
+#include <QStringList>
+#include <algorithm>
+
+SegmentBuilder::SegmentBuilder(Timeline *timeline, ConformCache *conformCache, TransitionCache *transitionCache,
+                               SequenceFlattener *sequenceFlattener)
+    : m_timeline(timeline)
+    , m_conformCache(conformCache)
+    , m_transitionCache(transitionCache)
+    , m_sequenceFlattener(sequenceFlattener)
+{
+}
+
+QVector<TimelineSegment> SegmentBuilder::build() const
+{
+    QVector<TimelineSegment> segments;
+    m_conformCache->setSettings(m_timeline->settings());
+    m_sequenceFlattener->beginPass();
+    const QVector<Clip> &clips = m_timeline->clips();
+    QVector<int> order;
+    for (int i = 0; i < clips.size(); ++i) {
+        order.append(i);
+    }
+    std::stable_sort(order.begin(), order.end(), [&clips](int a, int b) {
+        return clips[a].startTime() < clips[b].startTime();
+    });
+
+    Ticks cursor = 0;
+    for (int index : order) {
+        const Clip &clip = clips[index];
+        if (clip.duration() <= 0) {
+            continue;
+        }
+
+        Ticks start = clip.startTime();
+        if (start < 0) {
+            start = 0;
+        }
+
+        if (start > cursor) {
+            segments.append(gapSegment(cursor, start - cursor));
+            cursor = start;
+        }
+
+        // Compound clips play their sequence's sources in its place, and
+        // black if it can't be flattened
+        if (Nesting::isCompound(clip.filePath())) {
+            QVector<SequenceFlattener::Piece> pieces;
+            if (!m_sequenceFlattener->expand(Nesting::sequenceName(clip.filePath()), start, clip.trimStart(),
+                                             clip.duration(), pieces)) {
+                pieces = {{QString(), start, clip.duration(), 0, true}};
+            }
+            for (const SequenceFlattener::Piece &piece : pieces) {
+                if (piece.isGap) {
+                    segments.append(gapSegment(piece.start, piece.duration));
+                    continue;
+                }
+                TimelineSegment segment;
+                segment.timelineStart = piece.start;
+                segment.duration = piece.duration;
+                segment.trimStart = piece.trimStart;
+                segment.isGap = false;
+                segment.isTransition = false;
+                segment.source = piece.source;
+                m_conformCache->request(segment.source);
+                segments.append(segment);
+            }
+            cursor = std::max(cursor, start + clip.duration());
+            continue;
+        }
+
+        Ticks trimStart = clip.trimStart();
+        Ticks duration = clip.duration();
+
+        // A transition replaces the head of the clip with its cached render,
+        // or with the live lavfi graph while the render is being made
+        TransitionSpec spec;
+        QByteArray key;
+        if (m_timeline->transitionAt(index, spec, &key)) {
+            TimelineSegment transitionSegment;
+            transitionSegment.timelineStart = start;
+            transitionSegment.duration = spec.duration;
+            transitionSegment.trimStart = 0;
+            transitionSegment.isGap = false;
+            transitionSegment.isTransition = true;
+            transitionSegment.source = m_transitionCache->renderedFile(key);
+            if (transitionSegment.source.isEmpty()) {
+                m_transitionCache->request(spec);
+                transitionSegment.lavfiGraph = Transitions::lavfiGraph(spec, Transitions::NoSound);
+                transitionSegment.source = "av://lavfi:" + transitionSegment.lavfiGraph;
+            }
+            segments.append(transitionSegment);
+            start += spec.duration;
+            trimStart += spec.duration;
+            duration -= spec.duration;
+        }
+
+        TimelineSegment segment;
+        segment.timelineStart = start;
+        segment.duration = duration;
+        segment.trimStart = trimStart;
+        segment.isGap = false;
+        segment.isTransition = false;
+        segment.source = clip.filePath();
+        m_conformCache->request(segment.source);
+        segments.append(segment);
+        cursor = std::max(cursor, start + duration);
+    }
+
+    // Audio running past the last clip plays over black
+    const Ticks end = m_timeline->totalDuration();
+    if (end > cursor) {
+        segments.append(gapSegment(cursor, end - cursor));
+    }
+    m_sequenceFlattener->endPass();
+    return segments;
+}
+
+QStringList SegmentBuilder::edlParts(const QVector<TimelineSegment> &segments, int first, int last) const
+{
+    // MPV EDL format: edl://[clip1];[clip2];[clip3]...
+    // Each clip: [file_path,start,length] or [file_path]
+    // Example: edl://video1.mp4,10,5;video2.mp4,0,3
+    QStringList parts;
+    for (int i = first; i <= last && i < segments.size(); ++i) {
+        const TimelineSegment &segment = segments[i];
+        if (segment.isGap) {
+            parts.append(segment.source);
+            continue;
+        }
+
+        // Live transition graphs are full of ',' and ';', so they use
+        // mpv's length-prefixed form
+        if (!segment.lavfiGraph.isEmpty()) {
+            parts.append("%" + QString::number(segment.source.toUtf8().size()) + "%" + segment.source
+                         + ",0," + Timebase::toEdlSeconds(segment.duration));
+            continue;
+        }
+
+        // Sequences play from a frame list, whose path goes in
+        // length-prefixed
+        if (ImageSequence::isSequence(segment.source)) {
+            const QString source = ImageSequence::mpvSourceFor(segment.source);
+            parts.append("%" + QString::number(source.toUtf8().size()) + "%" + source
+                         + "," + Timebase::toEdlSeconds(segment.trimStart)
+                         + "," + Timebase::toEdlSeconds(segment.duration));
+            continue;
+        }
+
+        // The clip with its trim, from its conformed render once there is
+        // one, with EDL's special characters escaped
+        QString filePath = m_conformCache->playableFile(segment.source);
+        filePath.replace(";", "\\;");
+        filePath.replace(",", "\\,");
+        if (segment.trimStart > 0 || segment.duration > 0) {
+            parts.append(QString("%1,%2,%3")
+                             .arg(filePath)
+                             .arg(Timebase::toEdlSeconds(segment.trimStart))
+                             .arg(Timebase::toEdlSeconds(segment.duration)));
+        } else {
+            parts.append(filePath);
+        }
+    }
+    return parts;
+}
+
+TimelineSegment SegmentBuilder::gapSegment(Ticks start, Ticks duration) const
+{
+    TimelineSegment segment;
+    segment.timelineStart = start;
+    segment.duration = duration;
+    segment.trimStart = 0;
+    segment.isGap = true;
+    segment.isTransition = false;
+    segment.source = gapSource(duration);
+    return segment;
+}
+
+QString SegmentBuilder::gapSource(Ticks duration) const
+{
+    const ProjectSettings &settings = m_timeline->settings();
+    const QString filler = m_conformCache->fillerFile();
+    if (filler.isEmpty()) {
+        // Until the filler is rendered
+        return QString("lavfi:color=c=black:s=%1x%2:r=%3:d=%4")
+            .arg(settings.width)
+            .arg(settings.height)
+            .arg(Project::rateString(settings.frameRate))
+            .arg(Timebase::toEdlSeconds(duration));
+    }
+
+    // Every gap trims the one filler; longer gaps repeat it
+    const QString source = "%" + QString::number(filler.toUtf8().size()) + "%" + filler;
+    const Ticks fillerLength = Timebase::kTicksPerSecond * ConformCache::kFillerSeconds;
+    QStringList parts;
+    for (Ticks left = duration; left > 0; left -= fillerLength) {
+        parts.append(source + ",0," + Timebase::toEdlSeconds(std::min(left, fillerLength)));
+    }
+    return parts.join(";");
+}
@@ -0,0 +1,161 @@
+#include "SequenceFlattener.h"
+#include "Nesting.h"
+#include "Timeline.h"
+#include <QDebug>
+#include <algorithm>
+
+SequenceFlattener::SequenceFlattener(const Timeline *timeline)
+    : m_timeline(timeline)
+    , m_hits(0)
+    , m_misses(0)
+    , m_passHits(0)
+    , m_passMisses(0)
+    , m_passDepth(0)
+    , m_lastPassMs(0.0)
+{
+}
+
+void SequenceFlattener::beginPass()
+{
+    m_passHits = 0;
+    m_passMisses = 0;
+    m_passDepth = 0;
+    m_passTimer.start();
+}
+
+void SequenceFlattener::endPass()
+{
+    m_lastPassMs = m_passTimer.isValid() ? m_passTimer.nsecsElapsed() / 1e6 : 0.0;
+}
+
+bool SequenceFlattener::expand(const QString &name, Ticks start, Ticks trimStart, Ticks duration,
+                               QVector<Piece> &pieces)
+{
+    Entry entry;
+    if (!flatten(name, entry)) {
+        return false;
+    }
+    m_passDepth = std::max(m_passDepth, entry.depth + 1);
+    slice(entry, start, trimStart, duration, pieces);
+    return true;
+}
+
+SequenceFlattener::Stats SequenceFlattener::stats() const
+{
+    Stats stats;
+    stats.cached = m_entries.size();
+    stats.depth = m_passDepth;
+    stats.passHits = m_passHits;
+    stats.passMisses = m_passMisses;
+    stats.hits = m_hits;
+    stats.misses = m_misses;
+    stats.lastPassMs = m_lastPassMs;
+    return stats;
+}
+
+bool SequenceFlattener::isCurrent(const Entry &entry, const QString &name) const
+{
+    if (m_timeline->sequenceVersion(name) != entry.version) {
+        return false;
+    }
+    for (auto it = entry.dependencies.constBegin(); it != entry.dependencies.constEnd(); ++it) {
+        if (m_timeline->sequenceVersion(it.key()) != it.value()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool SequenceFlattener::flatten(const QString &name, Entry &entry)
+{
+    if (m_stack.contains(name)) {
+        qDebug() << "Sequence" << name << "contains itself";
+        return false;
+    }
+
+    auto cached = m_entries.constFind(name);
+    if (cached != m_entries.constEnd() && isCurrent(cached.value(), name)) {
+        ++m_hits;
+        ++m_passHits;
+        entry = cached.value();
+        return true;
+    }
+
+    QVector<Clip> clips;
+    if (!m_timeline->sequenceClips(name, clips, entry.version)) {
+        qDebug() << "No sequence named" << name;
+        return false;
+    }
+    ++m_misses;
+    ++m_passMisses;
+    entry.dependencies.clear();
+    entry.pieces.clear();
+    entry.depth = 0;
+
+    std::stable_sort(clips.begin(), clips.end(), [](const Clip &a, const Clip &b) {
+        return a.startTime() < b.startTime();
+    });
+
+    // The same walk as the top level: black between clips, each clip from
+    // its trim point
+    m_stack.append(name);
+    Ticks cursor = 0;
+    bool ok = true;
+    for (const Clip &clip : clips) {
+        if (clip.duration() <= 0) {
+            continue;
+        }
+        const Ticks start = std::max<Ticks>(0, clip.startTime());
+        if (start > cursor) {
+            entry.pieces.append({QString(), cursor, start - cursor, 0, true});
+        }
+
+        if (Nesting::isCompound(clip.filePath())) {
+            const QString inner = Nesting::sequenceName(clip.filePath());
+            Entry nested;
+            if (!flatten(inner, nested)) {
+                ok = false;
+                break;
+            }
+            entry.dependencies.insert(inner, nested.version);
+            entry.dependencies.insert(nested.dependencies);
+            entry.depth = std::max(entry.depth, nested.depth + 1);
+            slice(nested, start, clip.trimStart(), clip.duration(), entry.pieces);
+        } else {
+            entry.pieces.append({clip.filePath(), start, clip.duration(), clip.trimStart(), false});
+        }
+        cursor = std::max(cursor, start + clip.duration());
+    }
+    m_stack.removeLast();
+    if (!ok) {
+        return false;
+    }
+
+    entry.length = cursor;
+    m_entries.insert(name, entry);
+    return true;
+}
+
+void SequenceFlattener::slice(const Entry &entry, Ticks start, Ticks trimStart, Ticks duration,
+                              QVector<Piece> &pieces)
+{
+    const Ticks windowEnd = trimStart + duration;
+    for (const Piece &piece : entry.pieces) {
+        const Ticks from = std::max(piece.start, trimStart);
+        const Ticks to = std::min(piece.start + piece.duration, windowEnd);
+        if (from >= to) {
+            continue;
+        }
+        Piece placed = piece;
+        placed.start = start + (from - trimStart);
+        placed.duration = to - from;
+        placed.trimStart = piece.isGap ? 0 : piece.trimStart + (from - piece.start);
+        pieces.append(placed);
+    }
+
+    // A clip trimmed longer than its sequence holds black
+    const Ticks tail = std::max(trimStart, entry.length);
+    if (windowEnd > tail) {
+        pieces.append({QString(), start + (tail - trimStart), windowEnd - tail, 0, true});
+    }
+}
@@ -0,0 +1,63 @@
+#include "SequencePrefetcher.h"
+#include <QFile>
+
+namespace {
+const int kReadChunk = 4 * 1024 * 1024;
+
+// About ten seconds of frames at 24 fps
+const int kRecentFrames = 256;
+
+// Runs on a worker. Read and thrown away; the page cache keeps it for mpv.
+void readFrame(const QString &path)
+{
+    thread_local QByteArray buffer(kReadChunk, Qt::Uninitialized);
+    QFile file(path);
+    if (file.open(QIODevice::ReadOnly | QIODevice::Unbuffered)) {
+        while (file.read(buffer.data(), buffer.size()) > 0) {
+        }
+    }
+}
+}
+
+SequencePrefetcher::SequencePrefetcher(JobScheduler *jobs, QObject *parent)
+    : QObject(parent)
+    , m_jobs(jobs)
+{
+}
+
+SequencePrefetcher::~SequencePrefetcher()
+{
+    m_token.cancel();
+}
+
+void SequencePrefetcher::prefetch(const QStringList &paths)
+{
+    // Frames dropped from the queue unread may be asked for again
+    m_token.cancel();
+    m_token = CancelToken();
+    for (const QString &path : m_queue) {
+        m_recent.remove(path);
+        m_recentOrder.removeOne(path);
+    }
+    m_queue.clear();
+
+    // One job a frame, so the reads spread over the workers
+    for (const QString &path : paths) {
+        if (m_recent.contains(path)) {
+            continue;
+        }
+        m_queue.insert(path);
+        m_recent.insert(path);
+        m_recentOrder.append(path);
+        m_jobs->submit(JobScheduler::Visible,
+                       [path](const JobScheduler::Context &) {
+                           readFrame(path);
+                           return QVariant();
+                       },
+                       [this, path](const QVariant &) { m_queue.remove(path); },
+                       QVector<JobScheduler::JobId>(), m_token);
+    }
+    while (m_recentOrder.size() > kRecentFrames) {
+        m_recent.remove(m_recentOrder.takeFirst());
+    }
+}
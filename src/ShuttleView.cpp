@@ -0,0 +1,45 @@
+#include "ShuttleView.h"
+#include <QPainter>
+#include <cstdlib>
+
+ShuttleView::ShuttleView(QWidget *parent)
+    : QWidget(parent)
+    , m_speed(0)
+{
+    setAttribute(Qt::WA_OpaquePaintEvent);
+}
+
+void ShuttleView::setFrame(const QImage &frame)
+{
+    m_frame = frame;
+    update();
+}
+
+void ShuttleView::setSpeed(int speed)
+{
+    m_speed = speed;
+    update();
+}
+
+void ShuttleView::paintEvent(QPaintEvent *event)
+{
+    Q_UNUSED(event);
+
+    QPainter painter(this);
+    painter.fillRect(rect(), Qt::black);
+
+    if (!m_frame.isNull()) {
+        QSize size = m_frame.size();
+        size.scale(this->size(), Qt::KeepAspectRatio);
+        const QRect target(QPoint((width() - size.width()) / 2, (height() - size.height()) / 2), size);
+        painter.setRenderHint(QPainter::SmoothPixmapTransform);
+        painter.drawImage(target, m_frame);
+    }
+
+    if (m_speed != 0) {
+        const QString arrows = m_speed < 0 ? QString("<<") : QString(">>");
+        painter.setPen(Qt::white);
+        painter.drawText(rect().adjusted(12, 8, -12, -8), Qt::AlignTop | Qt::AlignLeft,
+                         QString("%1 %2x").arg(arrows).arg(std::abs(m_speed)));
+    }
+}
@@ -0,0 +1,773 @@
+#include "SmartExporter.h"
+#include "KeyframeIndexer.h"
+#include "AudioMixer.h"
+#include "ImageSequence.h"
+#include <QDebug>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QThread>
+#include <algorithm>
+
+namespace {
+// Chunk lengths; copying is cheap enough that shorter chunks would be
+// dominated by ffmpeg startup
+const Ticks kEncodeChunk = 20 * Timebase::kTicksPerSecond;
+const Ticks kCopyChunk = 120 * Timebase::kTicksPerSecond;
+
+const int kMaxAttempts = 3;
+
+// Relative cost of a second of output, against encoding a second of 1080p
+const double kCopyCost = 0.02;
+const double kGapCost = 0.25;
+
+// Encoder that writes the same bitstream format a source codec uses
+QString encoderFor(const QString &codec)
+{
+    if (codec == "h264") {
+        return "libx264";
+    }
+    if (codec == "hevc") {
+        return "libx265";
+    }
+    if (codec == "vp9") {
+        return "libvpx-vp9";
+    }
+    if (codec == "mpeg4") {
+        return "mpeg4";
+    }
+    return QString();
+}
+
+// libx264's and libx265's names for the profiles ffprobe reports, or
+// empty to leave the encoder's default
+QString encoderProfile(const QString &encoder, const QString &profile)
+{
+    static const QHash<QString, QString> x264 = {
+        {"Constrained Baseline", "baseline"}, {"Baseline", "baseline"}, {"Main", "main"}, {"High", "high"},
+        {"High 10", "high10"}, {"High 4:2:2", "high422"}, {"High 4:4:4 Predictive", "high444"}};
+    static const QHash<QString, QString> x265 = {
+        {"Main", "main"}, {"Main 10", "main10"}, {"Main Still Picture", "mainstillpicture"}};
+    if (encoder == "libx264") {
+        return x264.value(profile);
+    }
+    if (encoder == "libx265") {
+        return x265.value(profile);
+    }
+    return QString();
+}
+
+// Runs on a worker: one ffmpeg run, and what it printed if it failed
+QVariant runFfmpeg(JobScheduler *jobs, const QStringList &arguments, const CancelToken &token,
+                   const JobScheduler::Output &output = JobScheduler::Output())
+{
+    QByteArray errors;
+    const bool ok = jobs->streamProcess("ffmpeg", arguments, token, output, &errors);
+    return QVariantMap{{"ok", ok}, {"errors", QString::fromUtf8(errors).trimmed()}};
+}
+
+FrameRate parseFrameRate(const QString &text)
+{
+    const QStringList parts = text.split('/');
+    FrameRate rate = {parts.value(0).toInt(), parts.size() > 1 ? parts[1].toInt() : 1};
+    if (rate.numerator <= 0 || rate.denominator <= 0) {
+        rate = {30, 1};
+    }
+    return rate;
+}
+}
+
+SmartExporter::SmartExporter(KeyframeIndexer *indexer, JobScheduler *jobs, QObject *parent)
+    : QObject(parent)
+    , m_indexer(indexer)
+    , m_jobs(jobs)
+    , m_probesLeft(0)
+    , m_donePieces(0)
+    , m_waitingForIndexes(false)
+    , m_streamCopyEnabled(true)
+    , m_audioMixer(nullptr)
+    , m_settings(Project::defaults())
+    , m_hasMix(false)
+    , m_mixing(false)
+    , m_mixOk(false)
+    , m_encodeMs(0)
+    , m_busyMs(0)
+    , m_copiedTicks(0)
+    , m_encodedTicks(0)
+    , m_copiedPieces(0)
+    , m_retries(0)
+{
+    setWorkerCount(JobScheduler::kMaxProcesses);
+    connect(m_indexer, &KeyframeIndexer::indexed, this, &SmartExporter::onIndexReady);
+    connect(m_indexer, &KeyframeIndexer::failed, this, &SmartExporter::onIndexReady);
+}
+
+SmartExporter::~SmartExporter()
+{
+    // Running chunks are killed; the work directory goes with the last
+    m_token.cancel();
+}
+
+void SmartExporter::setWorkerCount(int count)
+{
+    if (isRunning()) {
+        return;
+    }
+
+    // More could only wait for a process slot
+    const Worker idle = {-1, QElapsedTimer()};
+    m_workers.fill(idle, qBound(1, count, JobScheduler::kMaxProcesses));
+}
+
+bool SmartExporter::isRunning() const
+{
+    return m_waitingForIndexes || m_probesLeft > 0 || m_workDir != nullptr;
+}
+
+void SmartExporter::start(const QVector<ExportSegment> &segments, const QString &outputPath)
+{
+    if (isRunning()) {
+        emit finished(false, "An export is already running");
+        return;
+    }
+
+    m_segments = segments;
+    m_outputPath = outputPath;
+    m_pieces.clear();
+    m_queue.clear();
+    m_donePieces = 0;
+    m_encodeMs = 0;
+    m_busyMs = 0;
+    m_copiedTicks = 0;
+    m_encodedTicks = 0;
+    m_copiedPieces = 0;
+    m_retries = 0;
+    m_token = CancelToken();
+    m_timer.start();
+
+    // Cut points come from the keyframe indexes, so wait for any still
+    // being built
+    for (const ExportSegment &segment : m_segments) {
+        if (!segment.isGap && !segment.isLavfi) {
+            m_indexer->index(segment.source, JobScheduler::Visible);
+            m_waitingForIndexes = m_waitingForIndexes || m_indexer->isIndexing(segment.source);
+        }
+    }
+    if (!m_waitingForIndexes) {
+        probeSources();
+    }
+}
+
+void SmartExporter::cancel()
+{
+    if (isRunning()) {
+        finish(false, "Export cancelled");
+    }
+}
+
+void SmartExporter::onIndexReady()
+{
+    if (!m_waitingForIndexes) {
+        return;
+    }
+    for (const ExportSegment &segment : m_segments) {
+        if (!segment.isGap && !segment.isLavfi && m_indexer->isIndexing(segment.source)) {
+            return;
+        }
+    }
+    m_waitingForIndexes = false;
+    probeSources();
+}
+
+void SmartExporter::probeSources()
+{
+    QStringList sources;
+    for (const ExportSegment &segment : m_segments) {
+        if (!segment.isGap && !segment.isLavfi && !sources.contains(segment.source)) {
+            sources.append(segment.source);
+        }
+    }
+    m_sources.clear();
+    if (sources.isEmpty()) {
+        plan();
+        return;
+    }
+
+    // Every source is probed at once, off the GUI thread, and the export
+    // is planned when the last probe is in
+    m_probesLeft = sources.size();
+    for (const QString &source : sources) {
+        QStringList arguments;
+        arguments << "-v" << "error"
+                  << "-show_entries"
+                  << "stream=codec_type,codec_name,profile,level,refs,width,height,pix_fmt,r_frame_rate,start_time"
+                     ":format=start_time"
+                  << "-of" << "json"
+                  << ImageSequence::inputArguments(source, m_settings.frameRate);
+        JobScheduler *jobs = m_jobs;
+        const CancelToken token = m_token;
+        m_jobs->submit(JobScheduler::Interactive,
+                       [jobs, arguments, token](const JobScheduler::Context &) {
+                           QByteArray output;
+                           return jobs->runProcess("ffprobe", arguments, token, &output, 10000) ? QVariant(output)
+                                                                                               : QVariant();
+                       },
+                       [this, source, token](const QVariant &result) {
+                           if (token.isCancelled()) {
+                               return;
+                           }
+                           SourceInfo info;
+                           if (!result.isValid() || !parseProbe(result.toByteArray(), info)) {
+                               finish(false, "Could not read " + source);
+                               return;
+                           }
+                           m_sources.insert(source, info);
+                           if (--m_probesLeft == 0) {
+                               plan();
+                           }
+                       },
+                       QVector<JobScheduler::JobId>(), token);
+    }
+}
+
+void SmartExporter::plan()
+{
+    QString firstSource;
+    for (const ExportSegment &segment : m_segments) {
+        if (!segment.isGap && !segment.isLavfi) {
+            firstSource = segment.source;
+            break;
+        }
+    }
+    if (firstSource.isEmpty()) {
+        finish(false, "The timeline has no clips to export");
+        return;
+    }
+
+    // The output is in the project's size and frame rate, with the first
+    // clip's codec; sources that match it can have their GOPs copied
+    m_output = m_sources.value(firstSource);
+    m_output.width = m_settings.width;
+    m_output.height = m_settings.height;
+    m_output.frameRate = Project::rateString(m_settings.frameRate);
+    m_encoder = encoderFor(m_output.codec);
+    if (m_encoder.isEmpty()) {
+        m_output.codec = "h264";
+        m_output.profile.clear();
+        m_output.level = 0;
+        m_output.refs = 0;
+        m_output.pixelFormat = "yuv420p";
+        m_encoder = "libx264";
+    }
+    // H.264 and HEVC pieces are MPEG-TS, whose Annex B streams carry the
+    // parameter sets in band at every keyframe. The concat demuxer keeps
+    // only the first piece's extradata, so that is what lets the joined
+    // stream decode across pieces encoded apart.
+    m_pieceSuffix = (m_output.codec == "h264" || m_output.codec == "hevc") ? ".ts" : ".mkv";
+
+    m_workDir = std::make_shared<QTemporaryDir>();
+    if (!m_workDir->isValid()) {
+        finish(false, "Could not create a temporary directory");
+        return;
+    }
+
+    for (const ExportSegment &segment : m_segments) {
+        planSegment(segment);
+    }
+    if (m_pieces.isEmpty()) {
+        finish(false, "The timeline has no frames to export");
+        return;
+    }
+
+    // The tracks' mix is rendered beside the chunks, and the join waits
+    // for it
+    m_hasMix = m_audioMixer && !m_audioMixer->isEmpty();
+    m_mixing = m_hasMix;
+    m_mixOk = false;
+    if (m_hasMix) {
+        const AudioMixer *mixer = m_audioMixer;
+        const std::shared_ptr<QTemporaryDir> workDir = m_workDir;
+        m_jobs->submit(JobScheduler::Visible,
+                       [mixer, workDir](const JobScheduler::Context &) {
+                           return mixer->renderWav(workDir->filePath("mix.wav"));
+                       },
+                       [this](const QVariant &result) { onMixFinished(result.toBool()); },
+                       QVector<JobScheduler::JobId>(), m_token);
+    }
+
+    // Longest first, so the big chunks don't end up trailing on one worker
+    for (int i = 0; i < m_pieces.size(); ++i) {
+        m_queue.append(i);
+    }
+    std::stable_sort(m_queue.begin(), m_queue.end(), [this](int a, int b) {
+        return m_pieces[a].cost > m_pieces[b].cost;
+    });
+
+    emit progress(0, m_pieces.size());
+    dispatch();
+}
+
+void SmartExporter::planSegment(const ExportSegment &segment)
+{
+    // Graphs are rendered like any encoded source, with no keyframes to cut at
+    if (segment.isLavfi) {
+        const int first = m_pieces.size();
+        addPieces(segment.source, nullptr, 0, segment.duration, false);
+        for (int i = first; i < m_pieces.size(); ++i) {
+            m_pieces[i].lavfi = true;
+        }
+        return;
+    }
+
+    const QString source = segment.isGap ? QString() : segment.source;
+    const KeyframeIndex *keyframes = segment.isGap ? nullptr : m_indexer->index(segment.source);
+    const Ticks end = segment.trimStart + segment.duration;
+    if (!keyframes || !canCopy(segment.source)) {
+        addPieces(source, keyframes, segment.trimStart, end, false);
+        return;
+    }
+
+    // Whole GOPs between the first and last keyframe inside the segment
+    // are copied; the partial GOPs either side are re-encoded
+    const Ticks copyStart = keyframes->keyframeAtOrAfter(segment.trimStart);
+    const Ticks copyEnd = keyframes->keyframeAtOrBefore(end);
+    if (copyStart < 0 || copyEnd <= copyStart) {
+        addPieces(source, keyframes, segment.trimStart, end, false);
+        return;
+    }
+
+    addPieces(source, keyframes, segment.trimStart, copyStart, false);
+    addPieces(source, keyframes, copyStart, copyEnd, true);
+    addPieces(source, keyframes, copyEnd, end, false);
+}
+
+void SmartExporter::addPieces(const QString &source, const KeyframeIndex *keyframes,
+                              Ticks start, Ticks end, bool copy)
+{
+    // Pieces shorter than half a frame hold no frames of their own
+    const Ticks minLength = Timebase::frameTicks(parseFrameRate(m_output.frameRate)) / 2;
+    const Ticks chunkLength = copy ? kCopyChunk : kEncodeChunk;
+    const double pixels = double(m_output.width) * m_output.height / (1920.0 * 1080.0);
+    const double costPerSecond = pixels * (copy ? kCopyCost : (source.isEmpty() ? kGapCost : 1.0));
+
+    Ticks pos = start;
+    while (end - pos >= minLength) {
+        // Chunks after the first start on a keyframe, so a copied chunk is
+        // whole GOPs and an encoded one decodes from its first frame
+        Ticks next = pos + chunkLength;
+        if (keyframes && next < end) {
+            next = keyframes->keyframeAtOrAfter(next);
+        }
+        if (next < 0 || next >= end || end - next < minLength) {
+            next = end;
+        }
+
+        Piece piece;
+        piece.source = source;
+        piece.lavfi = false;
+        piece.start = pos;
+        piece.duration = next - pos;
+        piece.copy = copy;
+        piece.cost = Timebase::toSeconds(piece.duration) * costPerSecond;
+        piece.attempts = 0;
+        const QString name = QString("piece%1").arg(m_pieces.size(), 5, 10, QChar('0'));
+        piece.file = m_workDir->filePath(name + m_pieceSuffix);
+        piece.audioFile = m_workDir->filePath(name + ".wav");
+        m_pieces.append(piece);
+        pos = next;
+    }
+}
+
+bool SmartExporter::parseProbe(const QByteArray &output, SourceInfo &info)
+{
+    info = SourceInfo();
+    info.level = 0;
+    info.refs = 0;
+    info.width = 0;
+    info.height = 0;
+    info.videoStart = 0;
+    info.hasAudio = false;
+    const QJsonObject probe = QJsonDocument::fromJson(output).object();
+    const double fileStart = probe.value("format").toObject().value("start_time").toString().toDouble();
+    const QJsonArray streams = probe.value("streams").toArray();
+    for (const QJsonValue &value : streams) {
+        const QJsonObject stream = value.toObject();
+        const QString type = stream.value("codec_type").toString();
+        if (type == "video" && info.codec.isEmpty()) {
+            info.codec = stream.value("codec_name").toString();
+            info.profile = stream.value("profile").toString();
+            info.level = stream.value("level").toInt();
+            info.refs = stream.value("refs").toInt();
+            info.pixelFormat = stream.value("pix_fmt").toString();
+            info.frameRate = stream.value("r_frame_rate").toString();
+            info.width = stream.value("width").toInt();
+            info.height = stream.value("height").toInt();
+            // Times are strings, and absent for image sequences
+            bool ok = false;
+            const double videoStart = stream.value("start_time").toString().toDouble(&ok);
+            if (ok) {
+                info.videoStart = std::max<Ticks>(0, Timebase::fromSeconds(videoStart - fileStart));
+            }
+        } else if (type == "audio") {
+            info.hasAudio = true;
+        }
+    }
+    return !info.codec.isEmpty();
+}
+
+bool SmartExporter::canCopy(const QString &source) const
+{
+    const SourceInfo info = m_sources.value(source);
+    return m_streamCopyEnabled
+        && info.codec == m_output.codec
+        && info.profile == m_output.profile
+        && info.pixelFormat == m_output.pixelFormat
+        && info.frameRate == m_output.frameRate
+        && info.width == m_output.width
+        && info.height == m_output.height;
+}
+
+int SmartExporter::threadsPerWorker() const
+{
+    return std::max(1, QThread::idealThreadCount() / int(m_workers.size()));
+}
+
+QStringList SmartExporter::pieceArguments(const Piece &piece) const
+{
+    const bool hasAudio = !piece.source.isEmpty() && !piece.lavfi && m_sources.value(piece.source).hasAudio;
+    QStringList arguments;
+    arguments << "-v" << "error" << "-y" << "-nostats" << "-progress" << "pipe:1";
+
+    if (piece.source.isEmpty()) {
+        arguments << "-f" << "lavfi"
+                  << "-i" << QString("color=c=black:s=%1x%2:r=%3")
+                                 .arg(m_output.width).arg(m_output.height).arg(m_output.frameRate);
+    } else if (piece.lavfi) {
+        arguments << "-f" << "lavfi";
+        if (piece.start > 0) {
+            arguments << "-ss" << Timebase::toEdlSeconds(piece.start);
+        }
+        arguments << "-i" << piece.source;
+    } else {
+        // Keyframe times count from the video stream's start and -ss from
+        // the file's, so the seek lands exactly on a copied piece's
+        // keyframe and its timestamps start at 0 from there, wherever the
+        // first packet's decode time falls
+        const Ticks seek = piece.start + m_sources.value(piece.source).videoStart;
+        arguments << "-ss" << Timebase::toEdlSeconds(seek)
+                  << ImageSequence::inputArguments(piece.source, m_settings.frameRate);
+    }
+    // Pieces without audio of their own get silence, so the joined audio
+    // keeps in step with the video
+    if (!hasAudio) {
+        arguments << "-f" << "lavfi" << "-i" << QString("anullsrc=r=%1:cl=stereo").arg(m_settings.sampleRate);
+    }
+    // Video and audio go to files of their own: the video is joined as it
+    // is, the audio is joined as PCM and encoded once
+    const QString duration = Timebase::toEdlSeconds(piece.duration);
+    arguments << "-map" << "0:v:0" << "-t" << duration << "-an";
+    if (piece.copy) {
+        arguments << "-c:v" << "copy";
+    } else {
+        // Workers share the cores rather than each starting a thread per core.
+        // Pieces cut from a copied source are encoded to match its GOPs.
+        const bool besideCopies = !piece.source.isEmpty() && !piece.lavfi && canCopy(piece.source);
+        arguments << "-c:v" << m_encoder
+                  << "-threads" << QString::number(threadsPerWorker())
+                  << encoderArguments(besideCopies ? m_sources.value(piece.source) : m_output)
+                  << "-pix_fmt" << m_output.pixelFormat
+                  << "-vf" << QString("scale=%1:%2:force_original_aspect_ratio=decrease,"
+                                      "pad=%1:%2:(ow-iw)/2:(oh-ih)/2,setsar=1,fps=%3")
+                                  .arg(m_output.width).arg(m_output.height).arg(m_output.frameRate);
+    }
+    arguments << piece.file;
+
+    // Padded with silence if the source's audio ends first, and cut to
+    // the piece's length to the sample
+    arguments << "-map" << (hasAudio ? "0:a:0" : "1:a:0") << "-t" << duration << "-vn"
+              << "-af" << "apad" << "-c:a" << "pcm_s16le"
+              << "-ar" << QString::number(m_settings.sampleRate) << "-ac" << "2"
+              << piece.audioFile;
+    return arguments;
+}
+
+QStringList SmartExporter::encoderArguments(const SourceInfo &info) const
+{
+    // The profile, level and reference count of the stream the piece
+    // joins, so its parameter sets fit the copied GOPs around it
+    QStringList arguments;
+    const QString profile = encoderProfile(m_encoder, info.profile);
+    if (m_encoder == "libx264") {
+        if (!profile.isEmpty()) {
+            arguments << "-profile:v" << profile;
+        }
+        if (info.level > 0) {
+            arguments << "-level:v" << QString::number(info.level / 10.0, 'f', 1);
+        }
+        if (info.refs > 0) {
+            arguments << "-refs" << QString::number(info.refs);
+        }
+    } else if (m_encoder == "libx265") {
+        if (!profile.isEmpty()) {
+            arguments << "-profile:v" << profile;
+        }
+        // HEVC levels are reported as 30 times the level number
+        QStringList parameters;
+        if (info.level > 0) {
+            parameters << "level-idc=" + QString::number(info.level / 30.0, 'f', 1);
+        }
+        if (info.refs > 0) {
+            parameters << "ref=" + QString::number(info.refs);
+        }
+        if (!parameters.isEmpty()) {
+            arguments << "-x265-params" << parameters.join(':');
+        }
+    }
+    return arguments;
+}
+
+void SmartExporter::dispatch()
+{
+    for (int i = 0; i < m_workers.size() && !m_queue.isEmpty(); ++i) {
+        Worker &worker = m_workers[i];
+        if (worker.piece >= 0) {
+            continue;
+        }
+
+        worker.piece = m_queue.takeFirst();
+        ++m_pieces[worker.piece].attempts;
+        worker.timer.start();
+        emit workerProgress(i, worker.piece, 0);
+        runPiece(i);
+    }
+}
+
+void SmartExporter::runPiece(int worker)
+{
+    const int pieceIndex = m_workers[worker].piece;
+    const Piece &piece = m_pieces[pieceIndex];
+    const QStringList arguments = pieceArguments(piece);
+    const qint64 durationUs = Timebase::toSeconds(piece.duration) * 1000000.0;
+    const int attempt = piece.attempts;
+    JobScheduler *jobs = m_jobs;
+    const std::shared_ptr<QTemporaryDir> workDir = m_workDir;
+    const CancelToken token = m_token;
+
+    // The job only reaches this object through calls the token drops
+    // once the export ends
+    m_jobs->submitProcess(
+        JobScheduler::Visible,
+        [this, jobs, arguments, durationUs, worker, pieceIndex, attempt, workDir, token](
+            const JobScheduler::Context &) {
+            // -progress writes key=value lines; out_time_us is the output position
+            QByteArray pending;
+            auto readProgress = [&](const QByteArray &chunk) {
+                pending += chunk;
+                QList<QByteArray> lines = pending.split('\n');
+                pending = lines.takeLast();
+                for (const QByteArray &line : lines) {
+                    if (line.startsWith("out_time_us=") && durationUs > 0) {
+                        const qint64 us = line.mid(12).toLongLong();
+                        const int percent = int(std::clamp<qint64>(us * 100 / durationUs, 0, 100));
+                        jobs->post(token, [this, worker, pieceIndex, attempt, percent]() {
+                            onPieceProgress(worker, pieceIndex, attempt, percent);
+                        });
+                    }
+                }
+            };
+            return runFfmpeg(jobs, arguments, token, readProgress);
+        },
+        [this, worker](const QVariant &result) {
+            const QVariantMap outcome = result.toMap();
+            onPieceFinished(worker, outcome.value("ok").toBool(), outcome.value("errors").toString());
+        },
+        QVector<JobScheduler::JobId>(), token);
+}
+
+void SmartExporter::onPieceProgress(int worker, int piece, int attempt, int percent)
+{
+    // Progress still on its way from a run that has finished is dropped
+    if (m_workers[worker].piece == piece && m_pieces[piece].attempts == attempt) {
+        emit workerProgress(worker, piece, percent);
+    }
+}
+
+void SmartExporter::onPieceFinished(int worker, bool ok, const QString &errors)
+{
+    Worker &w = m_workers[worker];
+    if (w.piece < 0) {
+        return;
+    }
+
+    const int pieceIndex = w.piece;
+    const qint64 elapsed = w.timer.elapsed();
+    w.piece = -1;
+    m_busyMs += elapsed;
+    emit workerProgress(worker, -1, 0);
+
+    const Piece &piece = m_pieces[pieceIndex];
+    if (!ok) {
+        qDebug() << "ffmpeg failed on chunk" << pieceIndex + 1 << ":" << errors;
+        // Only the failed chunk is redone; the rest of the export carries on
+        if (piece.attempts < kMaxAttempts) {
+            ++m_retries;
+            m_queue.prepend(pieceIndex);
+            dispatch();
+            return;
+        }
+        finish(false, QString("Chunk %1 failed after %2 attempts").arg(pieceIndex + 1).arg(piece.attempts)
+                          + (errors.isEmpty() ? QString() : ":\n" + errors.section('\n', -1)));
+        return;
+    }
+
+    if (piece.copy) {
+        m_copiedTicks += piece.duration;
+        ++m_copiedPieces;
+    } else {
+        m_encodedTicks += piece.duration;
+        m_encodeMs += elapsed;
+    }
+
+    ++m_donePieces;
+    emit progress(m_donePieces, m_pieces.size());
+    if (m_donePieces < m_pieces.size()) {
+        dispatch();
+    } else if (!m_mixing) {
+        runConcat();
+    }
+}
+
+void SmartExporter::onMixFinished(bool ok)
+{
+    // Mixing runs far faster than the encode, so the chunks are rarely
+    // done first
+    m_mixing = false;
+    m_mixOk = ok;
+    if (m_donePieces == m_pieces.size()) {
+        runConcat();
+    }
+}
+
+void SmartExporter::runConcat()
+{
+    // One list for the video pieces and one for their audio
+    const QString videoListPath = m_workDir->filePath("pieces.txt");
+    const QString audioListPath = m_workDir->filePath("audio.txt");
+    QFile videoList(videoListPath);
+    QFile audioList(audioListPath);
+    if (!videoList.open(QIODevice::WriteOnly | QIODevice::Text)
+        || !audioList.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        finish(false, "Could not write the chunk lists in " + m_workDir->path());
+        return;
+    }
+    QTextStream videoStream(&videoList);
+    QTextStream audioStream(&audioList);
+    for (const Piece &piece : m_pieces) {
+        QString file = piece.file;
+        QString audioFile = piece.audioFile;
+        videoStream << "file '" << file.replace("'", "'\\''") << "'\n";
+        audioStream << "file '" << audioFile.replace("'", "'\\''") << "'\n";
+    }
+    videoStream.flush();
+    audioStream.flush();
+    videoList.close();
+    audioList.close();
+
+    QStringList arguments;
+    arguments << "-v" << "error" << "-y"
+              << "-f" << "concat" << "-safe" << "0" << "-i" << videoListPath
+              << "-f" << "concat" << "-safe" << "0" << "-i" << audioListPath;
+    if (m_hasMix) {
+        // The tracks' mix is added in as the audio is encoded
+        if (!m_mixOk) {
+            finish(false, "Could not render the audio tracks");
+            return;
+        }
+        arguments << "-i" << m_workDir->filePath("mix.wav")
+                  << "-filter_complex" << "[1:a][2:a]amix=inputs=2:duration=first:normalize=0[a]"
+                  << "-map" << "0:v" << "-map" << "[a]";
+    } else {
+        arguments << "-map" << "0:v" << "-map" << "1:a";
+    }
+    arguments << "-c:v" << "copy"
+              << "-c:a" << "aac" << "-b:a" << "192k" << "-ar" << QString::number(m_settings.sampleRate)
+              << m_outputPath;
+
+    JobScheduler *jobs = m_jobs;
+    const std::shared_ptr<QTemporaryDir> workDir = m_workDir;
+    const CancelToken token = m_token;
+    m_jobs->submitProcess(JobScheduler::Visible,
+                          [jobs, arguments, workDir, token](const JobScheduler::Context &) {
+                              return runFfmpeg(jobs, arguments, token);
+                          },
+                          [this](const QVariant &result) {
+                              const QVariantMap outcome = result.toMap();
+                              onJoinFinished(outcome.value("ok").toBool(), outcome.value("errors").toString());
+                          },
+                          QVector<JobScheduler::JobId>(), token);
+}
+
+void SmartExporter::onJoinFinished(bool ok, const QString &errors)
+{
+    if (!ok) {
+        qDebug() << "ffmpeg failed joining chunks:" << errors;
+        finish(false, "Joining the chunks failed"
+                          + (errors.isEmpty() ? QString() : ":\n" + errors.section('\n', -1)));
+        return;
+    }
+    finish(true, report());
+}
+
+void SmartExporter::finish(bool ok, const QString &message)
+{
+    // Running jobs are killed or left to finish, and drop their results;
+    // the work directory goes with the last of them
+    m_token.cancel();
+    m_probesLeft = 0;
+    for (Worker &worker : m_workers) {
+        worker.piece = -1;
+    }
+    m_mixing = false;
+    m_workDir.reset();
+    m_queue.clear();
+    m_waitingForIndexes = false;
+    emit finished(ok, message);
+}
+
+QString SmartExporter::report() const
+{
+    const Ticks total = m_copiedTicks + m_encodedTicks;
+    const double copiedPercent = total > 0 ? 100.0 * m_copiedTicks / total : 0.0;
+    const double elapsed = m_timer.elapsed() / 1000.0;
+    const double utilisation = elapsed > 0.0 ? m_busyMs / (10.0 * elapsed * m_workers.size()) : 0.0;
+
+    QString text = QString("Copied %1 s (%2%) in %3 chunks, re-encoded %4 s in %5 chunks.\n"
+                           "%6 workers were busy %7% of the time; %8 chunks were retried.\n"
+                           "Export took %9 s")
+                       .arg(Timebase::toSeconds(m_copiedTicks), 0, 'f', 1)
+                       .arg(copiedPercent, 0, 'f', 1)
+                       .arg(m_copiedPieces)
+                       .arg(Timebase::toSeconds(m_encodedTicks), 0, 'f', 1)
+                       .arg(m_pieces.size() - m_copiedPieces)
+                       .arg(m_workers.size())
+                       .arg(utilisation, 0, 'f', 0)
+                       .arg(m_retries)
+                       .arg(elapsed, 0, 'f', 1);
+
+    // A full transcode extrapolated from the re-encode rate, scaled as if
+    // one encoder had every core; this errs towards a lower speedup
+    if (m_encodedTicks > 0 && m_encodeMs > 0 && elapsed > 0.0) {
+        const double cores = std::max(1, QThread::idealThreadCount());
+        const double encodeSeconds = m_encodeMs / 1000.0 * threadsPerWorker() / cores;
+        const double fullTranscode = encodeSeconds * total / m_encodedTicks;
+        text += QString("; a full transcode would take about %1 s (%2x speedup).")
+                    .arg(fullTranscode, 0, 'f', 1)
+                    .arg(fullTranscode / elapsed, 0, 'f', 1);
+    } else {
+        text += ".";
+    }
+    return text;
+}
@@ -0,0 +1,48 @@
+#include "SnapIndex.h"
+#include <iterator>
+
+void SnapIndex::insertEdge(Ticks time)
+{
+    ++m_edges[time];
+}
+
+void SnapIndex::removeEdge(Ticks time)
+{
+    auto it = m_edges.find(time);
+    if (it == m_edges.end()) {
+        return;
+    }
+    if (--it.value() <= 0) {
+        m_edges.erase(it);
+    }
+}
+
+bool SnapIndex::nearestEdge(Ticks time, Ticks tolerance, Ticks &edge) const
+{
+    if (m_edges.isEmpty()) {
+        return false;
+    }
+
+    // Only the first edge at or after time and the one before it can be closest
+    auto after = m_edges.lowerBound(time);
+    Ticks bestDistance = tolerance;
+    bool found = false;
+
+    if (after != m_edges.end()) {
+        Ticks distance = after.key() - time;
+        if (distance <= bestDistance) {
+            bestDistance = distance;
+            edge = after.key();
+            found = true;
+        }
+    }
+    if (after != m_edges.begin()) {
+        auto before = std::prev(after);
+        Ticks distance = time - before.key();
+        if (distance <= bestDistance) {
+            edge = before.key();
+            found = true;
+        }
+    }
+    return found;
+}
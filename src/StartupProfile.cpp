@@ -0,0 +1,47 @@
+#include "StartupProfile.h"
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QVector>
+
+namespace {
+struct Phase
+{
+    const char *name;
+    double ms;
+};
+
+QElapsedTimer startClock;
+QVector<Phase> phases;
+}
+
+namespace StartupProfile {
+
+void start()
+{
+    startClock.start();
+    phases.clear();
+}
+
+void mark(const char *phase)
+{
+    phases.append({phase, elapsedMs()});
+}
+
+double elapsedMs()
+{
+    return startClock.isValid() ? startClock.nsecsElapsed() / 1e6 : 0.0;
+}
+
+void print()
+{
+    double previous = 0.0;
+    for (const Phase &phase : phases) {
+        qDebug().noquote() << QString("startup: %1 ms (+%2 ms) %3")
+                                  .arg(phase.ms, 8, 'f', 1)
+                                  .arg(phase.ms - previous, 0, 'f', 1)
+                                  .arg(phase.name);
+        previous = phase.ms;
+    }
+}
+
+} // namespace StartupProfile
@@ -1,33 +1,136 @@
 #include "Timeline.h"
+#include "KeyframeIndexer.h"
+#include "TransitionCache.h"
+#include "EditJournal.h"
+#include "ImageSequence.h"
+#include "Nesting.h"
 #include <QPainter>
 #include <QMouseEvent>
 #include <QWheelEvent>
+#include <QDragEnterEvent>
+#include <QDropEvent>
+#include <QMimeData>
 #include <QFileDialog>
+#include <QFileInfo>
+#include <QInputDialog>
 #include <QSizePolicy>
-#include <QProcess>
+#include <QTimer>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QJsonArray>
+#include <QDebug>
+#include <cstdlib>
+#include <algorithm>
+
+namespace {
+// Distance in pixels within which a dragged clip snaps to a target
+const int kSnapDistance = 8;
+
+const Ticks kDefaultTransitionLength = Timebase::kTicksPerSecond;
+
+// Distance in pixels from a clip edge that grabs it for trimming
+const int kTrimHandleWidth = 6;
+
+// Clips are drawn at least this wide, however short
+const int kMinClipWidth = 50;
+
+const int kMinimumHeight = 150;
+
+// Audio lanes sit under the video track, which ends at y = 135
+const int kAudioLaneTop = 145;
+const int kAudioLaneHeight = 30;
+const int kAudioLanePitch = kAudioLaneHeight + 4;
+
+// A source's length from ffprobe, run as a job; 0 if it can't be read
+Ticks durationOf(JobScheduler *jobs, const QString &filePath, const CancelToken &token)
+{
+    QStringList arguments;
+    arguments << "-v" << "error"
+              << "-show_entries" << "format=duration"
+              << "-of" << "default=noprint_wrappers=1:nokey=1"
+              << filePath;
+    QByteArray output;
+    if (!jobs->runProcess("ffprobe", arguments, token, &output, 5000)) {
+        return 0;
+    }
+    bool ok = false;
+    const double duration = QString::fromUtf8(output).trimmed().toDouble(&ok);
+    return ok ? Timebase::fromSeconds(duration) : 0;
+}
+
+// Formats delivered as numbered frames
+bool isFrameFile(const QString &path)
+{
+    static const QStringList extensions = {"exr", "dpx", "png", "tif", "tiff", "jpg", "jpeg"};
+    return extensions.contains(QFileInfo(path).suffix().toLower());
+}
+}
 
 Timeline::Timeline(QWidget *parent)
     : QWidget(parent)
     , m_selectedClipIndex(-1)
     , m_pixelsPerSecond(50.0)
     , m_scrollOffset(0.0)
-    , m_playheadPosition(0.0)
+    , m_playheadPosition(0)
+    , m_settings(Project::defaults())
+    , m_selectedAudioClip(-1)
+    , m_sequenceName(Nesting::kMainSequence)
+    , m_lastVersion(0)
+    , m_snapEnabled(true)
+    , m_snapIndicatorTime(-1)
+    , m_snapIndexValid(true)
+    , m_rippleLongest(0)
+    , m_rippleIndexValid(false)
+    , m_ripplePending(false)
+    , m_keyframeIndexer(nullptr)
+    , m_keyframeSnapEnabled(false)
+    , m_transitionCache(nullptr)
+    , m_transitionsValid(false)
+    , m_transitionTimer(new QTimer(this))
+    , m_journal(nullptr)
+    , m_replaying(false)
+    , m_snapshotQueued(false)
+    , m_inBatch(false)
+    , m_batchWasBlocked(false)
+    , m_jobScheduler(nullptr)
     , m_isDragging(false)
     , m_isResizing(false)
     , m_isPanning(false)
+    , m_isDraggingAudio(false)
     , m_dragClipIndex(-1)
+    , m_dragOriginStart(0)
+    , m_dragOriginX(0)
+    , m_dragOriginTrack(0)
+    , m_resizeInEdge(false)
+    , m_resizeOriginTrim(0)
+    , m_resizeOriginDuration(0)
+    , m_resizeSourceLength(0)
 {
+    m_sequenceVersions.insert(m_sequenceName, ++m_lastVersion);
+
+    // Every committed edit ends in timelineChanged; the transitions are
+    // worked out again once the burst of edits is over
+    m_transitionTimer->setSingleShot(true);
+    m_transitionTimer->setInterval(0);
+    connect(m_transitionTimer, &QTimer::timeout, this, [this]() {
+        ensureTransitions();
+        update();
+    });
+    connect(this, &Timeline::timelineChanged, this, [this]() {
+        m_transitionsValid = false;
+        m_transitionTimer->start();
+    });
+
     setupUI();
-    setMinimumHeight(150);
+    setMinimumHeight(kMinimumHeight);
     setMouseTracking(true);
+    setAcceptDrops(true);
     setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Expanding);
 }
 
 Timeline::~Timeline()
 {
+    m_jobToken.cancel();
 }
 
 void Timeline::setupUI()
@@ -37,24 +140,95 @@ void Timeline::setupUI()
     
     m_addClipButton = new QPushButton("Add Clip", this);
     m_removeClipButton = new QPushButton("Remove Clip", this);
+    m_rippleDeleteButton = new QPushButton("Ripple Delete", this);
+    m_addMarkerButton = new QPushButton("Add Marker", this);
+    m_transitionButton = new QPushButton("Transition", this);
+    m_multicamButton = new QPushButton("Add Multicam", this);
+    m_addAudioButton = new QPushButton("Add Audio", this);
+    m_audioMixButton = new QPushButton("Audio Mix", this);
+    m_sequenceButton = new QPushButton(QString("Sequence: %1").arg(m_sequenceName), this);
+    m_addSequenceButton = new QPushButton("Add Sequence", this);
     m_removeClipButton->setEnabled(false);
+    m_rippleDeleteButton->setEnabled(false);
+    m_transitionButton->setEnabled(false);
+    m_audioMixButton->setEnabled(false);
     
     // Position buttons at the top-left
     m_addClipButton->move(5, 5);
     m_removeClipButton->move(m_addClipButton->x() + m_addClipButton->sizeHint().width() + 5, 5);
+    m_rippleDeleteButton->move(m_removeClipButton->x() + m_removeClipButton->sizeHint().width() + 5, 5);
+    m_addMarkerButton->move(m_rippleDeleteButton->x() + m_rippleDeleteButton->sizeHint().width() + 5, 5);
+    m_transitionButton->move(m_addMarkerButton->x() + m_addMarkerButton->sizeHint().width() + 5, 5);
+    m_multicamButton->move(m_transitionButton->x() + m_transitionButton->sizeHint().width() + 5, 5);
+    m_addAudioButton->move(m_multicamButton->x() + m_multicamButton->sizeHint().width() + 5, 5);
+    m_audioMixButton->move(m_addAudioButton->x() + m_addAudioButton->sizeHint().width() + 5, 5);
+    m_sequenceButton->move(m_audioMixButton->x() + m_audioMixButton->sizeHint().width() + 5, 5);
+    m_addSequenceButton->move(m_sequenceButton->x() + m_sequenceButton->sizeHint().width() + 5, 5);
     
     // Ensure buttons are visible above the painted content
     m_addClipButton->raise();
     m_removeClipButton->raise();
+    m_rippleDeleteButton->raise();
+    m_addMarkerButton->raise();
+    m_transitionButton->raise();
+    m_multicamButton->raise();
+    m_addAudioButton->raise();
+    m_audioMixButton->raise();
+    m_sequenceButton->raise();
+    m_addSequenceButton->raise();
     
     connect(m_addClipButton, &QPushButton::clicked, this, &Timeline::onAddClipClicked);
     connect(m_removeClipButton, &QPushButton::clicked, this, &Timeline::onRemoveClipClicked);
+    connect(m_rippleDeleteButton, &QPushButton::clicked, this, &Timeline::onRippleDeleteClicked);
+    connect(m_addMarkerButton, &QPushButton::clicked, this, &Timeline::onAddMarkerClicked);
+    connect(m_transitionButton, &QPushButton::clicked, this, &Timeline::onTransitionClicked);
+    connect(m_multicamButton, &QPushButton::clicked, this, &Timeline::onMulticamClicked);
+    connect(m_addAudioButton, &QPushButton::clicked, this, &Timeline::onAddAudioClicked);
+    connect(m_audioMixButton, &QPushButton::clicked, this, &Timeline::onAudioMixClicked);
+    connect(m_sequenceButton, &QPushButton::clicked, this, &Timeline::onSequenceClicked);
+    connect(m_addSequenceButton, &QPushButton::clicked, this, &Timeline::onAddSequenceClicked);
+}
+
+void Timeline::addClip(const QString &filePath, Ticks startTime, Ticks duration)
+{
+    recordEdit(TimelineEdit::AddClip, -1, filePath, startTime, duration);
+    insertClip(Clip(filePath, startTime, duration));
 }
 
-void Timeline::addClip(const QString &filePath, double startTime, double duration)
+void Timeline::addClip(const QString &filePath, Ticks startTime, Ticks duration, Ticks trimStart)
 {
+    if (trimStart <= 0) {
+        addClip(filePath, startTime, duration);
+        return;
+    }
+
+    recordEdit(TimelineEdit::AddTrimmedClip, -1, filePath, startTime, duration, 0, trimStart);
     Clip clip(filePath, startTime, duration);
+    clip.setTrimStart(trimStart);
+    insertClip(clip);
+}
+
+void Timeline::insertClip(const Clip &clip)
+{
+    // After any clips starting at the same time, as the index is built
+    if (m_rippleIndexValid) {
+        const int node = m_rippleOffsets.insert(m_rippleOffsets.upperBound(clip.startTime()), clip.startTime());
+        if (node >= m_rippleClips.size()) {
+            m_rippleClips.resize(node + 1);
+        }
+        m_rippleClips[node] = m_clips.size();
+        m_rippleNodes.append(node);
+        m_rippleLongest = std::max(m_rippleLongest, clip.duration());
+    }
     m_clips.append(clip);
+    if (m_keyframeIndexer) {
+        m_keyframeIndexer->index(clip.filePath());  // Starts the scan early
+    }
+    prefetchSourceLength(clip.filePath(), JobScheduler::Background);
+    if (m_snapIndexValid) {
+        m_snapIndex.insertEdge(clip.startTime());
+        m_snapIndex.insertEdge(clip.endTime());
+    }
     emit clipAdded(m_clips.size() - 1);
     emit timelineChanged();
     update();
@@ -63,11 +237,8 @@ void Timeline::addClip(const QString &filePath, double startTime, double duratio
 void Timeline::removeClip(int index)
 {
     if (index >= 0 && index < m_clips.size()) {
-        m_clips.remove(index);
-        if (m_selectedClipIndex == index) {
-            m_selectedClipIndex = -1;
-            m_removeClipButton->setEnabled(false);
-        }
+        recordEdit(TimelineEdit::RemoveClip, index, QString(), 0, 0);
+        detachClip(index);
         emit clipRemoved(index);
         emit timelineChanged();
         update();
@@ -76,18 +247,163 @@ void Timeline::removeClip(int index)
 
 void Timeline::clearClips()
 {
+    recordEdit(TimelineEdit::ClearClips, -1, QString(), 0, 0);
     m_clips.clear();
+    m_rippleIndexValid = false;
+    m_ripplePending = false;
+    m_snapIndexValid = false;
     m_selectedClipIndex = -1;
     m_removeClipButton->setEnabled(false);
+    m_rippleDeleteButton->setEnabled(false);
+    m_transitionButton->setEnabled(false);
     emit timelineChanged();
     update();
 }
 
-double Timeline::totalDuration() const
+void Timeline::rippleDelete(int index)
 {
-    double maxEnd = 0.0;
+    if (index < 0 || index >= m_clips.size()) {
+        return;
+    }
+
+    recordEdit(TimelineEdit::RippleDelete, index, QString(), 0, 0);
+
+    // Close the gap: everything after the clip moves back by its length
+    ensureRippleIndex();
+    const int position = m_rippleOffsets.positionOf(m_rippleNodes[index]);
+    m_rippleOffsets.shiftFrom(position + 1, -m_clips[index].duration());
+    m_ripplePending = true;
+    m_snapIndexValid = false;
+
+    detachClip(index);
+    emit clipRemoved(index);
+    emit timelineChanged();
+    update();
+}
+
+void Timeline::rippleInsert(const QString &filePath, Ticks startTime, Ticks duration)
+{
+    if (duration <= 0) {
+        return;
+    }
+    if (startTime < 0) {
+        startTime = 0;
+    }
+
+    // An insert inside a clip goes in at its end, so the new clip never
+    // overlaps it; recorded after, so replay doesn't depend on the index
+    ensureRippleIndex();
+    int position = m_rippleOffsets.lowerBound(startTime);
+    while (position > 0) {
+        const int before = rippleClipAt(position - 1);
+        const Ticks end = m_rippleOffsets.timeOf(m_rippleNodes[before]) + m_clips[before].duration();
+        if (end <= startTime) {
+            break;
+        }
+        startTime = end;
+        position = m_rippleOffsets.lowerBound(startTime);
+    }
+    recordEdit(TimelineEdit::RippleInsert, -1, filePath, startTime, duration);
+
+    // Everything at or after the insert point moves on by the new clip's
+    // length, and the clip takes its place in the index in front of them
+    m_rippleOffsets.shiftFrom(position, duration);
+    m_ripplePending = true;
+    m_snapIndexValid = false;
+    insertClip(Clip(filePath, startTime, duration));
+}
+
+void Timeline::rippleTrim(int index, Ticks trimStart, Ticks duration)
+{
+    if (index < 0 || index >= m_clips.size() || duration <= 0) {
+        return;
+    }
+
+    ensureRippleIndex();
+    Clip &clip = m_clips[index];
+    trimStart = std::max<Ticks>(0, trimStart);
+    
+    // Pull the in-point back to a keyframe, keeping the out-point where it
+    // was, so playback never has to decode up to the cut
+    if (m_keyframeSnapEnabled && m_keyframeIndexer) {
+        if (const KeyframeIndex *keyframes = m_keyframeIndexer->index(clip.filePath())) {
+            const Ticks keyframe = keyframes->keyframeAtOrBefore(trimStart);
+            duration += trimStart - keyframe;
+            trimStart = keyframe;
+        }
+    }
+    
+    // Recorded after snapping, so replay doesn't depend on the indexes
+    recordEdit(TimelineEdit::RippleTrim, index, QString(), trimStart, duration);
+
+    Ticks delta = duration - clip.duration();
+    clip.setTrimStart(trimStart);
+    clip.setDuration(duration);
+    m_rippleLongest = std::max(m_rippleLongest, duration);
+    if (delta != 0) {
+        m_rippleOffsets.shiftFrom(m_rippleOffsets.positionOf(m_rippleNodes[index]) + 1, delta);
+        m_ripplePending = true;
+    }
+    m_snapIndexValid = false;
+
+    emit timelineChanged();
+    update();
+}
+
+void Timeline::moveClip(int index, Ticks startTime)
+{
+    if (index < 0 || index >= m_clips.size()) {
+        return;
+    }
+
+    startTime = std::max<Ticks>(0, startTime);
+    recordEdit(TimelineEdit::MoveClip, index, QString(), startTime, 0);
+    invalidateRippleIndex();
+    m_clips[index].setStartTime(startTime);
+    m_snapIndexValid = false;
+    emit timelineChanged();
+    update();
+}
+
+void Timeline::trimClip(int index, Ticks trimStart, Ticks duration)
+{
+    if (index < 0 || index >= m_clips.size() || duration <= 0) {
+        return;
+    }
+
+    trimStart = std::max<Ticks>(0, trimStart);
+    recordEdit(TimelineEdit::TrimClip, index, QString(), trimStart, duration);
+    invalidateRippleIndex();
+    Clip &clip = m_clips[index];
+    clip.setStartTime(std::max<Ticks>(0, clip.startTime() + trimStart - clip.trimStart()));
+    clip.setTrimStart(trimStart);
+    clip.setDuration(duration);
+    m_snapIndexValid = false;
+    emit timelineChanged();
+    update();
+}
+
+const QVector<Clip>& Timeline::clips() const
+{
+    foldRippleOffsets();
+    return m_clips;
+}
+
+Ticks Timeline::totalDuration() const
+{
+    Ticks maxEnd = videoEnd();
+    for (const AudioClip &clip : m_audioClips) {
+        maxEnd = std::max(maxEnd, clip.endTime());
+    }
+    return maxEnd;
+}
+
+Ticks Timeline::videoEnd() const
+{
+    foldRippleOffsets();
+    Ticks maxEnd = 0;
     for (const Clip &clip : m_clips) {
-        double end = clip.endTime();
+        Ticks end = clip.endTime();
         if (end > maxEnd) {
             maxEnd = end;
         }
@@ -95,7 +411,608 @@ double Timeline::totalDuration() const
     return maxEnd;
 }
 
-void Timeline::setPlayheadPosition(double time)
+void Timeline::setKeyframeIndexer(KeyframeIndexer *indexer)
+{
+    if (m_keyframeIndexer) {
+        disconnect(m_keyframeIndexer, nullptr, this, nullptr);
+    }
+    m_keyframeIndexer = indexer;
+    if (!m_keyframeIndexer) {
+        return;
+    }
+
+    connect(m_keyframeIndexer, &KeyframeIndexer::indexed, this, [this]() {
+        update();
+    });
+    for (const Clip &clip : m_clips) {
+        m_keyframeIndexer->index(clip.filePath());
+    }
+}
+
+void Timeline::setTransitionCache(TransitionCache *cache)
+{
+    if (m_transitionCache) {
+        disconnect(m_transitionCache, nullptr, this, nullptr);
+    }
+    m_transitionCache = cache;
+    if (m_transitionCache) {
+        connect(m_transitionCache, &TransitionCache::rendered, this, [this]() {
+            for (ClipTransition &transition : m_transitions) {
+                if (transition.active && !transition.rendered) {
+                    transition.rendered = !m_transitionCache->renderedFile(transition.key).isEmpty();
+                }
+            }
+            update();
+        });
+    }
+    m_transitionsValid = false;
+}
+
+void Timeline::setClipTransition(int index, TransitionType type, Ticks duration)
+{
+    if (index < 0 || index >= m_clips.size()) {
+        return;
+    }
+
+    recordEdit(TimelineEdit::SetTransition, index, QString(), 0, duration, type);
+    m_clips[index].setTransition(type, duration);
+    emit timelineChanged();
+    update();
+}
+
+bool Timeline::transitionAt(int index, TransitionSpec &spec, QByteArray *key) const
+{
+    ensureTransitions();
+    if (index < 0 || index >= m_transitions.size() || !m_transitions[index].active) {
+        return false;
+    }
+    spec = m_transitions[index].spec;
+    if (key) {
+        *key = m_transitions[index].key;
+    }
+    return true;
+}
+
+void Timeline::ensureTransitions() const
+{
+    if (m_transitionsValid) {
+        return;
+    }
+
+    foldRippleOffsets();
+    m_transitions.fill({false, TransitionSpec(), QByteArray(), false}, m_clips.size());
+    m_transitionsValid = true;
+
+    // Only cuts between touching clips get a transition; the first clip
+    // ending at a start is the one cut from
+    QHash<Ticks, int> endingAt;
+    endingAt.reserve(m_clips.size());
+    for (int i = 0; i < m_clips.size(); ++i) {
+        if (m_clips[i].duration() > 0 && !endingAt.contains(m_clips[i].endTime())) {
+            endingAt.insert(m_clips[i].endTime(), i);
+        }
+    }
+
+    const Ticks frame = Timebase::frameTicks(m_settings.frameRate);
+    for (int index = 0; index < m_clips.size(); ++index) {
+        const Clip &clip = m_clips[index];
+        if (clip.transitionType() == NoTransition || clip.transitionDuration() <= 0
+            || Nesting::isCompound(clip.filePath())) {
+            continue;
+        }
+
+        // Compound clips cut; there is no one file to render from
+        const int from = endingAt.value(clip.startTime(), -1);
+        if (from < 0 || Nesting::isCompound(m_clips[from].filePath())) {
+            continue;
+        }
+
+        // Whole frames, leaving at least one frame of the clip after it
+        Ticks duration = std::min(clip.transitionDuration(), clip.duration() - frame);
+        duration = Timebase::fromFrame(Timebase::toFrame(duration, m_settings.frameRate), m_settings.frameRate);
+        if (duration < frame) {
+            continue;
+        }
+
+        ClipTransition &transition = m_transitions[index];
+        const Clip &fromClip = m_clips[from];
+        transition.spec.fromSource = fromClip.filePath();
+        transition.spec.fromOut = fromClip.trimStart() + fromClip.duration();
+        transition.spec.toSource = clip.filePath();
+        transition.spec.toIn = clip.trimStart();
+        transition.spec.type = clip.transitionType();
+        transition.spec.duration = duration;
+        transition.spec.format = m_settings;
+        transition.key = Transitions::cacheKey(transition.spec);
+        transition.rendered = m_transitionCache && !m_transitionCache->renderedFile(transition.key).isEmpty();
+        transition.active = true;
+    }
+}
+
+void Timeline::addMulticamClip(const QVector<CameraAngle> &angles, Ticks startTime, Ticks duration)
+{
+    if (angles.size() < Multicam::kMinAngles || angles.size() > Multicam::kMaxAngles || duration <= 0) {
+        return;
+    }
+
+    startTime = std::max<Ticks>(0, startTime);
+    recordEdit(TimelineEdit::AddMulticam, -1, Multicam::encodeAngles(angles), startTime, duration);
+
+    // Starts on the first angle at the group's time zero
+    Clip clip(angles[0].path, startTime, duration);
+    clip.setAngles(angles, 0);
+    clip.setTrimStart(angles[0].syncOffset);
+    insertClip(clip);
+}
+
+void Timeline::cutToAngle(Ticks time, int angle)
+{
+    time = Timebase::snapToFrame(time, m_settings.frameRate);
+    const int index = multicamClipAt(time);
+    if (index < 0 || angle < 0 || angle >= m_clips[index].angles().size()
+        || m_clips[index].activeAngle() == angle) {
+        return;
+    }
+
+    recordEdit(TimelineEdit::CutToAngle, index, QString(), time, 0, angle);
+
+    // At the in-point the whole clip switches; anywhere else the clip is
+    // split and the part from time on switches
+    const Ticks frame = Timebase::frameTicks(m_settings.frameRate);
+    Clip &clip = m_clips[index];
+    const Ticks offset = time - clip.startTime();
+    if (offset < frame) {
+        clip.switchAngle(angle);
+    } else {
+        Clip tail = clip;
+        tail.setStartTime(time);
+        tail.setDuration(clip.duration() - offset);
+        tail.setTrimStart(clip.trimStart() + offset);
+        tail.setTransition(NoTransition, 0);
+        tail.switchAngle(angle);
+        clip.setDuration(offset);
+
+        invalidateRippleIndex();
+        m_snapIndexValid = false;
+        m_clips.insert(index + 1, tail);
+        if (m_selectedClipIndex > index) {
+            ++m_selectedClipIndex;
+        }
+        if (m_keyframeIndexer) {
+            m_keyframeIndexer->index(tail.filePath());
+        }
+        emit clipAdded(index + 1);
+    }
+    emit timelineChanged();
+    update();
+}
+
+int Timeline::multicamClipAt(Ticks time) const
+{
+    foldRippleOffsets();
+    for (int i = 0; i < m_clips.size(); ++i) {
+        const Clip &clip = m_clips[i];
+        if (clip.isMulticam() && time >= clip.startTime() && time < clip.endTime()) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void Timeline::addAudioClip(const QString &filePath, int track, Ticks startTime, Ticks duration)
+{
+    track = std::max(0, std::min(track, AudioTracks::kMaxTracks - 1));
+    startTime = std::max<Ticks>(0, startTime);
+    recordEdit(TimelineEdit::AddAudioClip, track, filePath, startTime, duration);
+    m_audioClips.append(AudioTracks::makeClip(filePath, track, startTime, duration));
+    audioClipsChanged();
+}
+
+void Timeline::removeAudioClip(int index)
+{
+    if (index < 0 || index >= m_audioClips.size()) {
+        return;
+    }
+    recordEdit(TimelineEdit::RemoveAudioClip, index, QString(), 0, 0);
+    m_audioClips.remove(index);
+    if (m_selectedAudioClip >= 0) {
+        selectAudioClip(-1);
+        m_removeClipButton->setEnabled(false);
+    }
+    audioClipsChanged();
+}
+
+void Timeline::moveAudioClip(int index, int track, Ticks startTime)
+{
+    if (index < 0 || index >= m_audioClips.size()) {
+        return;
+    }
+    track = std::max(0, std::min(track, AudioTracks::kMaxTracks - 1));
+    startTime = std::max<Ticks>(0, startTime);
+    recordEdit(TimelineEdit::MoveAudioClip, index, QString(), startTime, 0, track);
+    m_audioClips[index].track = track;
+    m_audioClips[index].startTime = startTime;
+    audioClipsChanged();
+}
+
+void Timeline::setAudioClipGain(int index, double gainDb)
+{
+    if (index < 0 || index >= m_audioClips.size()) {
+        return;
+    }
+    // Stored as journaled, so a replay gives the same mix
+    const int value = qRound(gainDb * 100.0);
+    recordEdit(TimelineEdit::SetAudioGain, index, QString(), 0, 0, value);
+    m_audioClips[index].gainDb = value / 100.0;
+    audioClipsChanged();
+}
+
+void Timeline::setAudioClipPan(int index, double pan)
+{
+    if (index < 0 || index >= m_audioClips.size()) {
+        return;
+    }
+    const int value = qRound(std::max(-1.0, std::min(1.0, pan)) * 1000.0);
+    recordEdit(TimelineEdit::SetAudioPan, index, QString(), 0, 0, value);
+    m_audioClips[index].pan = value / 1000.0;
+    audioClipsChanged();
+}
+
+void Timeline::setAudioClipFades(int index, Ticks fadeIn, Ticks fadeOut)
+{
+    if (index < 0 || index >= m_audioClips.size()) {
+        return;
+    }
+    AudioClip &clip = m_audioClips[index];
+    fadeIn = std::max<Ticks>(0, std::min(fadeIn, clip.duration));
+    fadeOut = std::max<Ticks>(0, std::min(fadeOut, clip.duration));
+    recordEdit(TimelineEdit::SetAudioFades, index, QString(), fadeIn, fadeOut);
+    clip.fadeIn = fadeIn;
+    clip.fadeOut = fadeOut;
+    audioClipsChanged();
+}
+
+int Timeline::audioTrackCount() const
+{
+    int count = 0;
+    for (const AudioClip &clip : m_audioClips) {
+        count = std::max(count, clip.track + 1);
+    }
+    return count;
+}
+
+void Timeline::audioClipsChanged()
+{
+    setMinimumHeight(kMinimumHeight + audioTrackCount() * kAudioLanePitch);
+    emit timelineChanged();
+    update();
+}
+
+void Timeline::selectAudioClip(int index)
+{
+    m_selectedAudioClip = index;
+    m_audioMixButton->setEnabled(index >= 0);
+    if (index >= 0) {
+        // One selection at a time; the remove button acts on either
+        m_selectedClipIndex = -1;
+        m_removeClipButton->setEnabled(true);
+        m_rippleDeleteButton->setEnabled(false);
+        m_transitionButton->setEnabled(false);
+    }
+}
+
+TimelineState Timeline::state() const
+{
+    foldRippleOffsets();
+    TimelineState state;
+    state.clips = m_clips;
+    state.markers = m_markers;
+    state.settings = m_settings;
+    state.audioClips = m_audioClips;
+    state.sequence = m_sequenceName;
+    state.otherSequences = m_otherSequences;
+    return state;
+}
+
+void Timeline::restore(const TimelineState &state, const QVector<TimelineEdit> &edits)
+{
+    // Replayed edits are already in the journal, and the preview is
+    // rebuilt once rather than per edit. Keyframe indexes load on first
+    // use, or when MainWindow warms them after startup.
+    m_replaying = true;
+    const bool wasBlocked = blockSignals(true);
+
+    m_clips = state.clips;
+    m_markers = state.markers;
+    m_settings = state.settings;
+    m_audioClips = state.audioClips;
+    m_sequenceName = state.sequence.isEmpty() ? QString(Nesting::kMainSequence) : state.sequence;
+    m_otherSequences = state.otherSequences;
+    m_sequenceVersions.clear();
+    m_sequenceVersions.insert(m_sequenceName, ++m_lastVersion);
+    for (const SequenceState &sequence : m_otherSequences) {
+        m_sequenceVersions.insert(sequence.name, ++m_lastVersion);
+    }
+    resetContents();
+    for (const TimelineEdit &edit : edits) {
+        applyEdit(edit);
+    }
+    setMinimumHeight(kMinimumHeight + audioTrackCount() * kAudioLanePitch);
+
+    blockSignals(wasBlocked);
+    m_replaying = false;
+    emit timelineChanged();
+    update();
+}
+
+void Timeline::beginBatch()
+{
+    if (m_inBatch) {
+        return;
+    }
+    m_batchState = state();
+    m_inBatch = true;
+    m_batchWasBlocked = blockSignals(true);
+}
+
+void Timeline::endBatch(bool commit)
+{
+    if (!m_inBatch) {
+        return;
+    }
+    m_inBatch = false;
+    blockSignals(m_batchWasBlocked);
+    if (commit) {
+        emit timelineChanged();
+        update();
+    } else {
+        replace(m_batchState);
+    }
+    m_batchState = TimelineState();
+}
+
+void Timeline::replace(const TimelineState &state)
+{
+    restore(state, QVector<TimelineEdit>());
+    if (m_journal) {
+        m_journal->snapshot(this->state());
+    }
+}
+
+void Timeline::resetContents()
+{
+    m_rippleIndexValid = false;
+    m_ripplePending = false;
+    m_snapIndexValid = false;
+    m_transitionsValid = false;
+    m_selectedClipIndex = -1;
+    m_removeClipButton->setEnabled(false);
+    m_rippleDeleteButton->setEnabled(false);
+    m_transitionButton->setEnabled(false);
+    selectAudioClip(-1);
+    m_sequenceButton->setText(QString("Sequence: %1").arg(m_sequenceName));
+    m_addSequenceButton->move(m_sequenceButton->x() + m_sequenceButton->sizeHint().width() + 5, 5);
+    setMinimumHeight(kMinimumHeight + audioTrackCount() * kAudioLanePitch);
+    // Scans start here for clips that arrive all at once, as they do in
+    // insertClip for one, so painting only reads finished indexes
+    if (m_keyframeIndexer) {
+        for (const Clip &clip : m_clips) {
+            m_keyframeIndexer->index(clip.filePath());
+        }
+    }
+}
+
+QStringList Timeline::sequenceNames() const
+{
+    QStringList names;
+    names.append(m_sequenceName);
+    for (const SequenceState &sequence : m_otherSequences) {
+        names.append(sequence.name);
+    }
+    names.sort();
+    return names;
+}
+
+void Timeline::openSequence(const QString &name)
+{
+    const QString trimmed = name.trimmed();
+    if (trimmed.isEmpty() || trimmed == m_sequenceName) {
+        return;
+    }
+
+    recordEdit(TimelineEdit::OpenSequence, -1, trimmed, 0, 0);
+    foldRippleOffsets();
+    SequenceState next = {trimmed, QVector<Clip>(), QVector<Ticks>(), QVector<AudioClip>()};
+    for (int i = 0; i < m_otherSequences.size(); ++i) {
+        if (m_otherSequences[i].name == trimmed) {
+            next = m_otherSequences.takeAt(i);
+            break;
+        }
+    }
+    if (!m_sequenceVersions.contains(trimmed)) {
+        m_sequenceVersions.insert(trimmed, ++m_lastVersion);
+    }
+    m_otherSequences.append({m_sequenceName, m_clips, m_markers, m_audioClips});
+
+    m_sequenceName = next.name;
+    m_clips = next.clips;
+    m_markers = next.markers;
+    m_audioClips = next.audioClips;
+    resetContents();
+    emit timelineChanged();
+    update();
+}
+
+void Timeline::addCompoundClip(const QString &name, Ticks startTime)
+{
+    // A sequence can't play itself, however deep
+    if (!sequenceNames().contains(name) || sequenceNests(name, m_sequenceName)) {
+        qDebug() << "Can't nest" << name << "in" << m_sequenceName;
+        return;
+    }
+    const Ticks duration = sequenceDuration(name);
+    if (duration <= 0) {
+        qDebug() << "Sequence" << name << "is empty";
+        return;
+    }
+    addClip(Nesting::compoundPath(name), startTime, duration);
+}
+
+bool Timeline::sequenceClips(const QString &name, QVector<Clip> &clips, quint64 &version) const
+{
+    if (name == m_sequenceName) {
+        foldRippleOffsets();
+        clips = m_clips;
+        version = m_sequenceVersions.value(name);
+        return true;
+    }
+    for (const SequenceState &sequence : m_otherSequences) {
+        if (sequence.name == name) {
+            clips = sequence.clips;
+            version = m_sequenceVersions.value(name);
+            return true;
+        }
+    }
+    return false;
+}
+
+Ticks Timeline::sequenceDuration(const QString &name) const
+{
+    QVector<Clip> clips;
+    quint64 version = 0;
+    Ticks end = 0;
+    if (sequenceClips(name, clips, version)) {
+        for (const Clip &clip : clips) {
+            end = std::max(end, clip.endTime());
+        }
+    }
+    return end;
+}
+
+bool Timeline::sequenceNests(const QString &outer, const QString &inner) const
+{
+    if (outer == inner) {
+        return true;
+    }
+    QVector<Clip> clips;
+    quint64 version = 0;
+    if (!sequenceClips(outer, clips, version)) {
+        return false;
+    }
+    for (const Clip &clip : clips) {
+        if (Nesting::isCompound(clip.filePath()) && sequenceNests(Nesting::sequenceName(clip.filePath()), inner)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void Timeline::applyEdit(const TimelineEdit &edit)
+{
+    switch (edit.type) {
+    case TimelineEdit::AddClip:
+        addClip(edit.path, edit.time, edit.duration);
+        break;
+    case TimelineEdit::RemoveClip:
+        removeClip(edit.index);
+        break;
+    case TimelineEdit::ClearClips:
+        clearClips();
+        break;
+    case TimelineEdit::RippleDelete:
+        rippleDelete(edit.index);
+        break;
+    case TimelineEdit::RippleInsert:
+        rippleInsert(edit.path, edit.time, edit.duration);
+        break;
+    case TimelineEdit::RippleTrim: {
+        // Snapped when recorded; snapping again could move it
+        const bool keyframeSnap = m_keyframeSnapEnabled;
+        m_keyframeSnapEnabled = false;
+        rippleTrim(edit.index, edit.time, edit.duration);
+        m_keyframeSnapEnabled = keyframeSnap;
+        break;
+    }
+    case TimelineEdit::MoveClip:
+        moveClip(edit.index, edit.time);
+        break;
+    case TimelineEdit::AddMarker:
+        addMarker(edit.time);
+        break;
+    case TimelineEdit::SetTransition:
+        setClipTransition(edit.index, TransitionType(edit.value), edit.duration);
+        break;
+    case TimelineEdit::AddMulticam:
+        addMulticamClip(Multicam::decodeAngles(edit.path), edit.time, edit.duration);
+        break;
+    case TimelineEdit::CutToAngle:
+        cutToAngle(edit.time, edit.value);
+        break;
+    case TimelineEdit::TrimClip:
+        trimClip(edit.index, edit.time, edit.duration);
+        break;
+    case TimelineEdit::AddAudioClip:
+        addAudioClip(edit.path, edit.index, edit.time, edit.duration);
+        break;
+    case TimelineEdit::RemoveAudioClip:
+        removeAudioClip(edit.index);
+        break;
+    case TimelineEdit::MoveAudioClip:
+        moveAudioClip(edit.index, edit.value, edit.time);
+        break;
+    case TimelineEdit::SetAudioGain:
+        setAudioClipGain(edit.index, edit.value / 100.0);
+        break;
+    case TimelineEdit::SetAudioPan:
+        setAudioClipPan(edit.index, edit.value / 1000.0);
+        break;
+    case TimelineEdit::SetAudioFades:
+        setAudioClipFades(edit.index, edit.time, edit.duration);
+        break;
+    case TimelineEdit::SetProjectSettings: {
+        ProjectSettings settings;
+        if (Project::decode(edit.path, settings)) {
+            setSettings(settings);
+        }
+        break;
+    }
+    case TimelineEdit::OpenSequence:
+        openSequence(edit.path);
+        break;
+    case TimelineEdit::AddTrimmedClip:
+        addClip(edit.path, edit.time, edit.duration, edit.trimStart);
+        break;
+    }
+}
+
+void Timeline::recordEdit(TimelineEdit::Type type, int index, const QString &path,
+                          Ticks time, Ticks duration, int value, Ticks trimStart)
+{
+    // Every edit, replayed or not, makes the open sequence new to anything
+    // that flattened it
+    if (type != TimelineEdit::OpenSequence) {
+        m_sequenceVersions.insert(m_sequenceName, ++m_lastVersion);
+    }
+    if (!m_journal || m_replaying) {
+        return;
+    }
+
+    m_journal->append({type, index, path, time, duration, value, trimStart});
+
+    // Edits are recorded before they are applied, so the snapshot is taken
+    // once the current one (and any in the same batch) has finished
+    if (m_journal->wantsSnapshot() && !m_snapshotQueued) {
+        m_snapshotQueued = true;
+        QTimer::singleShot(0, this, [this]() {
+            m_snapshotQueued = false;
+            if (m_journal) {
+                m_journal->snapshot(state());
+            }
+        });
+    }
+}
+
+void Timeline::setPlayheadPosition(Ticks time)
 {
     if (m_playheadPosition != time) {
         m_playheadPosition = time;
@@ -103,9 +1020,34 @@ void Timeline::setPlayheadPosition(double time)
     }
 }
 
+void Timeline::setSettings(const ProjectSettings &settings)
+{
+    if (settings == m_settings || !Project::isValid(settings)) {
+        return;
+    }
+    recordEdit(TimelineEdit::SetProjectSettings, -1, Project::encode(settings), 0, 0);
+    m_settings = settings;
+    emit timelineChanged();
+    update();
+}
+
+void Timeline::addMarker(Ticks time)
+{
+    if (time < 0) {
+        time = 0;
+    }
+    recordEdit(TimelineEdit::AddMarker, -1, QString(), time, 0);
+    m_markers.append(time);
+    if (m_snapIndexValid) {
+        m_snapIndex.insertEdge(time);
+    }
+    update();
+}
+
 void Timeline::paintEvent(QPaintEvent *event)
 {
     Q_UNUSED(event);
+    foldRippleOffsets();
     QPainter painter(this);
     painter.setRenderHint(QPainter::Antialiasing);
     
@@ -127,7 +1069,7 @@ void Timeline::paintEvent(QPaintEvent *event)
     painter.setFont(font);
     
     for (int i = 0; i < width(); i += 100) {
-        double time = pixelToTime(i);
+        double time = Timebase::toSeconds(pixelToTime(i));
         painter.drawLine(i, rulerY + rulerHeight - 10, i, rulerY + rulerHeight);
         painter.drawText(i + 2, rulerY + rulerHeight - 15, QString::number(time, 'f', 1) + "s");
     }
@@ -139,14 +1081,39 @@ void Timeline::paintEvent(QPaintEvent *event)
     // Draw clip track background (slightly different color to show the area)
     painter.fillRect(0, clipAreaY, width(), clipAreaHeight, QColor(55, 55, 55));
     
-    // Draw each clip
-    for (int i = 0; i < m_clips.size(); ++i) {
+    // Draw the clips in view, including short ones drawn wider than
+    // they are that start just off the left edge
+    for (int i : clipsBetween(pixelToTime(-kMinClipWidth), pixelToTime(width()))) {
         painter.save();
         painter.translate(0, clipAreaY);
         drawClip(painter, m_clips[i], i);
         painter.restore();
     }
     
+    // Audio lanes under the video track
+    for (int track = 0; track < audioTrackCount(); ++track) {
+        painter.fillRect(0, kAudioLaneTop + track * kAudioLanePitch, width(), kAudioLaneHeight, QColor(50, 58, 52));
+    }
+    for (int i = 0; i < m_audioClips.size(); ++i) {
+        drawAudioClip(painter, m_audioClips[i], i);
+    }
+    
+    // Draw markers on the ruler
+    painter.setPen(QPen(QColor(80, 220, 120), 1));
+    for (Ticks marker : m_markers) {
+        int markerX = timeToPixel(marker);
+        if (markerX >= 0 && markerX <= width()) {
+            painter.drawLine(markerX, rulerY, markerX, clipAreaY + clipAreaHeight);
+        }
+    }
+    
+    // Draw the edge the dragged clip is snapped to
+    if (m_isDragging && m_snapIndicatorTime >= 0) {
+        int snapX = timeToPixel(m_snapIndicatorTime);
+        painter.setPen(QPen(QColor(255, 200, 0), 1, Qt::DashLine));
+        painter.drawLine(snapX, rulerY, snapX, height());
+    }
+    
     // Draw playhead indicator
     int playheadX = timeToPixel(m_playheadPosition);
     if (playheadX >= 0 && playheadX <= width()) {
@@ -170,8 +1137,13 @@ void Timeline::drawClip(QPainter &painter, const Clip &clip, int index)
     int height = 60;
     
     // Ensure minimum width for visibility
-    if (clipWidth < 50) {
-        clipWidth = 50;
+    if (clipWidth < kMinClipWidth) {
+        clipWidth = kMinClipWidth;
+    }
+    
+    // Skip clips outside the visible area
+    if (x > width() || x + clipWidth < 0) {
+        return;
     }
     
     // Clip background
@@ -189,12 +1161,15 @@ void Timeline::drawClip(QPainter &painter, const Clip &clip, int index)
     painter.setFont(font);
     
     QString fileName = clip.filePath().split('/').last();
+    if (clip.isMulticam()) {
+        fileName = QString("Cam %1/%2: %3").arg(clip.activeAngle() + 1).arg(clip.angles().size()).arg(fileName);
+    }
     QFontMetrics fm(font);
     QString elidedText = fm.elidedText(fileName, Qt::ElideMiddle, clipWidth - 10);
     painter.drawText(x + 5, 20, elidedText);
     
     // Duration text
-    QString durationText = QString::number(clip.duration(), 'f', 2) + "s";
+    QString durationText = QString::number(Timebase::toSeconds(clip.duration()), 'f', 2) + "s";
     painter.drawText(x + 5, 40, durationText);
     
     // Trim indicators
@@ -207,11 +1182,111 @@ void Timeline::drawClip(QPainter &painter, const Clip &clip, int index)
             painter.drawLine(x + clipWidth - 5, 0, x + clipWidth - 5, height);
         }
     }
+    
+    // Transition region, with a render bar: green once the render is
+    // cached, red while it would be composited live. Read from the last
+    // refresh, which may lag an edit by one pass of the event loop.
+    if (index < m_transitions.size() && m_transitions[index].active) {
+        const ClipTransition &transition = m_transitions[index];
+        int transitionWidth = std::max(4, timeToPixel(clip.startTime() + transition.spec.duration) - x);
+        bool rendered = transition.rendered;
+        painter.fillRect(x, 0, transitionWidth, height, QColor(255, 255, 255, 40));
+        painter.setPen(QPen(QColor(255, 255, 255), 1));
+        painter.drawLine(x, height, x + transitionWidth, 0);
+        painter.fillRect(x, 0, transitionWidth, 4, rendered ? QColor(80, 220, 120) : QColor(230, 70, 60));
+    }
+    
+    // Frames decoded from the previous keyframe before the in-point shows
+    // once the scan started by insertClip is done
+    if (clip.trimStart() > 0 && m_keyframeIndexer) {
+        if (const KeyframeIndex *keyframes = m_keyframeIndexer->cachedIndex(clip.filePath())) {
+            const KeyframeIndex::DecodeCost cost = keyframes->decodeCost(clip.trimStart());
+            if (cost.packets > 0) {
+                painter.setPen(QColor(255, 120, 60));
+                painter.drawText(x + 5, 55, QString("+%1f").arg(cost.packets));
+            }
+        }
+    }
+}
+
+void Timeline::drawAudioClip(QPainter &painter, const AudioClip &clip, int index)
+{
+    const int x = timeToPixel(clip.startTime);
+    const int clipWidth = std::max(timeToPixel(clip.startTime + clip.duration) - x, 4);
+    const int y = kAudioLaneTop + clip.track * kAudioLanePitch;
+    if (x > width() || x + clipWidth < 0) {
+        return;
+    }
+    
+    painter.fillRect(x, y, clipWidth, kAudioLaneHeight,
+                     index == m_selectedAudioClip ? QColor(90, 190, 120) : QColor(60, 150, 90));
+    painter.setPen(QPen(QColor(255, 255, 255), 1));
+    painter.drawRect(x, y, clipWidth, kAudioLaneHeight);
+    
+    // Fades as ramps from the clip's corners
+    painter.setPen(QPen(QColor(255, 255, 255, 160), 1));
+    if (clip.fadeIn > 0) {
+        painter.drawLine(x, y + kAudioLaneHeight, timeToPixel(clip.startTime + clip.fadeIn), y);
+    }
+    if (clip.fadeOut > 0) {
+        painter.drawLine(timeToPixel(clip.endTime() - clip.fadeOut), y, x + clipWidth, y + kAudioLaneHeight);
+    }
+    
+    QFont font = painter.font();
+    font.setPointSize(8);
+    painter.setFont(font);
+    painter.setPen(QColor(255, 255, 255));
+    QString label = clip.path.split('/').last();
+    if (clip.gainDb != 0.0) {
+        label += QString(" %1 dB").arg(clip.gainDb, 0, 'f', 1);
+    }
+    QFontMetrics fm(font);
+    painter.drawText(x + 5, y + 19, fm.elidedText(label, Qt::ElideMiddle, clipWidth - 10));
 }
 
 void Timeline::mousePressEvent(QMouseEvent *event)
 {
     if (event->button() == Qt::LeftButton) {
+        const int audioIndex = getAudioClipAtPosition(event->pos());
+        if (audioIndex >= 0) {
+            // Moved in place; committed as one edit on release
+            selectAudioClip(audioIndex);
+            m_isDraggingAudio = true;
+            m_dragClipIndex = audioIndex;
+            m_dragOriginStart = m_audioClips[audioIndex].startTime;
+            m_dragOriginTrack = m_audioClips[audioIndex].track;
+            m_dragOriginX = event->pos().x();
+            update();
+            return;
+        }
+        selectAudioClip(-1);
+        
+        bool inEdge = false;
+        int edgeIndex = clipEdgeAtPosition(event->pos(), inEdge);
+        if (edgeIndex >= 0) {
+            // Trimming moves the clip in place; the preview is rebuilt once
+            // on release
+            invalidateRippleIndex();
+            const Clip &clip = m_clips[edgeIndex];
+            m_selectedClipIndex = edgeIndex;
+            m_isResizing = true;
+            m_resizeInEdge = inEdge;
+            m_dragClipIndex = edgeIndex;
+            m_dragOriginStart = clip.startTime();
+            m_dragOriginX = event->pos().x();
+            m_resizeOriginTrim = clip.trimStart();
+            m_resizeOriginDuration = clip.duration();
+            // Unbounded until the length arrives if it isn't known yet
+            prefetchSourceLength(clip.filePath(), JobScheduler::Interactive);
+            m_resizeSourceLength = m_sourceLengths.value(clip.filePath());
+            m_removeClipButton->setEnabled(true);
+            m_rippleDeleteButton->setEnabled(true);
+            m_transitionButton->setEnabled(true);
+            emitTrimming(clip);
+            update();
+            return;
+        }
+        
         int clipIndex = getClipAtPosition(event->pos());
         
         if (clipIndex >= 0) {
@@ -219,12 +1294,27 @@ void Timeline::mousePressEvent(QMouseEvent *event)
             m_isDragging = true;
             m_dragClipIndex = clipIndex;
             m_lastMousePos = event->pos();
+            
+            // Take the dragged clip's edges out of the index so it
+            // doesn't snap to itself; they go back in on release.
+            // Moving a clip can reorder the ripple slots.
+            invalidateRippleIndex();
+            ensureSnapIndex();
+            const Clip &clip = m_clips[clipIndex];
+            m_dragOriginStart = clip.startTime();
+            m_dragOriginX = event->pos().x();
+            m_snapIndex.removeEdge(clip.startTime());
+            m_snapIndex.removeEdge(clip.endTime());
             m_removeClipButton->setEnabled(true);
+            m_rippleDeleteButton->setEnabled(true);
+            m_transitionButton->setEnabled(true);
             emit clipSelected(clipIndex);
             update();
         } else {
             m_selectedClipIndex = -1;
             m_removeClipButton->setEnabled(false);
+            m_rippleDeleteButton->setEnabled(false);
+            m_transitionButton->setEnabled(false);
             update();
         }
     } else if (event->button() == Qt::MiddleButton) {
@@ -236,16 +1326,59 @@ void Timeline::mousePressEvent(QMouseEvent *event)
 
 void Timeline::mouseMoveEvent(QMouseEvent *event)
 {
-    if (m_isDragging && m_dragClipIndex >= 0) {
-        int dx = event->pos().x() - m_lastMousePos.x();
-        double dt = dx / m_pixelsPerSecond; // Use raw pixels for drag
+    if (m_isDraggingAudio && m_dragClipIndex >= 0) {
+        AudioClip &clip = m_audioClips[m_dragClipIndex];
+        const Ticks delta = Timebase::fromSeconds((event->pos().x() - m_dragOriginX) / m_pixelsPerSecond);
+        // Onto any lane in use or a new one below them
+        const int lane = (event->pos().y() - kAudioLaneTop) / kAudioLanePitch;
+        clip.startTime = std::max<Ticks>(0, Timebase::snapToFrame(m_dragOriginStart + delta, m_settings.frameRate));
+        clip.track = std::max(0, std::min({lane, audioTrackCount(), AudioTracks::kMaxTracks - 1}));
+        update();
+    } else if (m_isResizing && m_dragClipIndex >= 0) {
+        const Ticks frame = Timebase::frameTicks(m_settings.frameRate);
+        const Ticks delta = Timebase::snapToFrame(
+            Timebase::fromSeconds((event->pos().x() - m_dragOriginX) / m_pixelsPerSecond), m_settings.frameRate);
+        Clip &clip = m_clips[m_dragClipIndex];
+        const Ticks previousTrim = clip.trimStart();
+        const Ticks previousDuration = clip.duration();
+        if (m_resizeInEdge) {
+            // Not before the source or the timeline starts, and at least a
+            // frame before the out-point
+            Ticks trim = std::max<Ticks>(m_resizeOriginTrim + delta, 0);
+            trim = std::max(trim, m_resizeOriginTrim - m_dragOriginStart);
+            trim = std::min(trim, m_resizeOriginTrim + m_resizeOriginDuration - frame);
+            clip.setTrimStart(trim);
+            clip.setStartTime(m_dragOriginStart + trim - m_resizeOriginTrim);
+            clip.setDuration(m_resizeOriginDuration - (trim - m_resizeOriginTrim));
+        } else {
+            Ticks duration = m_resizeOriginDuration + delta;
+            if (m_resizeSourceLength > 0) {
+                duration = std::min(duration, m_resizeSourceLength - m_resizeOriginTrim);
+            }
+            clip.setDuration(std::max(duration, frame));
+        }
+        if (clip.trimStart() != previousTrim || clip.duration() != previousDuration) {
+            emitTrimming(clip);
+            update();
+        }
+    } else if (m_isDragging && m_dragClipIndex >= 0) {
+        // Measure from the press position so snapping doesn't accumulate drift
+        int dx = event->pos().x() - m_dragOriginX;
+        Ticks newStartTime = m_dragOriginStart + Timebase::fromSeconds(dx / m_pixelsPerSecond);
         
         Clip &clip = m_clips[m_dragClipIndex];
-        double newStartTime = clip.startTime() + dt;
-        if (newStartTime >= 0) {
+        if (m_snapEnabled && !(event->modifiers() & Qt::ShiftModifier)) {
+            newStartTime = snapClipStart(newStartTime, clip.duration());
+        } else {
+            m_snapIndicatorTime = -1;
+        }
+        if (newStartTime < 0) {
+            newStartTime = 0;
+        }
+        if (newStartTime != clip.startTime()) {
+            // The preview is rebuilt once on release, not on every move
             clip.setStartTime(newStartTime);
             m_lastMousePos = event->pos();
-            emit timelineChanged();
             update();
         }
     } else if (m_isPanning) {
@@ -254,15 +1387,60 @@ void Timeline::mouseMoveEvent(QMouseEvent *event)
         if (m_scrollOffset < 0) m_scrollOffset = 0;
         m_lastMousePos = event->pos();
         update();
+    } else {
+        bool inEdge = false;
+        setCursor(clipEdgeAtPosition(event->pos(), inEdge) >= 0 ? Qt::SizeHorCursor : Qt::ArrowCursor);
     }
 }
 
 void Timeline::mouseReleaseEvent(QMouseEvent *event)
 {
     if (event->button() == Qt::LeftButton) {
+        if (m_isDraggingAudio && m_dragClipIndex >= 0) {
+            AudioClip &clip = m_audioClips[m_dragClipIndex];
+            const int track = clip.track;
+            const Ticks startTime = clip.startTime;
+            if (track != m_dragOriginTrack || startTime != m_dragOriginStart) {
+                clip.track = m_dragOriginTrack;
+                clip.startTime = m_dragOriginStart;
+                moveAudioClip(m_dragClipIndex, track, startTime);
+            }
+        }
+        m_isDraggingAudio = false;
+        bool moved = false;
+        if (m_isDragging && m_dragClipIndex >= 0) {
+            const Clip &clip = m_clips[m_dragClipIndex];
+            m_snapIndex.insertEdge(clip.startTime());
+            m_snapIndex.insertEdge(clip.endTime());
+            moved = clip.startTime() != m_dragOriginStart;
+            if (moved) {
+                recordEdit(TimelineEdit::MoveClip, m_dragClipIndex, QString(), clip.startTime(), 0);
+                // Painting may have rebuilt the index during the drag
+                m_rippleIndexValid = false;
+            }
+        }
+        if (m_isResizing && m_dragClipIndex >= 0) {
+            Clip &clip = m_clips[m_dragClipIndex];
+            const Ticks trimStart = clip.trimStart();
+            const Ticks duration = clip.duration();
+            if (trimStart != m_resizeOriginTrim || duration != m_resizeOriginDuration) {
+                // Back to where the drag began, so the commit is one
+                // journaled edit and one rebuild
+                clip.setStartTime(m_dragOriginStart);
+                clip.setTrimStart(m_resizeOriginTrim);
+                clip.setDuration(m_resizeOriginDuration);
+                trimClip(m_dragClipIndex, trimStart, duration);
+            }
+            emit trimFinished();
+        }
         m_isDragging = false;
         m_isResizing = false;
         m_dragClipIndex = -1;
+        m_snapIndicatorTime = -1;
+        if (moved) {
+            emit timelineChanged();
+        }
+        update();
     } else if (event->button() == Qt::MiddleButton) {
         m_isPanning = false;
         setCursor(Qt::ArrowCursor);
@@ -277,7 +1455,7 @@ void Timeline::wheelEvent(QWheelEvent *event)
     }
 
     double mouseX = event->position().x();
-    double timeAtMouse = pixelToTime(mouseX);
+    double timeAtMouse = Timebase::toSeconds(pixelToTime(mouseX));
 
     // Apply zoom
     m_pixelsPerSecond *= zoomFactor;
@@ -294,6 +1472,50 @@ void Timeline::wheelEvent(QWheelEvent *event)
     update();
 }
 
+void Timeline::dragEnterEvent(QDragEnterEvent *event)
+{
+    if (event->mimeData()->hasFormat(kMediaMimeType)) {
+        event->acceptProposedAction();
+    }
+}
+
+void Timeline::dragMoveEvent(QDragMoveEvent *event)
+{
+    if (event->mimeData()->hasFormat(kMediaMimeType)) {
+        event->acceptProposedAction();
+    }
+}
+
+void Timeline::dropEvent(QDropEvent *event)
+{
+    if (!event->mimeData()->hasFormat(kMediaMimeType)) {
+        return;
+    }
+
+    // Dropped assets are laid end to end from the drop point, with one
+    // rebuild for the lot
+    Ticks startTime = Timebase::snapToFrame(std::max<Ticks>(0, pixelToTime(event->position().x())), m_settings.frameRate);
+    const QList<QByteArray> lines = event->mimeData()->data(kMediaMimeType).split('\n');
+    beginBatch();
+    for (const QByteArray &line : lines) {
+        const QList<QByteArray> fields = line.split('\t');
+        if (fields.size() != 2) {
+            continue;
+        }
+        Ticks duration = fields[1].toLongLong();
+        if (duration <= 0) {
+            duration = 5 * Timebase::kTicksPerSecond; // Fallback default duration
+        }
+        // Whole frames, and at least one for assets shorter than a frame
+        duration = std::max(Timebase::fromFrame(Timebase::toFrame(duration, m_settings.frameRate), m_settings.frameRate),
+                            Timebase::frameTicks(m_settings.frameRate));
+        addClip(QString::fromUtf8(fields[0]), startTime, duration);
+        startTime += duration;
+    }
+    endBatch(true);
+    event->acceptProposedAction();
+}
+
 int Timeline::getClipAtPosition(const QPoint &pos)
 {
     int buttonAreaHeight = 35;
@@ -306,26 +1528,248 @@ int Timeline::getClipAtPosition(const QPoint &pos)
         return -1;
     }
     
-    double time = pixelToTime(pos.x());
+    Ticks time = pixelToTime(pos.x());
+    foldRippleOffsets();
     
-    for (int i = 0; i < m_clips.size(); ++i) {
-        const Clip &clip = m_clips[i];
-        if (time >= clip.startTime() && time <= clip.endTime()) {
+    const QVector<int> hits = clipsBetween(time, time);
+    return hits.isEmpty() ? -1 : hits.first();
+}
+
+int Timeline::getAudioClipAtPosition(const QPoint &pos) const
+{
+    const int track = audioTrackAtY(pos.y());
+    if (track < 0) {
+        return -1;
+    }
+    
+    // Last drawn is on top
+    const Ticks time = pixelToTime(pos.x());
+    for (int i = m_audioClips.size() - 1; i >= 0; --i) {
+        const AudioClip &clip = m_audioClips[i];
+        if (clip.track == track && time >= clip.startTime && time <= clip.endTime()) {
             return i;
         }
     }
-    
     return -1;
 }
 
-double Timeline::pixelToTime(int pixel) const
+int Timeline::audioTrackAtY(int y) const
+{
+    if (y < kAudioLaneTop) {
+        return -1;
+    }
+    const int track = (y - kAudioLaneTop) / kAudioLanePitch;
+    if ((y - kAudioLaneTop) % kAudioLanePitch > kAudioLaneHeight || track >= audioTrackCount()) {
+        return -1;
+    }
+    return track;
+}
+
+int Timeline::clipEdgeAtPosition(const QPoint &pos, bool &inEdge)
+{
+    int buttonAreaHeight = 35;
+    int rulerHeight = 30;
+    int clipAreaY = buttonAreaHeight + rulerHeight + 10;
+    int clipHeight = 60;
+    if (pos.y() < clipAreaY || pos.y() > clipAreaY + clipHeight) {
+        return -1;
+    }
+
+    foldRippleOffsets();
+    int best = -1;
+    int bestDistance = kTrimHandleWidth + 1;
+    const QVector<int> near = clipsBetween(pixelToTime(pos.x() - bestDistance), pixelToTime(pos.x() + bestDistance));
+    for (int i : near) {
+        const Clip &clip = m_clips[i];
+        const int inDistance = std::abs(pos.x() - timeToPixel(clip.startTime()));
+        const int outDistance = std::abs(pos.x() - timeToPixel(clip.endTime()));
+        if (inDistance < bestDistance) {
+            best = i;
+            bestDistance = inDistance;
+            inEdge = true;
+        }
+        if (outDistance < bestDistance) {
+            best = i;
+            bestDistance = outDistance;
+            inEdge = false;
+        }
+    }
+    return best;
+}
+
+void Timeline::emitTrimming(const Clip &clip)
+{
+    const Ticks lastFrame = clip.trimStart() + clip.duration() - Timebase::frameTicks(m_settings.frameRate);
+    emit trimming(clip.filePath(), clip.trimStart(), std::max(clip.trimStart(), lastFrame), m_resizeInEdge);
+}
+
+Ticks Timeline::snapClipStart(Ticks start, Ticks duration)
+{
+    Ticks tolerance = Timebase::fromSeconds(kSnapDistance / m_pixelsPerSecond);
+    Ticks bestDistance = tolerance;
+    Ticks snappedStart = start;
+    m_snapIndicatorTime = -1;
+
+    // Either edge of the clip may snap; keep whichever lands closest
+    auto consider = [&](Ticks edge, Ticks target, Ticks offset) {
+        Ticks distance = std::abs(edge - target);
+        if (distance <= bestDistance) {
+            bestDistance = distance;
+            snappedStart = target - offset;
+            m_snapIndicatorTime = target;
+        }
+    };
+
+    Ticks target = 0;
+    if (m_snapIndex.nearestEdge(start, tolerance, target)) {
+        consider(start, target, 0);
+    }
+    if (m_snapIndex.nearestEdge(start + duration, tolerance, target)) {
+        consider(start + duration, target, duration);
+    }
+    consider(start, m_playheadPosition, 0);
+    consider(start + duration, m_playheadPosition, duration);
+
+    if (m_snapIndicatorTime < 0) {
+        // Nothing nearby, fall back to the frame grid
+        snappedStart = Timebase::snapToFrame(start, m_settings.frameRate);
+    }
+    return snappedStart;
+}
+
+void Timeline::ensureSnapIndex()
+{
+    if (m_snapIndexValid) {
+        return;
+    }
+
+    foldRippleOffsets();
+    m_snapIndex.clear();
+    for (const Clip &clip : m_clips) {
+        m_snapIndex.insertEdge(clip.startTime());
+        m_snapIndex.insertEdge(clip.endTime());
+    }
+    for (Ticks marker : m_markers) {
+        m_snapIndex.insertEdge(marker);
+    }
+    m_snapIndexValid = true;
+}
+
+void Timeline::ensureRippleIndex()
+{
+    if (m_rippleIndexValid) {
+        return;
+    }
+
+    const int count = m_clips.size();
+    QVector<int> order(count);
+    for (int i = 0; i < count; ++i) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [this](int a, int b) {
+        return m_clips[a].startTime() < m_clips[b].startTime();
+    });
+
+    // Node n holds the start of the n-th clip in order
+    QVector<Ticks> starts(count);
+    m_rippleNodes.resize(count);
+    for (int node = 0; node < count; ++node) {
+        starts[node] = m_clips[order[node]].startTime();
+        m_rippleNodes[order[node]] = node;
+    }
+    m_rippleOffsets.assign(starts);
+    m_rippleClips = order;
+    m_rippleLongest = 0;
+    for (const Clip &clip : m_clips) {
+        m_rippleLongest = std::max(m_rippleLongest, clip.duration());
+    }
+    m_ripplePending = false;
+    m_rippleIndexValid = true;
+}
+
+void Timeline::invalidateRippleIndex()
+{
+    foldRippleOffsets();
+    m_rippleIndexValid = false;
+}
+
+void Timeline::foldRippleOffsets() const
+{
+    if (!m_ripplePending) {
+        return;
+    }
+
+    // One walk over the tree applies every pending ripple, then each
+    // clip reads its start
+    m_rippleOffsets.settle();
+    for (int i = 0; i < m_clips.size(); ++i) {
+        m_clips[i].setStartTime(m_rippleOffsets.timeOf(m_rippleNodes[i]));
+    }
+    m_ripplePending = false;
+}
+
+int Timeline::rippleClipAt(int position) const
+{
+    return m_rippleClips[m_rippleOffsets.nodeAt(position)];
+}
+
+QVector<int> Timeline::clipsBetween(Ticks from, Ticks to)
+{
+    // Only clips starting late enough to reach from, and no later than
+    // to, are looked at; the clip a drag is moving is checked on its own,
+    // as the index still has it where the drag began
+    ensureRippleIndex();
+    const int moving = m_isDragging || m_isResizing ? m_dragClipIndex : -1;
+    QVector<int> indexes;
+    const int last = m_rippleOffsets.upperBound(to);
+    for (int position = m_rippleOffsets.lowerBound(from - m_rippleLongest); position < last; ++position) {
+        const int index = rippleClipAt(position);
+        if (index != moving && m_clips[index].endTime() >= from) {
+            indexes.append(index);
+        }
+    }
+    if (moving >= 0 && m_clips[moving].startTime() <= to && m_clips[moving].endTime() >= from) {
+        indexes.append(moving);
+    }
+    std::sort(indexes.begin(), indexes.end());
+    return indexes;
+}
+
+void Timeline::detachClip(int index)
+{
+    const Clip &clip = m_clips[index];
+    if (m_snapIndexValid) {
+        m_snapIndex.removeEdge(clip.startTime());
+        m_snapIndex.removeEdge(clip.endTime());
+    }
+
+    if (m_rippleIndexValid) {
+        m_rippleOffsets.remove(m_rippleNodes[index]);
+        m_rippleNodes.remove(index);
+        for (int i = index; i < m_rippleNodes.size(); ++i) {
+            m_rippleClips[m_rippleNodes[i]] = i;
+        }
+    }
+    m_clips.remove(index);
+
+    if (m_selectedClipIndex == index) {
+        m_selectedClipIndex = -1;
+        m_removeClipButton->setEnabled(false);
+        m_rippleDeleteButton->setEnabled(false);
+        m_transitionButton->setEnabled(false);
+    } else if (m_selectedClipIndex > index) {
+        --m_selectedClipIndex;
+    }
+}
+
+Ticks Timeline::pixelToTime(int pixel) const
 {
-    return (pixel + m_scrollOffset) / m_pixelsPerSecond;
+    return Timebase::fromSeconds((pixel + m_scrollOffset) / m_pixelsPerSecond);
 }
 
-int Timeline::timeToPixel(double time) const
+int Timeline::timeToPixel(Ticks time) const
 {
-    return static_cast<int>(time * m_pixelsPerSecond - m_scrollOffset);
+    return static_cast<int>(Timebase::toSeconds(time) * m_pixelsPerSecond - m_scrollOffset);
 }
 
 void Timeline::onAddClipClicked()
@@ -334,44 +1778,324 @@ void Timeline::onAddClipClicked()
         this,
         "Select Video File",
         QString(),
-        "Video Files (*.mp4 *.avi *.mkv *.mov);;All Files (*)"
+        "Video Files (*.mp4 *.avi *.mkv *.mov);;Image Sequences (*.exr *.dpx *.png *.tif *.tiff *.jpg *.jpeg);;All Files (*)"
     );
 
     if (!fileName.isEmpty()) {
-        // Add clip at the end of timeline
-        double startTime = totalDuration();
-        double duration = getVideoDuration(fileName);
-        if (duration <= 0.0) {
-            duration = 5.0; // Fallback default duration
+        // Any frame of a numbered sequence adds the whole sequence
+        if (isFrameFile(fileName)) {
+            const QString pattern = ImageSequence::patternFor(fileName);
+            const ImageSequence *sequence = pattern.isEmpty() ? nullptr : ImageSequence::find(pattern);
+            if (sequence && sequence->presentCount() > 1) {
+                fileName = pattern;
+            }
         }
-        addClip(fileName, startTime, duration);
+
+        // Add clip at the end of timeline, wherever that is once the probe
+        // comes back
+        probeDuration(fileName, JobScheduler::Interactive, [this, fileName](Ticks duration) {
+            if (duration <= 0) {
+                duration = 5 * Timebase::kTicksPerSecond; // Fallback default duration
+            }
+            // Whole frames only, rounded down so the clip never runs past the
+            // source but at least one, from the first boundary clear of the
+            // last clip's frame
+            duration = std::max(Timebase::fromFrame(Timebase::toFrame(duration, m_settings.frameRate), m_settings.frameRate),
+                                Timebase::frameTicks(m_settings.frameRate));
+            addClip(fileName, Timebase::ceilToFrame(videoEnd(), m_settings.frameRate), duration);
+        });
     }
 }
 
 void Timeline::onRemoveClipClicked()
 {
-    if (m_selectedClipIndex >= 0) {
+    if (m_selectedAudioClip >= 0) {
+        removeAudioClip(m_selectedAudioClip);
+    } else if (m_selectedClipIndex >= 0) {
         removeClip(m_selectedClipIndex);
     }
 }
 
-double Timeline::getVideoDuration(const QString &filePath) const
+void Timeline::onTransitionClicked()
 {
-    // Use ffprobe to get video duration
-    QProcess process;
-    QStringList arguments;
-    arguments << "-v" << "error"
-              << "-show_entries" << "format=duration"
-              << "-of" << "default=noprint_wrappers=1:nokey=1"
-              << filePath;
+    if (m_selectedClipIndex < 0) {
+        return;
+    }
+
+    // Cycles none -> cross fade -> wipe
+    const Clip &clip = m_clips[m_selectedClipIndex];
+    TransitionType next = NoTransition;
+    if (clip.transitionType() == NoTransition) {
+        next = CrossFade;
+    } else if (clip.transitionType() == CrossFade) {
+        next = Wipe;
+    }
+    setClipTransition(m_selectedClipIndex, next, kDefaultTransitionLength);
+}
+
+void Timeline::onMulticamClicked()
+{
+    QStringList files = QFileDialog::getOpenFileNames(
+        this,
+        "Select Camera Angles",
+        QString(),
+        "Video Files (*.mp4 *.avi *.mkv *.mov);;All Files (*)"
+    );
+    if (files.size() < Multicam::kMinAngles) {
+        return;
+    }
+    if (files.size() > Multicam::kMaxAngles) {
+        qDebug() << "Multicam clips take at most" << Multicam::kMaxAngles << "angles";
+        files = files.mid(0, Multicam::kMaxAngles);
+    }
+
+    // Each angle's source time at a shared sync point, such as a clap
+    QStringList defaults;
+    for (int i = 0; i < files.size(); ++i) {
+        defaults.append("0");
+    }
+    bool ok = false;
+    const QString text = QInputDialog::getText(this, "Add Multicam",
+                                               "Sync point in each angle (seconds, comma separated):",
+                                               QLineEdit::Normal, defaults.join(", "), &ok);
+    if (!ok) {
+        return;
+    }
+    const QStringList fields = text.split(',');
+    if (fields.size() != files.size()) {
+        qDebug() << "Expected" << files.size() << "sync points, got" << fields.size();
+        return;
+    }
+
+    QVector<CameraAngle> angles;
+    for (int i = 0; i < files.size(); ++i) {
+        bool valid = false;
+        const double seconds = fields[i].trimmed().toDouble(&valid);
+        if (!valid || seconds < 0.0) {
+            qDebug() << "Invalid sync point" << fields[i];
+            return;
+        }
+        angles.append({files[i], Timebase::fromSeconds(seconds)});
+    }
+
+    // The group starts where the angle with the earliest sync point starts
+    Ticks earliest = angles[0].syncOffset;
+    for (const CameraAngle &angle : angles) {
+        earliest = std::min(earliest, angle.syncOffset);
+    }
+    for (CameraAngle &angle : angles) {
+        angle.syncOffset -= earliest;
+    }
+    if (!m_jobScheduler) {
+        addMulticamClip(angles, Timebase::ceilToFrame(videoEnd(), m_settings.frameRate), 5 * Timebase::kTicksPerSecond);
+        return;
+    }
+
+    // The angles are probed in parallel and one job waiting on them all
+    // finds the shortest run past the sync point
+    QVector<JobScheduler::JobId> probes;
+    for (const CameraAngle &angle : angles) {
+        const QString path = angle.path;
+        JobScheduler *jobs = m_jobScheduler;
+        probes.append(jobs->submit(JobScheduler::Interactive, [jobs, path](const JobScheduler::Context &context) {
+            return QVariant(durationOf(jobs, path, context.token));
+        }, JobScheduler::Done(), QVector<JobScheduler::JobId>(), m_jobToken));
+    }
+    m_jobScheduler->submit(JobScheduler::Interactive, [angles](const JobScheduler::Context &context) {
+        Ticks duration = -1;
+        for (int i = 0; i < angles.size(); ++i) {
+            const Ticks length = context.inputs[i].toLongLong() - angles[i].syncOffset;
+            duration = duration < 0 ? length : std::min(duration, length);
+        }
+        return QVariant(duration);
+    }, [this, angles](const QVariant &result) {
+        Ticks duration = result.toLongLong();
+        if (duration <= 0) {
+            duration = 5 * Timebase::kTicksPerSecond; // Fallback default duration
+        }
+        duration = Timebase::fromFrame(Timebase::toFrame(duration, m_settings.frameRate), m_settings.frameRate);
+        addMulticamClip(angles, Timebase::ceilToFrame(videoEnd(), m_settings.frameRate), duration);
+    }, probes, m_jobToken);
+}
+
+void Timeline::onAddAudioClicked()
+{
+    const QString fileName = QFileDialog::getOpenFileName(
+        this,
+        "Select Audio File",
+        QString(),
+        "Audio Files (*.wav *.flac *.mp3 *.m4a *.aac *.ogg *.opus);;All Files (*)"
+    );
+    if (fileName.isEmpty()) {
+        return;
+    }
+    
+    bool ok = false;
+    const int track = QInputDialog::getInt(this, "Add Audio", "Audio track:", std::max(1, audioTrackCount()),
+                                           1, AudioTracks::kMaxTracks, 1, &ok);
+    if (!ok) {
+        return;
+    }
+    
+    // At the playhead as it was when asked; audio keeps its full length
+    // rather than whole frames
+    const Ticks startTime = Timebase::snapToFrame(m_playheadPosition, m_settings.frameRate);
+    probeDuration(fileName, JobScheduler::Interactive, [this, fileName, track, startTime](Ticks duration) {
+        if (duration <= 0) {
+            duration = 5 * Timebase::kTicksPerSecond; // Fallback default duration
+        }
+        addAudioClip(fileName, track - 1, startTime, duration);
+    });
+}
+
+void Timeline::onAudioMixClicked()
+{
+    if (m_selectedAudioClip < 0) {
+        return;
+    }
+    
+    const int index = m_selectedAudioClip;
+    const AudioClip clip = m_audioClips[index];
+    bool ok = false;
+    const QString text = QInputDialog::getText(this, "Audio Mix",
+                                               "Gain (dB), pan (-1 to 1), fade in and fade out (seconds):",
+                                               QLineEdit::Normal,
+                                               QString("%1, %2, %3, %4")
+                                                   .arg(clip.gainDb)
+                                                   .arg(clip.pan)
+                                                   .arg(Timebase::toSeconds(clip.fadeIn))
+                                                   .arg(Timebase::toSeconds(clip.fadeOut)),
+                                               &ok);
+    if (!ok) {
+        return;
+    }
+    const QStringList fields = text.split(',');
+    double values[4] = {0.0, 0.0, 0.0, 0.0};
+    for (int i = 0; i < 4; ++i) {
+        bool valid = i < fields.size();
+        if (valid) {
+            values[i] = fields[i].trimmed().toDouble(&valid);
+        }
+        if (!valid) {
+            qDebug() << "Expected gain, pan, fade in and fade out, got" << text;
+            return;
+        }
+    }
+    
+    // Up to three edits, one preview rebuild
+    const bool wasBlocked = blockSignals(true);
+    if (values[0] != clip.gainDb) {
+        setAudioClipGain(index, values[0]);
+    }
+    if (values[1] != clip.pan) {
+        setAudioClipPan(index, values[1]);
+    }
+    const Ticks fadeIn = Timebase::fromSeconds(std::max(0.0, values[2]));
+    const Ticks fadeOut = Timebase::fromSeconds(std::max(0.0, values[3]));
+    if (fadeIn != clip.fadeIn || fadeOut != clip.fadeOut) {
+        setAudioClipFades(index, fadeIn, fadeOut);
+    }
+    blockSignals(wasBlocked);
+    emit timelineChanged();
+}
+
+void Timeline::onSequenceClicked()
+{
+    // Typing a new name starts an empty sequence
+    bool ok = false;
+    const QStringList names = sequenceNames();
+    const QString name = QInputDialog::getItem(this, "Sequence", "Open sequence:", names,
+                                               names.indexOf(m_sequenceName), true, &ok);
+    if (ok) {
+        openSequence(name);
+    }
+}
+
+void Timeline::onAddSequenceClicked()
+{
+    QStringList names;
+    for (const QString &name : sequenceNames()) {
+        if (!sequenceNests(name, m_sequenceName) && sequenceDuration(name) > 0) {
+            names.append(name);
+        }
+    }
+    if (names.isEmpty()) {
+        qDebug() << "No other sequence with clips to nest in" << m_sequenceName;
+        return;
+    }
+
+    bool ok = false;
+    const QString name = QInputDialog::getItem(this, "Add Sequence", "Sequence to nest:", names, 0, false, &ok);
+    if (ok) {
+        addCompoundClip(name, Timebase::ceilToFrame(videoEnd(), m_settings.frameRate));
+    }
+}
+
+void Timeline::onRippleDeleteClicked()
+{
+    if (m_selectedClipIndex >= 0) {
+        rippleDelete(m_selectedClipIndex);
+    }
+}
 
-    process.start("ffprobe", arguments);
-    if (!process.waitForFinished(5000)) {
-        return 0.0;
+void Timeline::onAddMarkerClicked()
+{
+    addMarker(m_playheadPosition);
+}
+
+JobScheduler::JobId Timeline::probeDuration(const QString &filePath, JobScheduler::Priority priority,
+                                            const std::function<void(Ticks)> &done)
+{
+    // Compound clips are as long as their sequence
+    if (Nesting::isCompound(filePath)) {
+        done(sequenceDuration(Nesting::sequenceName(filePath)));
+        return 0;
+    }
+
+    // Sequences are counted from their index, on this thread
+    if (ImageSequence::isSequence(filePath)) {
+        const ImageSequence *sequence = ImageSequence::find(filePath);
+        done(sequence ? sequence->duration(m_settings.frameRate) : 0);
+        return 0;
+    }
+    if (!m_jobScheduler) {
+        done(0);
+        return 0;
+    }
+
+    JobScheduler *jobs = m_jobScheduler;
+    return jobs->submit(priority, [jobs, filePath](const JobScheduler::Context &context) {
+        return QVariant(durationOf(jobs, filePath, context.token));
+    }, [done](const QVariant &result) {
+        done(result.toLongLong());
+    }, QVector<JobScheduler::JobId>(), m_jobToken);
+}
+
+void Timeline::prefetchSourceLength(const QString &filePath, JobScheduler::Priority priority)
+{
+    if (m_sourceLengths.contains(filePath)) {
+        return;
+    }
+    // A probe queued in the background is hurried along once a trim needs it
+    auto probing = m_probingLengths.constFind(filePath);
+    if (probing != m_probingLengths.constEnd()) {
+        if (probing.value() != 0 && m_jobScheduler) {
+            m_jobScheduler->raise(probing.value(), priority);
+        }
+        return;
     }
 
-    QString output = QString::fromUtf8(process.readAllStandardOutput()).trimmed();
-    bool ok;
-    double duration = output.toDouble(&ok);
-    return ok ? duration : 0.0;
+    // A trim already under way picks the length up when it lands
+    m_probingLengths.insert(filePath, 0);
+    const JobScheduler::JobId job = probeDuration(filePath, priority, [this, filePath](Ticks length) {
+        m_probingLengths.remove(filePath);
+        m_sourceLengths.insert(filePath, length);
+        if (m_isResizing && m_dragClipIndex >= 0 && m_dragClipIndex < m_clips.size()
+            && m_clips[m_dragClipIndex].filePath() == filePath) {
+            m_resizeSourceLength = length;
+        }
+    });
+    if (m_probingLengths.contains(filePath)) {
+        m_probingLengths.insert(filePath, job);
+    }
 }
@@ -0,0 +1,120 @@
+#include "Transition.h"
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QFileInfo>
+
+namespace {
+// Bump when the graph changes so stale renders are not reused
+const char kGraphVersion[] = "3";
+
+// Escapes a value for a filter option, then for the graph around it
+QString escapeFilterValue(const QString &value)
+{
+    QString option;
+    for (QChar c : value) {
+        if (c == '\\' || c == '\'' || c == ':') {
+            option += '\\';
+        }
+        option += c;
+    }
+
+    QString graph;
+    for (QChar c : option) {
+        if (c == '\\' || c == '\'' || c == '[' || c == ']' || c == ',' || c == ';') {
+            graph += '\\';
+        }
+        graph += c;
+    }
+    return graph;
+}
+
+// Brings both sides to the same size, rate and format for xfade
+QString normalizeFilter(const TransitionSpec &spec)
+{
+    return QString("scale=%1:%2:force_original_aspect_ratio=decrease,"
+                   "pad=%1:%2:(ow-iw)/2:(oh-ih)/2,setsar=1,fps=%3/%4,format=yuv420p")
+        .arg(spec.format.width)
+        .arg(spec.format.height)
+        .arg(spec.format.frameRate.numerator)
+        .arg(spec.format.frameRate.denominator);
+}
+
+QString xfadeName(TransitionType type)
+{
+    return type == Wipe ? QString("wipeleft") : QString("fade");
+}
+
+void addSource(QCryptographicHash &hash, const QString &path)
+{
+    const QFileInfo info(path);
+    hash.addData(info.absoluteFilePath().toUtf8());
+    hash.addData(QByteArray::number(info.size()));
+    hash.addData(QByteArray::number(info.lastModified().toMSecsSinceEpoch()));
+}
+}
+
+namespace Transitions {
+
+QString name(TransitionType type)
+{
+    switch (type) {
+    case CrossFade:
+        return "Cross Fade";
+    case Wipe:
+        return "Wipe";
+    case NoTransition:
+        break;
+    }
+    return "None";
+}
+
+QString lavfiGraph(const TransitionSpec &spec, Sound sound)
+{
+    // Both sides start at the cut, as the sound does; tpad holds the last
+    // frame when the cut is at the very end of the source
+    const QString duration = Timebase::toEdlSeconds(spec.duration);
+    const QString normalize = normalizeFilter(spec);
+
+    QString graph = QString("movie=%1:seek_point=%2,trim=start=%2,setpts=PTS-STARTPTS,%3,"
+                            "tpad=stop_mode=clone:stop_duration=%4,trim=duration=%4[from];")
+                        .arg(escapeFilterValue(spec.fromSource), Timebase::toEdlSeconds(spec.fromOut),
+                             normalize, duration);
+    graph += QString("movie=%1:seek_point=%2,trim=start=%2:duration=%3,setpts=PTS-STARTPTS,%4[to];")
+                 .arg(escapeFilterValue(spec.toSource), Timebase::toEdlSeconds(spec.toIn),
+                      duration, normalize);
+    graph += QString("[from][to]xfade=transition=%1:duration=%2:offset=0[out0]")
+                 .arg(xfadeName(spec.type), duration);
+    if (sound == Silence) {
+        graph += QString(";anullsrc=r=%1:cl=stereo,atrim=duration=%2[out1]")
+                     .arg(spec.format.sampleRate)
+                     .arg(duration);
+    } else if (sound == SourceSound) {
+        // The outgoing sound carries on past its cut, padded with silence
+        // where its source ends, and fades under the incoming sound
+        const QString audioFormat = QString("aresample=%1,aformat=channel_layouts=stereo,apad,atrim=duration=%2")
+                                        .arg(spec.format.sampleRate)
+                                        .arg(duration);
+        graph += QString(";amovie=%1:seek_point=%2,atrim=start=%2,asetpts=PTS-STARTPTS,%3[afrom]")
+                     .arg(escapeFilterValue(spec.fromSource), Timebase::toEdlSeconds(spec.fromOut), audioFormat);
+        graph += QString(";amovie=%1:seek_point=%2,atrim=start=%2,asetpts=PTS-STARTPTS,%3[ato]")
+                     .arg(escapeFilterValue(spec.toSource), Timebase::toEdlSeconds(spec.toIn), audioFormat);
+        graph += QString(";[afrom][ato]acrossfade=d=%1[out1]").arg(duration);
+    }
+    return graph;
+}
+
+QByteArray cacheKey(const TransitionSpec &spec)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(QByteArray(kGraphVersion));
+    addSource(hash, spec.fromSource);
+    hash.addData(QByteArray::number(spec.fromOut));
+    addSource(hash, spec.toSource);
+    hash.addData(QByteArray::number(spec.toIn));
+    hash.addData(QByteArray::number(int(spec.type)));
+    hash.addData(QByteArray::number(spec.duration));
+    hash.addData(Project::encode(spec.format).toUtf8());
+    return hash.result().toHex();
+}
+
+}
@@ -0,0 +1,114 @@
+#include "TransitionCache.h"
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QStandardPaths>
+
+namespace {
+QStringList renderArguments(const TransitionSpec &spec, Transitions::Sound sound, const QString &partFile)
+{
+    QStringList arguments;
+    arguments << "-v" << "error" << "-y"
+              << "-filter_complex" << Transitions::lavfiGraph(spec, sound)
+              << "-map" << "[out0]" << "-map" << "[out1]" << "-c:a" << "aac" << "-b:a" << "192k"
+              << "-c:v" << "libx264" << "-preset" << "veryfast" << "-crf" << "18"
+              << "-pix_fmt" << "yuv420p"
+              << "-t" << Timebase::toEdlSeconds(spec.duration)
+              << partFile;
+    return arguments;
+}
+
+// Runs on a worker: renders beside file and moves the render into place
+// once it is whole
+bool renderTransition(JobScheduler *jobs, const TransitionSpec &spec, const QString &file, const CancelToken &token)
+{
+    const QString partFile = file + ".part.mkv";
+    QByteArray errors;
+    bool ok = jobs->streamProcess("ffmpeg", renderArguments(spec, Transitions::SourceSound, partFile), token,
+                                  JobScheduler::Output(), &errors);
+    // amovie fails on sources without sound; those get silence, so every
+    // render has the same streams for its EDL segment
+    if (!ok && !token.isCancelled()) {
+        ok = jobs->streamProcess("ffmpeg", renderArguments(spec, Transitions::Silence, partFile), token,
+                                 JobScheduler::Output(), &errors);
+    }
+    if (!ok) {
+        if (!token.isCancelled()) {
+            qDebug() << "Transition render failed:" << QString::fromUtf8(errors).trimmed();
+        }
+        QFile::remove(partFile);
+        return false;
+    }
+    QFile::remove(file);
+    return QFile::rename(partFile, file);
+}
+}
+
+TransitionCache::TransitionCache(JobScheduler *jobs, QObject *parent)
+    : QObject(parent)
+    , m_jobs(jobs)
+{
+    m_cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/transitions";
+    QDir().mkpath(m_cacheDir);
+}
+
+TransitionCache::~TransitionCache()
+{
+    // Running renders are killed, and remove their partial files
+    m_token.cancel();
+}
+
+QString TransitionCache::fileFor(const QByteArray &key) const
+{
+    return m_cacheDir + "/" + QString::fromLatin1(key) + ".mkv";
+}
+
+QString TransitionCache::renderedFile(const TransitionSpec &spec) const
+{
+    return renderedFile(Transitions::cacheKey(spec));
+}
+
+QString TransitionCache::renderedFile(const QByteArray &key) const
+{
+    const QString file = fileFor(key);
+    if (m_rendered.contains(key)) {
+        return file;
+    }
+    // Renders left by earlier sessions
+    if (!m_pending.contains(key) && QFile::exists(file)) {
+        m_rendered.insert(key);
+        return file;
+    }
+    return QString();
+}
+
+void TransitionCache::request(const TransitionSpec &spec)
+{
+    const QByteArray key = Transitions::cacheKey(spec);
+    if (m_pending.contains(key) || m_failed.contains(key) || !renderedFile(spec).isEmpty()) {
+        return;
+    }
+
+    // The scheduler caps the renders along with every other ffmpeg
+    m_pending.insert(key);
+    JobScheduler *jobs = m_jobs;
+    const QString file = fileFor(key);
+    const CancelToken token = m_token;
+    m_jobs->submitProcess(JobScheduler::Background,
+                          [jobs, spec, file, token](const JobScheduler::Context &) {
+                              return renderTransition(jobs, spec, file, token);
+                          },
+                          [this, key](const QVariant &result) { onRendered(key, result.toBool()); },
+                          QVector<JobScheduler::JobId>(), token);
+}
+
+void TransitionCache::onRendered(const QByteArray &key, bool ok)
+{
+    m_pending.remove(key);
+    if (!ok) {
+        m_failed.insert(key);
+        return;
+    }
+    m_rendered.insert(key);
+    emit rendered(fileFor(key));
+}
@@ -0,0 +1,67 @@
+#include "TrimPreview.h"
+#include <QPainter>
+
+namespace {
+QString timecode(Ticks time)
+{
+    const double seconds = Timebase::toSeconds(time);
+    const int minutes = int(seconds / 60.0);
+    return QString("%1:%2").arg(minutes, 2, 10, QChar('0')).arg(seconds - minutes * 60.0, 6, 'f', 3, QChar('0'));
+}
+}
+
+TrimPreview::TrimPreview(QWidget *parent)
+    : QWidget(parent)
+    , m_times{0, 0}
+{
+    setAttribute(Qt::WA_OpaquePaintEvent);
+}
+
+void TrimPreview::setFrame(int side, const QImage &frame)
+{
+    if (side < InPoint || side > OutPoint) {
+        return;
+    }
+    m_frames[side] = frame;
+    update();
+}
+
+void TrimPreview::setTimes(Ticks inPoint, Ticks outPoint)
+{
+    m_times[InPoint] = inPoint;
+    m_times[OutPoint] = outPoint;
+    update();
+}
+
+void TrimPreview::clear()
+{
+    m_frames[InPoint] = QImage();
+    m_frames[OutPoint] = QImage();
+    update();
+}
+
+void TrimPreview::paintEvent(QPaintEvent *event)
+{
+    Q_UNUSED(event);
+
+    QPainter painter(this);
+    painter.fillRect(rect(), Qt::black);
+    painter.setRenderHint(QPainter::SmoothPixmapTransform);
+    painter.setPen(Qt::white);
+
+    const int half = width() / 2;
+    const char *labels[] = {"In", "Out"};
+    for (int side = InPoint; side <= OutPoint; ++side) {
+        const QRect cell(side * half, 0, half, height());
+        if (!m_frames[side].isNull()) {
+            QSize size = m_frames[side].size();
+            size.scale(cell.size() - QSize(8, 32), Qt::KeepAspectRatio);
+            const QRect target(QPoint(cell.x() + (cell.width() - size.width()) / 2,
+                                      cell.y() + (cell.height() - size.height()) / 2),
+                               size);
+            painter.drawImage(target, m_frames[side]);
+        }
+        painter.drawText(cell.adjusted(12, 8, -12, -8), Qt::AlignBottom | Qt::AlignHCenter,
+                         QString("%1  %2").arg(labels[side], timecode(m_times[side])));
+    }
+}
@@ -0,0 +1,234 @@
+#include "VideoScopes.h"
+#include "ScopeKernels.h"
+#include <QMutexLocker>
+#include <QThread>
+#include <algorithm>
+#include <vector>
+
+namespace {
+using ScopeKernels::kLevels;
+
+const int kHistogramHeight = 128;
+
+// Share of the frame a bin needs to reach full brightness: 1/16 of a
+// column in the waveform and parade, 1/1024 of the frame in the
+// vectorscope
+const qint64 kColumnGain = 16;
+const qint64 kVectorGain = 1024;
+
+// Weight of the newest frame in the averaged timings
+const double kTimingWeight = 0.1;
+
+QRgb scaled(QRgb colour, int level)
+{
+    return qRgb(qRed(colour) * level / 255, qGreen(colour) * level / 255, qBlue(colour) * level / 255);
+}
+
+// One waveform pane: a column per pixel column, level 255 at the top
+void drawColumns(const quint32 *bins, int width, int height, QRgb colour, QImage &image, int left)
+{
+    const qint64 gain = 255 * kColumnGain;
+    for (int level = 0; level < kLevels; ++level) {
+        QRgb *line = reinterpret_cast<QRgb *>(image.scanLine(kLevels - 1 - level)) + left;
+        for (int x = 0; x < width; ++x) {
+            const qint64 brightness = std::min<qint64>(255, bins[x * kLevels + level] * gain / height);
+            line[x] = scaled(colour, int(brightness));
+        }
+    }
+}
+
+QImage drawWaveform(const uchar *pixels, int width, int height, int stride, std::vector<quint32> &bins)
+{
+    bins.assign(size_t(width) * kLevels, 0);
+    ScopeKernels::waveform(pixels, width, height, stride, bins.data());
+    QImage image(width, kLevels, QImage::Format_RGB32);
+    drawColumns(bins.data(), width, height, qRgb(170, 255, 170), image, 0);
+    return image;
+}
+
+QImage drawParade(const uchar *pixels, int width, int height, int stride, std::vector<quint32> &bins)
+{
+    bins.assign(size_t(3) * width * kLevels, 0);
+    ScopeKernels::parade(pixels, width, height, stride, bins.data());
+    QImage image(3 * width, kLevels, QImage::Format_RGB32);
+    const QRgb colours[3] = {qRgb(255, 90, 90), qRgb(90, 255, 90), qRgb(110, 140, 255)};
+    for (int channel = 0; channel < 3; ++channel) {
+        drawColumns(bins.data() + size_t(channel) * width * kLevels, width, height, colours[channel], image, channel * width);
+    }
+    return image;
+}
+
+QImage drawVectorscope(const uchar *pixels, int width, int height, int stride, std::vector<quint32> &bins)
+{
+    bins.assign(size_t(kLevels) * kLevels, 0);
+    ScopeKernels::vectorscope(pixels, width, height, stride, bins.data());
+    QImage image(kLevels, kLevels, QImage::Format_RGB32);
+    const qint64 gain = 255 * kVectorGain;
+    const qint64 count = std::max<qint64>(1, qint64(width) * height);
+    for (int cr = 0; cr < kLevels; ++cr) {
+        QRgb *line = reinterpret_cast<QRgb *>(image.scanLine(kLevels - 1 - cr));
+        const quint32 *row = bins.data() + cr * kLevels;
+        for (int cb = 0; cb < kLevels; ++cb) {
+            line[cb] = scaled(qRgb(170, 255, 170), int(std::min<qint64>(255, row[cb] * gain / count)));
+        }
+    }
+    return image;
+}
+
+QImage drawHistogram(const uchar *pixels, int width, int height, int stride, std::vector<quint32> &bins)
+{
+    bins.assign(size_t(4) * kLevels, 0);
+    ScopeKernels::histogram(pixels, width, height, stride, bins.data());
+
+    // Scaled to the tallest bin short of the ends, so clipped frames
+    // don't flatten everything else
+    quint32 peak = 1;
+    for (int channel = 0; channel < 4; ++channel) {
+        const quint32 *channelBins = bins.data() + channel * kLevels;
+        peak = std::max(peak, *std::max_element(channelBins + 1, channelBins + kLevels - 1));
+    }
+
+    QImage image(kLevels, kHistogramHeight, QImage::Format_RGB32);
+    image.fill(qRgb(0, 0, 0));
+    for (int level = 0; level < kLevels; ++level) {
+        int heights[4];
+        for (int channel = 0; channel < 4; ++channel) {
+            heights[channel] = int(std::min<qint64>(kHistogramHeight, qint64(bins[channel * kLevels + level]) * kHistogramHeight / peak));
+        }
+        for (int y = 0; y < kHistogramHeight; ++y) {
+            const QRgb colour = y == heights[3] - 1 ? qRgb(255, 255, 255)
+                                                    : qRgb(y < heights[0] ? 200 : 0, y < heights[1] ? 200 : 0, y < heights[2] ? 200 : 0);
+            reinterpret_cast<QRgb *>(image.scanLine(kHistogramHeight - 1 - y))[level] = colour;
+        }
+    }
+    return image;
+}
+}
+
+VideoScopes::VideoScopes(QObject *parent)
+    : QObject(parent)
+    , m_thread(nullptr)
+    , m_stopping(false)
+    , m_framesPerSecond(0.0)
+    , m_enabled(false)
+    , m_busy(false)
+    , m_lastFrameMs(-1000)
+{
+    std::fill(m_computeMs, m_computeMs + ScopeCount, -1.0);
+    m_clock.start();
+    m_thread = QThread::create([this]() { run(); });
+    m_thread->setObjectName("video-scopes");
+    m_thread->start();
+}
+
+VideoScopes::~VideoScopes()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_stopping = true;
+        m_wake.wakeOne();
+    }
+    m_thread->wait();
+    delete m_thread;
+}
+
+void VideoScopes::setEnabled(bool enabled)
+{
+    m_enabled = enabled;
+}
+
+bool VideoScopes::wantsFrame() const
+{
+    return m_enabled && !m_busy && m_clock.elapsed() - m_lastFrameMs >= 1000 / kMaxRate;
+}
+
+void VideoScopes::submit(const QImage &frame)
+{
+    if (frame.isNull()) {
+        return;
+    }
+    m_busy = true;
+    m_lastFrameMs = m_clock.elapsed();
+
+    QMutexLocker locker(&m_mutex);
+    m_pending = frame;
+    m_wake.wakeOne();
+}
+
+QImage VideoScopes::image(Scope scope) const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_images[scope];
+}
+
+double VideoScopes::computeMs(Scope scope) const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_computeMs[scope];
+}
+
+double VideoScopes::framesPerSecond() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_framesPerSecond;
+}
+
+qint64 VideoScopes::memoryUsed() const
+{
+    QMutexLocker locker(&m_mutex);
+    qint64 bytes = m_pending.sizeInBytes();
+    for (const QImage &image : m_images) {
+        bytes += image.sizeInBytes();
+    }
+    return bytes;
+}
+
+void VideoScopes::run()
+{
+    typedef QImage (*DrawScope)(const uchar *, int, int, int, std::vector<quint32> &);
+    const DrawScope draw[ScopeCount] = {drawWaveform, drawParade, drawVectorscope, drawHistogram};
+
+    std::vector<quint32> bins;
+    QElapsedTimer rateClock;
+    rateClock.start();
+    int framesThisSecond = 0;
+    while (true) {
+        QImage frame;
+        {
+            QMutexLocker locker(&m_mutex);
+            while (m_pending.isNull() && !m_stopping) {
+                m_wake.wait(&m_mutex);
+            }
+            if (m_stopping) {
+                return;
+            }
+            frame = m_pending;
+            m_pending = QImage();
+        }
+
+        QImage images[ScopeCount];
+        double ms[ScopeCount];
+        for (int scope = 0; scope < ScopeCount; ++scope) {
+            QElapsedTimer timer;
+            timer.start();
+            images[scope] = draw[scope](frame.constBits(), frame.width(), frame.height(), frame.bytesPerLine(), bins);
+            ms[scope] = timer.nsecsElapsed() / 1e6;
+        }
+
+        ++framesThisSecond;
+        {
+            QMutexLocker locker(&m_mutex);
+            for (int scope = 0; scope < ScopeCount; ++scope) {
+                m_images[scope] = images[scope];
+                m_computeMs[scope] = m_computeMs[scope] < 0 ? ms[scope]
+                                   : m_computeMs[scope] + kTimingWeight * (ms[scope] - m_computeMs[scope]);
+            }
+            if (rateClock.elapsed() >= 1000) {
+                m_framesPerSecond = framesThisSecond * 1000.0 / rateClock.restart();
+                framesThisSecond = 0;
+            }
+        }
+        m_busy = false;
+        emit updated();
+    }
+}
@@ -1,16 +1,24 @@
 #include "MainWindow.h"
+#include "StartupProfile.h"
 #include <QApplication>
 
 int main(int argc, char *argv[]) {
+  StartupProfile::start();
   QApplication app(argc, argv);
 
   // Set application metadata
   app.setApplicationName("mvideo");
   app.setApplicationDisplayName("MVideo Editor - bilibili");
   app.setOrganizationName("isomoses");
+  StartupProfile::mark("application");
 
+  // --headless takes automation requests on stdin instead of showing a window
   MainWindow window;
-  window.show();
+  if (app.arguments().contains("--headless")) {
+    window.startHeadless();
+  } else {
+    window.show();
+  }
 
   return app.exec();
 }